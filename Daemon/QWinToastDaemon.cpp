@@ -0,0 +1,264 @@
+#include "QWinToastDaemon.h"
+#include "QWinToastClock.h"
+#include "QWinToastCodec.h"
+#include "QWinToastFrame.h"
+#include <QDataStream>
+#include <QFutureWatcher>
+
+QWinToastDaemon::QWinToastDaemon(QWinToast* toast, const Quota& quota, QObject* parent) :
+	QObject(parent),
+	_toast(toast),
+	_quota(quota)
+{
+	_server.setSocketOptions(QLocalServer::UserAccessOption);
+	connect(&_server, &QLocalServer::newConnection, this, &QWinToastDaemon::acceptConnection);
+}
+
+QWinToastDaemon::~QWinToastDaemon()
+{
+}
+
+bool QWinToastDaemon::listen(const QString& name)
+{
+	_errorString.clear();
+	// A live daemon answers; its name must not be taken over.
+	QLocalSocket probe;
+	probe.connectToServer(name);
+	if (probe.waitForConnected(250)) {
+		probe.abort();
+		_errorString = QStringLiteral("A daemon is already running under this name");
+		return false;
+	}
+	if (_server.listen(name)) {
+		return true;
+	}
+	// Nothing answered, so it was left behind by a daemon that did not shut
+	// down cleanly.
+	QLocalServer::removeServer(name);
+	return _server.listen(name);
+}
+
+QString QWinToastDaemon::errorString() const
+{
+	return _errorString.isEmpty() ? _server.errorString() : _errorString;
+}
+
+int QWinToastDaemon::clientCount() const
+{
+	return _clients.size();
+}
+
+void QWinToastDaemon::acceptConnection()
+{
+	while (QLocalSocket* socket = _server.nextPendingConnection()) {
+		Client client{ QByteArray(), QHash<qint64, qint64>(), _quota.burst, _toast->clock()->now(), false };
+		_clients.insert(socket, client);
+		connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { readClient(socket); });
+		connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+			dropClient(socket);
+			socket->deleteLater();
+		});
+	}
+}
+
+void QWinToastDaemon::readClient(QLocalSocket* socket)
+{
+	auto it = _clients.find(socket);
+	if (it == _clients.end()) {
+		return;
+	}
+	it->buffer += socket->readAll();
+	if (!it->queued) {
+		it->queued = true;
+		_ready.append(socket);
+		schedulePump();
+	}
+}
+
+void QWinToastDaemon::dropClient(QLocalSocket* socket)
+{
+	// Its toasts stay up: a tool may well exit right after show().
+	_clients.remove(socket);
+	_ready.removeAll(socket);
+}
+
+void QWinToastDaemon::schedulePump()
+{
+	if (_pumpScheduled) {
+		return;
+	}
+	_pumpScheduled = true;
+	QMetaObject::invokeMethod(this, [this]() { pump(); }, Qt::QueuedConnection);
+}
+
+void QWinToastDaemon::pump()
+{
+	_pumpScheduled = false;
+	QList<QLocalSocket*> turn;
+	turn.swap(_ready);
+	for (QLocalSocket* socket : turn) {
+		auto it = _clients.find(socket);
+		if (it == _clients.end()) {
+			continue;
+		}
+		bool malformed = false;
+		bool more = true;
+		quint8 type;
+		QByteArray payload;
+		for (int i = 0; i < FramesPerTurn && more; i++) {
+			const QWinToastFrame::Result result = QWinToastFrame::take(it->buffer, type, payload);
+			if (result == QWinToastFrame::Incomplete) {
+				more = false;
+			}
+			else if (result == QWinToastFrame::Malformed || !handleFrame(socket, *it, type, payload)) {
+				malformed = true;
+				more = false;
+			}
+		}
+		if (malformed) {
+			dropClient(socket);
+			socket->abort();
+			continue;
+		}
+		if (more) {
+			_ready.append(socket);
+		}
+		else {
+			it->queued = false;
+		}
+	}
+	if (!_ready.isEmpty()) {
+		schedulePump();
+	}
+}
+
+bool QWinToastDaemon::handleFrame(QLocalSocket* socket, Client& client, quint8 type, const QByteArray& payload)
+{
+	QDataStream in(payload);
+	switch (type) {
+	case QWinToastFrame::Show: {
+		qint64 request = -1;
+		QByteArray record;
+		in >> request >> record;
+		if (in.status() != QDataStream::Ok) {
+			return false;
+		}
+		show(socket, client, request, record);
+		return true;
+	}
+	case QWinToastFrame::Hide: {
+		qint64 request = -1;
+		in >> request;
+		if (in.status() != QDataStream::Ok) {
+			return false;
+		}
+		// The outcome, ApplicationHidden, is reported through the toast's future.
+		const qint64 id = client.live.value(request, -1);
+		if (id >= 0) {
+			_toast->hideToast(id);
+		}
+		return true;
+	}
+	case QWinToastFrame::Clear: {
+		const QList<qint64> ids = client.live.values();
+		for (const qint64 id : ids) {
+			_toast->hideToast(id);
+		}
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+void QWinToastDaemon::show(QLocalSocket* socket, Client& client, qint64 request, const QByteArray& record)
+{
+	QWinToastTemplate templ;
+	if (!QWinToastCodec::decode(record, templ)) {
+		reject(socket, request, QWinToast::InvalidParameters);
+		return;
+	}
+	if (!admit(client)) {
+		reject(socket, request, QWinToast::Throttled);
+		return;
+	}
+
+	QWinToast::QWinToastError error = QWinToast::NoError;
+	qint64 id = -1;
+	const QFuture<QWinToastResult> future = _toast->showToastForResult(templ, &error, &id);
+	if (id < 0) {
+		reject(socket, request, error);
+		return;
+	}
+	client.live.insert(request, id);
+	const QPointer<QLocalSocket> origin(socket);
+	if (future.isFinished()) {
+		finish(origin, request, future.result());
+		return;
+	}
+	QFutureWatcher<QWinToastResult>* watcher = new QFutureWatcher<QWinToastResult>(this);
+	connect(watcher, &QFutureWatcher<QWinToastResult>::finished, this, [this, watcher, origin, request]() {
+		finish(origin, request, watcher->result());
+		watcher->deleteLater();
+	});
+	watcher->setFuture(future);
+}
+
+bool QWinToastDaemon::admit(Client& client)
+{
+	if (_quota.maxLive > 0 && client.live.size() >= _quota.maxLive) {
+		return false;
+	}
+	if (_quota.rate <= 0.0) {
+		return true;
+	}
+	const qint64 now = _toast->clock()->now();
+	client.tokens = qMin(_quota.burst, client.tokens + (now - client.refilledAt) * _quota.rate / 1000.0);
+	client.refilledAt = now;
+	if (client.tokens < 1.0) {
+		return false;
+	}
+	client.tokens -= 1.0;
+	return true;
+}
+
+void QWinToastDaemon::finish(const QPointer<QLocalSocket>& socket, qint64 request, const QWinToastResult& result)
+{
+	auto it = _clients.find(socket.data());
+	if (!socket || it == _clients.end()) {
+		return;
+	}
+	it->live.remove(request);
+
+	QByteArray payload;
+	QDataStream out(&payload, QIODevice::WriteOnly);
+	out << request;
+	switch (result.outcome) {
+	case QWinToastResult::Activated:
+		out << result.arguments;
+		send(socket, QWinToastFrame::Activated, payload);
+		break;
+	case QWinToastResult::Dismissed:
+		out << static_cast<qint32>(result.reason);
+		send(socket, QWinToastFrame::Dismissed, payload);
+		break;
+	case QWinToastResult::Failed:
+		send(socket, QWinToastFrame::Failed, payload);
+		break;
+	}
+}
+
+void QWinToastDaemon::reject(QLocalSocket* socket, qint64 request, QWinToast::QWinToastError error)
+{
+	QByteArray payload;
+	QDataStream out(&payload, QIODevice::WriteOnly);
+	out << request << static_cast<qint32>(error);
+	send(socket, QWinToastFrame::Rejected, payload);
+}
+
+void QWinToastDaemon::send(QLocalSocket* socket, quint8 type, const QByteArray& payload)
+{
+	QByteArray frame;
+	QWinToastFrame::append(frame, type, payload);
+	socket->write(frame);
+}
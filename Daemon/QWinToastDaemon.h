@@ -0,0 +1,78 @@
+#ifndef QWINTOASTDAEMON
+#define QWINTOASTDAEMON
+
+#include "QWinToast.h"
+#include <QHash>
+#include <QList>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPointer>
+
+// Serves one initialized QWinToast to any number of local clients speaking
+// the QWinToastDaemonClient protocol. Every show request goes through the
+// notifier's full pipeline and its outcome is sent back to the client that
+// asked for it.
+//
+// Clients are served round robin, a bounded number of frames per turn, and
+// each is held to its own quota, so one noisy tool can neither starve the
+// others nor use up the shell on their behalf.
+class QWinToastDaemon : public QObject
+{
+    Q_OBJECT
+public:
+    struct Quota
+    {
+        // Toasts a client may have live at once; 0 for no limit.
+        int maxLive{ 64 };
+        // Sustained toasts per second and the burst allowed above it; a rate
+        // of 0 disables the bucket.
+        double rate{ 10.0 };
+        double burst{ 20.0 };
+    };
+
+    QWinToastDaemon(QWinToast* toast, const Quota& quota, QObject* parent = nullptr);
+    ~QWinToastDaemon() override;
+
+    // Fails when another daemon answers on name; a name nothing answers on
+    // is taken over.
+    bool listen(const QString& name);
+    QString errorString() const;
+    int clientCount() const;
+
+    // Frames handled per client before the next client gets a turn.
+    static const int FramesPerTurn = 32;
+
+private:
+    struct Client
+    {
+        QByteArray buffer;
+        // Request id to toast id for every toast awaiting its outcome.
+        QHash<qint64, qint64> live;
+        double tokens;
+        qint64 refilledAt;
+        bool queued;
+    };
+
+    QWinToast* _toast;
+    Quota _quota;
+    QLocalServer _server;
+    QString _errorString{};
+    QHash<QLocalSocket*, Client> _clients{};
+    // Clients with unread frames, in turn order.
+    QList<QLocalSocket*> _ready{};
+    bool _pumpScheduled{ false };
+
+    void acceptConnection();
+    void readClient(QLocalSocket* socket);
+    void dropClient(QLocalSocket* socket);
+    void schedulePump();
+    void pump();
+    bool handleFrame(QLocalSocket* socket, Client& client, quint8 type, const QByteArray& payload);
+    void show(QLocalSocket* socket, Client& client, qint64 request, const QByteArray& record);
+    bool admit(Client& client);
+    void finish(const QPointer<QLocalSocket>& socket, qint64 request, const QWinToastResult& result);
+    void reject(QLocalSocket* socket, qint64 request, QWinToast::QWinToastError error);
+    void send(QLocalSocket* socket, quint8 type, const QByteArray& payload);
+};
+
+#endif // QWINTOASTDAEMON
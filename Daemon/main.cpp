@@ -0,0 +1,67 @@
+#include "QWinToastDaemon.h"
+#include "QWinToastFakeBackend.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("qwintoastd");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Owns one initialized notifier and raises toasts for local clients.");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"name", "Local socket name to listen on.", "name", "qwintoastd"},
+        {"app-name", "Application name shown on the toasts.", "name", "qwintoastd"},
+        {"aumi", "App User Model ID; derived from the app name when empty.", "id"},
+        {"backend", "Backend to drive: shell or fake.", "name",
+#ifdef Q_OS_WIN
+            "shell"},
+#else
+            "fake"},
+#endif
+        {"max-live", "Live toasts allowed per client, 0 for no limit.", "n", "64"},
+        {"rate", "Toasts per second allowed per client, 0 for no limit.", "n", "10"},
+        {"burst", "Toasts a client may send above the rate at once.", "n", "20"},
+        {"digest", "Digest window in milliseconds, 0 to disable.", "ms", "0"},
+        {"dedupe", "Duplicate window in milliseconds, 0 to disable.", "ms", "0"},
+    });
+    parser.process(app);
+
+    QTextStream err(stderr);
+    QWinToastFakeBackend fakeBackend;
+    QWinToast toast;
+    if (parser.value("backend") == "fake") {
+        fakeBackend.setRecordPayloads(false);
+        toast.setBackend(&fakeBackend);
+    }
+    else if (parser.value("backend") != "shell") {
+        err << "Unknown backend: " << parser.value("backend") << endl;
+        return 2;
+    }
+
+    const QString appName = parser.value("app-name");
+    const QString aumi = parser.value("aumi");
+    toast.setAppName(appName);
+    toast.setAppUserModelID(aumi.isEmpty() ? QWinToast::configureAUMI("skykey", "qwintoast", appName, QString()) : aumi);
+    toast.setDigestWindow(parser.value("digest").toInt());
+    toast.setDuplicateWindow(parser.value("dedupe").toInt());
+    QWinToast::QWinToastError error;
+    if (!toast.initialize(&error)) {
+        err << "Initialization failed: " << QWinToast::strerror(error) << endl;
+        return 1;
+    }
+
+    QWinToastDaemon::Quota quota;
+    quota.maxLive = parser.value("max-live").toInt();
+    quota.rate = parser.value("rate").toDouble();
+    quota.burst = qMax(1.0, parser.value("burst").toDouble());
+    QWinToastDaemon daemon(&toast, quota);
+    if (!daemon.listen(parser.value("name"))) {
+        err << "Cannot listen on " << parser.value("name") << ": " << daemon.errorString() << endl;
+        return 1;
+    }
+    return app.exec();
+}
@@ -1,5 +1,6 @@
 ﻿#include "QWinToastExample.h"
 #include <QMessageBox>
+#include "ExampleToasts.h"
 
 QWinToastExample::QWinToastExample(QWidget *parent) : QWidget(parent)
 {
@@ -7,7 +8,11 @@ QWinToastExample::QWinToastExample(QWidget *parent) : QWidget(parent)
     QPushButton *btn1 = new QPushButton("Btn");
     mainLayout->addWidget(btn1);
 
+    QPushButton *btn2 = new QPushButton("Catalog");
+    mainLayout->addWidget(btn2);
+
     connect(btn1, &QPushButton::clicked, this, &QWinToastExample::on_btn_clicked);
+    connect(btn2, &QPushButton::clicked, this, &QWinToastExample::on_catalogBtn_clicked);
 }
 
 QWinToastExample::~QWinToastExample()
@@ -46,3 +51,18 @@ void QWinToastExample::on_btn_clicked()
         });
 
 }
+
+void QWinToastExample::on_catalogBtn_clicked()
+{
+    QWinToast* toast = QWinToast::instance();
+    toast->setAppName("A-Soul");
+    toast->setAppUserModelID(
+        QWinToast::configureAUMI("skykey", "qwintoast", "qwintoastexample", "20210828"));
+    if (!toast->initialize()) {
+        qDebug() << "Error, your system in not compatible!";
+    }
+
+    if (toast->showCatalogToast(ExampleToasts::greeting, ExampleToasts::greetingValues("D:/Diana.png", "Diana")) < 0) {
+        QMessageBox::warning(this, "Error", "Could not launch your toast notification!");
+    }
+}
@@ -16,6 +16,7 @@ private:
     QVBoxLayout *mainLayout;
 private:
     void on_btn_clicked();
+    void on_catalogBtn_clicked();
 };
 
 #endif //QWINTOASTEXAMPLE
\ No newline at end of file
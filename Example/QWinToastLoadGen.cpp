@@ -0,0 +1,828 @@
+#include "QWinToast.h"
+#include "QWinToastArguments.h"
+#include "QWinToastClock.h"
+#include "QWinToastFakeBackend.h"
+#include "QWinToastEventQueue.h"
+#include "QWinToastFailureTrace.h"
+#include "QWinToastCodec.h"
+#include "QWinToastMetrics.h"
+#include "QWinToastSharedQueue.h"
+#include "QWinToastTrace.h"
+#include "QWinToastXml.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#ifdef Q_OS_WIN
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <QFile>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    struct Options
+    {
+        QString backend;
+        double rate;
+        double duration;
+        qint64 count;
+        QVector<QWinToastTemplate::WinToastTemplateType> types;
+        int maxActions;
+        double imageRatio;
+        double hideRatio;
+        double repeatRatio;
+        int dedupe;
+        int fakeMinLatency;
+        int fakeMaxLatency;
+        double fakeFailureRate;
+        int eventThreads;
+        bool lazy;
+        bool simulate;
+        qint64 expiration;
+        quint32 seed;
+    };
+
+    qint64 residentBytes()
+    {
+#ifdef Q_OS_WIN
+        PROCESS_MEMORY_COUNTERS_EX counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters), sizeof(counters))) {
+            return static_cast<qint64>(counters.PrivateUsage);
+        }
+        return 0;
+#else
+        QFile statm("/proc/self/statm");
+        if (!statm.open(QIODevice::ReadOnly)) {
+            return 0;
+        }
+        const QList<QByteArray> fields = statm.readAll().split(' ');
+        return fields.size() > 1 ? fields[1].toLongLong() * sysconf(_SC_PAGESIZE) : 0;
+#endif
+    }
+
+    qint64 percentile(const QVector<qint64>& sorted, double q)
+    {
+        if (sorted.isEmpty()) {
+            return 0;
+        }
+        const int rank = static_cast<int>(std::ceil(q * sorted.size()));
+        return sorted[qBound(0, rank - 1, sorted.size() - 1)];
+    }
+
+    bool parseTypes(const QString& value, QVector<QWinToastTemplate::WinToastTemplateType>& types)
+    {
+        static const QHash<QString, QWinToastTemplate::WinToastTemplateType> Names = {
+            {"imageandtext01", QWinToastTemplate::ImageAndText01},
+            {"imageandtext02", QWinToastTemplate::ImageAndText02},
+            {"imageandtext03", QWinToastTemplate::ImageAndText03},
+            {"imageandtext04", QWinToastTemplate::ImageAndText04},
+            {"text01", QWinToastTemplate::Text01},
+            {"text02", QWinToastTemplate::Text02},
+            {"text03", QWinToastTemplate::Text03},
+            {"text04", QWinToastTemplate::Text04},
+        };
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        const QStringList names = value.split(',', Qt::SkipEmptyParts);
+#else
+        const QStringList names = value.split(',', QString::SkipEmptyParts);
+#endif
+        for (const QString& name : names) {
+            const auto iter = Names.find(name.trimmed().toLower());
+            if (iter == Names.end()) {
+                return false;
+            }
+            types.append(iter.value());
+        }
+        return !types.isEmpty();
+    }
+
+    QWinToastTemplate makeTemplate(const Options& options, QRandomGenerator& random, qint64 sequence)
+    {
+        const auto type = options.types[random.bounded(options.types.size())];
+        QWinToastTemplate templ(type);
+        for (std::size_t i = 0; i < templ.textFieldsCount(); i++) {
+            if (options.lazy) {
+                templ.setTextProvider(QWinToastTemplate::TextField(i), [sequence, i]() {
+                    return QString("loadgen #%1 line %2").arg(sequence).arg(i + 1);
+                });
+                continue;
+            }
+            templ.setTextField(QString("loadgen #%1 line %2").arg(sequence).arg(i + 1), QWinToastTemplate::TextField(i));
+        }
+        if (templ.hasImage() && random.generateDouble() < options.imageRatio) {
+            templ.setImagePath("C:/loadgen/image.png");
+        }
+        const int actions = options.maxActions > 0 ? random.bounded(options.maxActions + 1) : 0;
+        for (int i = 0; i < actions; i++) {
+            templ.addAction(QString("Action %1").arg(i));
+        }
+        return templ;
+    }
+
+    // The records shared queue producers push, the same in every thread and
+    // process for a given seed.
+    QVector<QByteArray> makeRecords(const Options& options, int maxRecordSize)
+    {
+        QRandomGenerator random(options.seed);
+        QVector<QByteArray> records;
+        for (int i = 0; i < 1024; i++) {
+            QByteArray record;
+            QWinToastCodec::append(record, makeTemplate(options, random, i));
+            if (record.size() <= maxRecordSize) {
+                records.append(record);
+            }
+        }
+        return records;
+    }
+
+    // Pushes records as fast as the ring takes them until stopped; returns
+    // how many pushes found the ring full.
+    qint64 produce(QWinToastSharedQueue& producer, const QVector<QByteArray>& records, int first,
+                   const std::function<bool()>& stopped, qint64& sent)
+    {
+        qint64 retries = 0;
+        for (int i = first; !stopped(); i++) {
+            const QByteArray& record = records[i % records.size()];
+            bool queued = producer.push(record.constData(), record.size());
+            while (!queued && !stopped()) {
+                retries++;
+                QThread::yieldCurrentThread();
+                queued = producer.push(record.constData(), record.size());
+            }
+            sent += queued ? 1 : 0;
+        }
+        return retries;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("qwintoast-loadgen");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Drives QWinToast at a target rate and reports throughput and showToast latency.");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"backend", "Backend to drive: shell or fake.", "name",
+#ifdef Q_OS_WIN
+            "shell"},
+#else
+            "fake"},
+#endif
+        {"rate", "Target toasts per second, 0 for maximum rate.", "n", "100"},
+        {"duration", "Run time in seconds.", "seconds", "10"},
+        {"count", "Stop after this many toasts, 0 for no limit.", "n", "0"},
+        {"types", "Comma separated template types to mix.", "list", "text02,imageandtext02,imageandtext04"},
+        {"actions", "Maximum number of actions per toast.", "n", "2"},
+        {"image-ratio", "Fraction of image templates that carry an image.", "ratio", "0.5"},
+        {"hide-ratio", "Fraction of shown toasts hidden again right away.", "ratio", "0.1"},
+        {"repeat-ratio", "Fraction of toasts that resend the previous template unchanged.", "ratio", "0"},
+        {"dedupe", "Duplicate window in milliseconds, 0 to show repeats.", "ms", "0"},
+        {"fake-latency", "Fake backend latency range in microseconds, min:max.", "range", "0:0"},
+        {"fake-failure-rate", "Fake backend failure probability.", "ratio", "0"},
+        {"event-threads", "Fake backend only: dismiss every live toast from this many threads and report event delivery. Producer threads for --event-queue.", "n", "0"},
+        {"lazy", "Fill text fields through providers run at delivery."},
+        {"simulate", "Run --duration in simulated time on a manual clock instead of sleeping."},
+        {"expiration", "Expiration set on every toast in milliseconds, 0 for none.", "ms", "0"},
+        {"codec", "Only benchmark template encode/decode over this many generated templates.", "n", "0"},
+        {"xml", "Only benchmark XML escaping and payload building over this many generated templates.", "n", "0"},
+        {"event-queue", "Only benchmark the event queue: push this many events from --event-threads producers (4 by default) and pop them on one consumer.", "n", "0"},
+        {"arguments", "Only benchmark activation argument parsing and command dispatch over this many generated strings.", "n", "0"},
+        {"metrics", "Print the library metrics at the end: prometheus or json.", "format"},
+        {"failures", "Print the failure trace at the end."},
+        {"shm-producers", "Only benchmark the shared memory queue with this many producer threads, each on its own mapping.", "n", "0"},
+        {"shm-show", "With --shm-producers: decode every record and show it instead of only moving bytes."},
+        {"shm-processes", "With --shm-producers: run every producer in a process of its own instead of a thread."},
+        {"shm-produce", "Internal: be one producer process of --shm-processes for this queue key.", "key"},
+        {"record", "Write a trace of the run's calls and events to this file.", "file"},
+        {"replay", "Replay a recorded trace instead of generating toasts.", "file"},
+        {"speed", "With --replay: multiple of the recorded pace, 0 for no pauses.", "factor", "1"},
+        {"seed", "Workload random seed.", "n", "1"},
+    });
+    parser.process(app);
+
+    Options options;
+    options.backend = parser.value("backend");
+    options.rate = parser.value("rate").toDouble();
+    options.duration = parser.value("duration").toDouble();
+    options.count = parser.value("count").toLongLong();
+    options.maxActions = parser.value("actions").toInt();
+    options.imageRatio = parser.value("image-ratio").toDouble();
+    options.hideRatio = parser.value("hide-ratio").toDouble();
+    options.repeatRatio = parser.value("repeat-ratio").toDouble();
+    options.dedupe = parser.value("dedupe").toInt();
+    const QStringList latency = parser.value("fake-latency").split(':');
+    options.fakeMinLatency = latency.value(0).toInt();
+    options.fakeMaxLatency = latency.value(1, latency.value(0)).toInt();
+    options.fakeFailureRate = parser.value("fake-failure-rate").toDouble();
+    options.eventThreads = parser.value("event-threads").toInt();
+    options.lazy = parser.isSet("lazy");
+    options.simulate = parser.isSet("simulate");
+    options.expiration = parser.value("expiration").toLongLong();
+    options.seed = parser.value("seed").toUInt();
+
+    QTextStream err(stderr);
+    if (!parseTypes(parser.value("types"), options.types)) {
+        err << "Invalid --types value: " << parser.value("types") << '\n';
+        return 2;
+    }
+
+    const int codecCount = parser.value("codec").toInt();
+    if (codecCount > 0) {
+        QRandomGenerator random(options.seed);
+        QVector<QWinToastTemplate> templates;
+        templates.reserve(codecCount);
+        for (int i = 0; i < codecCount; i++) {
+            QWinToastTemplate templ = makeTemplate(options, random, i);
+            templ.setTag(QString("tag-%1").arg(i % 64));
+            templ.setExpiration(random.bounded(60000));
+            templates.append(templ);
+        }
+
+        QElapsedTimer timer;
+        QByteArray stream;
+        timer.start();
+        for (const QWinToastTemplate& templ : templates) {
+            QWinToastCodec::append(stream, templ);
+        }
+        const double encodeSeconds = timer.nsecsElapsed() / 1e9;
+
+        QVector<QWinToastTemplate> decoded(codecCount);
+        timer.start();
+        int offset = 0;
+        for (int i = 0; i < codecCount; i++) {
+            const int used = QWinToastCodec::decode(stream.constData() + offset, stream.size() - offset, decoded[i]);
+            if (used <= 0) {
+                err << "Decode failed at record " << i << '\n';
+                return 1;
+            }
+            offset += used;
+        }
+        const double decodeSeconds = timer.nsecsElapsed() / 1e9;
+
+        // Round trip: every decoded template has to encode to the same bytes.
+        for (int i = 0; i < codecCount; i++) {
+            if (QWinToastCodec::encode(decoded[i]) != QWinToastCodec::encode(templates[i])) {
+                err << "Round trip mismatch at record " << i << '\n';
+                return 1;
+            }
+        }
+
+        QTextStream out(stdout);
+        const double megabytes = stream.size() / (1024.0 * 1024.0);
+        out << "records        " << codecCount << '\n';
+        out << "bytes/record   " << QString::number(double(stream.size()) / codecCount, 'f', 1) << '\n';
+        out << "encode         " << QString::number(codecCount / encodeSeconds, 'f', 0) << " /s, "
+            << QString::number(megabytes / encodeSeconds, 'f', 1) << " MiB/s" << '\n';
+        out << "decode         " << QString::number(codecCount / decodeSeconds, 'f', 0) << " /s, "
+            << QString::number(megabytes / decodeSeconds, 'f', 1) << " MiB/s" << '\n';
+        out << "round trip     ok" << '\n';
+        return 0;
+    }
+
+    const int xmlCount = parser.value("xml").toInt();
+    if (xmlCount > 0) {
+        // One text in eight carries markup, so both the clean copy and the
+        // entity path are exercised.
+        QRandomGenerator random(options.seed);
+        QVector<QWinToastTemplate> templates;
+        QVector<QString> texts;
+        int units = 0;
+        for (int i = 0; i < xmlCount; i++) {
+            QWinToastTemplate templ = makeTemplate(options, random, i);
+            for (std::size_t field = 0; field < templ.textFieldsCount(); field++) {
+                QString text = templ.textField(QWinToastTemplate::TextField(field));
+                if (random.bounded(8) == 0) {
+                    text += " <b>&amp; \"quoted\"</b>";
+                }
+                templ.setTextField(text, QWinToastTemplate::TextField(field));
+                units += text.size();
+                texts.append(text);
+            }
+            templates.append(templ);
+        }
+
+        QVector<ushort> buffer(units * 6);
+        const auto escapeAll = [&](bool vectorized) {
+            QElapsedTimer timer;
+            timer.start();
+            ushort* dst = buffer.data();
+            for (const QString& text : texts) {
+                dst = vectorized ? QWinToastXml::escape(text.utf16(), text.size(), dst)
+                    : QWinToastXml::escapeScalar(text.utf16(), text.size(), dst);
+            }
+            return timer.nsecsElapsed() / 1e9;
+        };
+        const double scalarSeconds = escapeAll(false);
+        const double vectorSeconds = escapeAll(true);
+
+        QElapsedTimer timer;
+        timer.start();
+        qint64 payloadUnits = 0;
+        for (const QWinToastTemplate& templ : templates) {
+            payloadUnits += QWinToastXml::toastPayload(templ, true).size();
+        }
+        const double payloadSeconds = timer.nsecsElapsed() / 1e9;
+
+        QTextStream out(stdout);
+        const double megabytes = units * 2 / 1e6;
+        out << "texts          " << texts.size() << ", " << units << " code units" << '\n';
+        out << "escape scalar  " << QString::number(megabytes / scalarSeconds, 'f', 0) << " MB/s" << '\n';
+        out << "escape vector  " << QString::number(megabytes / vectorSeconds, 'f', 0) << " MB/s" << '\n';
+        out << "payloads       " << QString::number(xmlCount / payloadSeconds, 'f', 0) << " /s, "
+            << QString::number(payloadUnits * 2 / 1e6 / payloadSeconds, 'f', 1) << " MB/s" << '\n';
+        return 0;
+    }
+
+    if (parser.isSet("shm-produce")) {
+        // Runs for --duration and reports its counts to the consumer on stdout.
+        QWinToastSharedQueue producer(parser.value("shm-produce"));
+        if (!producer.attach()) {
+            err << "Shared queue: " << producer.errorString() << '\n';
+            return 1;
+        }
+        const QVector<QByteArray> records = makeRecords(options, producer.maxRecordSize());
+        if (records.isEmpty()) {
+            return 1;
+        }
+        QElapsedTimer clock;
+        clock.start();
+        const qint64 deadline = static_cast<qint64>(options.duration * 1e9);
+        qint64 sent = 0;
+        const qint64 retries = produce(producer, records, QCoreApplication::applicationPid() % records.size(),
+            [&clock, deadline]() { return clock.nsecsElapsed() >= deadline; }, sent);
+        QTextStream(stdout) << sent << ' ' << retries << '\n';
+        return 0;
+    }
+
+    const qint64 queueCount = parser.value("event-queue").toLongLong();
+    if (queueCount > 0) {
+        // Latency runs from the push to the pop. A wake-up is a push that
+        // found no drain pending, which is what QWinToast posts an event for.
+        const int producerCount = options.eventThreads > 0 ? options.eventThreads : 4;
+        QWinToastEventQueue queue;
+        QAtomicInteger<qint64> wakeUps(0);
+        QVector<QThread*> producers;
+        for (int t = 0; t < producerCount; t++) {
+            const qint64 share = queueCount / producerCount + (t < queueCount % producerCount ? 1 : 0);
+            producers.append(QThread::create([&queue, &wakeUps, share]() {
+                qint64 wakes = 0;
+                for (qint64 i = 0; i < share; i++) {
+                    QWinToastEvent event{ QWinToastEvent::Dismissed, i, QWinToast::UserCanceled, QString(), QWinToastEventQueue::timestamp() };
+                    wakes += queue.push(std::move(event)) ? 1 : 0;
+                }
+                wakeUps.fetchAndAddRelaxed(wakes);
+            }));
+        }
+
+        QVector<qint64> latencies;
+        latencies.reserve(static_cast<int>(queueCount));
+        qint64 drains = 0;
+        QWinToastEvent event;
+        QElapsedTimer clock;
+        clock.start();
+        for (QThread* thread : producers) {
+            thread->start();
+        }
+        while (latencies.size() < queueCount) {
+            queue.beginDrain();
+            bool popped = false;
+            while (queue.pop(event)) {
+                latencies.append(QWinToastEventQueue::timestamp() - event.timestamp);
+                popped = true;
+            }
+            if (popped) {
+                drains++;
+            }
+            else {
+                QThread::yieldCurrentThread();
+            }
+        }
+        const double elapsed = clock.nsecsElapsed() / 1e9;
+        for (QThread* thread : producers) {
+            thread->wait();
+            delete thread;
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        QTextStream out(stdout);
+        out << "producers      " << producerCount << '\n';
+        out << "events         " << queueCount << " in " << drains << " drains, " << wakeUps.loadAcquire() << " wake-ups" << '\n';
+        out << "rate           " << QString::number(queueCount / elapsed / 1e6, 'f', 2) << " M/s" << '\n';
+        out << "latency p50    " << QString::number(percentile(latencies, 0.50) / 1000.0, 'f', 1) << " us" << '\n';
+        out << "latency p99    " << QString::number(percentile(latencies, 0.99) / 1000.0, 'f', 1) << " us" << '\n';
+        out << "latency max    " << QString::number(latencies.last() / 1000.0, 'f', 1) << " us" << '\n';
+        return 0;
+    }
+
+    const int argumentsCount = parser.value("arguments").toInt();
+    if (argumentsCount > 0) {
+        // Shaped like real launch strings: an action index, one of a few
+        // commands and a handful of application pairs, some needing escapes.
+        QRandomGenerator random(options.seed);
+        QWinToastCommandRegistry registry;
+        const int commandCount = 32;
+        for (int i = 0; i < commandCount; i++) {
+            registry.registerCommand(QString("command-%1").arg(i), [](qint64, const QWinToastArgumentsView&) {});
+        }
+        QVector<QString> sources;
+        sources.reserve(argumentsCount);
+        int units = 0;
+        for (int i = 0; i < argumentsCount; i++) {
+            QWinToastArguments arguments;
+            const int pairs = random.bounded(6);
+            for (int pair = 0; pair < pairs; pair++) {
+                arguments.insert(QString("key%1").arg(pair),
+                    random.bounded(4) == 0 ? QString("x&y=%1%").arg(i) : QString::number(random.bounded(100000)));
+            }
+            QString source = QString("a=%1&c=command-%2").arg(random.bounded(5)).arg(random.bounded(commandCount));
+            if (!arguments.isEmpty()) {
+                source += '&' + arguments.encoded();
+            }
+            units += source.size();
+            sources.append(source);
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        qint64 checksum = 0;
+        for (const QString& source : sources) {
+            const QWinToastArgumentsView view(source);
+            checksum += view.count() + view.actionIndex();
+        }
+        const double parseSeconds = timer.nsecsElapsed() / 1e9;
+
+        timer.start();
+        int dispatched = 0;
+        for (int i = 0; i < sources.size(); i++) {
+            dispatched += registry.dispatch(i, QWinToastArgumentsView(sources[i])) ? 1 : 0;
+        }
+        const double dispatchSeconds = timer.nsecsElapsed() / 1e9;
+        if (dispatched != argumentsCount) {
+            err << "Dispatched " << dispatched << " of " << argumentsCount << '\n';
+            return 1;
+        }
+
+        QTextStream out(stdout);
+        out << "strings        " << argumentsCount << ", " << QString::number(double(units) / argumentsCount, 'f', 1)
+            << " code units each (checksum " << checksum << ")" << '\n';
+        out << "parse          " << QString::number(argumentsCount / parseSeconds, 'f', 0) << " /s, "
+            << QString::number(units * 2 / 1e6 / parseSeconds, 'f', 0) << " MB/s" << '\n';
+        out << "parse+dispatch " << QString::number(argumentsCount / dispatchSeconds, 'f', 0) << " /s" << '\n';
+        return 0;
+    }
+
+    // Both outlive the toast, which detaches from its backend when destroyed.
+    QWinToastFakeBackend fakeBackend;
+    QWinToastManualClock manualClock;
+    QWinToast toast;
+    if (options.simulate) {
+        toast.setClock(&manualClock);
+    }
+    if (options.backend == "fake") {
+        fakeBackend.setRecordPayloads(false);
+        fakeBackend.setLatency(options.fakeMinLatency, options.fakeMaxLatency);
+        fakeBackend.setFailureRate(options.fakeFailureRate);
+        toast.setBackend(&fakeBackend);
+    }
+    else if (options.backend != "shell") {
+        err << "Unknown backend: " << options.backend << '\n';
+        return 2;
+    }
+
+    toast.setDuplicateWindow(options.dedupe);
+    toast.setAppName("qwintoast-loadgen");
+    toast.setAppUserModelID(QWinToast::configureAUMI("skykey", "qwintoast", "loadgen", QString()));
+    QWinToast::QWinToastError error;
+    if (!toast.initialize(&error)) {
+        err << "Initialization failed: " << QWinToast::strerror(error) << '\n';
+        return 1;
+    }
+
+    const int shmProducers = parser.value("shm-producers").toInt();
+    if (shmProducers > 0) {
+        // Each producer attaches its own QSharedMemory, as a separate process
+        // would, and pushes pre-encoded records as fast as the ring takes them.
+        const QString key = QString("loadgen-%1").arg(QCoreApplication::applicationPid());
+        QWinToastSharedQueue consumer(key);
+        if (!consumer.create(1 << 16, 256)) {
+            err << "Shared queue: " << consumer.errorString() << '\n';
+            return 1;
+        }
+        const QVector<QByteArray> records = makeRecords(options, consumer.maxRecordSize());
+        if (records.isEmpty()) {
+            err << "No generated record fits a slot" << '\n';
+            return 1;
+        }
+
+        QAtomicInteger<int> stopping(0);
+        QAtomicInteger<qint64> pushed(0), full(0);
+        QVector<QThread*> producers;
+        // Separate processes stop on their own at --duration; the consumer
+        // drains until they have all exited, polling them only when idle.
+        const bool processes = parser.isSet("shm-processes");
+        QVector<QProcess*> children;
+        for (int t = 0; t < shmProducers; t++) {
+            if (processes) {
+                QProcess* child = new QProcess();
+                child->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+                child->setProgram(QCoreApplication::applicationFilePath());
+                child->setArguments({ "--shm-produce", key, "--duration", parser.value("duration"),
+                    "--seed", parser.value("seed"), "--types", parser.value("types"), "--actions", parser.value("actions"),
+                    "--image-ratio", parser.value("image-ratio") });
+                children.append(child);
+                continue;
+            }
+            producers.append(QThread::create([&, t]() {
+                QWinToastSharedQueue producer(key);
+                if (!producer.attach()) {
+                    return;
+                }
+                qint64 sent = 0;
+                const qint64 retries = produce(producer, records, t, [&stopping]() { return stopping.loadAcquire() != 0; }, sent);
+                pushed.fetchAndAddRelaxed(sent);
+                full.fetchAndAddRelaxed(retries);
+            }));
+        }
+        const auto childrenRunning = [&children]() {
+            for (QProcess* child : children) {
+                if (child->state() != QProcess::NotRunning && !child->waitForFinished(0)) {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        const bool show = parser.isSet("shm-show");
+        QByteArray record;
+        QWinToastTemplate templ;
+        qint64 received = 0, malformed = 0, shmShown = 0;
+        QElapsedTimer clock;
+        clock.start();
+        for (QThread* thread : producers) {
+            thread->start();
+        }
+        for (QProcess* child : children) {
+            child->start();
+        }
+        const qint64 deadline = static_cast<qint64>(options.duration * 1e9);
+        qint64 idle = 0;
+        while ((processes ? idle == 0 || idle % 4096 != 0 || childrenRunning() || !consumer.isEmpty() : clock.nsecsElapsed() < deadline)
+               && (options.count <= 0 || received < options.count)) {
+            bool popped;
+            if (show) {
+                bool bad = false;
+                popped = consumer.pop(templ, &bad);
+                if (popped && bad) {
+                    malformed++;
+                }
+                else if (popped && toast.showToast(templ) >= 0) {
+                    shmShown++;
+                }
+            }
+            else {
+                popped = consumer.pop(record);
+            }
+            if (popped) {
+                received++;
+                idle = 0;
+            }
+            else {
+                idle++;
+            }
+        }
+        const double elapsed = clock.nsecsElapsed() / 1e9;
+        stopping.storeRelease(1);
+        // Producers blocked on a full ring see the flag and give up.
+        for (QThread* thread : producers) {
+            thread->wait();
+            delete thread;
+        }
+        for (QProcess* child : children) {
+            child->waitForFinished();
+            const QList<QByteArray> counts = child->readAllStandardOutput().simplified().split(' ');
+            pushed.fetchAndAddRelaxed(counts.value(0).toLongLong());
+            full.fetchAndAddRelaxed(counts.value(1).toLongLong());
+            delete child;
+        }
+
+        QTextStream out(stdout);
+        out << "producers      " << shmProducers << (processes ? " processes" : " threads") << '\n';
+        out << "slots          " << consumer.slotCount() << " x " << consumer.maxRecordSize() << " bytes" << '\n';
+        out << "pushed         " << pushed.loadAcquire() << '\n';
+        out << "received       " << received << '\n';
+        out << "rate           " << QString::number(received / elapsed / 1e6, 'f', 2) << " M/s" << '\n';
+        out << "full retries   " << full.loadAcquire() << '\n';
+        if (show) {
+            out << "shown          " << shmShown << '\n';
+            out << "malformed      " << malformed << '\n';
+        }
+        toast.clear();
+        return 0;
+    }
+
+    if (parser.isSet("replay")) {
+        QWinToastTraceReplayer replayer(&toast);
+        if (!replayer.load(parser.value("replay"))) {
+            err << "Replay: " << replayer.errorString() << '\n';
+            return 1;
+        }
+        replayer.setSpeed(parser.value("speed").toDouble());
+        if (options.backend == "fake") {
+            replayer.setEventBackend(&fakeBackend);
+        }
+        QObject::connect(&replayer, &QWinToastTraceReplayer::finished, &app, &QCoreApplication::quit);
+        const qint64 memoryBefore = residentBytes();
+        replayer.start();
+        app.exec();
+        const qint64 memoryAfter = residentBytes();
+
+        const QWinToastTraceReplayer::Stats& stats = replayer.stats();
+        const double elapsed = stats.elapsed / 1e9;
+        QTextStream out(stdout);
+        out << "backend        " << options.backend << '\n';
+        out << "records        " << replayer.recordCount() << '\n';
+        out << "speed          " << (replayer.speed() > 0 ? QString::number(replayer.speed()) + "x" : QString("max")) << '\n';
+        out << "elapsed        " << QString::number(stats.elapsed / 1e6, 'f', 1) << " ms" << '\n';
+        out << "call rate      " << QString::number(stats.calls / elapsed, 'f', 1) << " /s" << '\n';
+        out << "shown          " << stats.shown << '\n';
+        out << "rejected       " << stats.rejected << ", " << stats.skippedShows << " skipped" << '\n';
+        out << "events         " << stats.events << ", " << stats.skippedEvents << " skipped" << '\n';
+        out << "latency p50    " << QString::number(percentile(stats.showLatencies, 0.50) / 1000.0, 'f', 1) << " us" << '\n';
+        out << "latency p99    " << QString::number(percentile(stats.showLatencies, 0.99) / 1000.0, 'f', 1) << " us" << '\n';
+        out << "latency p999   " << QString::number(percentile(stats.showLatencies, 0.999) / 1000.0, 'f', 1) << " us" << '\n';
+        out << "latency max    " << QString::number((stats.showLatencies.isEmpty() ? 0 : stats.showLatencies.last()) / 1000.0, 'f', 1) << " us" << '\n';
+        out << "memory growth  " << (memoryAfter - memoryBefore) / 1024 << " KiB" << '\n';
+        toast.clear();
+        return 0;
+    }
+
+    QWinToastTraceRecorder recorder;
+    if (parser.isSet("record")) {
+        if (!recorder.start(parser.value("record"))) {
+            err << "Record: " << recorder.errorString() << '\n';
+            return 1;
+        }
+        toast.setTraceRecorder(&recorder);
+    }
+
+    QRandomGenerator random(options.seed);
+    QVector<qint64> latencies;
+    latencies.reserve(options.rate > 0 ? static_cast<int>(options.rate * options.duration) : 1 << 20);
+    qint64 shown = 0, failed = 0, hidden = 0, expired = 0;
+    QObject::connect(&toast, &QWinToast::toastDismissed, [&expired](QWinToast::WinToastDismissalReason reason) {
+        if (reason == QWinToast::TimedOut) {
+            expired++;
+        }
+    });
+    const qint64 memoryBefore = residentBytes();
+    const qint64 deadline = static_cast<qint64>(options.duration * 1e9);
+
+    // Simulated time jumps straight to each due point; expirations and other
+    // timers fire inside advanceTo() and the run ends as soon as the CPU does.
+    QElapsedTimer clock;
+    QElapsedTimer call;
+    clock.start();
+    QWinToastTemplate previous;
+    const auto elapsedNanos = [&]() {
+        return options.simulate ? manualClock.now() * 1000000 : clock.nsecsElapsed();
+    };
+    for (qint64 sequence = 0; options.count <= 0 || sequence < options.count; sequence++) {
+        if (options.rate > 0) {
+            const qint64 due = static_cast<qint64>(sequence * 1e9 / options.rate);
+            const qint64 wait = due - elapsedNanos();
+            if (wait > 0 && options.simulate) {
+                manualClock.advanceTo(due / 1000000);
+            }
+            else if (wait > 0) {
+                QThread::usleep(static_cast<unsigned long>(wait / 1000));
+            }
+        }
+        if (elapsedNanos() >= deadline) {
+            break;
+        }
+
+        if (sequence == 0 || random.generateDouble() >= options.repeatRatio) {
+            previous = makeTemplate(options, random, sequence);
+            if (options.expiration > 0) {
+                previous.setExpiration(options.expiration);
+            }
+        }
+        const QWinToastTemplate& templ = previous;
+        call.start();
+        QWinToast::QWinToastError showError;
+        const qint64 id = toast.showToast(templ, &showError);
+        latencies.append(call.nsecsElapsed());
+        if (id < 0) {
+            // Repeats dropped by --dedupe are reported on their own.
+            if (showError != QWinToast::Duplicate) {
+                failed++;
+            }
+            continue;
+        }
+        shown++;
+        if (random.generateDouble() < options.hideRatio && toast.hideToast(id)) {
+            hidden++;
+        }
+    }
+    if (options.simulate) {
+        manualClock.advanceTo(deadline / 1000000);
+    }
+    const double elapsed = elapsedNanos() / 1e9;
+    const qint64 memoryAfter = residentBytes();
+
+    std::sort(latencies.begin(), latencies.end());
+    QTextStream out(stdout);
+    out << "backend        " << options.backend << '\n';
+    out << "target rate    " << (options.rate > 0 ? QString::number(options.rate) : QString("max")) << " /s" << '\n';
+    out << "achieved rate  " << QString::number(latencies.size() / elapsed, 'f', 1) << " /s" << '\n';
+    out << "shown          " << shown << '\n';
+    out << "failed         " << failed << '\n';
+    out << "hidden         " << hidden << '\n';
+    out << "expired        " << expired << '\n';
+    out << "deduplicated   " << toast.suppressedDuplicateCount() << '\n';
+    if (options.simulate) {
+        out << "wall time      " << QString::number(clock.nsecsElapsed() / 1e6, 'f', 1) << " ms" << '\n';
+    }
+    out << "latency p50    " << QString::number(percentile(latencies, 0.50) / 1000.0, 'f', 1) << " us" << '\n';
+    out << "latency p99    " << QString::number(percentile(latencies, 0.99) / 1000.0, 'f', 1) << " us" << '\n';
+    out << "latency p999   " << QString::number(percentile(latencies, 0.999) / 1000.0, 'f', 1) << " us" << '\n';
+    out << "latency max    " << QString::number((latencies.isEmpty() ? 0 : latencies.last()) / 1000.0, 'f', 1) << " us" << '\n';
+    out << "memory growth  " << (memoryAfter - memoryBefore) / 1024 << " KiB" << '\n';
+
+    if (options.backend == "fake" && options.eventThreads > 0) {
+        // Events are fired from worker threads and measured from queueing to
+        // the end of the batch that delivered them on this thread.
+        const QVector<qint64> live = fakeBackend.liveToasts();
+        QVector<qint64> eventLatencies;
+        eventLatencies.reserve(live.size());
+        qint64 batches = 0;
+        QObject::connect(&toast, &QWinToast::toastEventsBatch, [&](const QVector<QWinToastEvent>& events) {
+            const qint64 now = toast.clock()->timestamp();
+            for (const QWinToastEvent& event : events) {
+                eventLatencies.append(now - event.timestamp);
+            }
+            batches++;
+        });
+
+        QElapsedTimer eventClock;
+        eventClock.start();
+        QVector<QThread*> threads;
+        for (int t = 0; t < options.eventThreads; t++) {
+            threads.append(QThread::create([&fakeBackend, &live, &options, t]() {
+                for (int i = t; i < live.size(); i += options.eventThreads) {
+                    fakeBackend.dismiss(live[i], QWinToast::UserCanceled);
+                }
+            }));
+            threads.last()->start();
+        }
+        while (eventLatencies.size() < live.size()) {
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+        }
+        const double eventElapsed = eventClock.nsecsElapsed() / 1e9;
+        for (QThread* thread : threads) {
+            thread->wait();
+            delete thread;
+        }
+
+        std::sort(eventLatencies.begin(), eventLatencies.end());
+        out << "events         " << eventLatencies.size() << " in " << batches << " batches" << '\n';
+        out << "event rate     " << QString::number(eventLatencies.size() / eventElapsed, 'f', 1) << " /s" << '\n';
+        out << "event p50      " << QString::number(percentile(eventLatencies, 0.50) / 1000.0, 'f', 1) << " us" << '\n';
+        out << "event p99      " << QString::number(percentile(eventLatencies, 0.99) / 1000.0, 'f', 1) << " us" << '\n';
+        out << "event max      " << QString::number((eventLatencies.isEmpty() ? 0 : eventLatencies.last()) / 1000.0, 'f', 1) << " us" << '\n';
+    }
+
+    if (parser.isSet("metrics")) {
+        const auto format = parser.value("metrics") == "json" ? QWinToastMetrics::Json : QWinToastMetrics::Prometheus;
+        out << QWinToastMetrics::global()->exportAs(format) << '\n';
+    }
+
+    if (parser.isSet("failures")) {
+        const QWinToastFailureTrace* trace = QWinToastFailureTrace::global();
+        out << "failures       " << trace->recorded() << " recorded, " << trace->dropped() << " dropped" << '\n';
+        out << trace->dump();
+    }
+
+    if (recorder.isRecording()) {
+        // Drains the events still queued so they make it into the trace.
+        QCoreApplication::processEvents();
+        toast.setTraceRecorder(nullptr);
+        recorder.stop();
+        out << "recorded       " << recorder.recordCount() << " records to " << parser.value("record") << '\n';
+    }
+
+    toast.clear();
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include "QToastChannel.h"
+#include "QWinToastMetrics.h"
+
+QToastChannel::QToastChannel(QObject* parent) :
+	QWinToast(parent)
+{
+	connectCounters();
+}
+
+QToastChannel::QToastChannel(const QString& appName, const QString& aumi, QObject* parent) :
+	QWinToast(parent)
+{
+	setAppName(appName);
+	setAppUserModelID(aumi);
+	connectCounters();
+}
+
+QToastChannel::~QToastChannel()
+{
+}
+
+void QToastChannel::setMaxLiveToasts(int limit)
+{
+	QMutexLocker locker(&_limitMutex);
+	_maxLiveToasts = qMax(0, limit);
+}
+
+int QToastChannel::maxLiveToasts() const
+{
+	QMutexLocker locker(&_limitMutex);
+	return _maxLiveToasts;
+}
+
+void QToastChannel::setMaxToastsPerSecond(double rate)
+{
+	QMutexLocker locker(&_limitMutex);
+	_maxRate = qMax(0.0, rate);
+	_burst = qMax(1.0, _maxRate);
+	_tokens = _burst;
+	_refilledAt = clock()->now();
+}
+
+double QToastChannel::maxToastsPerSecond() const
+{
+	QMutexLocker locker(&_limitMutex);
+	return _maxRate;
+}
+
+QToastChannel::Counters QToastChannel::counters() const
+{
+	return Counters{ _shown.loadAcquire(), _failed.loadAcquire(), _throttled.loadAcquire(), _rejected.loadAcquire(),
+		_hidden.loadAcquire() };
+}
+
+void QToastChannel::resetCounters()
+{
+	_shown.storeRelease(0);
+	_failed.storeRelease(0);
+	_throttled.storeRelease(0);
+	_rejected.storeRelease(0);
+	_hidden.storeRelease(0);
+}
+
+qint64 QToastChannel::showToast(const QWinToastTemplate& toast, QWinToastError* error)
+{
+	QWinToastError result = QWinToastError::NoError;
+	const qint64 id = QWinToast::showToast(toast, &result);
+	setError(error, result);
+	countShow(id, result);
+	return id;
+}
+
+qint64 QToastChannel::showCatalogToast(const QWinToastCatalogEntry& entry, const QStringList& values, QWinToastError* error)
+{
+	QWinToastError result = QWinToastError::NoError;
+	const qint64 id = QWinToast::showCatalogToast(entry, values, &result);
+	setError(error, result);
+	countShow(id, result);
+	return id;
+}
+
+bool QToastChannel::admitToast(const QWinToastTemplate& toast, QWinToastError* error)
+{
+	return admit() || throttle(toast.pendingTextProviders(), error);
+}
+
+bool QToastChannel::admitToast(const QWinToastCatalogEntry&, const QStringList&, QWinToastError* error)
+{
+	return admit() || throttle(0, error);
+}
+
+// Counts a rejection by admit(); always false.
+bool QToastChannel::throttle(int pendingTextProviders, QWinToastError* error)
+{
+	static QWinToastMetric* const throttled = QWinToastMetrics::global()->counter(
+		"qwintoast_toasts_throttled_total", "Toasts rejected by a channel limit.");
+	static QWinToastMetric* const skipped = QWinToastMetrics::global()->counter(
+		"qwintoast_text_providers_skipped_total", "Text providers never run because their toast was dropped or folded.");
+	throttled->increment();
+	skipped->add(pendingTextProviders);
+	_throttled.fetchAndAddRelaxed(1);
+	setError(error, QWinToastError::Throttled);
+	return false;
+}
+
+bool QToastChannel::hideToast(qint64 id)
+{
+	const bool hidden = QWinToast::hideToast(id);
+	if (hidden) {
+		_hidden.fetchAndAddRelaxed(1);
+	}
+	return hidden;
+}
+
+void QToastChannel::connectCounters()
+{
+	// Emitted on this thread, for failed shows before showToast() returns.
+	connect(this, &QWinToast::toastNotDisplayed, this, [this](qint64 id, qint32, int) {
+		countNotDisplayed(id);
+	});
+}
+
+void QToastChannel::countShow(qint64 id, QWinToastError result)
+{
+	// Display failures are counted by countNotDisplayed() and throttling by
+	// admitToast(); NotInitialized and invalid input are not counted.
+	if (id >= 0) {
+		_shown.fetchAndAddRelaxed(1);
+	}
+	else if (result == QWinToastError::Duplicate || result == QWinToastError::CircuitOpen) {
+		_rejected.fetchAndAddRelaxed(1);
+	}
+}
+
+void QToastChannel::countNotDisplayed(qint64 id)
+{
+	_failed.fetchAndAddRelaxed(1);
+	// A known id was given up on after retries and was counted as shown.
+	if (id >= 0) {
+		quint64 shown = _shown.loadAcquire();
+		while (shown > 0 && !_shown.testAndSetOrdered(shown, shown - 1, shown)) {
+		}
+	}
+}
+
+bool QToastChannel::admit()
+{
+	QMutexLocker locker(&_limitMutex);
+	if (_maxLiveToasts > 0 && liveToastCount() >= _maxLiveToasts) {
+		return false;
+	}
+	if (_maxRate > 0.0) {
+		const qint64 now = clock()->now();
+		_tokens = qMin(_burst, _tokens + (now - _refilledAt) * _maxRate / 1000.0);
+		_refilledAt = now;
+		if (_tokens < 1.0) {
+			return false;
+		}
+		_tokens -= 1.0;
+	}
+	return true;
+}
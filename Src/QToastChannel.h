@@ -0,0 +1,75 @@
+#ifndef QTOASTCHANNEL
+#define QTOASTCHANNEL
+
+#include "QWinToast.h"
+#include <QAtomicInteger>
+#include <QMutex>
+
+// An independently configured notifier. Each channel has its own AUMI, app
+// name, live-toast index, limits and counters, so several plugins in one
+// host do not have to share the QWinToast::instance() identity. All channels
+// in a process share the default backend and therefore its COM setup and
+// activation factories.
+class QToastChannel : public QWinToast
+{
+    Q_OBJECT
+public:
+    struct Counters
+    {
+        // Accepted by the backend or still being retried; a toast given up on
+        // after retries moves from shown to failed.
+        quint64 shown;
+        // Reported through toastNotDisplayed().
+        quint64 failed;
+        quint64 throttled;
+        // Dropped as a duplicate or by the open circuit breaker.
+        quint64 rejected;
+        quint64 hidden;
+    };
+
+    explicit QToastChannel(QObject* parent = nullptr);
+    QToastChannel(const QString& appName, const QString& aumi, QObject* parent = nullptr);
+    ~QToastChannel() override;
+
+    // 0 disables the limit.
+    void setMaxLiveToasts(int limit);
+    int maxLiveToasts() const;
+    // Token bucket refilled at this rate with a burst of one second, but at
+    // least one toast, so rates below 1/s still admit; 0 disables it.
+    void setMaxToastsPerSecond(double rate);
+    double maxToastsPerSecond() const;
+
+    Counters counters() const;
+    void resetCounters();
+
+    qint64 showToast(const QWinToastTemplate& toast, QWinToastError* error = nullptr) override;
+    qint64 showCatalogToast(const QWinToastCatalogEntry& entry, const QStringList& values = QStringList(),
+                            QWinToastError* error = nullptr) override;
+    bool hideToast(qint64 id) override;
+
+protected:
+    // Apply the limits, so throttled toasts are traced like any other show.
+    bool admitToast(const QWinToastTemplate& toast, QWinToastError* error) override;
+    bool admitToast(const QWinToastCatalogEntry& entry, const QStringList& values, QWinToastError* error) override;
+
+private:
+    mutable QMutex _limitMutex;
+    int _maxLiveToasts{ 0 };
+    double _maxRate{ 0.0 };
+    double _burst{ 0.0 };
+    double _tokens{ 0.0 };
+    qint64 _refilledAt{ 0 };
+    QAtomicInteger<quint64> _shown{ 0 };
+    QAtomicInteger<quint64> _failed{ 0 };
+    QAtomicInteger<quint64> _throttled{ 0 };
+    QAtomicInteger<quint64> _rejected{ 0 };
+    QAtomicInteger<quint64> _hidden{ 0 };
+
+    bool admit();
+    bool throttle(int pendingTextProviders, QWinToastError* error);
+    void connectCounters();
+    void countShow(qint64 id, QWinToastError result);
+    void countNotDisplayed(qint64 id);
+};
+
+#endif // QTOASTCHANNEL
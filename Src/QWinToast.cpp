@@ -1,368 +1,66 @@
-#include "QWinToast.h"
-#include <memory>
+#include "QWinToast_p.h"
+#include "QWinToastXml.h"
+#include "QWinToastInstance.h"
+#include "QWinToastDigest.h"
+#include "QWinToastMetrics.h"
+#include "QWinToastCatalog.h"
+#include "QWinToastTrace.h"
 #include <assert.h>
-#include <unordered_map>
-#include <array>
+#include <limits.h>
 #include <QDebug>
+#include <QCoreApplication>
+#include <QMetaMethod>
 
-#pragma comment(lib,"shlwapi")
-#pragma comment(lib,"user32")
-
-#ifdef NDEBUG
-#define DEBUG_MSG(str) do { } while ( false )
-#else
-#define DEBUG_MSG(str) do { std::wcout << str << std::endl; } while( false )
-#endif
-
-#define DEFAULT_SHELL_LINKS_PATH	L"\\Microsoft\\Windows\\Start Menu\\Programs\\"
-#define DEFAULT_LINK_FORMAT			L".lnk"
-#define STATUS_SUCCESS (0x00000000)
-
-
-// Quickstart: Handling toast activations from Win32 apps in Windows 10
-// https://blogs.msdn.microsoft.com/tiles_and_toasts/2015/10/16/quickstart-handling-toast-activations-from-win32-apps-in-windows-10/
-namespace DllImporter
-{
-	// Function load a function from library
-	template <typename Function>
-	HRESULT loadFunctionFromLibrary(HINSTANCE library, LPCSTR name, Function& func)
-	{
-		if (!library)
-		{
-			return E_INVALIDARG;
-		}
-		func = reinterpret_cast<Function>(GetProcAddress(library, name));
-		return (func != nullptr) ? S_OK : E_FAIL;
-	}
-
-	using f_SetCurrentProcessExplicitAppUserModelID = HRESULT(FAR STDAPICALLTYPE*)(__in PCWSTR AppID);
-	using f_PropVariantToString = HRESULT(FAR STDAPICALLTYPE*)(
-		_In_ REFPROPVARIANT propvar, _Out_writes_(cch) PWSTR psz, _In_ UINT cch);
-	using f_RoGetActivationFactory = HRESULT(FAR STDAPICALLTYPE*)(_In_ HSTRING activatableClassId, _In_ REFIID iid,
-	                                                              _COM_Outptr_ void** factory);
-	using f_WindowsCreateStringReference = HRESULT(FAR STDAPICALLTYPE*)(
-		_In_reads_opt_(length + 1) PCWSTR sourceString, UINT32 length, _Out_ HSTRING_HEADER* hstringHeader,
-		_Outptr_result_maybenull_ _Result_nullonfailure_ HSTRING* string);
-	using f_WindowsGetStringRawBuffer = PCWSTR(FAR STDAPICALLTYPE*)(_In_ HSTRING string, _Out_opt_ UINT32* length);
-	using f_WindowsDeleteString = HRESULT(FAR STDAPICALLTYPE*)(_In_opt_ HSTRING string);
-
-	static f_SetCurrentProcessExplicitAppUserModelID SetCurrentProcessExplicitAppUserModelID;
-	static f_PropVariantToString PropVariantToString;
-	static f_RoGetActivationFactory RoGetActivationFactory;
-	static f_WindowsCreateStringReference WindowsCreateStringReference;
-	static f_WindowsGetStringRawBuffer WindowsGetStringRawBuffer;
-	static f_WindowsDeleteString WindowsDeleteString;
-
-
-	template <class T>
-	_Check_return_ __inline HRESULT _1_GetActivationFactory(_In_ HSTRING activatableClassId, _COM_Outptr_ T** factory)
-	{
-		return RoGetActivationFactory(activatableClassId, IID_INS_ARGS(factory));
-	}
-
-	template <typename T>
-	inline HRESULT Wrap_GetActivationFactory(_In_ HSTRING activatableClassId,
-	                                         _Inout_ Details::ComPtrRef<T> factory) noexcept
-	{
-		return _1_GetActivationFactory(activatableClassId, factory.ReleaseAndGetAddressOf());
-	}
-
-	inline HRESULT initialize()
-	{
-		HINSTANCE LibShell32 = LoadLibraryW(L"SHELL32.DLL");
-		HRESULT hr = loadFunctionFromLibrary(LibShell32, "SetCurrentProcessExplicitAppUserModelID",
-		                                     SetCurrentProcessExplicitAppUserModelID);
-		if (SUCCEEDED(hr))
-		{
-			HINSTANCE LibPropSys = LoadLibraryW(L"PROPSYS.DLL");
-			hr = loadFunctionFromLibrary(LibPropSys, "PropVariantToString", PropVariantToString);
-			if (SUCCEEDED(hr))
-			{
-				HINSTANCE LibComBase = LoadLibraryW(L"COMBASE.DLL");
-				const bool succeded = SUCCEEDED(
-						loadFunctionFromLibrary(LibComBase, "RoGetActivationFactory", RoGetActivationFactory))
-					&& SUCCEEDED(
-						loadFunctionFromLibrary(LibComBase, "WindowsCreateStringReference", WindowsCreateStringReference
-						))
-					&& SUCCEEDED(
-						loadFunctionFromLibrary(LibComBase, "WindowsGetStringRawBuffer", WindowsGetStringRawBuffer))
-					&& SUCCEEDED(loadFunctionFromLibrary(LibComBase, "WindowsDeleteString", WindowsDeleteString));
-				return succeded ? S_OK : E_FAIL;
-			}
-		}
-		return hr;
-	}
-}
-
-class WinToastStringWrapper
-{
-public:
-	WinToastStringWrapper(_In_reads_(length) PCWSTR stringRef, _In_ UINT32 length) noexcept
-	{
-		HRESULT hr = DllImporter::WindowsCreateStringReference(stringRef, length, &_header, &_hstring);
-		if (!SUCCEEDED(hr))
-		{
-			RaiseException(static_cast<DWORD>(STATUS_INVALID_PARAMETER), EXCEPTION_NONCONTINUABLE, 0, nullptr);
-		}
-	}
-
-	WinToastStringWrapper(_In_ const std::wstring& stringRef) noexcept
-	{
-		HRESULT hr = DllImporter::WindowsCreateStringReference(stringRef.c_str(),
-		                                                       static_cast<UINT32>(stringRef.length()), &_header,
-		                                                       &_hstring);
-		if (FAILED(hr))
-		{
-			RaiseException(static_cast<DWORD>(STATUS_INVALID_PARAMETER), EXCEPTION_NONCONTINUABLE, 0, nullptr);
-		}
-	}
-
-	~WinToastStringWrapper()
-	{
-		DllImporter::WindowsDeleteString(_hstring);
-	}
-
-	inline HSTRING Get() const noexcept
-	{
-		return _hstring;
-	}
-
-private:
-	HSTRING _hstring;
-	HSTRING_HEADER _header;
-};
-
-class InternalDateTime : public IReference<DateTime>
+namespace Metrics
 {
-public:
-	static INT64 Now()
-	{
-		FILETIME now;
-		GetSystemTimeAsFileTime(&now);
-		return ((((INT64)now.dwHighDateTime) << 32) | now.dwLowDateTime);
-	}
-
-	InternalDateTime(DateTime dateTime) : _dateTime(dateTime)
-	{
-	}
-
-	InternalDateTime(INT64 millisecondsFromNow)
-	{
-		_dateTime.UniversalTime = Now() + millisecondsFromNow * 10000;
-	}
-
-	virtual ~InternalDateTime() = default;
-
-	operator INT64()
-	{
-		return _dateTime.UniversalTime;
-	}
+	// Activation buckets: no action, actions 0-4 (the shell's maximum) and anything else.
+	const int ActivationBuckets = 7;
 
-	HRESULT STDMETHODCALLTYPE get_Value(DateTime* dateTime) override
+	struct ToastMetrics
 	{
-		*dateTime = _dateTime;
-		return S_OK;
-	}
-
-	HRESULT STDMETHODCALLTYPE QueryInterface(const IID& riid, void** ppvObject) override
-	{
-		if (!ppvObject)
-		{
-			return E_POINTER;
-		}
-		if (riid == __uuidof(IUnknown) || riid == __uuidof(IReference<DateTime>))
-		{
-			*ppvObject = static_cast<IUnknown*>(static_cast<IReference<DateTime>*>(this));
-			return S_OK;
-		}
-		return E_NOINTERFACE;
-	}
-
-	ULONG STDMETHODCALLTYPE Release() override
-	{
-		return 1;
-	}
-
-	ULONG STDMETHODCALLTYPE AddRef() override
-	{
-		return 2;
-	}
-
-	HRESULT STDMETHODCALLTYPE GetIids(ULONG*, IID**) override
-	{
-		return E_NOTIMPL;
-	}
-
-	HRESULT STDMETHODCALLTYPE GetRuntimeClassName(HSTRING*) override
-	{
-		return E_NOTIMPL;
-	}
-
-	HRESULT STDMETHODCALLTYPE GetTrustLevel(TrustLevel*) override
-	{
-		return E_NOTIMPL;
-	}
-
-protected:
-	DateTime _dateTime;
-};
-
-namespace Util
-{
-	typedef LONG NTSTATUS, *PNTSTATUS;
-	using RtlGetVersionPtr = NTSTATUS(WINAPI*)(PRTL_OSVERSIONINFOW);
-
-	inline RTL_OSVERSIONINFOW getRealOSVersion()
-	{
-		HMODULE hMod = ::GetModuleHandleW(L"ntdll.dll");
-		if (hMod)
-		{
-			auto fxPtr = (RtlGetVersionPtr)::GetProcAddress(hMod, "RtlGetVersion");
-			if (fxPtr != nullptr)
-			{
-				RTL_OSVERSIONINFOW rovi = {0};
-				rovi.dwOSVersionInfoSize = sizeof(rovi);
-				if (STATUS_SUCCESS == fxPtr(&rovi))
-				{
-					return rovi;
-				}
-			}
-		}
-		RTL_OSVERSIONINFOW rovi = {0};
-		return rovi;
-	}
-
-	inline HRESULT defaultExecutablePath(_In_ WCHAR* path, _In_ DWORD nSize = MAX_PATH)
-	{
-		DWORD written = GetModuleFileNameExW(GetCurrentProcess(), nullptr, path, nSize);
-		DEBUG_MSG("Default executable path: " << path);
-		return (written > 0) ? S_OK : E_FAIL;
-	}
-
-
-	inline HRESULT defaultShellLinksDirectory(_In_ WCHAR* path, _In_ DWORD nSize = MAX_PATH)
-	{
-		DWORD written = GetEnvironmentVariableW(L"APPDATA", path, nSize);
-		HRESULT hr = written > 0 ? S_OK : E_INVALIDARG;
-		if (SUCCEEDED(hr))
-		{
-			errno_t result = wcscat_s(path, nSize, DEFAULT_SHELL_LINKS_PATH);
-			hr = (result == 0) ? S_OK : E_INVALIDARG;
-			DEBUG_MSG("Default shell link path: " << path);
-		}
-		return hr;
-	}
-
-	inline HRESULT defaultShellLinkPath(const std::wstring& appname, _In_ WCHAR* path, _In_ DWORD nSize = MAX_PATH)
-	{
-		HRESULT hr = defaultShellLinksDirectory(path, nSize);
-		if (SUCCEEDED(hr))
-		{
-			const std::wstring appLink(appname + DEFAULT_LINK_FORMAT);
-			errno_t result = wcscat_s(path, nSize, appLink.c_str());
-			hr = (result == 0) ? S_OK : E_INVALIDARG;
-			DEBUG_MSG("Default shell link file path: " << path);
-		}
-		return hr;
-	}
-
-
-	inline PCWSTR AsString(ComPtr<IXmlDocument>& xmlDocument)
-	{
-		HSTRING xml;
-		ComPtr<IXmlNodeSerializer> ser;
-		HRESULT hr = xmlDocument.As<IXmlNodeSerializer>(&ser);
-		hr = ser->GetXml(&xml);
-		if (SUCCEEDED(hr))
-			return DllImporter::WindowsGetStringRawBuffer(xml, nullptr);
-		return nullptr;
-	}
-
-	inline PCWSTR AsString(HSTRING hstring)
-	{
-		return DllImporter::WindowsGetStringRawBuffer(hstring, nullptr);
-	}
-
-	inline HRESULT setNodeStringValue(const std::wstring& string, IXmlNode* node, IXmlDocument* xml)
-	{
-		ComPtr<IXmlText> textNode;
-		HRESULT hr = xml->CreateTextNode(WinToastStringWrapper(string).Get(), &textNode);
-		if (SUCCEEDED(hr))
-		{
-			ComPtr<IXmlNode> stringNode;
-			hr = textNode.As(&stringNode);
-			if (SUCCEEDED(hr))
-			{
-				ComPtr<IXmlNode> appendedChild;
-
-				qDebug() << "setNodeStringValue: " << string;
-
-				hr = node->AppendChild(stringNode.Get(), &appendedChild);
-			}
-		}
-		return hr;
-	}
+		QWinToastMetric* shown;
+		QWinToastMetric* failed;
+		QWinToastMetric* retried;
+		QWinToastMetric* shortCircuited;
+		QWinToastMetric* deduplicated;
+		QWinToastMetric* hidden;
+		QWinToastMetric* live;
+		QWinToastMetric* queueDepth;
+		QWinToastMetric* providersEvaluated;
+		QWinToastMetric* providersSkipped;
+		QWinToastMetric* activations[ActivationBuckets];
+	};
 
-	inline HRESULT addAttribute(_In_ IXmlDocument* xml, const std::wstring& name, IXmlNamedNodeMap* attributeMap)
-	{
-		ComPtr<ABI::Windows::Data::Xml::Dom::IXmlAttribute> srcAttribute;
-		HRESULT hr = xml->CreateAttribute(WinToastStringWrapper(name).Get(), &srcAttribute);
-		if (SUCCEEDED(hr))
-		{
-			ComPtr<IXmlNode> node;
-			hr = srcAttribute.As(&node);
-			if (SUCCEEDED(hr))
-			{
-				ComPtr<IXmlNode> pNode;
-				hr = attributeMap->SetNamedItem(node.Get(), &pNode);
+	inline const ToastMetrics& get() {
+		static const ToastMetrics metrics = [] {
+			QWinToastMetrics* registry = QWinToastMetrics::global();
+			ToastMetrics m;
+			m.shown = registry->counter("qwintoast_toasts_shown_total", "Toasts accepted by the backend.");
+			m.failed = registry->counter("qwintoast_toasts_failed_total", "Toasts the backend failed to display.");
+			m.retried = registry->counter("qwintoast_toasts_retried_total", "Show attempts scheduled after a transient failure.");
+			m.shortCircuited = registry->counter("qwintoast_toasts_short_circuited_total", "Toasts rejected while the circuit breaker was open.");
+			m.deduplicated = registry->counter("qwintoast_toasts_deduplicated_total", "Toasts dropped as repeats within the duplicate window.");
+			m.hidden = registry->counter("qwintoast_toasts_hidden_total", "Toasts hidden by the application.");
+			m.live = registry->gauge("qwintoast_live_toasts", "Toasts currently tracked as live.");
+			m.queueDepth = registry->gauge("qwintoast_event_queue_depth", "Backend events waiting to be delivered.");
+			m.providersEvaluated = registry->counter("qwintoast_text_providers_evaluated_total", "Text providers run to build a shown toast.");
+			m.providersSkipped = registry->counter("qwintoast_text_providers_skipped_total", "Text providers never run because their toast was dropped or folded.");
+			for (int i = 0; i < ActivationBuckets; i++) {
+				const QString action = i == 0 ? QStringLiteral("none")
+					: i == ActivationBuckets - 1 ? QStringLiteral("other") : QString::number(i - 1);
+				m.activations[i] = registry->counter("qwintoast_activations_total", "Toast activations by action index.",
+					{ qMakePair(QStringLiteral("action"), action) });
 			}
-		}
-		return hr;
+			return m;
+		}();
+		return metrics;
 	}
 
-	inline HRESULT createElement(_In_ IXmlDocument* xml, _In_ const std::wstring& root_node,
-	                             _In_ const std::wstring& element_name,
-	                             _In_ const std::vector<std::wstring>& attribute_names)
-	{
-		ComPtr<IXmlNodeList> rootList;
-		HRESULT hr = xml->GetElementsByTagName(WinToastStringWrapper(root_node).Get(), &rootList);
-		if (SUCCEEDED(hr))
-		{
-			ComPtr<IXmlNode> root;
-			hr = rootList->Item(0, &root);
-			if (SUCCEEDED(hr))
-			{
-				ComPtr<ABI::Windows::Data::Xml::Dom::IXmlElement> audioElement;
-				hr = xml->CreateElement(WinToastStringWrapper(element_name).Get(), &audioElement);
-				if (SUCCEEDED(hr))
-				{
-					ComPtr<IXmlNode> audioNodeTmp;
-					hr = audioElement.As(&audioNodeTmp);
-					if (SUCCEEDED(hr))
-					{
-						ComPtr<IXmlNode> audioNode;
-						hr = root->AppendChild(audioNodeTmp.Get(), &audioNode);
-						if (SUCCEEDED(hr))
-						{
-							ComPtr<IXmlNamedNodeMap> attributes;
-							hr = audioNode->get_Attributes(&attributes);
-							if (SUCCEEDED(hr))
-							{
-								for (const auto& it : attribute_names)
-								{
-									hr = addAttribute(xml, it, attributes.Get());
-								}
-							}
-						}
-					}
-				}
-			}
-		}
-		return hr;
+	inline QWinToastMetric* activation(int actionIndex) {
+		return get().activations[qBound(0, actionIndex + 1, ActivationBuckets - 1)];
 	}
 }
 
-
 QWinToastTemplate::QWinToastTemplate(WinToastTemplateType type) :
 	_type(type)
 {
@@ -395,6 +93,45 @@ void QWinToastTemplate::setTextField(const QString& text, TextField pos)
 	const auto position = static_cast<std::size_t>(pos);
 	assert(position < _textFields.size());
 	_textFields[position] = text;
+	if (position < static_cast<std::size_t>(_textProviders.size())) {
+		_textProviders[position] = TextProvider();
+	}
+}
+
+void QWinToastTemplate::setTextProvider(TextField pos, const TextProvider& provider)
+{
+	const auto position = static_cast<std::size_t>(pos);
+	assert(position < _textFields.size());
+	if (_textProviders.isEmpty()) {
+		_textProviders.resize(_textFields.size());
+	}
+	_textFields[position].clear();
+	_textProviders[position] = provider;
+}
+
+int QWinToastTemplate::pendingTextProviders() const
+{
+	int count = 0;
+	for (const TextProvider& provider : _textProviders) {
+		if (provider) {
+			count++;
+		}
+	}
+	return count;
+}
+
+int QWinToastTemplate::resolveTextProviders()
+{
+	int count = 0;
+	for (int i = 0; i < _textProviders.size(); i++) {
+		if (_textProviders[i]) {
+			_textFields[i] = _textProviders[i]();
+			count++;
+		}
+	}
+	_textProviders.clear();
+	Metrics::get().providersEvaluated->add(count);
+	return count;
 }
 
 void QWinToastTemplate::setAttributionText(const QString& attributionText)
@@ -457,9 +194,9 @@ void QWinToastTemplate::setDuration(Duration duration)
 	_duration = duration;
 }
 
-void QWinToastTemplate::setExpiration(INT64 millsecondsFromNow)
+void QWinToastTemplate::setExpiration(qint64 millsecondsFromNow)
 {
-	_expiration = expiration();
+	_expiration = millsecondsFromNow;
 }
 
 void QWinToastTemplate::setScenario(Scenario scenario)
@@ -472,9 +209,37 @@ void QWinToastTemplate::setScenario(Scenario scenario)
 	}
 }
 
+void QWinToastTemplate::setTag(const QString& tag)
+{
+	_tag = tag;
+}
+
+void QWinToastTemplate::setGroup(const QString& group)
+{
+	_group = group;
+}
+
+void QWinToastTemplate::setDigestKey(const QString& key)
+{
+	_digestKey = key;
+}
+
 void QWinToastTemplate::addAction(const QString& label)
 {
 	_actions.push_back(label);
+	_actionArguments.push_back(QString());
+}
+
+void QWinToastTemplate::addAction(const QString& label, const QString& command, const QWinToastArguments& arguments)
+{
+	QString encoded = QStringLiteral("c=");
+	QWinToastArguments::appendEncoded(encoded, command);
+	if (!arguments.isEmpty()) {
+		encoded += QLatin1Char('&');
+		encoded += arguments.encoded();
+	}
+	_actions.push_back(label);
+	_actionArguments.push_back(encoded);
 }
 
 std::size_t QWinToastTemplate::textFieldsCount() const
@@ -510,6 +275,12 @@ const QString& QWinToastTemplate::actionLabel(std::size_t pos) const
 	return _actions[pos];
 }
 
+const QString& QWinToastTemplate::actionArguments(std::size_t pos) const
+{
+	assert(pos < _actionArguments.size());
+	return _actionArguments[pos];
+}
+
 const QString& QWinToastTemplate::imagePath() const
 {
 	return _imagePath;
@@ -530,7 +301,22 @@ const QString& QWinToastTemplate::scenario() const
 	return _scenario;
 }
 
-INT64 QWinToastTemplate::expiration() const
+const QString& QWinToastTemplate::tag() const
+{
+	return _tag;
+}
+
+const QString& QWinToastTemplate::group() const
+{
+	return _group;
+}
+
+const QString& QWinToastTemplate::digestKey() const
+{
+	return _digestKey;
+}
+
+qint64 QWinToastTemplate::expiration() const
 {
 	return _expiration;
 }
@@ -556,10 +342,27 @@ QWinToast* QWinToast::instance()
 	return &instance;
 }
 
+QWinToastPrivate::QWinToastPrivate(QWinToast* toast) :
+	q(toast),
+	_digest(new QWinToastDigest())
+{
+}
+
+QWinToastPrivate::~QWinToastPrivate()
+{
+	// Futures still waiting see a failure; suspended coroutines are not resumed
+	// into an object that is going away.
+	for (auto it = _pending.begin(); it != _pending.end(); ++it) {
+		QWinToastResult result;
+		result.id = it.key();
+		it->promise.reportResult(result);
+		it->promise.reportFinished();
+	}
+}
+
 QWinToast::QWinToast(QObject* parent) :
 	QObject(parent),
-	_isInitialized(false),
-	_hasCoInitialized(false)
+	_d(new QWinToastPrivate(this))
 {
 	if (!isCompatible())
 	{
@@ -569,42 +372,38 @@ QWinToast::QWinToast(QObject* parent) :
 
 QWinToast::~QWinToast()
 {
-	if(_hasCoInitialized)
-	{
-		CoUninitialize();
+	// The backend holds this pointer for every toast still on screen.
+	if (_d->_backend) {
+		_d->_backend->detach(this);
 	}
 }
 
 void QWinToast::setAppName(const QString& appName)
 {
-	_appName = appName;
+	_d->_appName = appName;
 }
 
 void QWinToast::setAppUserModelID(const QString& aumi)
 {
-	_aumi = aumi;
-	qDebug() << "Default App User Model Id: " << _aumi;
+	_d->_aumi = aumi;
+	qDebug() << "Default App User Model Id: " << _d->_aumi;
 }
 
 void QWinToast::setShortcutPolicy(ShortcutPolicy policy)
 {
-	_shortcutPolicy = policy;
+	_d->_shortcutPolicy = policy;
 }
 
 bool QWinToast::isCompatible()
 {
-	DllImporter::initialize();
-	return !((DllImporter::SetCurrentProcessExplicitAppUserModelID == nullptr)
-		|| (DllImporter::PropVariantToString == nullptr)
-		|| (DllImporter::RoGetActivationFactory == nullptr)
-		|| (DllImporter::WindowsCreateStringReference == nullptr)
-		|| (DllImporter::WindowsDeleteString == nullptr));
+	QWinToastBackend* platform = QWinToastBackend::platformBackend();
+	return platform && platform->isCompatible();
 }
 
 bool QWinToast::isSupportingModernFeatures()
 {
-	constexpr auto MinimumSupportedVersion = 6;
-	return Util::getRealOSVersion().dwMajorVersion > MinimumSupportedVersion;
+	QWinToastBackend* platform = QWinToastBackend::platformBackend();
+	return platform && platform->supportsModernFeatures();
 }
 
 QString QWinToast::configureAUMI(const QString& companyName, const QString& product, const QString& subProduct, const QString& versionInformation)
@@ -636,7 +435,10 @@ const QString& QWinToast::strerror(QWinToastError error)
 		{QWinToastError::InvalidAppUserModelID, "The AUMI is not a valid one"},
 		{QWinToastError::InvalidParameters, "The parameters used to configure the library are not valid normally because an invalid AUMI or App Name"},
 		{QWinToastError::NotDisplayed, "The toast was created correctly but WinToast was not able to display the toast"},
-		{QWinToastError::UnknownError, "Unknown error"}
+		{QWinToastError::UnknownError, "Unknown error"},
+		{QWinToastError::Throttled, "The toast was rejected by a channel limit"},
+		{QWinToastError::CircuitOpen, "The toast was rejected because recent toasts kept failing"},
+		{QWinToastError::Duplicate, "The toast repeats one shown within the duplicate window"}
 	};
 
 	const auto iter = Labels.find(error);
@@ -645,662 +447,901 @@ const QString& QWinToast::strerror(QWinToastError error)
 }
 
 enum QWinToast::ShortcutResult QWinToast::createShortcut() {
-	if (_aumi.isEmpty() || _appName.isEmpty()) {
+	if (_d->_aumi.isEmpty() || _d->_appName.isEmpty()) {
 		DEBUG_MSG(L"Error: App User Model Id or Appname is empty!");
 		return SHORTCUT_MISSING_PARAMETERS;
 	}
-
-	if (!isCompatible()) {
-		DEBUG_MSG(L"Your OS is not compatible with this library! =(");
+	if (!backend()) {
 		return SHORTCUT_INCOMPATIBLE_OS;
 	}
+	return backend()->createShortcut(this);
+}
 
-	if (!_hasCoInitialized) {
-		HRESULT initHr = CoInitializeEx(nullptr, COINIT::COINIT_MULTITHREADED);
-		if (initHr != RPC_E_CHANGED_MODE) {
-			if (FAILED(initHr) && initHr != S_FALSE) {
-				DEBUG_MSG(L"Error on COM library initialization!");
-				return SHORTCUT_COM_INIT_FAILURE;
-			}
-			else {
-				_hasCoInitialized = true;
-			}
-		}
+bool QWinToast::initialize(QWinToastError* error) {
+	_d->_isInitialized = false;
+	setError(error, QWinToastError::NoError);
+
+	if (_d->_aumi.isEmpty() || _d->_appName.isEmpty()) {
+		setError(error, QWinToastError::InvalidParameters);
+		DEBUG_MSG(L"Error while initializing, did you set up a valid AUMI and App name?");
+		return false;
+	}
+	if (!backend()) {
+		setError(error, QWinToastError::SystemNotSupported);
+		DEBUG_MSG(L"Error: no backend for this platform.");
+		return false;
 	}
 
-	bool wasChanged;
-	HRESULT hr = validateShellLinkHelper(wasChanged);
-	if (SUCCEEDED(hr))
-		return wasChanged ? SHORTCUT_WAS_CHANGED : SHORTCUT_UNCHANGED;
+	_d->_isInitialized = backend()->initialize(this, error);
+	return _d->_isInitialized;
+}
 
-	hr = createShellLinkHelper();
-	return SUCCEEDED(hr) ? SHORTCUT_WAS_CREATED : SHORTCUT_CREATE_FAILED;
+bool QWinToast::isInitialized() const {
+	return _d->_isInitialized;
 }
 
-bool QWinToast::initialize(_Out_opt_ QWinToastError* error) {
-	_isInitialized = false;
-	setError(error, QWinToastError::NoError);
+const QString& QWinToast::appName() const {
+	return _d->_appName;
+}
 
-	if (!isCompatible()) {
-		setError(error, QWinToastError::SystemNotSupported);
-		DEBUG_MSG(L"Error: system not supported.");
-		return false;
+const QString& QWinToast::appUserModelId() const {
+	return _d->_aumi;
+}
+
+qint64 QWinToast::showToast(const QWinToastTemplate& toast, QWinToastError* error) {
+	const qint64 id = admitToast(toast, error) ? _d->showToast(toast, error) : -1;
+	if (_d->_trace) {
+		_d->_trace->recordShow(toast, id);
 	}
+	return id;
+}
 
+bool QWinToast::admitToast(const QWinToastTemplate&, QWinToastError*) {
+	return true;
+}
 
-	if (_aumi.isEmpty() || _appName.isEmpty()) {
-		setError(error, QWinToastError::InvalidParameters);
-		DEBUG_MSG(L"Error while initializing, did you set up a valid AUMI and App name?");
-		return false;
+bool QWinToast::admitToast(const QWinToastCatalogEntry&, const QStringList&, QWinToastError*) {
+	return true;
+}
+
+qint64 QWinToastPrivate::showToast(const QWinToastTemplate& toast, QWinToast::QWinToastError* error) {
+	QWinToast::setError(error, QWinToast::NoError);
+	if (!_isInitialized) {
+		QWinToast::setError(error, QWinToast::NotInitialized);
+		DEBUG_MSG("Error when launching the toast. WinToast is not initialized.");
+		Metrics::get().providersSkipped->add(toast.pendingTextProviders());
+		return -1;
+	}
+
+	// Content of a template with providers is unknown until delivery, and
+	// running them here would defeat the point.
+	if (_dedupe.ttl() > 0 && toast.pendingTextProviders() == 0
+		&& _dedupe.isDuplicate(QWinToastDedupe::contentHash(toast), _clock->now())) {
+		Metrics::get().deduplicated->increment();
+		QWinToast::setError(error, QWinToast::Duplicate);
+		return -1;
 	}
 
-	if (_shortcutPolicy != SHORTCUT_POLICY_IGNORE) {
-		if (createShortcut() < 0) {
-			setError(error, QWinToastError::ShellLinkNotCreated);
-			DEBUG_MSG(L"Error while attaching the AUMI to the current proccess =(");
-			return false;
+	if (!toast.digestKey().isEmpty() && _digest->window() > 0) {
+		// A new burst has to replace the live toast with its tag, typically the
+		// summary of the previous burst, rather than leave it tracked under a
+		// stale id.
+		qint64 id = -1;
+		{
+			QMutexLocker locker(&_bufferMutex);
+			id = _tags.value(qMakePair(toast.group(), QWinToastDigest::burstTag(toast.digestKey(), toast)), -1);
+		}
+		QWinToastTemplate first;
+		if (_digest->fold(toast.digestKey(), toast, id, first)) {
+			Metrics::get().providersSkipped->add(toast.pendingTextProviders());
+			return id;
+		}
+		id = deliverToast(first, error, id);
+		if (id < 0) {
+			_digest->cancel(toast.digestKey());
+			return id;
 		}
+		// The window may be armed from any thread; the timer lives on ours.
+		const QString key = toast.digestKey();
+		const int window = _digest->window();
+		QMetaObject::invokeMethod(q, [this, key, window]() {
+			_clock->schedule(window, q, [this, key]() { flushDigest(key); });
+		}, Qt::QueuedConnection);
+		return id;
 	}
+	return deliverToast(toast, error);
+}
 
-	if (FAILED(DllImporter::SetCurrentProcessExplicitAppUserModelID(_aumi.toStdWString().c_str()))) {
-		setError(error, QWinToastError::InvalidAppUserModelID);
-		DEBUG_MSG(L"Error while attaching the AUMI to the current proccess =(");
-		return false;
+QFuture<QWinToastResult> QWinToast::showToastForResult(const QWinToastTemplate& toast, QWinToastError* error) {
+	return showToastForResult(toast, error, nullptr);
+}
+
+QFuture<QWinToastResult> QWinToast::showToastForResult(const QWinToastTemplate& toast, QWinToastError* error, qint64* id) {
+	QWinToastPrivate::PendingResult pending{ QFutureInterface<QWinToastResult>(), nullptr, nullptr };
+	pending.promise.reportStarted();
+	const QFuture<QWinToastResult> future = pending.promise.future();
+	const qint64 shown = showToast(toast, error);
+	if (id) {
+		*id = shown;
+	}
+	if (shown < 0) {
+		pending.promise.reportResult(QWinToastResult());
+		pending.promise.reportFinished();
+		return future;
 	}
+	// Events are drained on this thread, so none can resolve the toast before
+	// the entry is in place.
+	QMutexLocker locker(&_d->_bufferMutex);
+	_d->_pending.insert(shown, pending);
+	return future;
+}
 
-	_isInitialized = true;
-	return _isInitialized;
+bool QWinToast::resumeOnResult(qint64 id, void (*resume)(void*), void* context) {
+	QMutexLocker locker(&_d->_bufferMutex);
+	auto it = _d->_pending.find(id);
+	while (it != _d->_pending.end() && it.key() == id) {
+		if (!it->resume) {
+			it->resume = resume;
+			it->context = context;
+			return true;
+		}
+		++it;
+	}
+	return false;
 }
 
-bool QWinToast::isInitialized() const {
-	return _isInitialized;
+qint64 QWinToast::showCatalogToast(const QWinToastCatalogEntry& entry, const QStringList& values, QWinToastError* error) {
+	const qint64 id = admitToast(entry, values, error) ? _d->showCatalogToast(entry, values, error) : -1;
+	if (_d->_trace) {
+		_d->_trace->recordShowCatalog(entry, values, id);
+	}
+	return id;
 }
 
-const QString& QWinToast::appName() const {
-	return _appName;
+qint64 QWinToastPrivate::showCatalogToast(const QWinToastCatalogEntry& entry, const QStringList& values, QWinToast::QWinToastError* error) {
+	QWinToast::setError(error, QWinToast::NoError);
+	if (!_isInitialized) {
+		QWinToast::setError(error, QWinToast::NotInitialized);
+		DEBUG_MSG("Error when launching the toast. WinToast is not initialized.");
+		return -1;
+	}
+	if (values.size() > entry.placeholderCount) {
+		QWinToast::setError(error, QWinToast::InvalidParameters);
+		return -1;
+	}
+	if (_dedupe.ttl() > 0 && _dedupe.isDuplicate(QWinToastDedupe::catalogHash(entry, values), _clock->now())) {
+		Metrics::get().deduplicated->increment();
+		QWinToast::setError(error, QWinToast::Duplicate);
+		return -1;
+	}
+
+	const QString tag = QString::fromUtf16(entry.tag);
+	const QString group = QString::fromUtf16(entry.group);
+	const bool modern = q->backend()->supportsModernFeatures();
+	return deliverPayload(tag, group, entry.expiration, [&entry, &values, modern]() {
+		return QWinToastCatalog::payload(entry, values, modern);
+	}, error, -1);
 }
 
-const QString& QWinToast::appUserModelId() const {
-	return _aumi;
-}
-
-HRESULT	QWinToast::validateShellLinkHelper(_Out_ bool& wasChanged) {
-	WCHAR	path[MAX_PATH] = { L'\0' };
-	Util::defaultShellLinkPath(_appName.toStdWString(), path);
-	// Check if the file exist
-	DWORD attr = GetFileAttributesW(path);
-	if (attr >= 0xFFFFFFF) {
-		DEBUG_MSG("Error, shell link not found. Try to create a new one in: " << path);
-		return E_FAIL;
-	}
-
-	// Let's load the file as shell link to validate.
-	// - Create a shell link
-	// - Create a persistant file
-	// - Load the path as data for the persistant file
-	// - Read the property AUMI and validate with the current
-	// - Review if AUMI is equal.
-	ComPtr<IShellLink> shellLink;
-	HRESULT hr = CoCreateInstance(CLSID_ShellLink, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&shellLink));
-	if (SUCCEEDED(hr)) {
-		ComPtr<IPersistFile> persistFile;
-		hr = shellLink.As(&persistFile);
-		if (SUCCEEDED(hr)) {
-			hr = persistFile->Load(path, STGM_READWRITE);
-			if (SUCCEEDED(hr)) {
-				ComPtr<IPropertyStore> propertyStore;
-				hr = shellLink.As(&propertyStore);
-				if (SUCCEEDED(hr)) {
-					PROPVARIANT appIdPropVar;
-					hr = propertyStore->GetValue(PKEY_AppUserModel_ID, &appIdPropVar);
-					if (SUCCEEDED(hr)) {
-						WCHAR AUMI[MAX_PATH];
-						hr = DllImporter::PropVariantToString(appIdPropVar, AUMI, MAX_PATH);
-						wasChanged = false;
-						if (FAILED(hr) || _aumi != AUMI) {
-							if (_shortcutPolicy == SHORTCUT_POLICY_REQUIRE_CREATE) {
-								// AUMI Changed for the same app, let's update the current value! =)
-								wasChanged = true;
-								PropVariantClear(&appIdPropVar);
-								hr = InitPropVariantFromString(_aumi.toStdWString().c_str(), &appIdPropVar);
-								if (SUCCEEDED(hr)) {
-									hr = propertyStore->SetValue(PKEY_AppUserModel_ID, appIdPropVar);
-									if (SUCCEEDED(hr)) {
-										hr = propertyStore->Commit();
-										if (SUCCEEDED(hr) && SUCCEEDED(persistFile->IsDirty())) {
-											hr = persistFile->Save(path, TRUE);
-										}
-									}
-								}
-							}
-							else {
-								// Not allowed to touch the shortcut to fix the AUMI
-								hr = E_FAIL;
-							}
-						}
-						PropVariantClear(&appIdPropVar);
-					}
-				}
-			}
+qint64 QWinToastPrivate::deliverToast(const QWinToastTemplate& toast, QWinToast::QWinToastError* error, qint64 id) {
+	const bool modern = q->backend()->supportsModernFeatures();
+	bool built = false;
+	id = deliverPayload(toast.tag(), toast.group(), toast.expiration(), [&toast, modern, &built]() {
+		built = true;
+		if (toast.pendingTextProviders() == 0) {
+			return QWinToastXml::toastPayload(toast, modern);
 		}
+		QWinToastTemplate resolved = toast;
+		resolved.resolveTextProviders();
+		return QWinToastXml::toastPayload(resolved, modern);
+	}, error, id);
+	if (!built) {
+		Metrics::get().providersSkipped->add(toast.pendingTextProviders());
 	}
-	return hr;
-}
-
-
-HRESULT	QWinToast::createShellLinkHelper() {
-	if (_shortcutPolicy != SHORTCUT_POLICY_REQUIRE_CREATE) {
-		return E_FAIL;
-	}
-
-	WCHAR   exePath[MAX_PATH]{ L'\0' };
-	WCHAR	slPath[MAX_PATH]{ L'\0' };
-	Util::defaultShellLinkPath(_appName.toStdWString(), slPath);
-	Util::defaultExecutablePath(exePath);
-	ComPtr<IShellLinkW> shellLink;
-	HRESULT hr = CoCreateInstance(CLSID_ShellLink, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&shellLink));
-	if (SUCCEEDED(hr)) {
-		hr = shellLink->SetPath(exePath);
-		if (SUCCEEDED(hr)) {
-			hr = shellLink->SetArguments(L"");
-			if (SUCCEEDED(hr)) {
-				hr = shellLink->SetWorkingDirectory(exePath);
-				if (SUCCEEDED(hr)) {
-					ComPtr<IPropertyStore> propertyStore;
-					hr = shellLink.As(&propertyStore);
-					if (SUCCEEDED(hr)) {
-						PROPVARIANT appIdPropVar;
-						hr = InitPropVariantFromString(_aumi.toStdWString().c_str(), &appIdPropVar);
-						if (SUCCEEDED(hr)) {
-							hr = propertyStore->SetValue(PKEY_AppUserModel_ID, appIdPropVar);
-							if (SUCCEEDED(hr)) {
-								hr = propertyStore->Commit();
-								if (SUCCEEDED(hr)) {
-									ComPtr<IPersistFile> persistFile;
-									hr = shellLink.As(&persistFile);
-									if (SUCCEEDED(hr)) {
-										hr = persistFile->Save(slPath, TRUE);
-									}
-								}
-							}
-							PropVariantClear(&appIdPropVar);
-						}
-					}
-				}
-			}
+	return id;
+}
+
+qint64 QWinToastPrivate::deliverPayload(const QString& tag, const QString& group, qint64 expiration,
+                                        const std::function<QString()>& payload, QWinToast::QWinToastError* error, qint64 id) {
+	// Checked before the payload is built so an open circuit costs next to nothing.
+	if (!admitShow()) {
+		Metrics::get().shortCircuited->increment();
+		QWinToast::setError(error, QWinToast::CircuitOpen);
+		return -1;
+	}
+
+	// A tagged toast replaces the live toast with the same (group, tag) and keeps its id.
+	bool replacing = false;
+	{
+		QMutexLocker locker(&_bufferMutex);
+		if (id < 0 && !tag.isEmpty()) {
+			id = _tags.value(qMakePair(group, tag), -1);
 		}
+		replacing = id >= 0 && _buffer.contains(id);
+	}
+	if (!replacing) {
+		if (id < 0) {
+			id = QWinToast::nextToastId();
+		}
+		// Registered before show() so an event racing back from the backend finds it.
+		trackToast(id, group, tag);
 	}
-	return hr;
-}
 
-INT64 QWinToast::showToast(_In_ const QWinToastTemplate& toast, _Out_ QWinToastError* error) {
-	setError(error, QWinToastError::NoError);
-	INT64 id = -1;
-	if (!isInitialized()) {
-		setError(error, QWinToastError::NotInitialized);
-		DEBUG_MSG("Error when launching the toast. WinToast is not initialized.");
+	const QWinToastBackend::Request request{ id, expiration, payload(), tag, group };
+	const QWinToastBackend::Result hr = q->backend()->show(q, request);
+	noteShowResult(QWinToastBackend::succeeded(hr));
+	if (QWinToastBackend::succeeded(hr)) {
+		Metrics::get().shown->increment();
+		scheduleExpiry(id, request.expiration);
+		return id;
+	}
+	if (_retryPolicy.maxAttempts > 1 && q->backend()->isTransient(hr)) {
+		scheduleRetry(request, replacing, 1);
 		return id;
 	}
+	if (!replacing) {
+		untrackToast(id);
+	}
+	Metrics::get().failed->increment();
+	QWinToast::setError(error, QWinToast::NotDisplayed);
+	// The caller gets -1, not the id that was reserved for the toast.
+	emit q->toastNotDisplayed(-1, hr, 1);
+	emit q->toastFailed();
+	return -1;
+}
 
-	ComPtr<IToastNotificationManagerStatics> notificationManager;
-	HRESULT hr = DllImporter::Wrap_GetActivationFactory(WinToastStringWrapper(RuntimeClass_Windows_UI_Notifications_ToastNotificationManager).Get(), &notificationManager);
-	if (SUCCEEDED(hr)) {
-		ComPtr<IToastNotifier> notifier;
-		hr = notificationManager->CreateToastNotifierWithId(WinToastStringWrapper(_aumi.toStdWString()).Get(), &notifier);
-		if (SUCCEEDED(hr)) {
-			ComPtr<IToastNotificationFactory> notificationFactory;
-			hr = DllImporter::Wrap_GetActivationFactory(WinToastStringWrapper(RuntimeClass_Windows_UI_Notifications_ToastNotification).Get(), &notificationFactory);
-			if (SUCCEEDED(hr)) {
-				ComPtr<IXmlDocument> xmlDocument;
-				HRESULT hr = notificationManager->GetTemplateContent(ToastTemplateType(toast.type()), &xmlDocument);
-				if (SUCCEEDED(hr)) {
-					for (UINT32 i = 0, fieldsCount = static_cast<UINT32>(toast.textFieldsCount()); i < fieldsCount && SUCCEEDED(hr); i++) {
-
-						qDebug() << "hr = setTextFieldHelper(xmlDocument.Get(), toast.textField(QWinToastTemplate::TextField(i)), i);" << toast.textField(QWinToastTemplate::TextField(i)) << i;
-						qDebug() << toast.type();
-						hr = setTextFieldHelper(xmlDocument.Get(), toast.textField(QWinToastTemplate::TextField(i)), i);
-						//qDebug() << toast.textField(0) << toast.textField(1) << toast.textField(2);
-						//hr = setTextFieldHelper(xmlDocument.Get(), toast.textField(QWinToastTemplate::TextField(0)), 0);
-						//hr = setTextFieldHelper(xmlDocument.Get(), toast.textField(QWinToastTemplate::TextField(1)), 1);
-					}
-
-					// Modern feature are supported Windows > Windows 10
-					if (SUCCEEDED(hr) && isSupportingModernFeatures()) {
-
-						// Note that we do this *after* using toast.textFieldsCount() to
-						// iterate/fill the template's text fields, since we're adding yet another text field.
-						if (SUCCEEDED(hr)
-							&& !toast.attributionText().isEmpty()) {
-							hr = setAttributionTextFieldHelper(xmlDocument.Get(), toast.attributionText());
-						}
-
-						std::array<WCHAR, 12> buf;
-						for (std::size_t i = 0, actionsCount = toast.actionsCount(); i < actionsCount && SUCCEEDED(hr); i++) {
-							_snwprintf_s(buf.data(), buf.size(), _TRUNCATE, L"%zd", i);
-							hr = addActionHelper(xmlDocument.Get(), toast.actionLabel(i), QString::fromWCharArray(buf.data()));
-						}
-
-						if (SUCCEEDED(hr)) {
-							hr = (toast.audioPath().isEmpty() && toast.audioOption() == QWinToastTemplate::AudioOption::Default)
-								? hr : setAudioFieldHelper(xmlDocument.Get(), toast.audioPath(), toast.audioOption());
-						}
-
-						if (SUCCEEDED(hr) && toast.duration() != QWinToastTemplate::Duration::System) {
-							hr = addDurationHelper(xmlDocument.Get(),
-								(toast.duration() == QWinToastTemplate::Duration::Short) ? "short" : "long");
-						}
-
-						if (SUCCEEDED(hr)) {
-							hr = addScenarioHelper(xmlDocument.Get(), toast.scenario());
-						}
-
-					}
-					else {
-						DEBUG_MSG("Modern features (Actions/Sounds/Attributes) not supported in this os version");
-					}
-
-					if (SUCCEEDED(hr)) {
-						hr = toast.hasImage() ? setImageFieldHelper(xmlDocument.Get(), toast.imagePath()) : hr;
-						if (SUCCEEDED(hr)) {
-							ComPtr<IToastNotification> notification;
-							hr = notificationFactory->CreateToastNotification(xmlDocument.Get(), &notification);
-							if (SUCCEEDED(hr)) {
-								INT64 expiration = 0, relativeExpiration = toast.expiration();
-								if (relativeExpiration > 0) {
-									InternalDateTime expirationDateTime(relativeExpiration);
-									expiration = expirationDateTime;
-									hr = notification->put_ExpirationTime(&expirationDateTime);
-								}
-
-								if (SUCCEEDED(hr)) {
-									hr = handleEventHandlers(notification.Get(), expiration);
-									if (FAILED(hr)) {
-										setError(error, QWinToastError::InvalidHandler);
-									}
-								}
-
-								if (SUCCEEDED(hr)) {
-									GUID guid;
-									hr = CoCreateGuid(&guid);
-									if (SUCCEEDED(hr)) {
-										id = guid.Data1;
-										_buffer[id] = notification;
-										DEBUG_MSG("xml: " << Util::AsString(xmlDocument));
-										hr = notifier->Show(notification.Get());
-										if (FAILED(hr)) {
-											setError(error, QWinToastError::NotDisplayed);
-										}
-									}
-								}
-							}
-						}
-					}
-				}
-			}
+bool QWinToastPrivate::admitShow() {
+	bool changed = false;
+	const bool allowed = _breaker.allow(&changed);
+	if (changed) {
+		emit q->circuitStateChanged(_breaker.state());
+	}
+	return allowed;
+}
+
+void QWinToastPrivate::noteShowResult(bool succeeded) {
+	if (succeeded ? _breaker.recordSuccess() : _breaker.recordFailure()) {
+		emit q->circuitStateChanged(_breaker.state());
+	}
+}
+
+void QWinToastPrivate::scheduleRetry(const QWinToastBackend::Request& request, bool replacing, int attempt) {
+	Metrics::get().retried->increment();
+	const int delay = _retryPolicy.delayFor(attempt);
+	QMetaObject::invokeMethod(q, [this, request, replacing, attempt, delay]() {
+		_clock->schedule(delay, q, [this, request, replacing, attempt]() {
+			retryShow(request, replacing, attempt + 1);
+		});
+	}, Qt::QueuedConnection);
+}
+
+void QWinToastPrivate::retryShow(const QWinToastBackend::Request& request, bool replacing, int attempt) {
+	{
+		// Hidden or cleared while waiting.
+		QMutexLocker locker(&_bufferMutex);
+		if (!_buffer.contains(request.id)) {
+			return;
+		}
+	}
+
+	QWinToastBackend::Result hr = QWinToastBackend::Aborted;
+	if (admitShow()) {
+		hr = q->backend()->show(q, request);
+		noteShowResult(QWinToastBackend::succeeded(hr));
+		if (QWinToastBackend::succeeded(hr)) {
+			Metrics::get().shown->increment();
+			scheduleExpiry(request.id, request.expiration);
+			return;
+		}
+		if (attempt < _retryPolicy.maxAttempts && q->backend()->isTransient(hr)) {
+			scheduleRetry(request, replacing, attempt);
+			return;
 		}
 	}
-	return FAILED(hr) ? -1 : id;
+	if (!replacing) {
+		untrackToast(request.id);
+	}
+	Metrics::get().failed->increment();
+	emit q->toastNotDisplayed(request.id, hr, attempt);
+	emit q->toastFailed();
+	if (!replacing) {
+		QWinToastResult result;
+		result.id = request.id;
+		resolveResult(result);
+	}
+}
+
+void QWinToast::setRetryPolicy(const QWinToastRetryPolicy& policy) {
+	_d->_retryPolicy = policy;
+}
+
+QWinToastRetryPolicy QWinToast::retryPolicy() const {
+	return _d->_retryPolicy;
+}
+
+void QWinToast::setClock(QWinToastClock* clock) {
+	if (_d->_expiryTimer) {
+		_d->_clock->cancel(_d->_expiryTimer);
+		_d->_expiryTimer = 0;
+	}
+	_d->_clock = clock ? clock : QWinToastClock::system();
+	_d->_breaker.setClock(_d->_clock);
+	if (_d->_trace) {
+		_d->_trace->setClock(_d->_clock);
+	}
+	_d->resetTracking();
+}
+
+QWinToastClock* QWinToast::clock() const {
+	return _d->_clock;
 }
 
-ComPtr<IToastNotifier> QWinToast::notifier(_In_ bool* succeded) const {
-	ComPtr<IToastNotificationManagerStatics> notificationManager;
-	ComPtr<IToastNotifier> notifier;
-	HRESULT hr = DllImporter::Wrap_GetActivationFactory(WinToastStringWrapper(RuntimeClass_Windows_UI_Notifications_ToastNotificationManager).Get(), &notificationManager);
-	if (SUCCEEDED(hr)) {
-		hr = notificationManager->CreateToastNotifierWithId(WinToastStringWrapper(_aumi.toStdWString()).Get(), &notifier);
+void QWinToast::setCircuitBreaker(int failureThreshold, int openMilliseconds) {
+	_d->_breaker.setThreshold(failureThreshold, openMilliseconds);
+}
+
+QWinToastCircuitBreaker::State QWinToast::circuitState() const {
+	return _d->_breaker.state();
+}
+
+void QWinToast::setTraceRecorder(QWinToastTraceRecorder* recorder) {
+	_d->_trace = recorder;
+	if (recorder) {
+		recorder->setClock(_d->_clock);
 	}
-	*succeded = SUCCEEDED(hr);
-	return notifier;
 }
 
-bool QWinToast::hideToast(_In_ INT64 id) {
+QWinToastTraceRecorder* QWinToast::traceRecorder() const {
+	return _d->_trace;
+}
+
+bool QWinToast::hideToast(qint64 id) {
 	if (!isInitialized()) {
 		DEBUG_MSG("Error when hiding the toast. WinToast is not initialized.");
 		return false;
 	}
+	if (_d->_trace) {
+		_d->_trace->recordHide(id);
+	}
 
-	if (_buffer.find(id) != _buffer.end()) {
-		auto succeded = false;
-		auto notify = notifier(&succeded);
-		if (succeded) {
-			auto result = notify->Hide(_buffer[id].Get());
-			_buffer.erase(id);
-			return SUCCEEDED(result);
-		}
+	if (!_d->untrackToast(id)) {
+		return false;
 	}
+	if (backend()->hide(this, id)) {
+		Metrics::get().hidden->increment();
+		_d->resolveHidden(id);
+		return true;
+	}
+	// No longer tracked, so no event will settle a pending result.
+	QWinToastResult result;
+	result.id = id;
+	_d->resolveResult(result);
 	return false;
 }
 
 void QWinToast::clear() {
-	auto succeded = false;
-	auto notify = notifier(&succeded);
-	if (succeded) {
-		auto end = _buffer.end();
-		for (auto it = _buffer.begin(); it != end; ++it) {
-			notify->Hide(it->second.Get());
-		}
-		_buffer.clear();
-	}
-}
-
-//
-// Available as of Windows 10 Anniversary Update
-// Ref: https://docs.microsoft.com/en-us/windows/uwp/design/shell/tiles-and-notifications/adaptive-interactive-toasts
-//
-// NOTE: This will add a new text field, so be aware when iterating over
-//       the toast's text fields or getting a count of them.
-//
-HRESULT QWinToast::setAttributionTextFieldHelper(_In_ IXmlDocument* xml, _In_ const QString& text) {
-	Util::createElement(xml, L"binding", L"text", { L"placement" });
-	ComPtr<IXmlNodeList> nodeList;
-	HRESULT hr = xml->GetElementsByTagName(WinToastStringWrapper(L"text").Get(), &nodeList);
-	if (SUCCEEDED(hr)) {
-		UINT32 nodeListLength;
-		hr = nodeList->get_Length(&nodeListLength);
-		if (SUCCEEDED(hr)) {
-			for (UINT32 i = 0; i < nodeListLength; i++) {
-				ComPtr<IXmlNode> textNode;
-				hr = nodeList->Item(i, &textNode);
-				if (SUCCEEDED(hr)) {
-					ComPtr<IXmlNamedNodeMap> attributes;
-					hr = textNode->get_Attributes(&attributes);
-					if (SUCCEEDED(hr)) {
-						ComPtr<IXmlNode> editedNode;
-						if (SUCCEEDED(hr)) {
-							hr = attributes->GetNamedItem(WinToastStringWrapper(L"placement").Get(), &editedNode);
-							if (FAILED(hr) || !editedNode) {
-								continue;
-							}
-							hr = Util::setNodeStringValue(L"attribution", editedNode.Get(), xml);
-							if (SUCCEEDED(hr)) {
-								return setTextFieldHelper(xml, text, i);
-							}
-						}
-					}
-				}
-			}
-		}
+	if (_d->_trace) {
+		_d->_trace->recordClear();
 	}
-	return hr;
-}
-
-HRESULT QWinToast::addDurationHelper(_In_ IXmlDocument* xml, _In_ const QString& duration) {
-	ComPtr<IXmlNodeList> nodeList;
-	HRESULT hr = xml->GetElementsByTagName(WinToastStringWrapper(L"toast").Get(), &nodeList);
-	if (SUCCEEDED(hr)) {
-		UINT32 length;
-		hr = nodeList->get_Length(&length);
-		if (SUCCEEDED(hr)) {
-			ComPtr<IXmlNode> toastNode;
-			hr = nodeList->Item(0, &toastNode);
-			if (SUCCEEDED(hr)) {
-				ComPtr<IXmlElement> toastElement;
-				hr = toastNode.As(&toastElement);
-				if (SUCCEEDED(hr)) {
-					hr = toastElement->SetAttribute(WinToastStringWrapper(L"duration").Get(),
-						WinToastStringWrapper(duration.toStdWString()).Get());
-				}
-			}
-		}
+	// Snapshot and reset under one lock, so a toast shown in between is
+	// neither cleared while still tracked nor left on screen untracked.
+	QVector<qint64> ids;
+	QMultiHash<qint64, QWinToastPrivate::PendingResult> pending;
+	{
+		QMutexLocker locker(&_d->_bufferMutex);
+		ids = _d->_buffer.keys().toVector();
+		_d->resetLocked(pending);
+	}
+	if (_d->_backend && !ids.isEmpty()) {
+		_d->_backend->clear(this, ids);
+		Metrics::get().hidden->add(ids.size());
+	}
+	_d->_digest->clear();
+	_d->_dedupe.clear();
+	_d->finishHidden(pending);
+}
+
+void QWinToast::setDigestWindow(int milliseconds) {
+	_d->_digest->setWindow(milliseconds);
+}
+
+int QWinToast::digestWindow() const {
+	return _d->_digest->window();
+}
+
+void QWinToast::setDigestFormatter(const std::function<QWinToastTemplate(const QWinToastTemplate& first, int count)>& formatter) {
+	_d->_digest->setFormatter(formatter);
+}
+
+quint64 QWinToast::digestedToastCount() const {
+	return _d->_digest->foldedCount();
+}
+
+void QWinToast::setDuplicateWindow(int milliseconds) {
+	_d->_dedupe.setTtl(milliseconds);
+}
+
+int QWinToast::duplicateWindow() const {
+	return _d->_dedupe.ttl();
+}
+
+quint64 QWinToast::suppressedDuplicateCount() const {
+	return _d->_dedupe.suppressedCount();
+}
+
+void QWinToastPrivate::flushDigest(const QString& key) {
+	qint64 id = -1;
+	QWinToastTemplate summary;
+	if (_digest->take(key, id, summary) && _isInitialized) {
+		deliverToast(summary, nullptr, id);
 	}
-	return hr;
-}
-
-HRESULT QWinToast::addScenarioHelper(_In_ IXmlDocument* xml, _In_ const QString& scenario) {
-	ComPtr<IXmlNodeList> nodeList;
-	HRESULT hr = xml->GetElementsByTagName(WinToastStringWrapper(L"toast").Get(), &nodeList);
-	if (SUCCEEDED(hr)) {
-		UINT32 length;
-		hr = nodeList->get_Length(&length);
-		if (SUCCEEDED(hr)) {
-			ComPtr<IXmlNode> toastNode;
-			hr = nodeList->Item(0, &toastNode);
-			if (SUCCEEDED(hr)) {
-				ComPtr<IXmlElement> toastElement;
-				hr = toastNode.As(&toastElement);
-				if (SUCCEEDED(hr)) {
-					hr = toastElement->SetAttribute(WinToastStringWrapper(L"scenario").Get(),
-						WinToastStringWrapper(scenario.toStdWString()).Get());
-				}
+}
+
+void QWinToast::clearGroup(const QString& group) {
+	if (_d->_trace) {
+		_d->_trace->recordClearGroup(group);
+	}
+	// The group's whole slice of the live index goes in one pass under one lock.
+	QSet<qint64> ids;
+	{
+		QMutexLocker locker(&_d->_bufferMutex);
+		ids = _d->_groups.take(group);
+		for (const qint64 id : ids) {
+			const QWinToastPrivate::LiveToast live = _d->_buffer.take(id);
+			if (!live.tag.isEmpty()) {
+				_d->_tags.remove(qMakePair(live.group, live.tag));
 			}
 		}
+		_d->_expiry.removeAll(ids);
+	}
+	if (ids.isEmpty()) {
+		return;
 	}
-	return hr;
+	Metrics::get().live->add(-ids.size());
+	if (isInitialized()) {
+		backend()->clearGroup(this, group, ids.values().toVector());
+		Metrics::get().hidden->add(ids.size());
+	}
+	_d->resolveHidden(ids);
+}
+
+int QWinToast::liveToastCount() const {
+	QMutexLocker locker(&_d->_bufferMutex);
+	return _d->_buffer.size();
 }
 
-HRESULT QWinToast::setTextFieldHelper(_In_ IXmlDocument* xml, _In_ const QString& text, _In_ UINT32 pos) {
-	ComPtr<IXmlNodeList> nodeList;
-	HRESULT hr = xml->GetElementsByTagName(WinToastStringWrapper(L"text").Get(), &nodeList);
+void QWinToastPrivate::trackToast(qint64 id, const QString& group, const QString& tag) {
+	QMutexLocker locker(&_bufferMutex);
+	if (_expired.remove(id)) {
+		_expiry.remove(id);
+	}
+	const int size = _buffer.size();
+	_buffer.insert(id, LiveToast{ group, tag });
+	Metrics::get().live->add(_buffer.size() - size);
+	if (!tag.isEmpty()) {
+		_tags.insert(qMakePair(group, tag), id);
+	}
+	if (!group.isEmpty()) {
+		_groups[group].insert(id);
+	}
+}
 
-	UINT32 ret;
-	nodeList.Get()->get_Length(&ret);
-	qDebug() << "ret: " << ret;
+bool QWinToastPrivate::untrackToast(qint64 id) {
+	QMutexLocker locker(&_bufferMutex);
+	return untrackLocked(id);
+}
 
-	if (SUCCEEDED(hr)) {
-		ComPtr<IXmlNode> node;
-		hr = nodeList->Item(pos, &node);
-		if (!node)
-			qDebug() << text << pos << "node is empty";
-		if (SUCCEEDED(hr)) {
-			hr = Util::setNodeStringValue(text.toStdWString(), node.Get(), xml);
-		}
+void QWinToastPrivate::resetTracking() {
+	QMultiHash<qint64, PendingResult> pending;
+	{
+		QMutexLocker locker(&_bufferMutex);
+		resetLocked(pending);
 	}
-	return hr;
-}
-
-
-HRESULT QWinToast::setImageFieldHelper(_In_ IXmlDocument* xml, _In_ const QString& path) {
-	assert(path.size() < MAX_PATH);
-
-	wchar_t imagePath[MAX_PATH] = L"file:///";
-	HRESULT hr = StringCchCatW(imagePath, MAX_PATH, path.toStdWString().c_str());
-	if (SUCCEEDED(hr)) {
-		ComPtr<IXmlNodeList> nodeList;
-		HRESULT hr = xml->GetElementsByTagName(WinToastStringWrapper(L"image").Get(), &nodeList);
-		if (SUCCEEDED(hr)) {
-			ComPtr<IXmlNode> node;
-			hr = nodeList->Item(0, &node);
-			if (SUCCEEDED(hr)) {
-				ComPtr<IXmlNamedNodeMap> attributes;
-				hr = node->get_Attributes(&attributes);
-				if (SUCCEEDED(hr)) {
-					ComPtr<IXmlNode> editedNode;
-					hr = attributes->GetNamedItem(WinToastStringWrapper(L"src").Get(), &editedNode);
-					if (SUCCEEDED(hr)) {
-						Util::setNodeStringValue(imagePath, editedNode.Get(), xml);
-					}
-				}
+	finishHidden(pending);
+}
+
+void QWinToastPrivate::resetLocked(QMultiHash<qint64, PendingResult>& pending) {
+	Metrics::get().live->add(-_buffer.size());
+	_buffer.clear();
+	_tags.clear();
+	_groups.clear();
+	_expiry.clear();
+	_expired.clear();
+	pending.swap(_pending);
+}
+
+bool QWinToastPrivate::untrackLocked(qint64 id) {
+	const auto it = _buffer.find(id);
+	if (it == _buffer.end()) {
+		return false;
+	}
+	if (!it->tag.isEmpty()) {
+		_tags.remove(qMakePair(it->group, it->tag));
+	}
+	if (!it->group.isEmpty()) {
+		auto group = _groups.find(it->group);
+		if (group != _groups.end()) {
+			group->remove(id);
+			if (group->isEmpty()) {
+				_groups.erase(group);
 			}
 		}
 	}
-	return hr;
-}
-
-HRESULT QWinToast::setAudioFieldHelper(_In_ IXmlDocument* xml, _In_ const QString& path, _In_opt_ QWinToastTemplate::AudioOption option) {
-	std::vector<std::wstring> attrs;
-	if (!path.isEmpty()) attrs.push_back(L"src");
-	if (option == QWinToastTemplate::AudioOption::Loop) attrs.push_back(L"loop");
-	if (option == QWinToastTemplate::AudioOption::Silent) attrs.push_back(L"silent");
-	Util::createElement(xml, L"toast", L"audio", attrs);
-
-	ComPtr<IXmlNodeList> nodeList;
-	HRESULT hr = xml->GetElementsByTagName(WinToastStringWrapper(L"audio").Get(), &nodeList);
-	if (SUCCEEDED(hr)) {
-		ComPtr<IXmlNode> node;
-		hr = nodeList->Item(0, &node);
-		if (SUCCEEDED(hr)) {
-			ComPtr<IXmlNamedNodeMap> attributes;
-			hr = node->get_Attributes(&attributes);
-			if (SUCCEEDED(hr)) {
-				ComPtr<IXmlNode> editedNode;
-				if (!path.isEmpty()) {
-					if (SUCCEEDED(hr)) {
-						hr = attributes->GetNamedItem(WinToastStringWrapper(L"src").Get(), &editedNode);
-						if (SUCCEEDED(hr)) {
-							hr = Util::setNodeStringValue(path.toStdWString(), editedNode.Get(), xml);
-						}
-					}
-				}
-
-				if (SUCCEEDED(hr)) {
-					switch (option) {
-					case QWinToastTemplate::AudioOption::Loop:
-						hr = attributes->GetNamedItem(WinToastStringWrapper(L"loop").Get(), &editedNode);
-						if (SUCCEEDED(hr)) {
-							hr = Util::setNodeStringValue(L"true", editedNode.Get(), xml);
-						}
-						break;
-					case QWinToastTemplate::AudioOption::Silent:
-						hr = attributes->GetNamedItem(WinToastStringWrapper(L"silent").Get(), &editedNode);
-						if (SUCCEEDED(hr)) {
-							hr = Util::setNodeStringValue(L"true", editedNode.Get(), xml);
-						}
-					default:
-						break;
-					}
-				}
-			}
+	_buffer.erase(it);
+	_expiry.remove(id);
+	Metrics::get().live->add(-1);
+	return true;
+}
+
+void QWinToastPrivate::scheduleExpiry(qint64 id, qint64 expiration) {
+	bool earliest = false;
+	{
+		QMutexLocker locker(&_bufferMutex);
+		if (!_buffer.contains(id)) {
+			return;
+		}
+		// A replacement without expiration drops the previous deadline.
+		if (expiration <= 0) {
+			_expiry.remove(id);
+			return;
 		}
+		const qint64 deadline = _clock->now() + expiration;
+		_expiry.insert(id, deadline);
+		earliest = _expiry.nextDeadline() == deadline;
+	}
+	if (earliest) {
+		QMetaObject::invokeMethod(q, [this]() { armExpiryTimer(); }, Qt::QueuedConnection);
 	}
-	return hr;
 }
 
-HRESULT QWinToast::addActionHelper(_In_ IXmlDocument* xml, _In_ const QString& content, _In_ const QString& arguments) {
-	ComPtr<IXmlNodeList> nodeList;
-	HRESULT hr = xml->GetElementsByTagName(WinToastStringWrapper(L"actions").Get(), &nodeList);
-	if (SUCCEEDED(hr)) {
-		UINT32 length;
-		hr = nodeList->get_Length(&length);
-		if (SUCCEEDED(hr)) {
-			ComPtr<IXmlNode> actionsNode;
-			if (length > 0) {
-				hr = nodeList->Item(0, &actionsNode);
-			}
-			else {
-				hr = xml->GetElementsByTagName(WinToastStringWrapper(L"toast").Get(), &nodeList);
-				if (SUCCEEDED(hr)) {
-					hr = nodeList->get_Length(&length);
-					if (SUCCEEDED(hr)) {
-						ComPtr<IXmlNode> toastNode;
-						hr = nodeList->Item(0, &toastNode);
-						if (SUCCEEDED(hr)) {
-							ComPtr<IXmlElement> toastElement;
-							hr = toastNode.As(&toastElement);
-							if (SUCCEEDED(hr))
-								hr = toastElement->SetAttribute(WinToastStringWrapper(L"template").Get(), WinToastStringWrapper(L"ToastGeneric").Get());
-							if (SUCCEEDED(hr))
-								hr = toastElement->SetAttribute(WinToastStringWrapper(L"duration").Get(), WinToastStringWrapper(L"long").Get());
-							if (SUCCEEDED(hr)) {
-								ComPtr<IXmlElement> actionsElement;
-								hr = xml->CreateElement(WinToastStringWrapper(L"actions").Get(), &actionsElement);
-								if (SUCCEEDED(hr)) {
-									hr = actionsElement.As(&actionsNode);
-									if (SUCCEEDED(hr)) {
-										ComPtr<IXmlNode> appendedChild;
-										hr = toastNode->AppendChild(actionsNode.Get(), &appendedChild);
-									}
-								}
-							}
-						}
-					}
-				}
-			}
-			if (SUCCEEDED(hr)) {
-				ComPtr<IXmlElement> actionElement;
-				hr = xml->CreateElement(WinToastStringWrapper(L"action").Get(), &actionElement);
-				if (SUCCEEDED(hr))
-					hr = actionElement->SetAttribute(WinToastStringWrapper(L"content").Get(), WinToastStringWrapper(content.toStdWString()).Get());
-				if (SUCCEEDED(hr))
-					hr = actionElement->SetAttribute(WinToastStringWrapper(L"arguments").Get(), WinToastStringWrapper(arguments.toStdWString()).Get());
-				if (SUCCEEDED(hr)) {
-					ComPtr<IXmlNode> actionNode;
-					hr = actionElement.As(&actionNode);
-					if (SUCCEEDED(hr)) {
-						ComPtr<IXmlNode> appendedChild;
-						hr = actionsNode->AppendChild(actionNode.Get(), &appendedChild);
-					}
-				}
+void QWinToastPrivate::armExpiryTimer() {
+	qint64 next;
+	{
+		QMutexLocker locker(&_bufferMutex);
+		next = _expiry.nextDeadline();
+	}
+	if (_expiryTimer) {
+		_clock->cancel(_expiryTimer);
+		_expiryTimer = 0;
+	}
+	if (next < 0) {
+		return;
+	}
+	_expiryTimer = _clock->schedule(next - _clock->now(), q, [this]() {
+		_expiryTimer = 0;
+		expireToasts();
+	});
+}
+
+void QWinToastPrivate::expireToasts() {
+	// How long an expired id is remembered to swallow a late shell report.
+	static const qint64 ExpiredGrace = 60000;
+
+	QVector<qint64> expired;
+	{
+		QMutexLocker locker(&_bufferMutex);
+		const qint64 now = _clock->now();
+		qint64 id;
+		while (_expiry.popExpired(now, id)) {
+			if (_expired.remove(id)) {
+				continue;
 			}
+			untrackLocked(id);
+			_expired.insert(id);
+			_expiry.insert(id, now + ExpiredGrace);
+			expired.append(id);
 		}
 	}
-	return hr;
+	for (const qint64 id : expired) {
+		releaseToast(id);
+		if (!_instance || !_instance->routeDismissed(id, QWinToast::TimedOut)) {
+			emit q->toastDismissed(QWinToast::TimedOut);
+			QWinToastResult result;
+			result.outcome = QWinToastResult::Dismissed;
+			result.id = id;
+			result.reason = QWinToast::TimedOut;
+			resolveResult(result);
+		}
+	}
+	armExpiryTimer();
+}
+
+void QWinToastPrivate::releaseToast(qint64 id) {
+	if (_backend) {
+		_backend->release(q, id);
+	}
+}
+
+void QWinToast::setBackend(QWinToastBackend* backend) {
+	if (_d->_backend && _d->_backend != backend) {
+		_d->_backend->detach(this);
+	}
+	_d->_backend = backend;
+	_d->_isInitialized = false;
+	_d->_breaker.reset();
+	_d->resetTracking();
+}
+
+QWinToastBackend* QWinToast::backend() {
+	if (!_d->_backend) {
+		_d->_backend = QWinToastBackend::platformBackend();
+	}
+	return _d->_backend;
 }
 
-void QWinToast::setError(_Out_opt_ QWinToastError* error, _In_ QWinToastError value) {
+bool QWinToast::enableSingleInstance(const QString& key) {
+	if (_d->_instance && _d->_backend == _d->_instance->forwardingBackend()) {
+		setBackend(nullptr);
+	}
+	_d->_instance.reset(new QWinToastInstance(this, key));
+	const bool primary = _d->_instance->elect();
+	if (!primary) {
+		setBackend(_d->_instance->forwardingBackend());
+	}
+	return primary;
+}
+
+bool QWinToast::isPrimaryInstance() const {
+	return !_d->_instance || _d->_instance->isPrimary();
+}
+
+qint64 QWinToast::nextToastId() {
+	static QAtomicInteger<qint64> nextId(1);
+	return nextId.fetchAndAddRelaxed(1);
+}
+
+QWinToast::ShortcutPolicy QWinToast::shortcutPolicy() const {
+	return _d->_shortcutPolicy;
+}
+
+void QWinToast::setError(QWinToastError* error, QWinToastError value) {
 	if (error) {
 		*error = value;
 	}
 }
 
-HRESULT QWinToast::handleEventHandlers(IToastNotification* notification, INT64 expirationTime)
-{
-	EventRegistrationToken activatedToken, dismissedToken, failedToken;
-	HRESULT hr = notification->add_Activated(
-		Callback<Implements<RuntimeClassFlags<ClassicCom>,
-		ITypedEventHandler<ToastNotification*, IInspectable*>>>(
-			[this](IToastNotification*, IInspectable* inspectable)
-			{
-				IToastActivatedEventArgs* activatedEventArgs;
-				HRESULT hr = inspectable->QueryInterface(&activatedEventArgs);
-				if (SUCCEEDED(hr))
-				{
-					HSTRING argumentsHandle;
-					hr = activatedEventArgs->get_Arguments(&argumentsHandle);
-					if (SUCCEEDED(hr))
-					{
-						PCWSTR arguments = Util::AsString(argumentsHandle);
-						if (arguments && *arguments)
-						{
-							emit toastActivated(static_cast<int>(wcstol(arguments, nullptr, 10)));
-							qDebug() << "emit toastActivated(static_cast<int>(wcstol(arguments, nullptr, 10)));";
-							//eventHandler->toastActivated(static_cast<int>(wcstol(arguments, nullptr, 10)));
-							return S_OK;
-						}
-					}
-				}
-				emit toastActivated();
-				qDebug() << "emit toastActivated();";
-				//eventHandler->toastActivated();
-				return S_OK;
-			}).Get(), &activatedToken);
-
-	if (SUCCEEDED(hr))
+int QWinToast::registerCommand(const QString& command, const QWinToastCommandRegistry::Handler& handler) {
+	return _d->_commands.registerCommand(command, handler);
+}
+
+void QWinToast::unregisterCommand(const QString& command) {
+	_d->_commands.unregisterCommand(command);
+}
+
+static const QEvent::Type DrainToastEvents = static_cast<QEvent::Type>(QEvent::registerEventType());
+
+bool QWinToast::event(QEvent* event) {
+	if (event->type() == DrainToastEvents) {
+		static const QMetaMethod batchSignal = QMetaMethod::fromSignal(&QWinToast::toastEventsBatch);
+		_d->drainToastEvents(isSignalConnected(batchSignal));
+		return true;
+	}
+	return QObject::event(event);
+}
+
+void QWinToastPrivate::postToastEvent(QWinToastEvent&& event) {
+	// One posted event wakes the drain for everything queued until it runs.
+	Metrics::get().queueDepth->increment();
+	if (_events.push(std::move(event))) {
+		QCoreApplication::postEvent(q, new QEvent(DrainToastEvents));
+	}
+}
+
+void QWinToastPrivate::drainToastEvents(bool collect) {
+	// Bounded so a flood of events cannot starve the rest of the event loop.
+	static const int MaxBatch = 256;
+
+	QVector<QWinToastEvent> batch;
+	_events.beginDrain();
+	QWinToastEvent event;
+	int count = 0;
+	while (count < MaxBatch && _events.pop(event)) {
+		count++;
+		if (_trace) {
+			_trace->recordEvent(event);
+		}
+		switch (event.type) {
+		case QWinToastEvent::Activated:
+			handleActivated(event.id, event.arguments);
+			break;
+		case QWinToastEvent::Dismissed:
+			handleDismissed(event.id, static_cast<QWinToast::WinToastDismissalReason>(event.reason));
+			break;
+		case QWinToastEvent::Failed:
+			handleFailed(event.id);
+			break;
+		}
+		if (collect) {
+			batch.append(std::move(event));
+		}
+	}
+	Metrics::get().queueDepth->add(-count);
+	if (count == MaxBatch && _events.reschedule()) {
+		QCoreApplication::postEvent(q, new QEvent(DrainToastEvents));
+	}
+	if (!batch.isEmpty()) {
+		emit q->toastEventsBatch(batch);
+	}
+}
+
+void QWinToastPrivate::handleActivated(qint64 id, QStringView arguments) {
+	untrackToast(id);
+	releaseToast(id);
+	if (_instance && _instance->routeActivated(id, arguments)) {
+		return;
+	}
+	const QWinToastArgumentsView view(arguments);
+	const int actionIndex = view.actionIndex();
+	Metrics::activation(actionIndex)->increment();
+	if (actionIndex < 0) {
+		emit q->toastActivated();
+	}
+	else {
+		emit q->toastActivated(actionIndex);
+		_commands.dispatch(id, view);
+	}
+	QWinToastResult result;
+	result.outcome = QWinToastResult::Activated;
+	result.id = id;
+	result.actionIndex = actionIndex;
+	result.arguments = arguments.toString();
+	resolveResult(result);
+}
+
+void QWinToastPrivate::handleDismissed(qint64 id, QWinToast::WinToastDismissalReason reason) {
 	{
-		hr = notification->add_Dismissed(Callback<Implements<RuntimeClassFlags<ClassicCom>,
-			ITypedEventHandler<
-			ToastNotification*, ToastDismissedEventArgs*>>>(
-				[this, expirationTime](
-					IToastNotification*, IToastDismissedEventArgs* e)
-				{
-					ToastDismissalReason reason;
-					if (SUCCEEDED(e->get_Reason(&reason)))
-					{
-						if (reason == ToastDismissalReason_UserCanceled &&
-							expirationTime && InternalDateTime::Now() >=
-							expirationTime)
-							reason = ToastDismissalReason_TimedOut;
-						emit toastDismissed(
-							static_cast<WinToastDismissalReason>(
-								reason));
-						qDebug() << "emit toastDismissed";
-						//eventHandler->toastDismissed(
-						//	static_cast<IWinToastHandler::WinToastDismissalReason>(
-						//		reason));
-					}
-					return S_OK;
-				}).Get(), &dismissedToken);
-		if (SUCCEEDED(hr))
-		{
-			hr = notification->add_Failed(Callback<Implements<RuntimeClassFlags<ClassicCom>,
-				ITypedEventHandler<
-				ToastNotification*, ToastFailedEventArgs*>>>(
-					[this](IToastNotification*, IToastFailedEventArgs*)
-					{
-						emit toastFailed();
-						//eventHandler->toastFailed();
-						return S_OK;
-					}).Get(), &failedToken);
+		QMutexLocker locker(&_bufferMutex);
+		// Already reported by expireToasts().
+		if (_expired.remove(id)) {
+			_expiry.remove(id);
+			return;
+		}
+		// The shell reports a timeout as UserCanceled.
+		const qint64 deadline = _expiry.deadline(id);
+		if (reason == QWinToast::UserCanceled && deadline >= 0 && _clock->now() >= deadline) {
+			reason = QWinToast::TimedOut;
+		}
+		untrackLocked(id);
+	}
+	releaseToast(id);
+	if (_instance && _instance->routeDismissed(id, reason)) {
+		return;
+	}
+	emit q->toastDismissed(reason);
+	QWinToastResult result;
+	result.outcome = QWinToastResult::Dismissed;
+	result.id = id;
+	result.reason = reason;
+	resolveResult(result);
+}
+
+void QWinToastPrivate::handleFailed(qint64 id) {
+	untrackToast(id);
+	releaseToast(id);
+	Metrics::get().failed->increment();
+	noteShowResult(false);
+	if (_instance && _instance->routeFailed(id)) {
+		return;
+	}
+	emit q->toastFailed();
+	QWinToastResult result;
+	result.id = id;
+	resolveResult(result);
+}
+
+void QWinToastPrivate::resolveResult(const QWinToastResult& result) {
+	QVector<PendingResult> waiting;
+	{
+		QMutexLocker locker(&_bufferMutex);
+		auto it = _pending.find(result.id);
+		while (it != _pending.end() && it.key() == result.id) {
+			waiting.append(it.value());
+			it = _pending.erase(it);
+		}
+	}
+	// Outside the lock: a resumed coroutine may show the next toast right away.
+	// Every future is fulfilled before any coroutine runs, as a coroutine may
+	// be waiting on a future other than the entry it was attached to.
+	for (PendingResult& pending : waiting) {
+		pending.promise.reportResult(result);
+		pending.promise.reportFinished();
+	}
+	for (const PendingResult& pending : waiting) {
+		if (pending.resume) {
+			pending.resume(pending.context);
+		}
+	}
+}
+
+void QWinToastPrivate::resolveHidden(qint64 id) {
+	QWinToastResult result;
+	result.outcome = QWinToastResult::Dismissed;
+	result.id = id;
+	result.reason = QWinToast::ApplicationHidden;
+	resolveResult(result);
+}
+
+void QWinToastPrivate::resolveHidden(const QSet<qint64>& ids) {
+	QMultiHash<qint64, PendingResult> waiting;
+	{
+		QMutexLocker locker(&_bufferMutex);
+		if (_pending.isEmpty()) {
+			return;
+		}
+		for (const qint64 id : ids) {
+			auto it = _pending.find(id);
+			while (it != _pending.end() && it.key() == id) {
+				waiting.insert(id, it.value());
+				it = _pending.erase(it);
+			}
 		}
 	}
-	return hr;
+	finishHidden(waiting);
+}
+
+void QWinToastPrivate::finishHidden(QMultiHash<qint64, PendingResult>& pending) {
+	// Same order as resolveResult(): every future first, then the coroutines.
+	for (auto it = pending.begin(); it != pending.end(); ++it) {
+		QWinToastResult result;
+		result.outcome = QWinToastResult::Dismissed;
+		result.id = it.key();
+		result.reason = QWinToast::ApplicationHidden;
+		it->promise.reportResult(result);
+		it->promise.reportFinished();
+	}
+	for (auto it = pending.begin(); it != pending.end(); ++it) {
+		if (it->resume) {
+			it->resume(it->context);
+		}
+	}
+}
+
+void QWinToastBackend::clearGroup(QWinToast* toast, const QString&, const QVector<qint64>& ids) {
+	for (const qint64 id : ids) {
+		hide(toast, id);
+	}
+}
+
+QWinToast::ShortcutResult QWinToastBackend::createShortcut(QWinToast*) {
+	return QWinToast::SHORTCUT_UNCHANGED;
+}
+
+void QWinToastBackend::release(QWinToast*, qint64) {
+}
+
+void QWinToastBackend::detach(QWinToast*) {
+}
+
+bool QWinToastBackend::isTransient(Result result) const {
+	return result == Pending;
+}
+
+bool QWinToastBackend::isCompatible() const {
+	return true;
+}
+
+bool QWinToastBackend::supportsModernFeatures() const {
+	return true;
+}
+
+static QWinToastBackend* (*PlatformBackendFactory)() = nullptr;
+
+void QWinToastBackend::setPlatformBackend(QWinToastBackend* (*factory)()) {
+	PlatformBackendFactory = factory;
+}
+
+QWinToastBackend* QWinToastBackend::platformBackend() {
+	return PlatformBackendFactory ? PlatformBackendFactory() : nullptr;
+}
+
+void QWinToastBackend::activated(QWinToast* toast, qint64 id, QStringView arguments) {
+	toast->_d->postToastEvent(QWinToastEvent{ QWinToastEvent::Activated, id, 0, arguments.toString(), toast->_d->_clock->timestamp() });
+}
+
+void QWinToastBackend::dismissed(QWinToast* toast, qint64 id, QWinToast::WinToastDismissalReason reason) {
+	toast->_d->postToastEvent(QWinToastEvent{ QWinToastEvent::Dismissed, id, reason, QString(), toast->_d->_clock->timestamp() });
+}
+
+void QWinToastBackend::failed(QWinToast* toast, qint64 id) {
+	toast->_d->postToastEvent(QWinToastEvent{ QWinToastEvent::Failed, id, 0, QString(), toast->_d->_clock->timestamp() });
 }
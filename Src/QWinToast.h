@@ -1,32 +1,16 @@
 #ifndef QWINTOAST
 #define QWINTOAST
 
+#include <QFuture>
 #include <QObject>
-#include <QtCore>
-#include <Windows.h>
-#include <sdkddkver.h>
-#include <WinUser.h>
-#include <ShObjIdl.h>
-#include <wrl/implements.h>
-#include <wrl/event.h>
-#include <windows.ui.notifications.h>
-#include <strsafe.h>
-#include <Psapi.h>
-#include <ShlObj.h>
-#include <roapi.h>
-#include <propvarutil.h>
-#include <functiondiscoverykeys.h>
-#include <iostream>
-#include <winstring.h>
-#include <string.h>
-#include <vector>
-#include <map>
-using namespace Microsoft::WRL;
-using namespace ABI::Windows::Data::Xml::Dom;
-using namespace ABI::Windows::Foundation;
-using namespace ABI::Windows::UI::Notifications;
-using namespace Windows::Foundation;
-
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <functional>
+#include <memory>
+#include "QWinToastArguments.h"
+#include "QWinToastRetry.h"
+#include "QWinToastEventQueue.h"
 
 class QWinToastTemplate
 {
@@ -62,14 +46,15 @@ public:
 
     enum WinToastTemplateType
     {
-        ImageAndText01 = ToastTemplateType::ToastTemplateType_ToastImageAndText01,
-        ImageAndText02 = ToastTemplateType::ToastTemplateType_ToastImageAndText02,
-        ImageAndText03 = ToastTemplateType::ToastTemplateType_ToastImageAndText03,
-        ImageAndText04 = ToastTemplateType::ToastTemplateType_ToastImageAndText04,
-        Text01 = ToastTemplateType::ToastTemplateType_ToastText01,
-        Text02 = ToastTemplateType::ToastTemplateType_ToastText02,
-        Text03 = ToastTemplateType::ToastTemplateType_ToastText03,
-        Text04 = ToastTemplateType::ToastTemplateType_ToastText04
+        // Same values as the shell's ToastTemplateType.
+        ImageAndText01 = 0,
+        ImageAndText02 = 1,
+        ImageAndText03 = 2,
+        ImageAndText04 = 3,
+        Text01 = 4,
+        Text02 = 5,
+        Text03 = 6,
+        Text04 = 7
     };
 
     enum AudioSystemFile
@@ -102,59 +87,102 @@ public:
         Call10
     };
 
-    QWinToastTemplate(_In_ WinToastTemplateType type = WinToastTemplateType::ImageAndText02);
+    // Builds a text field only when the toast is about to be shown.
+    typedef std::function<QString()> TextProvider;
+
+    QWinToastTemplate(WinToastTemplateType type = WinToastTemplateType::ImageAndText02);
     ~QWinToastTemplate();
 
-    void setFirstLine(_In_ const QString& text);
-    void setSecondLine(_In_ const QString& text);
-    void setThirdLine(_In_ const QString& text);
-    void setTextField(_In_ const QString& text, _In_ TextField pos);
-    void setAttributionText(_In_ const QString& attributionText);
-    void setImagePath(_In_ const QString& imgPath);
-    void setAudioPath(_In_ QWinToastTemplate::AudioSystemFile audio);
-    void setAudioPath(_In_ const QString& audioPath);
-    void setAudioOption(_In_ QWinToastTemplate::AudioOption audioOption);
-    void setDuration(_In_ Duration duration);
-    void setExpiration(_In_ INT64 millsecondsFromNow);
-    void setScenario(_In_ Scenario scenario);
-    void addAction(_In_ const QString& label);
+    void setFirstLine(const QString& text);
+    void setSecondLine(const QString& text);
+    void setThirdLine(const QString& text);
+    void setTextField(const QString& text, TextField pos);
+    // The provider runs right before the XML is built, so toasts dropped by a
+    // channel limit, the circuit breaker or a digest never pay for it. Setting
+    // the field's text replaces the provider.
+    void setTextProvider(TextField pos, const TextProvider& provider);
+    void setAttributionText(const QString& attributionText);
+    void setImagePath(const QString& imgPath);
+    void setAudioPath(QWinToastTemplate::AudioSystemFile audio);
+    void setAudioPath(const QString& audioPath);
+    void setAudioOption(QWinToastTemplate::AudioOption audioOption);
+    void setDuration(Duration duration);
+    void setExpiration(qint64 millsecondsFromNow);
+    void setScenario(Scenario scenario);
+    // Toasts sharing a non-empty (group, tag) replace each other in place.
+    void setTag(const QString& tag);
+    void setGroup(const QString& group);
+    // Toasts with the same digest key shown within QWinToast::digestWindow()
+    // are collapsed into one summary toast.
+    void setDigestKey(const QString& key);
+    void addAction(const QString& label);
+    // The command and arguments are encoded next to the action index and
+    // dispatched through QWinToast::registerCommand() on activation.
+    void addAction(const QString& label, const QString& command,
+                   const QWinToastArguments& arguments = QWinToastArguments());
 
     std::size_t textFieldsCount() const;
     std::size_t actionsCount() const;
     bool hasImage() const;
     const QVector<QString>& textFields() const;
-    const QString& textField(_In_ TextField pos) const;
-    const QString& actionLabel(_In_ std::size_t pos) const;
+    // Empty while the field's provider has not run.
+    const QString& textField(TextField pos) const;
+    int pendingTextProviders() const;
+    // Runs the pending providers and stores their text. Returns how many ran.
+    int resolveTextProviders();
+    const QString& actionLabel(std::size_t pos) const;
+    const QString& actionArguments(std::size_t pos) const;
     const QString& imagePath() const;
     const QString& audioPath() const;
     const QString& attributionText() const;
     const QString& scenario() const;
-    INT64 expiration() const;
+    const QString& tag() const;
+    const QString& group() const;
+    const QString& digestKey() const;
+    qint64 expiration() const;
     WinToastTemplateType type() const;
     QWinToastTemplate::AudioOption audioOption() const;
     Duration duration() const;
 
 private:
     QVector<QString> _textFields{};
+    QVector<TextProvider> _textProviders{};
     QVector<QString> _actions{};
+    QVector<QString> _actionArguments{};
     QString _imagePath{};
     QString _audioPath{};
     QString _attributionText{};
     QString _scenario{ "Default" };
-    INT64 _expiration{ 0 };
+    QString _tag{};
+    QString _group{};
+    QString _digestKey{};
+    qint64 _expiration{ 0 };
     AudioOption _audioOption{ QWinToastTemplate::AudioOption::Default };
     WinToastTemplateType _type{ WinToastTemplateType::Text01 };
     Duration _duration{ Duration::System };
+
+    friend class QWinToastCodec;
 };
 
+class QWinToastBackend;
+class QWinToastClock;
+class QWinToastTraceRecorder;
+class QWinToastPrivate;
+class QWinToastInstance;
+class QWinToastDigest;
+class QWinToastAwaitable;
+struct QWinToastCatalogEntry;
+struct QWinToastResult;
+
 class QWinToast: public QObject
 {
     Q_OBJECT
 public:
     enum WinToastDismissalReason {
-        UserCanceled = ToastDismissalReason::ToastDismissalReason_UserCanceled,
-        ApplicationHidden = ToastDismissalReason::ToastDismissalReason_ApplicationHidden,
-        TimedOut = ToastDismissalReason::ToastDismissalReason_TimedOut
+        // Same values as the shell's ToastDismissalReason.
+        UserCanceled = 0,
+        ApplicationHidden = 1,
+        TimedOut = 2
     };
 
     enum QWinToastError
@@ -167,7 +195,10 @@ public:
         InvalidParameters,
         InvalidHandler,
         NotDisplayed,
-        UnknownError
+        UnknownError,
+        Throttled,
+        CircuitOpen,
+        Duplicate
     };
 
     enum ShortcutResult
@@ -200,51 +231,206 @@ public:
     static QWinToast* instance();
     static bool isCompatible();
     static bool isSupportingModernFeatures();
-    static QString configureAUMI(_In_ const QString& companyName,
-                                 _In_ const QString& product,
-                                 _In_ const QString& subProduct,
-                                 _In_ const QString& versionInformation);
-    static const QString& strerror(_In_ QWinToastError error);
-    virtual bool initialize(_Out_opt_ QWinToastError* error = nullptr);
+    static QString configureAUMI(const QString& companyName,
+                                 const QString& product,
+                                 const QString& subProduct,
+                                 const QString& versionInformation);
+    static const QString& strerror(QWinToastError error);
+    virtual bool initialize(QWinToastError* error = nullptr);
     virtual bool isInitialized() const;
-    virtual bool hideToast(_In_ INT64 id);
-    virtual INT64 showToast(_In_ const QWinToastTemplate& toast, _Out_opt_ QWinToastError* error = nullptr);
+    virtual bool hideToast(qint64 id);
+    virtual qint64 showToast(const QWinToastTemplate& toast, QWinToastError* error = nullptr);
+    // The future resolves once the toast is activated, dismissed, hidden or
+    // given up on; a toast that cannot be shown resolves it right away. Call on
+    // this object's thread. Waiting costs one small entry per toast.
+    QFuture<QWinToastResult> showToastForResult(const QWinToastTemplate& toast, QWinToastError* error = nullptr);
+    // Also stores the toast id for hideToast(), -1 when it was not shown.
+    QFuture<QWinToastResult> showToastForResult(const QWinToastTemplate& toast, QWinToastError* error, qint64* id);
+    // Shows a toast generated by qwintoast_add_catalog(); values fill its
+    // placeholders in order. Admission and deduplication apply as for
+    // showToast().
+    virtual qint64 showCatalogToast(const QWinToastCatalogEntry& entry, const QStringList& values = QStringList(),
+                            QWinToastError* error = nullptr);
     virtual void clear();
+    // Hides every live toast of the group in one backend call; the shell
+    // drops the group from its history instead of hiding toast by toast.
+    virtual void clearGroup(const QString& group);
+    // Older name of clearGroup().
+    void removeGroup(const QString& group) { clearGroup(group); }
     virtual enum ShortcutResult createShortcut();
 
     const QString& appName() const;
     const QString& appUserModelId() const;
-    void setAppUserModelID(_In_ const QString& aumi);
-    void setAppName(_In_ const QString& appName);
-    void setShortcutPolicy(_In_ ShortcutPolicy policy);
+    void setAppUserModelID(const QString& aumi);
+    void setAppName(const QString& appName);
+    void setShortcutPolicy(ShortcutPolicy policy);
+    ShortcutPolicy shortcutPolicy() const;
+
+    // Routes toasts through a custom backend instead of the Windows shell.
+    // The backend is not owned and must outlive the toast; passing nullptr
+    // restores the default one.
+    void setBackend(QWinToastBackend* backend);
+    QWinToastBackend* backend();
+    int liveToastCount() const;
+
+    // Elects one primary process per key. Secondaries forward their toasts to
+    // the primary and receive their own events back. Call before initialize().
+    // Returns true when this process is the primary.
+    bool enableSingleInstance(const QString& key);
+    bool isPrimaryInstance() const;
+
+    // Holds keyed toasts for this many milliseconds and replaces the first of
+    // each burst with a silent summary. 0 (the default) disables digesting.
+    void setDigestWindow(int milliseconds);
+    int digestWindow() const;
+    void setDigestFormatter(const std::function<QWinToastTemplate(const QWinToastTemplate& first, int count)>& formatter);
+    quint64 digestedToastCount() const;
+
+    // Drops toasts whose content repeats one shown within the window; see
+    // QWinToastDedupe. 0 (the default) disables it. Templates with pending
+    // text providers are never deduplicated.
+    void setDuplicateWindow(int milliseconds);
+    int duplicateWindow() const;
+    quint64 suppressedDuplicateCount() const;
+
+    // Transient show() failures are retried on this object's thread; the call
+    // still returns the toast id. The breaker counts failures of every attempt.
+    void setRetryPolicy(const QWinToastRetryPolicy& policy);
+    QWinToastRetryPolicy retryPolicy() const;
+    void setCircuitBreaker(int failureThreshold, int openMilliseconds);
+
+    // Time source for expirations, retries, digests, the breaker and channel
+    // limits. Not owned; nullptr restores the system clock. Live toasts are
+    // forgotten, so set it before showing any.
+    void setClock(QWinToastClock* clock);
+    QWinToastClock* clock() const;
+    QWinToastCircuitBreaker::State circuitState() const;
+
+    // Writes every show, including catalog and rejected ones, every hide and
+    // clear call and every event to the recorder for later replay. Not owned;
+    // nullptr stops tracing. Set it before showing any toast. The recorder is
+    // switched to this object's clock.
+    void setTraceRecorder(QWinToastTraceRecorder* recorder);
+    QWinToastTraceRecorder* traceRecorder() const;
+
+    // Handlers run on the thread that delivers the activation; register them
+    // before showing toasts that carry the command.
+    int registerCommand(const QString& command, const QWinToastCommandRegistry::Handler& handler);
+    void unregisterCommand(const QString& command);
 
 signals:
     void toastActivated();
     void toastActivated(int actionIndex);
     void toastDismissed(WinToastDismissalReason state);
+    // Also emitted, after toastNotDisplayed(), when a toast is given up on.
     void toastFailed();
+    // Carries the last backend result once a toast is given up on. id is -1
+    // when showToast() itself failed and returned -1.
+    void toastNotDisplayed(qint64 id, qint32 result, int attempts);
+    void circuitStateChanged(QWinToastCircuitBreaker::State state);
+    // Every drained batch of backend events, after the per-event signals.
+    void toastEventsBatch(const QVector<QWinToastEvent>& events);
 
 protected:
-    bool _isInitialized{ false };
-    bool _hasCoInitialized{ false };
-    ShortcutPolicy _shortcutPolicy{ SHORTCUT_POLICY_REQUIRE_CREATE };
-    QString _appName{};
-    QString _aumi{};
-    std::map<INT64, ComPtr<IToastNotification>> _buffer{};
-
-    HRESULT validateShellLinkHelper(_Out_ bool& wasChanged);
-    HRESULT createShellLinkHelper();
-    HRESULT setImageFieldHelper(_In_ IXmlDocument *xml, _In_ const QString& path);
-    HRESULT setAudioFieldHelper(_In_ IXmlDocument* xml, _In_ const QString& path, _In_opt_ QWinToastTemplate::AudioOption option = QWinToastTemplate::AudioOption::Default);
-    HRESULT setTextFieldHelper(_In_ IXmlDocument* xml, _In_ const QString& text, _In_ UINT32 POS);
-    HRESULT setAttributionTextFieldHelper(_In_ IXmlDocument *xml, _In_ const QString& text);
-    HRESULT addActionHelper(_In_ IXmlDocument* xml, _In_ const QString& action, _In_ const QString& arguments);
-    HRESULT addDurationHelper(_In_ IXmlDocument* xml, _In_ const QString& duration);
-    HRESULT addScenarioHelper(_In_ IXmlDocument* xml, _In_ const QString& scenario);
-    ComPtr<IToastNotifier> notifier(_In_ bool* succeded) const;
-    void setError(_Out_opt_ QWinToastError* error, _In_ QWinToastError value);
-    HRESULT handleEventHandlers(_In_ IToastNotification* notification, _In_ INT64 expirationTime);
+    bool event(QEvent* event) override;
+    // Checked by showToast() before the toast enters the pipeline; a subclass
+    // sets the error and returns false to turn it away. Rejected toasts are
+    // traced like any other failed show. The default admits every toast.
+    virtual bool admitToast(const QWinToastTemplate& toast, QWinToastError* error);
+    // The same check for showCatalogToast().
+    virtual bool admitToast(const QWinToastCatalogEntry& entry, const QStringList& values, QWinToastError* error);
+    static qint64 nextToastId();
+    static void setError(QWinToastError* error, QWinToastError value);
+
+private:
+    std::unique_ptr<QWinToastPrivate> _d;
+
+    // Calls resume(context) once the toast resolves; false when nothing is pending for it.
+    bool resumeOnResult(qint64 id, void (*resume)(void*), void* context);
+
+    friend class QWinToastPrivate;
+    friend class QWinToastAwaitable;
+    friend class QWinToastBackend;
+    friend class QWinToastInstance;
+    friend class QWinToastDigest;
+};
 
+// Outcome of a toast shown with QWinToast::showToastForResult().
+struct QWinToastResult
+{
+    enum Outcome
+    {
+        Activated,
+        Dismissed,
+        Failed
+    };
+
+    Outcome outcome{ Failed };
+    qint64 id{ -1 };
+    // Activated: the action index, -1 for the toast body, and its arguments.
+    int actionIndex{ -1 };
+    QString arguments{};
+    // Dismissed: why. Hiding, clearing or removing the group reports ApplicationHidden.
+    QWinToast::WinToastDismissalReason reason{ QWinToast::UserCanceled };
+};
+
+// Delivers toast payloads to a notification host. The default backend talks to
+// the Windows shell; QWinToastFakeBackend records payloads in-process.
+// Event callbacks may be invoked from any thread.
+class QWinToastBackend
+{
+public:
+    // HRESULT-compatible: negative values are failures.
+    typedef qint32 Result;
+    static const Result Ok = 0;
+    static const Result Aborted = qint32(0x80004004);
+    static const Result Failed = qint32(0x80004005);
+    static const Result Pending = qint32(0x8000000A);
+
+    struct Request
+    {
+        qint64 id;
+        // Relative expiration in milliseconds, 0 for none.
+        qint64 expiration;
+        QString xml;
+        QString tag;
+        QString group;
+    };
+
+    virtual ~QWinToastBackend() = default;
+    virtual bool initialize(QWinToast* toast, QWinToast::QWinToastError* error) = 0;
+    virtual QWinToast::ShortcutResult createShortcut(QWinToast* toast);
+    // A request whose id is already live replaces that toast.
+    virtual Result show(QWinToast* toast, const Request& request) = 0;
+    virtual bool hide(QWinToast* toast, qint64 id) = 0;
+    // Hides the given live toasts, the ones the toast tracks itself. Toasts it
+    // shows for secondary instances and others under the same AUMI stay.
+    virtual void clear(QWinToast* toast, const QVector<qint64>& ids) = 0;
+    // Hides the given live toasts of one group. The default hides them one by one.
+    virtual void clearGroup(QWinToast* toast, const QString& group, const QVector<qint64>& ids);
+    // Drops per-toast state once the toast is gone without touching the shell.
+    virtual void release(QWinToast* toast, qint64 id);
+    // Drops every entry of the toast, forwarded ones included, without
+    // touching the shell; no event reaches the toast once it returns. Called
+    // when the toast is destroyed or switches backends.
+    virtual void detach(QWinToast* toast);
+    // Whether a failed show() is worth retrying.
+    virtual bool isTransient(Result result) const;
+    // Whether the host can run at all and understands actions, audio and scenarios.
+    virtual bool isCompatible() const;
+    virtual bool supportsModernFeatures() const;
+
+    // The backend used by a QWinToast without setBackend(). Platform backend
+    // libraries install their factory during static initialization.
+    static void setPlatformBackend(QWinToastBackend* (*factory)());
+    static QWinToastBackend* platformBackend();
+
+    static bool succeeded(Result result) { return result >= 0; }
+
+protected:
+    static void activated(QWinToast* toast, qint64 id, QStringView arguments);
+    static void dismissed(QWinToast* toast, qint64 id, QWinToast::WinToastDismissalReason reason);
+    static void failed(QWinToast* toast, qint64 id);
 };
 
 
@@ -0,0 +1,272 @@
+#include "QWinToastArguments.h"
+#include <QHash>
+#include <algorithm>
+
+namespace
+{
+	const char16_t ActionKey[] = u"a";
+	const char16_t CommandKey[] = u"c";
+
+	inline int hexValue(QChar c)
+	{
+		const ushort u = c.unicode();
+		if (u >= '0' && u <= '9') return u - '0';
+		if (u >= 'A' && u <= 'F') return u - 'A' + 10;
+		if (u >= 'a' && u <= 'f') return u - 'a' + 10;
+		return -1;
+	}
+}
+
+QWinToastArguments& QWinToastArguments::insert(const QString& key, const QString& value)
+{
+	if (!key.isEmpty() && !isReservedKey(key)) {
+		_pairs.append(qMakePair(key, value));
+	}
+	return *this;
+}
+
+bool QWinToastArguments::isEmpty() const
+{
+	return _pairs.isEmpty();
+}
+
+QString QWinToastArguments::encoded() const
+{
+	QString out;
+	for (const auto& pair : _pairs) {
+		if (!out.isEmpty()) {
+			out += QLatin1Char('&');
+		}
+		appendEncoded(out, pair.first);
+		out += QLatin1Char('=');
+		appendEncoded(out, pair.second);
+	}
+	return out;
+}
+
+bool QWinToastArguments::isReservedKey(QStringView key)
+{
+	return key == QStringView(ActionKey) || key == QStringView(CommandKey);
+}
+
+void QWinToastArguments::appendEncoded(QString& out, QStringView text)
+{
+	for (const QChar c : text) {
+		switch (c.unicode()) {
+		case '%': out += QLatin1String("%25"); break;
+		case '&': out += QLatin1String("%26"); break;
+		case '=': out += QLatin1String("%3D"); break;
+		default: out += c; break;
+		}
+	}
+}
+
+QWinToastArgumentsView::QWinToastArgumentsView(QStringView source) :
+	_source(source)
+{
+	const int size = static_cast<int>(source.size());
+	int begin = 0;
+	while (begin < size) {
+		int end = begin;
+		int equals = -1;
+		while (end < size && source[end] != QLatin1Char('&')) {
+			if (equals < 0 && source[end] == QLatin1Char('=')) {
+				equals = end;
+			}
+			end++;
+		}
+		const int keyLength = (equals < 0 ? end : equals) - begin;
+		if (keyLength > 0) {
+			if (_count == MaxPairs) {
+				_truncated = true;
+				break;
+			}
+			Pair& pair = _pairs[_count++];
+			pair.keyBegin = begin;
+			pair.keyLength = keyLength;
+			pair.valueBegin = equals < 0 ? end : equals + 1;
+			pair.valueLength = end - pair.valueBegin;
+		}
+		begin = end + 1;
+	}
+}
+
+int QWinToastArgumentsView::count() const
+{
+	return _count;
+}
+
+bool QWinToastArgumentsView::isTruncated() const
+{
+	return _truncated;
+}
+
+QStringView QWinToastArgumentsView::key(int i) const
+{
+	return i >= 0 && i < _count ? _source.mid(_pairs[i].keyBegin, _pairs[i].keyLength) : QStringView();
+}
+
+QStringView QWinToastArgumentsView::value(int i) const
+{
+	return i >= 0 && i < _count ? _source.mid(_pairs[i].valueBegin, _pairs[i].valueLength) : QStringView();
+}
+
+QStringView QWinToastArgumentsView::value(QStringView key) const
+{
+	for (int i = 0; i < _count; i++) {
+		if (this->key(i) == key) {
+			return value(i);
+		}
+	}
+	return QStringView();
+}
+
+bool QWinToastArgumentsView::contains(QStringView key) const
+{
+	for (int i = 0; i < _count; i++) {
+		if (this->key(i) == key) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int QWinToastArgumentsView::actionIndex() const
+{
+	QStringView digits = value(QStringView(ActionKey));
+	if (_count == 1 && _pairs[0].valueBegin == _pairs[0].keyBegin + _pairs[0].keyLength) {
+		// Arguments written before the key/value encoding are a bare index,
+		// which parses as a single key without '='.
+		digits = key(0);
+	}
+	if (digits.isEmpty() || digits.size() > 9) {
+		return -1;
+	}
+	int index = 0;
+	for (const QChar c : digits) {
+		if (c < QLatin1Char('0') || c > QLatin1Char('9')) {
+			return -1;
+		}
+		index = index * 10 + (c.unicode() - '0');
+	}
+	return index;
+}
+
+QStringView QWinToastArgumentsView::command() const
+{
+	return value(QStringView(CommandKey));
+}
+
+QString QWinToastArgumentsView::decode(QStringView encoded)
+{
+	QString out;
+	out.reserve(static_cast<int>(encoded.size()));
+	for (int i = 0, size = static_cast<int>(encoded.size()); i < size; i++) {
+		if (encoded[i] == QLatin1Char('%') && i + 2 < size) {
+			const int high = hexValue(encoded[i + 1]);
+			const int low = hexValue(encoded[i + 2]);
+			if (high >= 0 && low >= 0) {
+				out += QChar(static_cast<ushort>(high * 16 + low));
+				i += 2;
+				continue;
+			}
+		}
+		out += encoded[i];
+	}
+	return out;
+}
+
+int QWinToastCommandRegistry::registerCommand(const QString& command, const Handler& handler)
+{
+	QString encoded;
+	QWinToastArguments::appendEncoded(encoded, command);
+	int id = encodedId(encoded);
+	if (id >= 0) {
+		_handlers[id] = handler;
+		return id;
+	}
+
+	if ((_used + 1) * 2 > _slots.size()) {
+		rehash(qMax(16, _slots.size() * 2));
+	}
+	id = _names.size();
+	_names.append(encoded);
+	_handlers.append(handler);
+
+	const int mask = _slots.size() - 1;
+	const uint hash = qHash(QStringView(encoded));
+	for (int i = static_cast<int>(hash) & mask;; i = (i + 1) & mask) {
+		if (_slots[i].id < 0) {
+			_slots[i] = Slot{ hash, id };
+			break;
+		}
+	}
+	_used++;
+	return id;
+}
+
+void QWinToastCommandRegistry::unregisterCommand(const QString& command)
+{
+	// Ids stay stable for the lifetime of the registry; only the handler goes.
+	const int id = commandId(command);
+	if (id >= 0) {
+		_handlers[id] = Handler();
+	}
+}
+
+int QWinToastCommandRegistry::commandId(QStringView command) const
+{
+	QString encoded;
+	QWinToastArguments::appendEncoded(encoded, command);
+	return encodedId(encoded);
+}
+
+int QWinToastCommandRegistry::encodedId(QStringView command) const
+{
+	if (_slots.isEmpty()) {
+		return -1;
+	}
+	const int mask = _slots.size() - 1;
+	const uint hash = qHash(command);
+	for (int i = static_cast<int>(hash) & mask;; i = (i + 1) & mask) {
+		const Slot& slot = _slots[i];
+		if (slot.id < 0) {
+			return -1;
+		}
+		if (slot.hash == hash && QStringView(_names[slot.id]) == command) {
+			return slot.id;
+		}
+	}
+}
+
+bool QWinToastCommandRegistry::dispatch(qint64 toastId, const QWinToastArgumentsView& arguments) const
+{
+	const QStringView command = arguments.command();
+	if (command.isEmpty()) {
+		return false;
+	}
+	int id = encodedId(command);
+	if (id < 0 && std::find(command.begin(), command.end(), QLatin1Char('%')) != command.end()) {
+		id = commandId(QWinToastArgumentsView::decode(command));
+	}
+	if (id < 0 || !_handlers[id]) {
+		return false;
+	}
+	_handlers[id](toastId, arguments);
+	return true;
+}
+
+void QWinToastCommandRegistry::rehash(int capacity)
+{
+	_slots = QVector<Slot>(capacity, Slot{ 0, -1 });
+	const int mask = capacity - 1;
+	for (int id = 0; id < _names.size(); id++) {
+		const uint hash = qHash(QStringView(_names[id]));
+		for (int i = static_cast<int>(hash) & mask;; i = (i + 1) & mask) {
+			if (_slots[i].id < 0) {
+				_slots[i] = Slot{ hash, id };
+				break;
+			}
+		}
+	}
+}
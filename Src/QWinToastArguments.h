@@ -0,0 +1,102 @@
+#ifndef QWINTOASTARGUMENTS
+#define QWINTOASTARGUMENTS
+
+#include <QString>
+#include <QStringView>
+#include <QVector>
+#include <array>
+#include <functional>
+
+// Builder for the compact key/value activation arguments carried by a toast
+// action: "a=1&c=approve&id=42". '%', '&' and '=' inside keys and values are
+// percent-encoded. The keys "a" (action index) and "c" (command) are reserved.
+class QWinToastArguments
+{
+public:
+    QWinToastArguments() = default;
+
+    // A pair with an empty or reserved key is dropped, so it can never
+    // shadow the action index or the command.
+    QWinToastArguments& insert(const QString& key, const QString& value);
+    bool isEmpty() const;
+    QString encoded() const;
+
+    static bool isReservedKey(QStringView key);
+    static void appendEncoded(QString& out, QStringView text);
+
+private:
+    QVector<QPair<QString, QString>> _pairs{};
+};
+
+// Non-allocating parse of an encoded argument string. The view only stores
+// offsets into the source buffer, which must outlive it. Values are returned
+// still encoded; decode() allocates only when a caller needs the plain text.
+class QWinToastArgumentsView
+{
+public:
+    enum { MaxPairs = 16 };
+
+    explicit QWinToastArgumentsView(QStringView source);
+
+    int count() const;
+    bool isTruncated() const;
+    QStringView key(int i) const;
+    QStringView value(int i) const;
+    QStringView value(QStringView key) const;
+    bool contains(QStringView key) const;
+
+    // Index of the activated action, or -1 when missing or malformed. A bare
+    // index, as written before the key/value encoding, is accepted too.
+    int actionIndex() const;
+    QStringView command() const;
+
+    static QString decode(QStringView encoded);
+
+private:
+    struct Pair
+    {
+        int keyBegin;
+        int keyLength;
+        int valueBegin;
+        int valueLength;
+    };
+
+    QStringView _source;
+    std::array<Pair, MaxPairs> _pairs;
+    int _count{ 0 };
+    bool _truncated{ false };
+};
+
+// Maps command names to handlers. Names are interned in their encoded form
+// into small integer ids once at registration, so lookups from a view hash
+// the raw characters and never allocate. Only a command encoded differently
+// from QWinToastArguments, say with lowercase hex, is decoded first.
+class QWinToastCommandRegistry
+{
+public:
+    typedef std::function<void(qint64 toastId, const QWinToastArgumentsView& arguments)> Handler;
+
+    int registerCommand(const QString& command, const Handler& handler);
+    void unregisterCommand(const QString& command);
+    // Takes the plain command name.
+    int commandId(QStringView command) const;
+    bool dispatch(qint64 toastId, const QWinToastArgumentsView& arguments) const;
+
+private:
+    struct Slot
+    {
+        uint hash;
+        int id;
+    };
+
+    QVector<Slot> _slots{};
+    // Encoded, as they appear in the arguments.
+    QVector<QString> _names{};
+    QVector<Handler> _handlers{};
+    int _used{ 0 };
+
+    int encodedId(QStringView encoded) const;
+    void rehash(int capacity);
+};
+
+#endif // QWINTOASTARGUMENTS
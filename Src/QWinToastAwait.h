@@ -0,0 +1,60 @@
+#ifndef QWINTOASTAWAIT
+#define QWINTOASTAWAIT
+
+#include "QWinToast.h"
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define QWINTOAST_HAS_COROUTINES
+#endif
+#endif
+
+#ifdef QWINTOAST_HAS_COROUTINES
+
+// Shows a toast and suspends the awaiting coroutine until it resolves:
+//
+//     const QWinToastResult result = co_await QWinToastAwaitable(toast, templ);
+//     if (result.outcome == QWinToastResult::Activated && result.actionIndex == 0) { ... }
+//
+// The coroutine handle is parked in the toast's pending entry, so a suspended
+// prompt holds no QObject or connection. It is resumed on the thread that
+// resolves the toast, normally the toast's own. Await on that thread.
+class QWinToastAwaitable
+{
+public:
+    QWinToastAwaitable(QWinToast& toast, const QWinToastTemplate& templ) :
+        _toast(toast),
+        _future(toast.showToastForResult(templ, nullptr, &_id))
+    {
+    }
+
+    bool await_ready() const
+    {
+        return _future.isFinished();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        return _toast.resumeOnResult(_id, &QWinToastAwaitable::resume, handle.address());
+    }
+
+    QWinToastResult await_resume() const
+    {
+        return _future.result();
+    }
+
+private:
+    QWinToast& _toast;
+    qint64 _id{ -1 };
+    QFuture<QWinToastResult> _future;
+
+    static void resume(void* address)
+    {
+        std::coroutine_handle<>::from_address(address).resume();
+    }
+};
+
+#endif // QWINTOAST_HAS_COROUTINES
+
+#endif // QWINTOASTAWAIT
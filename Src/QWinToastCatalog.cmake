@@ -0,0 +1,37 @@
+# qwintoast_add_catalog(<target> NAME <namespace> JSON <catalog.json>)
+#
+# Generates <namespace>.h and <namespace>.cpp from a JSON toast catalog (see
+# QWinToastCatalogGen.cmake for the schema) and adds them to <target>. The
+# header declares one QWinToastCatalogEntry per toast and a <toast>Values()
+# helper taking its placeholders; pass both to QWinToast::showCatalogToast().
+# Schema errors fail the build. Generation needs CMake 3.19 for string(JSON).
+
+set(_QWINTOAST_CATALOG_DIR "${CMAKE_CURRENT_LIST_DIR}")
+set(_QWINTOAST_CATALOG_GENERATOR "${_QWINTOAST_CATALOG_DIR}/QWinToastCatalogGen.cmake")
+
+function(qwintoast_add_catalog target)
+    cmake_parse_arguments(ARG "" "NAME;JSON" "" ${ARGN})
+    if(NOT ARG_NAME OR NOT ARG_JSON)
+        message(FATAL_ERROR "qwintoast_add_catalog: NAME and JSON are required")
+    endif()
+    if(CMAKE_VERSION VERSION_LESS 3.19)
+        message(FATAL_ERROR "qwintoast_add_catalog needs CMake 3.19 or newer")
+    endif()
+
+    get_filename_component(json "${ARG_JSON}" ABSOLUTE)
+    set(dir "${CMAKE_CURRENT_BINARY_DIR}/qwintoast_catalog")
+    set(header "${dir}/${ARG_NAME}.h")
+    set(source "${dir}/${ARG_NAME}.cpp")
+    add_custom_command(
+        OUTPUT "${header}" "${source}"
+        COMMAND "${CMAKE_COMMAND}" -E make_directory "${dir}"
+        COMMAND "${CMAKE_COMMAND}" "-DINPUT=${json}" "-DNAME=${ARG_NAME}"
+                "-DOUTPUT_HEADER=${header}" "-DOUTPUT_SOURCE=${source}"
+                -P "${_QWINTOAST_CATALOG_GENERATOR}"
+        DEPENDS "${json}" "${_QWINTOAST_CATALOG_GENERATOR}"
+        COMMENT "Generating toast catalog ${ARG_NAME}"
+        VERBATIM)
+    target_sources(${target} PRIVATE "${header}" "${source}")
+    # The generated code includes QWinToastCatalog.h from next to this file.
+    target_include_directories(${target} PRIVATE "${dir}" "${_QWINTOAST_CATALOG_DIR}")
+endfunction()
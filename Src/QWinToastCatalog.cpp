@@ -0,0 +1,45 @@
+#include "QWinToastCatalog.h"
+#include "QWinToastArguments.h"
+#include "QWinToastXml.h"
+#include <string.h>
+
+QString QWinToastCatalog::payload(const QWinToastCatalogEntry& entry, const QStringList& values, bool modernFeatures)
+{
+	const QWinToastCatalogSegment* segments = modernFeatures ? entry.modern : entry.legacy;
+	const int count = modernFeatures ? entry.modernCount : entry.legacyCount;
+
+	int size = 0;
+	for (int i = 0; i < count; i++) {
+		size += segments[i].text ? segments[i].length : values.value(segments[i].placeholder).size();
+	}
+
+	QString xml;
+	xml.reserve(size);
+	for (int i = 0; i < count; i++) {
+		const QWinToastCatalogSegment& segment = segments[i];
+		if (segment.text) {
+			xml.append(reinterpret_cast<const QChar*>(segment.text), segment.length);
+		}
+		else if (segment.placeholder < values.size()) {
+			if (segment.argument) {
+				QString encoded;
+				QWinToastArguments::appendEncoded(encoded, values[segment.placeholder]);
+				QWinToastXml::appendEscaped(xml, encoded);
+			}
+			else {
+				QWinToastXml::appendEscaped(xml, values[segment.placeholder]);
+			}
+		}
+	}
+	return xml;
+}
+
+int QWinToastCatalog::placeholderIndex(const QWinToastCatalogEntry& entry, const char* name)
+{
+	for (int i = 0; i < entry.placeholderCount; i++) {
+		if (strcmp(entry.placeholders[i], name) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,44 @@
+#ifndef QWINTOASTCATALOG
+#define QWINTOASTCATALOG
+
+#include <QString>
+#include <QStringList>
+
+// Tables emitted by qwintoast_add_catalog() (QWinToastCatalog.cmake). Each
+// catalog toast is stored as prebuilt XML split into literal segments and
+// placeholder references; showing it only escapes and splices the values.
+
+struct QWinToastCatalogSegment
+{
+    // Already escaped XML, or nullptr for a placeholder.
+    const char16_t* text;
+    int length;
+    int placeholder;
+    // The value sits inside action arguments and is percent-encoded first.
+    bool argument;
+};
+
+struct QWinToastCatalogEntry
+{
+    const char* name;
+    // Payload with modern features (actions, audio, scenario) and without.
+    const QWinToastCatalogSegment* modern;
+    int modernCount;
+    const QWinToastCatalogSegment* legacy;
+    int legacyCount;
+    const char* const* placeholders;
+    int placeholderCount;
+    qint64 expiration;
+    const char16_t* tag;
+    const char16_t* group;
+};
+
+namespace QWinToastCatalog
+{
+    // Missing values are treated as empty strings.
+    QString payload(const QWinToastCatalogEntry& entry, const QStringList& values, bool modernFeatures);
+    // -1 when the entry has no placeholder of that name.
+    int placeholderIndex(const QWinToastCatalogEntry& entry, const char* name);
+}
+
+#endif // QWINTOASTCATALOG
@@ -0,0 +1,512 @@
+# Generates C++ tables from a JSON toast catalog. Run in script mode:
+#   cmake -DINPUT=<catalog.json> -DNAME=<Name> -DOUTPUT_HEADER=<h> -DOUTPUT_SOURCE=<cpp> -P QWinToastCatalogGen.cmake
+#
+# The catalog is an object with a "toasts" array. Every toast has:
+#   name         C++ identifier, unique in the catalog (required)
+#   template     ImageAndText01..04 or Text01..04 (required)
+#   text         array of lines, at most as many as the template has
+#   image        image path, image templates only
+#   attribution  attribution text
+#   scenario     Default, Alarm, IncomingCall or Reminder
+#   duration     System, Short or Long
+#   audio        AudioSystemFile name (e.g. Mail) or a sound URI
+#   audioOption  Default, Silent or Loop
+#   actions      array of { label, command, arguments: { key: value } }
+#   expiration   milliseconds, 0 for none
+#   tag, group   replace-in-place identity
+# Strings may reference {placeholder} values that are filled in when the
+# toast is shown. Names and placeholders become C++ identifiers, so keywords
+# and reserved identifiers are rejected. Any schema error fails the build.
+
+cmake_minimum_required(VERSION 3.19)
+
+foreach(_var INPUT NAME OUTPUT_HEADER OUTPUT_SOURCE)
+    if(NOT DEFINED ${_var})
+        message(FATAL_ERROR "QWinToastCatalogGen: ${_var} is not set")
+    endif()
+endforeach()
+
+file(READ "${INPUT}" _json)
+
+function(_qwt_fail _toast _message)
+    message(FATAL_ERROR "${INPUT}: toast '${_toast}': ${_message}")
+endfunction()
+
+# Reads an optional member; sets <out> to "" and <out>_FOUND accordingly.
+function(_qwt_get _out _json_object)
+    string(JSON _value ERROR_VARIABLE _error GET "${_json_object}" ${ARGN})
+    if(_error)
+        set(${_out} "" PARENT_SCOPE)
+        set(${_out}_FOUND FALSE PARENT_SCOPE)
+    else()
+        set(${_out} "${_value}" PARENT_SCOPE)
+        set(${_out}_FOUND TRUE PARENT_SCOPE)
+    endif()
+endfunction()
+
+# Fails unless _identifier can be declared in C++11 and later standards.
+function(_qwt_expect_identifier _toast _what _identifier)
+    if(NOT _identifier MATCHES "^[A-Za-z_][A-Za-z0-9_]*$")
+        _qwt_fail("${_toast}" "${_what} must be a C++ identifier")
+    endif()
+    if(_identifier IN_LIST _cpp_keywords)
+        _qwt_fail("${_toast}" "${_what} '${_identifier}' is a C++ keyword")
+    endif()
+    if(_identifier MATCHES "__" OR _identifier MATCHES "^_[A-Z]")
+        _qwt_fail("${_toast}" "${_what} '${_identifier}' is reserved for the implementation")
+    endif()
+endfunction()
+
+function(_qwt_expect_type _toast _json_object _member _type)
+    string(JSON _actual ERROR_VARIABLE _error TYPE "${_json_object}" ${_member})
+    if(NOT _error AND NOT _actual STREQUAL _type)
+        _qwt_fail("${_toast}" "'${_member}' must be of type ${_type}, not ${_actual}")
+    endif()
+endfunction()
+
+function(_qwt_escape_xml _out _text)
+    string(REPLACE "&" "&amp;" _text "${_text}")
+    string(REPLACE "<" "&lt;" _text "${_text}")
+    string(REPLACE ">" "&gt;" _text "${_text}")
+    string(REPLACE "\"" "&quot;" _text "${_text}")
+    string(REPLACE "'" "&apos;" _text "${_text}")
+    set(${_out} "${_text}" PARENT_SCOPE)
+endfunction()
+
+# Same escaping as QWinToastArguments::appendEncoded().
+function(_qwt_encode_argument _out _text)
+    string(REPLACE "%" "%25" _text "${_text}")
+    string(REPLACE "&" "%26" _text "${_text}")
+    string(REPLACE "=" "%3D" _text "${_text}")
+    set(${_out} "${_text}" PARENT_SCOPE)
+endfunction()
+
+function(_qwt_escape_cpp _out _text)
+    string(REPLACE "\\" "\\\\" _text "${_text}")
+    string(REPLACE "\"" "\\\"" _text "${_text}")
+    string(REPLACE "\n" "\\n" _text "${_text}")
+    string(REPLACE "\r" "\\r" _text "${_text}")
+    string(REPLACE "\t" "\\t" _text "${_text}")
+    set(${_out} "${_text}" PARENT_SCOPE)
+endfunction()
+
+# Segment building. _segments holds the C++ initializers built so far,
+# _literal the escaped XML not yet flushed, _placeholders the names in order
+# of first use.
+macro(_qwt_begin)
+    set(_segments "")
+    set(_segment_count 0)
+    set(_literal "")
+endmacro()
+
+macro(_qwt_flush)
+    if(NOT _literal STREQUAL "")
+        _qwt_escape_cpp(_cpp "${_literal}")
+        string(APPEND _segments "    QWT_LITERAL(u\"${_cpp}\"),\n")
+        math(EXPR _segment_count "${_segment_count} + 1")
+        set(_literal "")
+    endif()
+endmacro()
+
+# Appends raw markup.
+function(_qwt_markup _text)
+    string(APPEND _literal "${_text}")
+    set(_literal "${_literal}" PARENT_SCOPE)
+endfunction()
+
+# Appends user text with {placeholder} references. _argument_mode selects
+# percent-encoding for text inside action arguments.
+function(_qwt_text_impl _text _argument_mode)
+    set(_rest "${_text}")
+    while(TRUE)
+        string(REGEX MATCH "\\{([A-Za-z_][A-Za-z0-9_]*)\\}" _match "${_rest}")
+        if(_match STREQUAL "")
+            break()
+        endif()
+        set(_placeholder "${CMAKE_MATCH_1}")
+        _qwt_expect_identifier("${_name}" "placeholder" "${_placeholder}")
+        string(FIND "${_rest}" "${_match}" _at)
+        string(SUBSTRING "${_rest}" 0 ${_at} _before)
+        string(LENGTH "${_match}" _match_length)
+        math(EXPR _after_at "${_at} + ${_match_length}")
+        string(SUBSTRING "${_rest}" ${_after_at} -1 _rest)
+
+        if(_argument_mode)
+            _qwt_encode_argument(_before "${_before}")
+        endif()
+        _qwt_escape_xml(_before "${_before}")
+        string(APPEND _literal "${_before}")
+        if(NOT _literal STREQUAL "")
+            _qwt_escape_cpp(_cpp "${_literal}")
+            string(APPEND _segments "    QWT_LITERAL(u\"${_cpp}\"),\n")
+            math(EXPR _segment_count "${_segment_count} + 1")
+            set(_literal "")
+        endif()
+
+        list(FIND _placeholders "${_placeholder}" _index)
+        if(_index EQUAL -1)
+            list(LENGTH _placeholders _index)
+            list(APPEND _placeholders "${_placeholder}")
+        endif()
+        if(_argument_mode)
+            string(APPEND _segments "    QWT_ARGUMENT(${_index}),\n")
+        else()
+            string(APPEND _segments "    QWT_PLACEHOLDER(${_index}),\n")
+        endif()
+        math(EXPR _segment_count "${_segment_count} + 1")
+    endwhile()
+    if(_argument_mode)
+        _qwt_encode_argument(_rest "${_rest}")
+    endif()
+    _qwt_escape_xml(_rest "${_rest}")
+    string(APPEND _literal "${_rest}")
+
+    set(_segments "${_segments}" PARENT_SCOPE)
+    set(_segment_count "${_segment_count}" PARENT_SCOPE)
+    set(_literal "${_literal}" PARENT_SCOPE)
+    set(_placeholders "${_placeholders}" PARENT_SCOPE)
+endfunction()
+
+function(_qwt_text _text)
+    _qwt_text_impl("${_text}" FALSE)
+    set(_segments "${_segments}" PARENT_SCOPE)
+    set(_segment_count "${_segment_count}" PARENT_SCOPE)
+    set(_literal "${_literal}" PARENT_SCOPE)
+    set(_placeholders "${_placeholders}" PARENT_SCOPE)
+endfunction()
+
+function(_qwt_argument _text)
+    _qwt_text_impl("${_text}" TRUE)
+    set(_segments "${_segments}" PARENT_SCOPE)
+    set(_segment_count "${_segment_count}" PARENT_SCOPE)
+    set(_literal "${_literal}" PARENT_SCOPE)
+    set(_placeholders "${_placeholders}" PARENT_SCOPE)
+endfunction()
+
+set(_cpp_keywords
+    alignas alignof and and_eq asm auto bitand bitor bool break case catch char
+    char8_t char16_t char32_t class compl concept const consteval constexpr
+    constinit const_cast continue co_await co_return co_yield decltype default
+    delete do double dynamic_cast else enum explicit export extern false float
+    for friend goto if inline int long mutable namespace new noexcept not not_eq
+    nullptr operator or or_eq private protected public register
+    reinterpret_cast requires return short signed sizeof static static_assert
+    static_cast struct switch template this thread_local throw true try typedef
+    typeid typename union unsigned using virtual void volatile wchar_t while
+    xor xor_eq)
+set(_templates ImageAndText01 ImageAndText02 ImageAndText03 ImageAndText04 Text01 Text02 Text03 Text04)
+set(_template_fields 1 2 2 3 1 2 2 3)
+set(_scenarios Default Alarm IncomingCall Reminder)
+set(_durations System Short Long)
+set(_audio_options Default Silent Loop)
+set(_known_members name template text image attribution scenario duration audio audioOption actions expiration tag group)
+set(_audio_files
+    DefaultSound "ms-winsoundevent:Notification.Default"
+    IM "ms-winsoundevent:Notification.IM"
+    Mail "ms-winsoundevent:Notification.Mail"
+    Reminder "ms-winsoundevent:Notification.Reminder"
+    SMS "ms-winsoundevent:Notification.SMS")
+foreach(_n "" 2 3 4 5 6 7 8 9 10)
+    list(APPEND _audio_files "Alarm${_n}" "ms-winsoundevent:Notification.Looping.Alarm${_n}")
+endforeach()
+foreach(_n "" 1 2 3 4 5 6 7 8 9 10)
+    list(APPEND _audio_files "Call${_n}" "ms-winsoundevent:Notification.Looping.Call${_n}")
+endforeach()
+
+string(JSON _toasts_type ERROR_VARIABLE _error TYPE "${_json}" toasts)
+if(_error OR NOT _toasts_type STREQUAL "ARRAY")
+    message(FATAL_ERROR "${INPUT}: expected an object with a \"toasts\" array")
+endif()
+string(JSON _toast_count LENGTH "${_json}" toasts)
+
+if(_toast_count EQUAL 0)
+    message(FATAL_ERROR "${INPUT}: the catalog has no toasts")
+endif()
+math(EXPR _last_toast "${_toast_count} - 1")
+
+set(_header_entries "")
+set(_source_tables "")
+set(_names "")
+foreach(_t RANGE 0 ${_last_toast})
+    string(JSON _toast GET "${_json}" toasts ${_t})
+
+    _qwt_get(_name "${_toast}" name)
+    _qwt_expect_identifier("#${_t}" "name" "${_name}")
+    if(_name IN_LIST _names)
+        _qwt_fail("${_name}" "duplicate name")
+    endif()
+    list(APPEND _names "${_name}")
+
+    string(JSON _member_count LENGTH "${_toast}")
+    math(EXPR _last_member "${_member_count} - 1")
+    foreach(_m RANGE 0 ${_last_member})
+        string(JSON _member MEMBER "${_toast}" ${_m})
+        if(NOT _member IN_LIST _known_members)
+            _qwt_fail("${_name}" "unknown member '${_member}'")
+        endif()
+    endforeach()
+
+    _qwt_get(_template "${_toast}" template)
+    list(FIND _templates "${_template}" _template_index)
+    if(_template_index EQUAL -1)
+        _qwt_fail("${_name}" "'template' must be one of ${_templates}")
+    endif()
+    list(GET _template_fields ${_template_index} _field_count)
+
+    _qwt_expect_type("${_name}" "${_toast}" text ARRAY)
+    _qwt_expect_type("${_name}" "${_toast}" actions ARRAY)
+    _qwt_expect_type("${_name}" "${_toast}" expiration NUMBER)
+    foreach(_member image attribution scenario duration audio audioOption tag group)
+        _qwt_expect_type("${_name}" "${_toast}" ${_member} STRING)
+    endforeach()
+
+    set(_lines "")
+    _qwt_get(_text "${_toast}" text)
+    set(_line_count 0)
+    if(_text_FOUND)
+        string(JSON _line_count LENGTH "${_toast}" text)
+        if(_line_count GREATER _field_count)
+            _qwt_fail("${_name}" "${_template} has ${_field_count} text fields, got ${_line_count}")
+        endif()
+    endif()
+
+    _qwt_get(_image "${_toast}" image)
+    if(_image_FOUND AND _template_index GREATER 3)
+        _qwt_fail("${_name}" "'image' needs an ImageAndText template")
+    endif()
+    _qwt_get(_attribution "${_toast}" attribution)
+
+    _qwt_get(_scenario "${_toast}" scenario)
+    if(NOT _scenario_FOUND)
+        set(_scenario Default)
+    elseif(NOT _scenario IN_LIST _scenarios)
+        _qwt_fail("${_name}" "'scenario' must be one of ${_scenarios}")
+    endif()
+    _qwt_get(_duration "${_toast}" duration)
+    if(NOT _duration_FOUND)
+        set(_duration System)
+    elseif(NOT _duration IN_LIST _durations)
+        _qwt_fail("${_name}" "'duration' must be one of ${_durations}")
+    endif()
+    _qwt_get(_audio_option "${_toast}" audioOption)
+    if(NOT _audio_option_FOUND)
+        set(_audio_option Default)
+    elseif(NOT _audio_option IN_LIST _audio_options)
+        _qwt_fail("${_name}" "'audioOption' must be one of ${_audio_options}")
+    endif()
+    _qwt_get(_audio "${_toast}" audio)
+    # Names sit at even positions of the name/URI list.
+    list(FIND _audio_files "${_audio}" _audio_index)
+    if(_audio_FOUND AND _audio_index GREATER -1)
+        math(EXPR _audio_is_uri "${_audio_index} % 2")
+        if(NOT _audio_is_uri)
+            math(EXPR _audio_index "${_audio_index} + 1")
+            list(GET _audio_files ${_audio_index} _audio)
+        endif()
+    endif()
+
+    _qwt_get(_expiration "${_toast}" expiration)
+    if(NOT _expiration_FOUND)
+        set(_expiration 0)
+    elseif(NOT _expiration MATCHES "^[0-9]+$")
+        _qwt_fail("${_name}" "'expiration' must be a non-negative integer")
+    endif()
+    foreach(_member tag group)
+        _qwt_get(_${_member} "${_toast}" ${_member})
+        if(_${_member} MATCHES "\\{[A-Za-z_][A-Za-z0-9_]*\\}")
+            _qwt_fail("${_name}" "'${_member}' cannot contain placeholders")
+        endif()
+    endforeach()
+
+    set(_action_count 0)
+    _qwt_get(_actions "${_toast}" actions)
+    if(_actions_FOUND)
+        string(JSON _action_count LENGTH "${_toast}" actions)
+    endif()
+
+    set(_placeholders "")
+    string(REPLACE "ImageAndText" "ToastImageAndText" _binding "${_template}")
+    string(REGEX REPLACE "^Text" "ToastText" _binding "${_binding}")
+
+    # Both variants mirror QWinToastXml::toastPayload().
+    foreach(_variant modern legacy)
+        _qwt_begin()
+        if(_variant STREQUAL "modern")
+            _qwt_markup("<toast")
+            if(_duration STREQUAL "Short")
+                _qwt_markup(" duration=\"short\"")
+            elseif(_duration STREQUAL "Long" OR _action_count GREATER 0)
+                _qwt_markup(" duration=\"long\"")
+            endif()
+            _qwt_markup(" scenario=\"${_scenario}\"")
+            if(_action_count GREATER 0)
+                _qwt_markup(" template=\"ToastGeneric\"")
+            endif()
+            _qwt_markup(">")
+        else()
+            _qwt_markup("<toast>")
+        endif()
+        _qwt_markup("<visual><binding template=\"${_binding}\">")
+        if(_template_index LESS 4)
+            _qwt_markup("<image id=\"1\" src=\"file:///")
+            _qwt_text("${_image}")
+            _qwt_markup("\"/>")
+        endif()
+        foreach(_line RANGE 1 ${_field_count})
+            _qwt_markup("<text id=\"${_line}\">")
+            if(_line LESS_EQUAL _line_count)
+                math(EXPR _line_index "${_line} - 1")
+                string(JSON _line_text GET "${_toast}" text ${_line_index})
+                _qwt_text("${_line_text}")
+            endif()
+            _qwt_markup("</text>")
+        endforeach()
+        if(_variant STREQUAL "modern" AND NOT _attribution STREQUAL "")
+            _qwt_markup("<text placement=\"attribution\">")
+            _qwt_text("${_attribution}")
+            _qwt_markup("</text>")
+        endif()
+        _qwt_markup("</binding></visual>")
+
+        if(_variant STREQUAL "modern" AND _action_count GREATER 0)
+            _qwt_markup("<actions>")
+            math(EXPR _last_action "${_action_count} - 1")
+            foreach(_a RANGE 0 ${_last_action})
+                string(JSON _action GET "${_toast}" actions ${_a})
+                string(JSON _action_type TYPE "${_toast}" actions ${_a})
+                if(NOT _action_type STREQUAL "OBJECT")
+                    _qwt_fail("${_name}" "actions[${_a}] must be an object")
+                endif()
+                _qwt_get(_label "${_action}" label)
+                if(NOT _label_FOUND OR _label STREQUAL "")
+                    _qwt_fail("${_name}" "actions[${_a}] needs a 'label'")
+                endif()
+                _qwt_get(_command "${_action}" command)
+                _qwt_get(_arguments "${_action}" arguments)
+                if(_arguments_FOUND)
+                    string(JSON _arguments_type TYPE "${_action}" arguments)
+                    if(NOT _arguments_type STREQUAL "OBJECT")
+                        _qwt_fail("${_name}" "actions[${_a}].arguments must be an object")
+                    endif()
+                endif()
+
+                _qwt_markup("<action content=\"")
+                _qwt_text("${_label}")
+                _qwt_markup("\" arguments=\"a=${_a}")
+                # Same layout as QWinToastTemplate::addAction(label, command, arguments).
+                if(_command_FOUND)
+                    _qwt_markup("&amp;c=")
+                    _qwt_argument("${_command}")
+                endif()
+                if(_arguments_FOUND)
+                    string(JSON _pair_count LENGTH "${_action}" arguments)
+                    if(_pair_count GREATER 0)
+                        math(EXPR _last_pair "${_pair_count} - 1")
+                        foreach(_p RANGE 0 ${_last_pair})
+                            string(JSON _key MEMBER "${_action}" arguments ${_p})
+                            string(JSON _value GET "${_action}" arguments "${_key}")
+                            _qwt_markup("&amp;")
+                            _qwt_argument("${_key}")
+                            _qwt_markup("=")
+                            _qwt_argument("${_value}")
+                        endforeach()
+                    endif()
+                endif()
+                _qwt_markup("\"/>")
+            endforeach()
+            _qwt_markup("</actions>")
+        endif()
+
+        if(_variant STREQUAL "modern" AND (NOT _audio STREQUAL "" OR NOT _audio_option STREQUAL "Default"))
+            _qwt_markup("<audio")
+            if(NOT _audio STREQUAL "")
+                _qwt_markup(" src=\"")
+                _qwt_text("${_audio}")
+                _qwt_markup("\"")
+            endif()
+            if(_audio_option STREQUAL "Loop")
+                _qwt_markup(" loop=\"true\"")
+            elseif(_audio_option STREQUAL "Silent")
+                _qwt_markup(" silent=\"true\"")
+            endif()
+            _qwt_markup("/>")
+        endif()
+        _qwt_markup("</toast>")
+        _qwt_flush()
+
+        set(_${_variant}_segments "${_segments}")
+        set(_${_variant}_count ${_segment_count})
+    endforeach()
+
+    # Header: the entry plus a values() helper whose parameters are the
+    # placeholders, so a missing value is a compile error.
+    set(_parameters "")
+    set(_arguments "")
+    set(_names_table "")
+    foreach(_placeholder IN LISTS _placeholders)
+        if(NOT _parameters STREQUAL "")
+            string(APPEND _parameters ", ")
+            string(APPEND _arguments ", ")
+        endif()
+        string(APPEND _parameters "const QString& ${_placeholder}")
+        string(APPEND _arguments "${_placeholder}")
+        string(APPEND _names_table "\"${_placeholder}\", ")
+    endforeach()
+    list(LENGTH _placeholders _placeholder_count)
+    string(APPEND _header_entries "    extern const QWinToastCatalogEntry ${_name};\n")
+    if(_placeholder_count GREATER 0)
+        set(_list "QStringList{ ${_arguments} }")
+    else()
+        set(_list "QStringList()")
+    endif()
+    string(APPEND _header_entries "    inline QStringList ${_name}Values(${_parameters})\n    {\n        return ${_list};\n    }\n\n")
+
+    _qwt_escape_cpp(_tag_cpp "${_tag}")
+    _qwt_escape_cpp(_group_cpp "${_group}")
+    string(APPEND _source_tables "// ${_name}\n")
+    string(APPEND _source_tables "constexpr QWinToastCatalogSegment ${_name}Modern[] = {\n${_modern_segments}};\n")
+    string(APPEND _source_tables "constexpr QWinToastCatalogSegment ${_name}Legacy[] = {\n${_legacy_segments}};\n")
+    if(_placeholder_count GREATER 0)
+        string(APPEND _source_tables "constexpr const char* ${_name}Placeholders[] = { ${_names_table}};\n")
+        set(_names_pointer "${_name}Placeholders")
+    else()
+        set(_names_pointer "nullptr")
+    endif()
+    string(APPEND _source_tables "extern const QWinToastCatalogEntry ${_name};\n")
+    string(APPEND _source_tables "constexpr QWinToastCatalogEntry ${_name} = {\n")
+    string(APPEND _source_tables "    \"${_name}\", ${_name}Modern, ${_modern_count}, ${_name}Legacy, ${_legacy_count},\n")
+    string(APPEND _source_tables "    ${_names_pointer}, ${_placeholder_count}, ${_expiration}, u\"${_tag_cpp}\", u\"${_group_cpp}\"\n};\n\n")
+endforeach()
+
+get_filename_component(_header_name "${OUTPUT_HEADER}" NAME)
+string(TOUPPER "QWINTOASTCATALOG_${NAME}" _guard)
+file(WRITE "${OUTPUT_HEADER}.tmp"
+"// Generated from ${INPUT} by QWinToastCatalogGen.cmake. Do not edit.
+#ifndef ${_guard}
+#define ${_guard}
+
+#include \"QWinToastCatalog.h\"
+
+namespace ${NAME}
+{
+${_header_entries}}
+
+#endif // ${_guard}
+")
+file(WRITE "${OUTPUT_SOURCE}.tmp"
+"// Generated from ${INPUT} by QWinToastCatalogGen.cmake. Do not edit.
+#include \"${_header_name}\"
+
+#define QWT_LITERAL(s) { s, static_cast<int>(sizeof(s) / sizeof(char16_t)) - 1, -1, false }
+#define QWT_PLACEHOLDER(i) { nullptr, 0, i, false }
+#define QWT_ARGUMENT(i) { nullptr, 0, i, true }
+
+namespace ${NAME}
+{
+${_source_tables}}
+")
+# Only touch the outputs when they change so dependents are not rebuilt.
+# file(COPY_FILE) would need 3.21.
+execute_process(COMMAND "${CMAKE_COMMAND}" -E copy_if_different "${OUTPUT_HEADER}.tmp" "${OUTPUT_HEADER}")
+execute_process(COMMAND "${CMAKE_COMMAND}" -E copy_if_different "${OUTPUT_SOURCE}.tmp" "${OUTPUT_SOURCE}")
+file(REMOVE "${OUTPUT_HEADER}.tmp" "${OUTPUT_SOURCE}.tmp")
@@ -0,0 +1,153 @@
+#include "QWinToastClock.h"
+#include <QElapsedTimer>
+#include <QTimer>
+#include <chrono>
+#include <limits.h>
+
+namespace
+{
+	class SystemClock : public QWinToastClock
+	{
+	public:
+		SystemClock()
+		{
+			_elapsed.start();
+		}
+
+		qint64 now() const override
+		{
+			return _elapsed.elapsed();
+		}
+
+		qint64 timestamp() const override
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		quint64 schedule(qint64 delay, QObject* context, const Callback& callback) override
+		{
+			QTimer* timer = new QTimer(context);
+			timer->setSingleShot(true);
+			quint64 handle;
+			{
+				QMutexLocker locker(&_mutex);
+				handle = _nextHandle++;
+				_timers.insert(handle, timer);
+			}
+			QObject::connect(timer, &QTimer::timeout, timer, [this, handle, timer, callback]() {
+				{
+					QMutexLocker locker(&_mutex);
+					_timers.remove(handle);
+				}
+				timer->deleteLater();
+				callback();
+			});
+			timer->start(static_cast<int>(qBound<qint64>(0, delay, INT_MAX)));
+			return handle;
+		}
+
+		void cancel(quint64 handle) override
+		{
+			QPointer<QTimer> timer;
+			{
+				QMutexLocker locker(&_mutex);
+				timer = _timers.take(handle);
+			}
+			if (timer) {
+				timer->stop();
+				timer->deleteLater();
+			}
+		}
+
+	private:
+		QElapsedTimer _elapsed;
+		QMutex _mutex;
+		quint64 _nextHandle{ 1 };
+		QHash<quint64, QPointer<QTimer>> _timers;
+	};
+}
+
+qint64 QWinToastClock::timestamp() const
+{
+	return now() * 1000000;
+}
+
+QWinToastClock* QWinToastClock::system()
+{
+	static SystemClock clock;
+	return &clock;
+}
+
+QWinToastManualClock::QWinToastManualClock(qint64 start) :
+	_now(start)
+{
+}
+
+qint64 QWinToastManualClock::now() const
+{
+	QMutexLocker locker(&_mutex);
+	return _now;
+}
+
+quint64 QWinToastManualClock::schedule(qint64 delay, QObject* context, const Callback& callback)
+{
+	QMutexLocker locker(&_mutex);
+	const quint64 handle = _nextHandle++;
+	const qint64 deadline = _now + qMax<qint64>(0, delay);
+	_entries.insert(qMakePair(deadline, handle), Entry{ context, callback });
+	_deadlines.insert(handle, deadline);
+	return handle;
+}
+
+void QWinToastManualClock::cancel(quint64 handle)
+{
+	QMutexLocker locker(&_mutex);
+	const auto it = _deadlines.find(handle);
+	if (it == _deadlines.end()) {
+		return;
+	}
+	_entries.remove(qMakePair(it.value(), handle));
+	_deadlines.erase(it);
+}
+
+void QWinToastManualClock::advance(qint64 milliseconds)
+{
+	advanceTo(now() + qMax<qint64>(0, milliseconds));
+}
+
+void QWinToastManualClock::advanceTo(qint64 time)
+{
+	for (;;) {
+		Entry entry;
+		{
+			QMutexLocker locker(&_mutex);
+			const auto it = _entries.begin();
+			if (it == _entries.end() || it.key().first > time) {
+				_now = qMax(_now, time);
+				return;
+			}
+			// Callbacks scheduled from a callback land on the new now() and run
+			// in the same pass if they are due.
+			_now = qMax(_now, it.key().first);
+			_deadlines.remove(it.key().second);
+			entry = it.value();
+			_entries.erase(it);
+		}
+		if (entry.context) {
+			entry.callback();
+		}
+	}
+}
+
+int QWinToastManualClock::pendingCount() const
+{
+	QMutexLocker locker(&_mutex);
+	return _entries.size();
+}
+
+qint64 QWinToastManualClock::nextDeadline() const
+{
+	QMutexLocker locker(&_mutex);
+	return _entries.isEmpty() ? -1 : _entries.firstKey().first;
+}
@@ -0,0 +1,69 @@
+#ifndef QWINTOASTCLOCK
+#define QWINTOASTCLOCK
+
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QPointer>
+#include <functional>
+
+class QTimer;
+
+// Every time read and timer of the library goes through a clock: expiry
+// deadlines, retry backoff, digest windows, the circuit breaker, channel
+// rate limits, event timestamps and trace records. Times are milliseconds on
+// a monotonic scale; timestamp() is the nanosecond reading for instrumentation.
+class QWinToastClock
+{
+public:
+    typedef std::function<void()> Callback;
+
+    virtual ~QWinToastClock() = default;
+    virtual qint64 now() const = 0;
+    // Runs callback once now() has advanced by delay milliseconds, provided
+    // context still exists. Call on context's thread. Returns a non-zero
+    // handle for cancel().
+    virtual quint64 schedule(qint64 delay, QObject* context, const Callback& callback) = 0;
+    virtual void cancel(quint64 handle) = 0;
+    // Nanoseconds on a monotonic scale. now() scaled up unless overridden;
+    // the system clock reads the steady clock at full resolution.
+    virtual qint64 timestamp() const;
+
+    // QElapsedTimer and QTimer backed; the default everywhere.
+    static QWinToastClock* system();
+};
+
+// Time only moves when told to. Due callbacks run inside advance() on the
+// calling thread, in deadline order, with now() reporting their deadline.
+class QWinToastManualClock : public QWinToastClock
+{
+public:
+    explicit QWinToastManualClock(qint64 start = 0);
+
+    qint64 now() const override;
+    quint64 schedule(qint64 delay, QObject* context, const Callback& callback) override;
+    void cancel(quint64 handle) override;
+
+    void advance(qint64 milliseconds);
+    // Runs everything scheduled at or before time.
+    void advanceTo(qint64 time);
+    int pendingCount() const;
+    // -1 when nothing is scheduled.
+    qint64 nextDeadline() const;
+
+private:
+    struct Entry
+    {
+        QPointer<QObject> context;
+        Callback callback;
+    };
+
+    mutable QMutex _mutex;
+    qint64 _now;
+    quint64 _nextHandle{ 1 };
+    // Keyed by (deadline, handle) so equal deadlines run in scheduling order.
+    QMap<QPair<qint64, quint64>, Entry> _entries{};
+    QHash<quint64, qint64> _deadlines{};
+};
+
+#endif // QWINTOASTCLOCK
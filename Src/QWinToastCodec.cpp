@@ -0,0 +1,308 @@
+#include "QWinToastCodec.h"
+#include "QWinToast.h"
+#include <QDataStream>
+#include <limits.h>
+
+namespace
+{
+	enum Field
+	{
+		TypeField = 1,
+		TextField = 2,
+		ImagePathField = 3,
+		AudioPathField = 4,
+		AttributionField = 5,
+		ScenarioField = 6,
+		AudioOptionField = 7,
+		DurationField = 8,
+		ExpirationField = 9,
+		ActionLabelField = 10,
+		ActionArgumentsField = 11,
+		TagField = 12,
+		GroupField = 13,
+		DigestKeyField = 14
+	};
+
+	enum WireType
+	{
+		VarintWire = 0,
+		Fixed64Wire = 1,
+		BytesWire = 2,
+		Fixed32Wire = 5
+	};
+
+	void putVarint(QByteArray& out, quint64 value)
+	{
+		while (value >= 0x80) {
+			out += static_cast<char>((value & 0x7f) | 0x80);
+			value >>= 7;
+		}
+		out += static_cast<char>(value);
+	}
+
+	void putVarintField(QByteArray& out, int field, quint64 value)
+	{
+		putVarint(out, static_cast<quint64>(field) << 3 | VarintWire);
+		putVarint(out, value);
+	}
+
+	void putStringField(QByteArray& out, int field, const QString& value)
+	{
+		const QByteArray utf8 = value.toUtf8();
+		putVarint(out, static_cast<quint64>(field) << 3 | BytesWire);
+		putVarint(out, static_cast<quint64>(utf8.size()));
+		out += utf8;
+	}
+
+	// Optional fields equal to a default template are left out.
+	void putStringFieldIfSet(QByteArray& out, int field, const QString& value)
+	{
+		if (!value.isEmpty()) {
+			putStringField(out, field, value);
+		}
+	}
+
+	// Returns false on truncated or overlong input.
+	bool getVarint(const uchar*& p, const uchar* end, quint64& value)
+	{
+		value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (p == end) {
+				return false;
+			}
+			const uchar byte = *p++;
+			value |= static_cast<quint64>(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	quint64 zigzag(qint64 value)
+	{
+		return (static_cast<quint64>(value) << 1) ^ static_cast<quint64>(value >> 63);
+	}
+
+	qint64 unzigzag(quint64 value)
+	{
+		return static_cast<qint64>(value >> 1) ^ -static_cast<qint64>(value & 1);
+	}
+}
+
+void QWinToastCodec::append(QByteArray& out, const QWinToastTemplate& toast)
+{
+	QByteArray body;
+	body.reserve(128);
+	body += static_cast<char>(Version);
+	putVarintField(body, TypeField, static_cast<quint64>(toast._type));
+	for (const QString& text : toast._textFields) {
+		putStringField(body, TextField, text);
+	}
+	putStringFieldIfSet(body, ImagePathField, toast._imagePath);
+	putStringFieldIfSet(body, AudioPathField, toast._audioPath);
+	putStringFieldIfSet(body, AttributionField, toast._attributionText);
+	putStringField(body, ScenarioField, toast._scenario);
+	if (toast._audioOption != QWinToastTemplate::AudioOption::Default) {
+		putVarintField(body, AudioOptionField, static_cast<quint64>(toast._audioOption));
+	}
+	if (toast._duration != QWinToastTemplate::Duration::System) {
+		putVarintField(body, DurationField, static_cast<quint64>(toast._duration));
+	}
+	if (toast._expiration != 0) {
+		putVarintField(body, ExpirationField, zigzag(toast._expiration));
+	}
+	// Labels and arguments are written in pairs so they line up on decode.
+	for (int i = 0; i < toast._actions.size(); i++) {
+		putStringField(body, ActionLabelField, toast._actions[i]);
+		putStringField(body, ActionArgumentsField, toast._actionArguments.value(i));
+	}
+	putStringFieldIfSet(body, TagField, toast._tag);
+	putStringFieldIfSet(body, GroupField, toast._group);
+	putStringFieldIfSet(body, DigestKeyField, toast._digestKey);
+
+	putVarint(out, static_cast<quint64>(body.size()));
+	out += body;
+}
+
+QByteArray QWinToastCodec::encode(const QWinToastTemplate& toast)
+{
+	QByteArray out;
+	append(out, toast);
+	return out;
+}
+
+int QWinToastCodec::decode(const char* data, int size, QWinToastTemplate& toast)
+{
+	const uchar* p = reinterpret_cast<const uchar*>(data);
+	const uchar* const end = p + size;
+	quint64 length = 0;
+	if (!getVarint(p, end, length)) {
+		// A truncated prefix is incomplete; ten bytes without a terminator is not.
+		return size >= 10 ? -1 : 0;
+	}
+	if (length == 0 || length > static_cast<quint64>(INT_MAX)) {
+		return -1;
+	}
+	if (static_cast<quint64>(end - p) < length) {
+		return 0;
+	}
+	const uchar* const bodyEnd = p + length;
+	const int consumed = static_cast<int>(bodyEnd - reinterpret_cast<const uchar*>(data));
+	if (*p++ != Version) {
+		return -1;
+	}
+
+	QWinToastTemplate result(QWinToastTemplate::Text01);
+	result._textFields.clear();
+	while (p != bodyEnd) {
+		quint64 key = 0;
+		if (!getVarint(p, bodyEnd, key)) {
+			return -1;
+		}
+		const int field = static_cast<int>(key >> 3);
+		const int wire = static_cast<int>(key & 7);
+		quint64 number = 0;
+		const uchar* bytes = nullptr;
+		quint64 byteCount = 0;
+		if (wire == VarintWire) {
+			if (!getVarint(p, bodyEnd, number)) {
+				return -1;
+			}
+		}
+		else if (wire == BytesWire) {
+			if (!getVarint(p, bodyEnd, byteCount) || static_cast<quint64>(bodyEnd - p) < byteCount) {
+				return -1;
+			}
+			bytes = p;
+			p += byteCount;
+		}
+		else if (wire == Fixed64Wire || wire == Fixed32Wire) {
+			// Not used by any field yet; skipped whatever the number.
+			const int width = wire == Fixed64Wire ? 8 : 4;
+			if (bodyEnd - p < width) {
+				return -1;
+			}
+			p += width;
+			continue;
+		}
+		else {
+			return -1;
+		}
+
+		// Fields with an unknown number or an unexpected wire type come from
+		// newer writers and are skipped.
+		if (wire == VarintWire) {
+			switch (field) {
+			case TypeField:
+				if (number > QWinToastTemplate::Text04) {
+					return -1;
+				}
+				result._type = static_cast<QWinToastTemplate::WinToastTemplateType>(number);
+				break;
+			case AudioOptionField:
+				if (number <= QWinToastTemplate::Loop) {
+					result._audioOption = static_cast<QWinToastTemplate::AudioOption>(number);
+				}
+				break;
+			case DurationField:
+				if (number <= QWinToastTemplate::Long) {
+					result._duration = static_cast<QWinToastTemplate::Duration>(number);
+				}
+				break;
+			case ExpirationField:
+				result._expiration = unzigzag(number);
+				break;
+			}
+			continue;
+		}
+
+		QString* target = nullptr;
+		switch (field) {
+		case TextField:
+			if (result._textFields.size() < 3) {
+				result._textFields.append(QString());
+				target = &result._textFields.last();
+			}
+			break;
+		case ImagePathField: target = &result._imagePath; break;
+		case AudioPathField: target = &result._audioPath; break;
+		case AttributionField: target = &result._attributionText; break;
+		case ScenarioField: target = &result._scenario; break;
+		case ActionLabelField:
+			result._actions.append(QString());
+			target = &result._actions.last();
+			break;
+		case ActionArgumentsField:
+			if (result._actionArguments.size() < result._actions.size()) {
+				result._actionArguments.append(QString());
+				target = &result._actionArguments.last();
+			}
+			break;
+		case TagField: target = &result._tag; break;
+		case GroupField: target = &result._group; break;
+		case DigestKeyField: target = &result._digestKey; break;
+		}
+		if (target) {
+			// Decoded straight out of the input buffer.
+			*target = QString::fromUtf8(reinterpret_cast<const char*>(bytes), static_cast<int>(byteCount));
+		}
+	}
+
+	// Keep the text field count consistent with the template type.
+	const int expected = static_cast<int>(QWinToastTemplate(result._type).textFieldsCount());
+	result._textFields.resize(expected);
+	result._actionArguments.resize(result._actions.size());
+	toast = result;
+	return consumed;
+}
+
+bool QWinToastCodec::decode(const QByteArray& data, QWinToastTemplate& toast)
+{
+	return decode(data.constData(), data.size(), toast) == data.size();
+}
+
+QDataStream& operator<<(QDataStream& out, const QWinToastTemplate& toast)
+{
+	const QByteArray record = QWinToastCodec::encode(toast);
+	out.writeRawData(record.constData(), record.size());
+	return out;
+}
+
+QDataStream& operator>>(QDataStream& in, QWinToastTemplate& toast)
+{
+	// Read the varint prefix byte by byte, then the body in one go.
+	QByteArray record;
+	record.reserve(256);
+	quint64 length = 0;
+	for (int shift = 0; ; shift += 7) {
+		quint8 byte = 0;
+		in >> byte;
+		if (in.status() != QDataStream::Ok) {
+			return in;
+		}
+		record += static_cast<char>(byte);
+		length |= static_cast<quint64>(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			break;
+		}
+		if (shift >= 63) {
+			in.setStatus(QDataStream::ReadCorruptData);
+			return in;
+		}
+	}
+	if (length > 16 * 1024 * 1024) {
+		in.setStatus(QDataStream::ReadCorruptData);
+		return in;
+	}
+	const int prefix = record.size();
+	record.resize(prefix + static_cast<int>(length));
+	if (in.readRawData(record.data() + prefix, static_cast<int>(length)) != static_cast<int>(length)) {
+		in.setStatus(QDataStream::ReadPastEnd);
+		return in;
+	}
+	if (!QWinToastCodec::decode(record, toast)) {
+		in.setStatus(QDataStream::ReadCorruptData);
+	}
+	return in;
+}
@@ -0,0 +1,39 @@
+#ifndef QWINTOASTCODEC
+#define QWINTOASTCODEC
+
+#include <QByteArray>
+
+class QDataStream;
+class QWinToastTemplate;
+
+// Compact binary form of QWinToastTemplate for IPC and persistence.
+//
+// A record is a varint body length followed by the body: one version byte and
+// a sequence of fields. Each field starts with a varint key (number << 3 |
+// wire type), wire type 0 carrying a varint, 1 eight bytes, 2 a varint length
+// plus bytes and 5 four bytes, as in protobuf. Only 0 and 2 are written today.
+// Strings are UTF-8. Decoders skip field numbers and wire types they do not
+// know, so new fields can be added without bumping the version; the group
+// wire types 3 and 4 and the unassigned 6 and 7 have no known length and make
+// the record malformed. Text providers are not encoded; resolve them first to
+// keep their text.
+class QWinToastCodec
+{
+public:
+    static const quint8 Version = 1;
+
+    // Appends one length-prefixed record.
+    static void append(QByteArray& out, const QWinToastTemplate& toast);
+    static QByteArray encode(const QWinToastTemplate& toast);
+
+    // Decodes one record straight from [data, data + size). Returns the number
+    // of bytes consumed, 0 when the record is incomplete and -1 when it is
+    // malformed or of an unsupported version.
+    static int decode(const char* data, int size, QWinToastTemplate& toast);
+    static bool decode(const QByteArray& data, QWinToastTemplate& toast);
+};
+
+QDataStream& operator<<(QDataStream& out, const QWinToastTemplate& toast);
+QDataStream& operator>>(QDataStream& in, QWinToastTemplate& toast);
+
+#endif // QWINTOASTCODEC
@@ -0,0 +1,140 @@
+#include "QWinToastDaemonClient.h"
+#include "QWinToastCodec.h"
+#include "QWinToastFrame.h"
+#include <QDataStream>
+
+QWinToastDaemonClient::QWinToastDaemonClient(QObject* parent) :
+	QObject(parent),
+	_socket(new QLocalSocket(this))
+{
+	connect(_socket, &QLocalSocket::readyRead, this, &QWinToastDaemonClient::readDaemon);
+	connect(_socket, &QLocalSocket::disconnected, this, &QWinToastDaemonClient::disconnected);
+}
+
+QWinToastDaemonClient::~QWinToastDaemonClient()
+{
+}
+
+bool QWinToastDaemonClient::connectToDaemon(const QString& name, int timeoutMilliseconds)
+{
+	_socket->abort();
+	_buffer.clear();
+	_socket->connectToServer(name);
+	return _socket->waitForConnected(timeoutMilliseconds);
+}
+
+bool QWinToastDaemonClient::isConnected() const
+{
+	return _socket->state() == QLocalSocket::ConnectedState;
+}
+
+qint64 QWinToastDaemonClient::show(const QWinToastTemplate& toast)
+{
+	if (!isConnected()) {
+		return -1;
+	}
+	const qint64 request = _nextRequest++;
+	QByteArray payload;
+	QDataStream out(&payload, QIODevice::WriteOnly);
+	if (toast.pendingTextProviders() > 0) {
+		QWinToastTemplate resolved(toast);
+		resolved.resolveTextProviders();
+		out << request << QWinToastCodec::encode(resolved);
+	}
+	else {
+		out << request << QWinToastCodec::encode(toast);
+	}
+	send(QWinToastFrame::Show, payload);
+	return request;
+}
+
+void QWinToastDaemonClient::hide(qint64 requestId)
+{
+	QByteArray payload;
+	QDataStream out(&payload, QIODevice::WriteOnly);
+	out << requestId;
+	send(QWinToastFrame::Hide, payload);
+}
+
+void QWinToastDaemonClient::clear()
+{
+	send(QWinToastFrame::Clear, QByteArray());
+}
+
+bool QWinToastDaemonClient::flush(int timeoutMilliseconds)
+{
+	while (_socket->bytesToWrite() > 0) {
+		if (!_socket->waitForBytesWritten(timeoutMilliseconds)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void QWinToastDaemonClient::send(quint8 type, const QByteArray& payload)
+{
+	if (!isConnected()) {
+		return;
+	}
+	QByteArray frame;
+	QWinToastFrame::append(frame, type, payload);
+	_socket->write(frame);
+}
+
+void QWinToastDaemonClient::readDaemon()
+{
+	_buffer += _socket->readAll();
+	quint8 type;
+	QByteArray payload;
+	for (;;) {
+		const QWinToastFrame::Result result = QWinToastFrame::take(_buffer, type, payload);
+		if (result == QWinToastFrame::Incomplete) {
+			break;
+		}
+		if (result == QWinToastFrame::Malformed) {
+			_socket->abort();
+			break;
+		}
+		handleFrame(type, payload);
+	}
+}
+
+void QWinToastDaemonClient::handleFrame(quint8 type, const QByteArray& payload)
+{
+	QDataStream in(payload);
+	qint64 request = -1;
+	in >> request;
+	switch (type) {
+	case QWinToastFrame::Activated: {
+		QString arguments;
+		in >> arguments;
+		if (in.status() == QDataStream::Ok) {
+			emit activated(request, QWinToastArgumentsView(arguments).actionIndex(), arguments);
+		}
+		break;
+	}
+	case QWinToastFrame::Dismissed: {
+		qint32 reason = 0;
+		in >> reason;
+		if (in.status() == QDataStream::Ok) {
+			emit dismissed(request, static_cast<QWinToast::WinToastDismissalReason>(reason));
+		}
+		break;
+	}
+	case QWinToastFrame::Failed:
+		if (in.status() == QDataStream::Ok) {
+			emit failed(request);
+		}
+		break;
+	case QWinToastFrame::Rejected: {
+		qint32 error = 0;
+		in >> error;
+		if (in.status() == QDataStream::Ok) {
+			emit rejected(request, static_cast<QWinToast::QWinToastError>(error));
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
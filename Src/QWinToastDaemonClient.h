@@ -0,0 +1,55 @@
+#ifndef QWINTOASTDAEMONCLIENT
+#define QWINTOASTDAEMONCLIENT
+
+#include "QWinToast.h"
+#include <QLocalSocket>
+
+// Raises toasts through a running qwintoastd, so a tool needs neither COM nor
+// a shortcut of its own. Requests are pipelined: show() returns a request id
+// right away and the outcome arrives later as exactly one of activated(),
+// dismissed(), failed() or rejected().
+//
+// Frames, see QWinToastFrame; payloads are QDataStream encoded:
+//   Show       qint64 request, QByteArray QWinToastCodec record
+//   Hide       qint64 request
+//   Clear      (empty) hides every live toast of this client
+//   Activated  qint64 request, QString arguments
+//   Dismissed  qint64 request, qint32 WinToastDismissalReason
+//   Failed     qint64 request
+//   Rejected   qint64 request, qint32 QWinToastError
+class QWinToastDaemonClient : public QObject
+{
+    Q_OBJECT
+public:
+    explicit QWinToastDaemonClient(QObject* parent = nullptr);
+    ~QWinToastDaemonClient() override;
+
+    bool connectToDaemon(const QString& name = QStringLiteral("qwintoastd"), int timeoutMilliseconds = 1000);
+    bool isConnected() const;
+    // Text providers are resolved here; the daemon only sees their text.
+    // Returns -1 when not connected.
+    qint64 show(const QWinToastTemplate& toast);
+    void hide(qint64 requestId);
+    void clear();
+    // For tools that exit right after show(): waits until everything queued
+    // has been handed to the daemon.
+    bool flush(int timeoutMilliseconds = 1000);
+
+signals:
+    void activated(qint64 requestId, int actionIndex, const QString& arguments);
+    void dismissed(qint64 requestId, QWinToast::WinToastDismissalReason reason);
+    void failed(qint64 requestId);
+    void rejected(qint64 requestId, QWinToast::QWinToastError error);
+    void disconnected();
+
+private:
+    QLocalSocket* _socket;
+    QByteArray _buffer{};
+    qint64 _nextRequest{ 1 };
+
+    void send(quint8 type, const QByteArray& payload);
+    void readDaemon();
+    void handleFrame(quint8 type, const QByteArray& payload);
+};
+
+#endif // QWINTOASTDAEMONCLIENT
@@ -0,0 +1,140 @@
+#include "QWinToastDedupe.h"
+#include "QWinToastCatalog.h"
+#include <algorithm>
+
+namespace
+{
+	// FNV-1a over the UTF-16 code units; separators keep ("ab", "") and ("a", "b") apart.
+	inline void mix(quint64& hash, quint64 value)
+	{
+		hash ^= value;
+		hash *= Q_UINT64_C(1099511628211);
+	}
+
+	inline void mix(quint64& hash, const QString& text)
+	{
+		const ushort* p = text.utf16();
+		for (const ushort* end = p + text.size(); p != end; ++p) {
+			mix(hash, *p);
+		}
+		mix(hash, 0x10000);
+	}
+}
+
+QWinToastDedupe::QWinToastDedupe()
+{
+}
+
+void QWinToastDedupe::setTtl(int milliseconds)
+{
+	QMutexLocker locker(&_mutex);
+	_ttl = qMax(0, milliseconds);
+	if (_ttl == 0) {
+		_bits = QVector<quint64>();
+	}
+	else if (_bits.isEmpty()) {
+		_bits = QVector<quint64>(Buckets * BucketWords, 0);
+	}
+}
+
+int QWinToastDedupe::ttl() const
+{
+	QMutexLocker locker(&_mutex);
+	return _ttl;
+}
+
+bool QWinToastDedupe::isDuplicate(quint64 hash, qint64 now)
+{
+	QMutexLocker locker(&_mutex);
+	if (_ttl == 0) {
+		return false;
+	}
+	rotate(now);
+
+	// Double hashing: probe i lands on h1 + i * h2.
+	const quint32 h1 = static_cast<quint32>(hash);
+	const quint32 h2 = static_cast<quint32>(hash >> 32) | 1;
+	quint32 positions[Probes];
+	for (int i = 0; i < Probes; i++) {
+		positions[i] = (h1 + i * h2) % BucketBits;
+	}
+
+	quint64* bits = _bits.data();
+	for (int bucket = 0; bucket < Buckets; bucket++) {
+		const quint64* words = bits + bucket * BucketWords;
+		bool seen = true;
+		for (int i = 0; i < Probes && seen; i++) {
+			seen = (words[positions[i] / 64] >> (positions[i] % 64)) & 1;
+		}
+		if (seen) {
+			_suppressed++;
+			return true;
+		}
+	}
+
+	quint64* words = bits + _current * BucketWords;
+	for (int i = 0; i < Probes; i++) {
+		words[positions[i] / 64] |= Q_UINT64_C(1) << (positions[i] % 64);
+	}
+	return false;
+}
+
+void QWinToastDedupe::rotate(qint64 now)
+{
+	const qint64 span = qMax<qint64>(1, _ttl / (Buckets - 1));
+	if (now - _bucketStart < span) {
+		return;
+	}
+	const qint64 steps = (now - _bucketStart) / span;
+	for (qint64 i = 0; i < qMin<qint64>(steps, Buckets); i++) {
+		_current = (_current + 1) % Buckets;
+		std::fill_n(_bits.data() + _current * BucketWords, BucketWords, quint64(0));
+	}
+	_bucketStart += steps * span;
+}
+
+void QWinToastDedupe::clear()
+{
+	QMutexLocker locker(&_mutex);
+	_bits.fill(0);
+}
+
+quint64 QWinToastDedupe::suppressedCount() const
+{
+	QMutexLocker locker(&_mutex);
+	return _suppressed;
+}
+
+quint64 QWinToastDedupe::contentHash(const QWinToastTemplate& toast)
+{
+	quint64 hash = Q_UINT64_C(14695981039346656037);
+	mix(hash, toast.type());
+	for (std::size_t i = 0; i < toast.textFieldsCount(); i++) {
+		mix(hash, toast.textField(QWinToastTemplate::TextField(i)));
+	}
+	mix(hash, toast.imagePath());
+	for (std::size_t i = 0; i < toast.actionsCount(); i++) {
+		mix(hash, toast.actionLabel(i));
+		mix(hash, toast.actionArguments(i));
+	}
+	mix(hash, toast.attributionText());
+	mix(hash, toast.audioPath());
+	mix(hash, static_cast<quint64>(toast.audioOption()));
+	mix(hash, toast.scenario());
+	// The same text under another (group, tag) is a different toast.
+	mix(hash, toast.group());
+	mix(hash, toast.tag());
+	return hash;
+}
+
+quint64 QWinToastDedupe::catalogHash(const QWinToastCatalogEntry& entry, const QStringList& values)
+{
+	quint64 hash = Q_UINT64_C(14695981039346656037);
+	mix(hash, QString::fromUtf8(entry.name));
+	mix(hash, QString::fromUtf16(entry.tag));
+	mix(hash, QString::fromUtf16(entry.group));
+	for (const QString& value : values) {
+		mix(hash, value);
+	}
+	return hash;
+}
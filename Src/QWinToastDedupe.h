@@ -0,0 +1,52 @@
+#ifndef QWINTOASTDEDUPE
+#define QWINTOASTDEDUPE
+
+#include "QWinToast.h"
+#include <QMutex>
+#include <QVector>
+
+// Suppresses exact repeats of a toast's content within a time to live. Seen
+// contents go into a ring of Bloom filters, each covering a quarter of the
+// TTL; the oldest is wiped as time moves on, so memory stays fixed at any
+// volume. A repeat up to ttl old is always caught and one up to 5/4 ttl old
+// may be. A false positive, which is rare, drops a toast that was never shown.
+class QWinToastDedupe
+{
+public:
+    QWinToastDedupe();
+
+    // 0 disables deduplication and frees the filters.
+    void setTtl(int milliseconds);
+    int ttl() const;
+
+    // Returns true when the content was seen within the TTL. Otherwise records
+    // it at now. A repeat does not extend the original's TTL.
+    bool isDuplicate(quint64 hash, qint64 now);
+    void clear();
+    quint64 suppressedCount() const;
+
+    // Type, text fields, image, actions, attribution, audio, scenario, group
+    // and tag.
+    // Text providers are not run; their fields hash as empty.
+    static quint64 contentHash(const QWinToastTemplate& toast);
+    // Entry, values, tag and group of a catalog toast.
+    static quint64 catalogHash(const QWinToastCatalogEntry& entry, const QStringList& values);
+
+private:
+    static const int Buckets = 5;
+    static const int BucketBits = 1 << 16;
+    static const int BucketWords = BucketBits / 64;
+    static const int Probes = 4;
+
+    mutable QMutex _mutex;
+    int _ttl{ 0 };
+    int _current{ 0 };
+    qint64 _bucketStart{ 0 };
+    // Buckets * BucketWords bits, empty while disabled.
+    QVector<quint64> _bits{};
+    quint64 _suppressed{ 0 };
+
+    void rotate(qint64 now);
+};
+
+#endif // QWINTOASTDEDUPE
@@ -0,0 +1,106 @@
+#include "QWinToastDigest.h"
+
+QWinToastDigest::QWinToastDigest() :
+	_formatter(&QWinToastDigest::defaultSummary)
+{
+}
+
+void QWinToastDigest::setWindow(int milliseconds)
+{
+	QMutexLocker locker(&_mutex);
+	_window = qMax(0, milliseconds);
+}
+
+int QWinToastDigest::window() const
+{
+	QMutexLocker locker(&_mutex);
+	return _window;
+}
+
+void QWinToastDigest::setFormatter(const Formatter& formatter)
+{
+	QMutexLocker locker(&_mutex);
+	_formatter = formatter ? formatter : Formatter(&QWinToastDigest::defaultSummary);
+}
+
+bool QWinToastDigest::fold(const QString& key, const QWinToastTemplate& toast, qint64& id, QWinToastTemplate& first)
+{
+	QMutexLocker locker(&_mutex);
+	auto it = _bursts.find(key);
+	if (it != _bursts.end()) {
+		it->count++;
+		_folded++;
+		id = it->id;
+		return true;
+	}
+
+	// The first toast is tagged so the summary can replace it in place.
+	first = toast;
+	first.setTag(burstTag(key, toast));
+	if (id < 0) {
+		id = QWinToast::nextToastId();
+	}
+	_bursts.insert(key, Burst{ id, 1, first });
+	return false;
+}
+
+bool QWinToastDigest::take(const QString& key, qint64& id, QWinToastTemplate& summary)
+{
+	QMutexLocker locker(&_mutex);
+	const auto it = _bursts.find(key);
+	if (it == _bursts.end()) {
+		return false;
+	}
+	const Burst burst = it.value();
+	_bursts.erase(it);
+	if (burst.count < 2) {
+		return false;
+	}
+
+	id = burst.id;
+	summary = _formatter(burst.first, burst.count);
+	summary.setTag(burst.first.tag());
+	summary.setGroup(burst.first.group());
+	// Only the first toast of a burst is allowed to make a sound.
+	summary.setAudioOption(QWinToastTemplate::AudioOption::Silent);
+	return true;
+}
+
+void QWinToastDigest::cancel(const QString& key)
+{
+	QMutexLocker locker(&_mutex);
+	_bursts.remove(key);
+}
+
+void QWinToastDigest::clear()
+{
+	QMutexLocker locker(&_mutex);
+	_bursts.clear();
+}
+
+quint64 QWinToastDigest::foldedCount() const
+{
+	QMutexLocker locker(&_mutex);
+	return _folded;
+}
+
+QString QWinToastDigest::burstTag(const QString& key, const QWinToastTemplate& toast)
+{
+	return toast.tag().isEmpty() ? QStringLiteral("digest-") + QString::number(qHash(key), 16) : toast.tag();
+}
+
+QWinToastTemplate QWinToastDigest::defaultSummary(const QWinToastTemplate& first, int count)
+{
+	QWinToastTemplate summary = first;
+	const QString line = QStringLiteral("%1 new notifications").arg(count);
+	if (summary.textFieldsCount() < 2) {
+		summary.resolveTextProviders();
+		summary.setFirstLine(QStringLiteral("%1 (%2)").arg(summary.textField(QWinToastTemplate::FirstLine), line));
+		return summary;
+	}
+	summary.setSecondLine(line);
+	if (summary.textFieldsCount() > 2) {
+		summary.setThirdLine(QString());
+	}
+	return summary;
+}
@@ -0,0 +1,55 @@
+#ifndef QWINTOASTDIGEST
+#define QWINTOASTDIGEST
+
+#include "QWinToast.h"
+#include <QHash>
+#include <QMutex>
+#include <functional>
+
+// Collapses bursts of toasts sharing a digest key. The first toast of a burst
+// is shown right away; later ones inside the window are only counted. When
+// the window closes a silent summary replaces the first toast in place.
+class QWinToastDigest
+{
+public:
+    typedef std::function<QWinToastTemplate(const QWinToastTemplate& first, int count)> Formatter;
+
+    QWinToastDigest();
+
+    // 0 disables digesting.
+    void setWindow(int milliseconds);
+    int window() const;
+    void setFormatter(const Formatter& formatter);
+
+    // Returns true when the toast was folded into a running burst; id is then
+    // the burst's toast id. Otherwise a new burst was opened and the caller
+    // must show the returned first toast with id: the one passed in, normally
+    // that of the live toast the first replaces, or a fresh one when it is -1.
+    bool fold(const QString& key, const QWinToastTemplate& toast, qint64& id, QWinToastTemplate& first);
+    // Closes the burst. Returns true with the summary to show when more than
+    // one toast was folded into it.
+    bool take(const QString& key, qint64& id, QWinToastTemplate& summary);
+    void cancel(const QString& key);
+    void clear();
+    quint64 foldedCount() const;
+
+    // Tag the first toast of a burst is shown with.
+    static QString burstTag(const QString& key, const QWinToastTemplate& toast);
+    static QWinToastTemplate defaultSummary(const QWinToastTemplate& first, int count);
+
+private:
+    struct Burst
+    {
+        qint64 id;
+        int count;
+        QWinToastTemplate first;
+    };
+
+    mutable QMutex _mutex;
+    int _window{ 0 };
+    Formatter _formatter;
+    QHash<QString, Burst> _bursts{};
+    quint64 _folded{ 0 };
+};
+
+#endif // QWINTOASTDIGEST
@@ -0,0 +1,57 @@
+#include "QWinToastEventQueue.h"
+#include "QWinToastClock.h"
+
+// Intrusive MPSC queue after Vyukov: producers swap the head and then link the
+// previous node, the consumer follows next pointers from a stub node.
+
+QWinToastEventQueue::QWinToastEventQueue() :
+	_head(new Node{ {}, QWinToastEvent{} }),
+	_tail(_head.loadAcquire())
+{
+}
+
+QWinToastEventQueue::~QWinToastEventQueue()
+{
+	QWinToastEvent event;
+	while (pop(event)) {
+	}
+	delete _tail;
+}
+
+bool QWinToastEventQueue::push(QWinToastEvent&& event)
+{
+	Node* node = new Node{ {}, std::move(event) };
+	Node* previous = _head.fetchAndStoreOrdered(node);
+	previous->next.storeRelease(node);
+	return _scheduled.testAndSetOrdered(0, 1);
+}
+
+void QWinToastEventQueue::beginDrain()
+{
+	// Cleared before popping so an event pushed from now on schedules a new drain.
+	_scheduled.fetchAndStoreOrdered(0);
+}
+
+bool QWinToastEventQueue::reschedule()
+{
+	return _scheduled.testAndSetOrdered(0, 1);
+}
+
+bool QWinToastEventQueue::pop(QWinToastEvent& event)
+{
+	Node* tail = _tail;
+	Node* next = tail->next.loadAcquire();
+	if (!next) {
+		return false;
+	}
+	// next becomes the new stub; its payload moves out.
+	event = std::move(next->event);
+	_tail = next;
+	delete tail;
+	return true;
+}
+
+qint64 QWinToastEventQueue::timestamp()
+{
+	return QWinToastClock::system()->timestamp();
+}
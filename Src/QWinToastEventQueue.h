@@ -0,0 +1,60 @@
+#ifndef QWINTOASTEVENTQUEUE
+#define QWINTOASTEVENTQUEUE
+
+#include <QAtomicInteger>
+#include <QAtomicPointer>
+#include <QString>
+
+struct QWinToastEvent
+{
+    enum Type
+    {
+        Activated = 0,
+        Dismissed,
+        Failed
+    };
+
+    Type type;
+    qint64 id;
+    // QWinToast::WinToastDismissalReason for Dismissed events.
+    int reason;
+    QString arguments;
+    // QWinToastClock::timestamp() of the toast's clock when the event was queued.
+    qint64 timestamp;
+};
+
+// Lock-free multi-producer, single-consumer queue of toast events. Any thread
+// may push; only the thread that owns the QWinToast pops. push() reports when
+// the consumer has to be woken, so one wake-up covers a whole batch.
+class QWinToastEventQueue
+{
+public:
+    QWinToastEventQueue();
+    ~QWinToastEventQueue();
+
+    // Returns true when no drain is pending and the caller must schedule one.
+    bool push(QWinToastEvent&& event);
+    // Called by the consumer before it starts popping.
+    void beginDrain();
+    // Called by the consumer when it stops early; same contract as push().
+    bool reschedule();
+    bool pop(QWinToastEvent& event);
+
+    // The system clock's timestamp(), for code without a toast at hand.
+    static qint64 timestamp();
+
+private:
+    struct Node
+    {
+        QAtomicPointer<Node> next;
+        QWinToastEvent event;
+    };
+
+    QAtomicPointer<Node> _head;
+    Node* _tail;
+    QAtomicInteger<int> _scheduled{ 0 };
+
+    Q_DISABLE_COPY(QWinToastEventQueue)
+};
+
+#endif // QWINTOASTEVENTQUEUE
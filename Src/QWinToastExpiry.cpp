@@ -0,0 +1,155 @@
+#include "QWinToastExpiry.h"
+
+void QWinToastExpiryIndex::insert(qint64 id, qint64 deadline)
+{
+	const auto it = _positions.constFind(id);
+	if (it != _positions.constEnd()) {
+		const int index = it.value();
+		const qint64 previous = _heap[index].deadline;
+		_heap[index].deadline = deadline;
+		if (deadline < previous) {
+			siftUp(index);
+		}
+		else {
+			siftDown(index);
+		}
+		return;
+	}
+	_heap.append(Entry{ deadline, id });
+	_positions.insert(id, _heap.size() - 1);
+	siftUp(_heap.size() - 1);
+}
+
+bool QWinToastExpiryIndex::remove(qint64 id)
+{
+	const auto it = _positions.constFind(id);
+	if (it == _positions.constEnd()) {
+		return false;
+	}
+	removeAt(it.value());
+	return true;
+}
+
+int QWinToastExpiryIndex::removeAll(const QSet<qint64>& ids)
+{
+	// Below this share of the heap, k removals at O(log n) beat one rebuild.
+	if (ids.size() * 8 < _heap.size()) {
+		int removed = 0;
+		for (const qint64 id : ids) {
+			removed += remove(id) ? 1 : 0;
+		}
+		return removed;
+	}
+
+	const int before = _heap.size();
+	QVector<Entry> kept;
+	kept.reserve(before);
+	for (const Entry& entry : _heap) {
+		if (!ids.contains(entry.id)) {
+			kept.append(entry);
+		}
+	}
+	_heap.swap(kept);
+	_positions.clear();
+	_positions.reserve(_heap.size());
+	for (int i = 0; i < _heap.size(); i++) {
+		_positions.insert(_heap[i].id, i);
+	}
+	for (int i = _heap.size() / 2 - 1; i >= 0; i--) {
+		siftDown(i);
+	}
+	return before - _heap.size();
+}
+
+bool QWinToastExpiryIndex::contains(qint64 id) const
+{
+	return _positions.contains(id);
+}
+
+qint64 QWinToastExpiryIndex::deadline(qint64 id) const
+{
+	const auto it = _positions.constFind(id);
+	return it == _positions.constEnd() ? -1 : _heap[it.value()].deadline;
+}
+
+qint64 QWinToastExpiryIndex::nextDeadline() const
+{
+	return _heap.isEmpty() ? -1 : _heap.first().deadline;
+}
+
+bool QWinToastExpiryIndex::popExpired(qint64 now, qint64& id)
+{
+	if (_heap.isEmpty() || _heap.first().deadline > now) {
+		return false;
+	}
+	id = _heap.first().id;
+	removeAt(0);
+	return true;
+}
+
+int QWinToastExpiryIndex::size() const
+{
+	return _heap.size();
+}
+
+void QWinToastExpiryIndex::clear()
+{
+	_heap.clear();
+	_positions.clear();
+}
+
+void QWinToastExpiryIndex::place(int index, const Entry& entry)
+{
+	_heap[index] = entry;
+	_positions[entry.id] = index;
+}
+
+void QWinToastExpiryIndex::siftUp(int index)
+{
+	const Entry entry = _heap[index];
+	while (index > 0) {
+		const int parent = (index - 1) / 2;
+		if (_heap[parent].deadline <= entry.deadline) {
+			break;
+		}
+		place(index, _heap[parent]);
+		index = parent;
+	}
+	place(index, entry);
+}
+
+void QWinToastExpiryIndex::siftDown(int index)
+{
+	const Entry entry = _heap[index];
+	const int count = _heap.size();
+	for (;;) {
+		int child = 2 * index + 1;
+		if (child >= count) {
+			break;
+		}
+		if (child + 1 < count && _heap[child + 1].deadline < _heap[child].deadline) {
+			child++;
+		}
+		if (entry.deadline <= _heap[child].deadline) {
+			break;
+		}
+		place(index, _heap[child]);
+		index = child;
+	}
+	place(index, entry);
+}
+
+void QWinToastExpiryIndex::removeAt(int index)
+{
+	_positions.remove(_heap[index].id);
+	const int last = _heap.size() - 1;
+	if (index == last) {
+		_heap.removeLast();
+		return;
+	}
+	const Entry moved = _heap[last];
+	_heap.removeLast();
+	place(index, moved);
+	siftUp(index);
+	siftDown(_positions.value(moved.id));
+}
@@ -0,0 +1,46 @@
+#ifndef QWINTOASTEXPIRY
+#define QWINTOASTEXPIRY
+
+#include <QHash>
+#include <QSet>
+#include <QVector>
+
+// Indexed binary min-heap of toast deadlines. Deadlines are milliseconds on a
+// monotonic clock chosen by the owner. Insert, update and remove are
+// O(log n); the earliest deadline is O(1). Not thread-safe.
+class QWinToastExpiryIndex
+{
+public:
+    // Inserts the id or moves its existing deadline.
+    void insert(qint64 id, qint64 deadline);
+    bool remove(qint64 id);
+    // Removes many ids at once, rebuilding the heap in O(n) when that is
+    // cheaper than removing them one by one. Returns how many were indexed.
+    int removeAll(const QSet<qint64>& ids);
+    bool contains(qint64 id) const;
+    // -1 when the id is not indexed.
+    qint64 deadline(qint64 id) const;
+    // -1 when empty.
+    qint64 nextDeadline() const;
+    // Pops the earliest entry if its deadline is at or before now.
+    bool popExpired(qint64 now, qint64& id);
+    int size() const;
+    void clear();
+
+private:
+    struct Entry
+    {
+        qint64 deadline;
+        qint64 id;
+    };
+
+    QVector<Entry> _heap{};
+    QHash<qint64, int> _positions{};
+
+    void place(int index, const Entry& entry);
+    void siftUp(int index);
+    void siftDown(int index);
+    void removeAt(int index);
+};
+
+#endif // QWINTOASTEXPIRY
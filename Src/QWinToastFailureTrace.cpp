@@ -0,0 +1,99 @@
+#include "QWinToastFailureTrace.h"
+#include "QWinToastEventQueue.h"
+#include <algorithm>
+
+QWinToastFailureTrace* QWinToastFailureTrace::global()
+{
+	static QWinToastFailureTrace trace;
+	return &trace;
+}
+
+void QWinToastFailureTrace::record(QWinToastFailure::Stage stage, qint32 result, qint64 id, quint32 templateHash, qint64 elapsed)
+{
+	const quint64 sequence = _next.fetchAndAddRelaxed(1);
+	Slot& slot = _slots[sequence % Capacity];
+	const quint32 state = slot.state.loadAcquire();
+	// Another writer lapped the ring and still owns this slot.
+	if ((state & 1) || !slot.state.testAndSetAcquire(state, state + 1)) {
+		_dropped.fetchAndAddRelaxed(1);
+		return;
+	}
+	// Release stores so a reader that sees any new field also sees the odd state.
+	slot.sequence.storeRelease(sequence);
+	slot.stage.storeRelease(stage);
+	slot.result.storeRelease(result);
+	slot.id.storeRelease(id);
+	slot.templateHash.storeRelease(templateHash);
+	slot.elapsed.storeRelease(elapsed);
+	slot.timestamp.storeRelease(QWinToastEventQueue::timestamp());
+	slot.state.storeRelease(state + 2);
+}
+
+QVector<QWinToastFailure> QWinToastFailureTrace::snapshot() const
+{
+	QVector<QWinToastFailure> failures;
+	failures.reserve(Capacity);
+	for (const Slot& slot : _slots) {
+		const quint32 before = slot.state.loadAcquire();
+		if (before == 0 || (before & 1)) {
+			continue;
+		}
+		QWinToastFailure failure;
+		failure.sequence = slot.sequence.loadAcquire();
+		failure.stage = QWinToastFailure::Stage(slot.stage.loadAcquire());
+		failure.result = slot.result.loadAcquire();
+		failure.id = slot.id.loadAcquire();
+		failure.templateHash = slot.templateHash.loadAcquire();
+		failure.elapsed = slot.elapsed.loadAcquire();
+		failure.timestamp = slot.timestamp.loadAcquire();
+		if (slot.state.loadAcquire() == before) {
+			failures.append(failure);
+		}
+	}
+	std::sort(failures.begin(), failures.end(), [](const QWinToastFailure& a, const QWinToastFailure& b) {
+		return a.sequence < b.sequence;
+	});
+	return failures;
+}
+
+QString QWinToastFailureTrace::dump() const
+{
+	QString out;
+	for (const QWinToastFailure& failure : snapshot()) {
+		out += QString("#%1 %2 hr=0x%3 id=%4 template=%5 elapsed=%6us\n")
+			.arg(failure.sequence)
+			.arg(QLatin1String(stageName(failure.stage)))
+			.arg(quint32(failure.result), 8, 16, QLatin1Char('0'))
+			.arg(failure.id)
+			.arg(failure.templateHash, 8, 16, QLatin1Char('0'))
+			.arg(QString::number(failure.elapsed / 1000.0, 'f', 1));
+	}
+	return out;
+}
+
+quint64 QWinToastFailureTrace::recorded() const
+{
+	return _next.loadAcquire();
+}
+
+quint64 QWinToastFailureTrace::dropped() const
+{
+	return _dropped.loadAcquire();
+}
+
+const char* QWinToastFailureTrace::stageName(QWinToastFailure::Stage stage)
+{
+	switch (stage) {
+	case QWinToastFailure::Notifier: return "notifier";
+	case QWinToastFailure::LoadXml: return "load-xml";
+	case QWinToastFailure::CreateNotification: return "create-notification";
+	case QWinToastFailure::Expiration: return "expiration";
+	case QWinToastFailure::Tag: return "tag";
+	case QWinToastFailure::Group: return "group";
+	case QWinToastFailure::EventHandlers: return "event-handlers";
+	case QWinToastFailure::Show: return "show";
+	case QWinToastFailure::Hide: return "hide";
+	case QWinToastFailure::Delivery: return "delivery";
+	default: return "unknown";
+	}
+}
@@ -0,0 +1,87 @@
+#ifndef QWINTOASTFAILURETRACE
+#define QWINTOASTFAILURETRACE
+
+#include <QAtomicInteger>
+#include <QString>
+#include <QVector>
+
+// One failed step of showing or managing a toast.
+struct QWinToastFailure
+{
+    enum Stage
+    {
+        Unknown = 0,
+        Notifier,
+        LoadXml,
+        CreateNotification,
+        Expiration,
+        Tag,
+        Group,
+        EventHandlers,
+        Show,
+        Hide,
+        // Reported by the host after a successful show().
+        Delivery
+    };
+
+    // Position in the trace; increases by one per recorded failure.
+    quint64 sequence;
+    Stage stage;
+    // The backend's HRESULT-compatible result.
+    qint32 result;
+    qint64 id;
+    // qHash of the toast payload, so repeated failures of one template line up;
+    // 0 where the payload is no longer at hand.
+    quint32 templateHash;
+    // Nanoseconds from the start of the failing call to the failure.
+    qint64 elapsed;
+    // System clock timestamp(); the trace is process-wide and not tied to
+    // any toast's clock.
+    qint64 timestamp;
+};
+
+// Fixed-size, lock-free ring of the most recent failures across the process.
+// record() never allocates and never blocks; a writer that would overwrite a
+// slot still being written by another drops its record instead. Nothing is
+// touched on the success path.
+class QWinToastFailureTrace
+{
+public:
+    static const int Capacity = 256;
+
+    static QWinToastFailureTrace* global();
+
+    void record(QWinToastFailure::Stage stage, qint32 result, qint64 id, quint32 templateHash, qint64 elapsed);
+    // The retained failures, oldest first. Records being written are skipped.
+    QVector<QWinToastFailure> snapshot() const;
+    // One line per retained failure.
+    QString dump() const;
+    quint64 recorded() const;
+    quint64 dropped() const;
+
+    static const char* stageName(QWinToastFailure::Stage stage);
+
+private:
+    QWinToastFailureTrace() = default;
+
+    // Even while stable, odd while a writer owns it; 0 until first written.
+    struct Slot
+    {
+        QAtomicInteger<quint32> state{ 0 };
+        QAtomicInteger<quint64> sequence{ 0 };
+        QAtomicInteger<quint32> stage{ 0 };
+        QAtomicInteger<qint32> result{ 0 };
+        QAtomicInteger<qint64> id{ 0 };
+        QAtomicInteger<quint32> templateHash{ 0 };
+        QAtomicInteger<qint64> elapsed{ 0 };
+        QAtomicInteger<qint64> timestamp{ 0 };
+    };
+
+    QAtomicInteger<quint64> _next{ 0 };
+    QAtomicInteger<quint64> _dropped{ 0 };
+    Slot _slots[Capacity];
+
+    Q_DISABLE_COPY(QWinToastFailureTrace)
+};
+
+#endif // QWINTOASTFAILURETRACE
@@ -0,0 +1,195 @@
+#include "QWinToastFakeBackend.h"
+#include "QWinToastFailureTrace.h"
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QThread>
+
+QWinToastFakeBackend::QWinToastFakeBackend()
+{
+}
+
+QWinToastFakeBackend::~QWinToastFakeBackend()
+{
+}
+
+bool QWinToastFakeBackend::initialize(QWinToast*, QWinToast::QWinToastError* error)
+{
+	if (error) {
+		*error = QWinToast::NoError;
+	}
+	return true;
+}
+
+QWinToastBackend::Result QWinToastFakeBackend::show(QWinToast* toast, const Request& request)
+{
+	QElapsedTimer started;
+	started.start();
+	int minLatency, maxLatency;
+	double failureRate;
+	Result failureResult;
+	{
+		QMutexLocker locker(&_mutex);
+		minLatency = _minLatency;
+		maxLatency = _maxLatency;
+		failureRate = _failureRate;
+		failureResult = _failureResult;
+	}
+
+	if (maxLatency > 0) {
+		const int latency = maxLatency > minLatency
+			? QRandomGenerator::global()->bounded(minLatency, maxLatency + 1) : maxLatency;
+		QThread::usleep(static_cast<unsigned long>(latency));
+	}
+	if (failureRate > 0.0 && QRandomGenerator::global()->generateDouble() < failureRate) {
+		QWinToastFailureTrace::global()->record(QWinToastFailure::Show, failureResult, request.id,
+			qHash(request.xml), started.nsecsElapsed());
+		return failureResult;
+	}
+
+	QMutexLocker locker(&_mutex);
+	_live.insert(request.id, toast);
+	++_payloadCount;
+	if (_recordPayloads) {
+		_payloads.append(Payload{ toast, request });
+	}
+	return Ok;
+}
+
+bool QWinToastFakeBackend::hide(QWinToast*, qint64 id)
+{
+	QMutexLocker locker(&_mutex);
+	return _live.remove(id) > 0;
+}
+
+void QWinToastFakeBackend::release(QWinToast*, qint64 id)
+{
+	QMutexLocker locker(&_mutex);
+	_live.remove(id);
+}
+
+void QWinToastFakeBackend::clear(QWinToast* toast, const QVector<qint64>& ids)
+{
+	QMutexLocker locker(&_mutex);
+	for (const qint64 id : ids) {
+		auto it = _live.find(id);
+		if (it != _live.end() && it.value() == toast) {
+			_live.erase(it);
+		}
+	}
+}
+
+void QWinToastFakeBackend::detach(QWinToast* toast)
+{
+	QMutexLocker locker(&_mutex);
+	for (auto it = _live.begin(); it != _live.end();) {
+		if (it.value() == toast) {
+			it = _live.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+void QWinToastFakeBackend::setLatency(int minMicroseconds, int maxMicroseconds)
+{
+	QMutexLocker locker(&_mutex);
+	_minLatency = qMax(0, minMicroseconds);
+	_maxLatency = qMax(_minLatency, maxMicroseconds);
+}
+
+void QWinToastFakeBackend::setFailureRate(double rate)
+{
+	QMutexLocker locker(&_mutex);
+	_failureRate = qBound(0.0, rate, 1.0);
+}
+
+void QWinToastFakeBackend::setFailureResult(Result result)
+{
+	QMutexLocker locker(&_mutex);
+	_failureResult = result;
+}
+
+void QWinToastFakeBackend::setRecordPayloads(bool record)
+{
+	QMutexLocker locker(&_mutex);
+	_recordPayloads = record;
+}
+
+QVector<QWinToastFakeBackend::Payload> QWinToastFakeBackend::payloads() const
+{
+	QMutexLocker locker(&_mutex);
+	return _payloads;
+}
+
+QWinToastFakeBackend::Payload QWinToastFakeBackend::lastPayload() const
+{
+	QMutexLocker locker(&_mutex);
+	return _payloads.isEmpty() ? Payload{ nullptr, Request{ -1, 0, QString(), QString(), QString() } } : _payloads.last();
+}
+
+int QWinToastFakeBackend::payloadCount() const
+{
+	QMutexLocker locker(&_mutex);
+	return _payloadCount;
+}
+
+void QWinToastFakeBackend::clearPayloads()
+{
+	QMutexLocker locker(&_mutex);
+	_payloads.clear();
+	_payloadCount = 0;
+}
+
+QVector<qint64> QWinToastFakeBackend::liveToasts() const
+{
+	QMutexLocker locker(&_mutex);
+	return _live.keys().toVector();
+}
+
+bool QWinToastFakeBackend::isLive(qint64 id) const
+{
+	QMutexLocker locker(&_mutex);
+	return _live.contains(id);
+}
+
+bool QWinToastFakeBackend::activate(qint64 id, const QString& arguments)
+{
+	// Posted under the lock, like every event below, so detach() cannot
+	// return while the event is still on its way to a toast being destroyed.
+	QMutexLocker locker(&_mutex);
+	QWinToast* toast = _live.take(id);
+	if (!toast) {
+		return false;
+	}
+	activated(toast, id, arguments);
+	return true;
+}
+
+bool QWinToastFakeBackend::activateAction(qint64 id, int actionIndex)
+{
+	return activate(id, QStringLiteral("a=") + QString::number(actionIndex));
+}
+
+bool QWinToastFakeBackend::dismiss(qint64 id, QWinToast::WinToastDismissalReason reason)
+{
+	QMutexLocker locker(&_mutex);
+	QWinToast* toast = _live.take(id);
+	if (!toast) {
+		return false;
+	}
+	dismissed(toast, id, reason);
+	return true;
+}
+
+bool QWinToastFakeBackend::fail(qint64 id)
+{
+	QMutexLocker locker(&_mutex);
+	QWinToast* toast = _live.take(id);
+	if (!toast) {
+		return false;
+	}
+	QWinToastFailureTrace::global()->record(QWinToastFailure::Delivery, Failed, id, 0, 0);
+	failed(toast, id);
+	return true;
+}
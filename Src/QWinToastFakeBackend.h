@@ -0,0 +1,64 @@
+#ifndef QWINTOASTFAKEBACKEND
+#define QWINTOASTFAKEBACKEND
+
+#include "QWinToast.h"
+#include <QHash>
+#include <QMutex>
+
+// In-process backend that records every payload instead of talking to the
+// shell. Tests and load tools use it to fire activation, dismissal and
+// failure events for any live toast. All members are safe to call from
+// multiple threads; events are queued to the toast's thread.
+class QWinToastFakeBackend : public QWinToastBackend
+{
+public:
+    struct Payload
+    {
+        QWinToast* toast;
+        QWinToastBackend::Request request;
+    };
+
+    QWinToastFakeBackend();
+    ~QWinToastFakeBackend() override;
+
+    bool initialize(QWinToast* toast, QWinToast::QWinToastError* error) override;
+    Result show(QWinToast* toast, const Request& request) override;
+    bool hide(QWinToast* toast, qint64 id) override;
+    void clear(QWinToast* toast, const QVector<qint64>& ids) override;
+    void release(QWinToast* toast, qint64 id) override;
+    void detach(QWinToast* toast) override;
+
+    // Each show() sleeps for a uniformly distributed time in [min, max] microseconds.
+    void setLatency(int minMicroseconds, int maxMicroseconds);
+    // Probability in [0, 1] that show() fails with the failure result.
+    void setFailureRate(double rate);
+    // Failed by default; a transient result such as Pending exercises retries.
+    void setFailureResult(Result result);
+    // Disables payload capture for long running load tests.
+    void setRecordPayloads(bool record);
+
+    QVector<Payload> payloads() const;
+    Payload lastPayload() const;
+    int payloadCount() const;
+    void clearPayloads();
+    QVector<qint64> liveToasts() const;
+    bool isLive(qint64 id) const;
+
+    bool activate(qint64 id, const QString& arguments = QString());
+    bool activateAction(qint64 id, int actionIndex);
+    bool dismiss(qint64 id, QWinToast::WinToastDismissalReason reason);
+    bool fail(qint64 id);
+
+private:
+    mutable QMutex _mutex;
+    QHash<qint64, QWinToast*> _live{};
+    QVector<Payload> _payloads{};
+    int _payloadCount{ 0 };
+    int _minLatency{ 0 };
+    int _maxLatency{ 0 };
+    double _failureRate{ 0.0 };
+    Result _failureResult{ Failed };
+    bool _recordPayloads{ true };
+};
+
+#endif // QWINTOASTFAKEBACKEND
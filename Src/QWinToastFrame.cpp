@@ -0,0 +1,31 @@
+#include "QWinToastFrame.h"
+#include <QtEndian>
+
+void QWinToastFrame::append(QByteArray& out, quint8 type, const QByteArray& payload)
+{
+	const quint32 length = static_cast<quint32>(payload.size()) + 1;
+	char header[5];
+	qToLittleEndian<quint32>(length, header);
+	header[4] = static_cast<char>(type);
+	out.reserve(out.size() + 5 + payload.size());
+	out.append(header, 5);
+	out.append(payload);
+}
+
+QWinToastFrame::Result QWinToastFrame::take(QByteArray& buffer, quint8& type, QByteArray& payload)
+{
+	if (buffer.size() < 4) {
+		return Incomplete;
+	}
+	const quint32 length = qFromLittleEndian<quint32>(buffer.constData());
+	if (length == 0 || length > MaxFrameSize) {
+		return Malformed;
+	}
+	if (static_cast<quint32>(buffer.size()) - 4 < length) {
+		return Incomplete;
+	}
+	type = static_cast<quint8>(buffer.at(4));
+	payload = buffer.mid(5, static_cast<int>(length) - 1);
+	buffer.remove(0, static_cast<int>(length) + 4);
+	return Complete;
+}
@@ -0,0 +1,37 @@
+#ifndef QWINTOASTFRAME
+#define QWINTOASTFRAME
+
+#include <QByteArray>
+
+// Framing shared by the local socket channels and qwintoastd: a little-endian
+// quint32 length covering the type byte and payload, the type byte, then the
+// payload.
+namespace QWinToastFrame
+{
+    enum Type : quint8
+    {
+        Show = 1,
+        Hide = 2,
+        Clear = 3,
+        Activated = 4,
+        Dismissed = 5,
+        Failed = 6,
+        // qwintoastd only: the request was refused before it reached the shell.
+        Rejected = 7
+    };
+
+    enum Result
+    {
+        Malformed = -1,
+        Incomplete = 0,
+        Complete = 1
+    };
+
+    const quint32 MaxFrameSize = 16 * 1024 * 1024;
+
+    void append(QByteArray& out, quint8 type, const QByteArray& payload);
+    // Removes one complete frame from the front of buffer.
+    Result take(QByteArray& buffer, quint8& type, QByteArray& payload);
+}
+
+#endif // QWINTOASTFRAME
@@ -0,0 +1,379 @@
+#include "QWinToastInstance.h"
+#include "QWinToastFrame.h"
+#include <QDataStream>
+#include <QDir>
+#include <QLockFile>
+#include <QPointer>
+#include <QThread>
+
+class QWinToastInstance::ForwardingBackend : public QWinToastBackend
+{
+public:
+	explicit ForwardingBackend(QWinToastInstance* instance) :
+		_instance(instance)
+	{
+	}
+
+	bool initialize(QWinToast*, QWinToast::QWinToastError* error) override
+	{
+		if (error) {
+			*error = QWinToast::NoError;
+		}
+		return true;
+	}
+
+	Result show(QWinToast*, const Request& request) override
+	{
+		QByteArray payload;
+		QDataStream out(&payload, QIODevice::WriteOnly);
+		out << request.id << request.expiration
+			<< request.xml << request.tag << request.group;
+		send(QWinToastFrame::Show, payload);
+		return Ok;
+	}
+
+	bool hide(QWinToast*, qint64 id) override
+	{
+		QByteArray payload;
+		QDataStream out(&payload, QIODevice::WriteOnly);
+		out << id;
+		send(QWinToastFrame::Hide, payload);
+		return true;
+	}
+
+	// The primary hides exactly the toasts this process forwarded.
+	void clear(QWinToast*, const QVector<qint64>&) override
+	{
+		send(QWinToastFrame::Clear, QByteArray());
+	}
+
+	void deliver(quint8 type, const QByteArray& payload)
+	{
+		QDataStream in(payload);
+		qint64 id = -1;
+		in >> id;
+		switch (type) {
+		case QWinToastFrame::Activated: {
+			QString arguments;
+			in >> arguments;
+			if (in.status() == QDataStream::Ok) {
+				activated(_instance->_toast, id, arguments);
+			}
+			break;
+		}
+		case QWinToastFrame::Dismissed: {
+			qint32 reason = 0;
+			in >> reason;
+			if (in.status() == QDataStream::Ok) {
+				dismissed(_instance->_toast, id, static_cast<QWinToast::WinToastDismissalReason>(reason));
+			}
+			break;
+		}
+		case QWinToastFrame::Failed:
+			if (in.status() == QDataStream::Ok) {
+				failed(_instance->_toast, id);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+private:
+	QWinToastInstance* _instance;
+
+	void send(quint8 type, const QByteArray& payload)
+	{
+		if (QThread::currentThread() == _instance->thread()) {
+			_instance->sendToPrimary(type, payload);
+			return;
+		}
+		QPointer<QWinToastInstance> instance(_instance);
+		QMetaObject::invokeMethod(_instance, [instance, type, payload]() {
+			if (instance) {
+				instance->sendToPrimary(type, payload);
+			}
+		}, Qt::QueuedConnection);
+	}
+};
+
+QWinToastInstance::QWinToastInstance(QWinToast* toast, const QString& key) :
+	QObject(nullptr),
+	_toast(toast),
+	_key(key),
+	_backend(new ForwardingBackend(this))
+{
+}
+
+QWinToastInstance::~QWinToastInstance()
+{
+}
+
+bool QWinToastInstance::elect()
+{
+	delete _primary;
+	_primary = nullptr;
+	_primaryBuffer.clear();
+
+	// Serializes the connect-or-listen decision so two processes starting at
+	// the same time cannot both remove a stale server and listen.
+	QLockFile lock(QDir::temp().filePath(_key + QStringLiteral(".lock")));
+	lock.lock();
+
+	QLocalSocket* socket = new QLocalSocket(this);
+	socket->connectToServer(_key);
+	if (socket->waitForConnected(250)) {
+		_primary = socket;
+		connect(_primary, &QLocalSocket::readyRead, this, &QWinToastInstance::readPrimary);
+		connect(_primary, &QLocalSocket::disconnected, this, &QWinToastInstance::primaryDisconnected);
+		return false;
+	}
+	delete socket;
+
+	if (!_server) {
+		_server = new QLocalServer(this);
+		_server->setSocketOptions(QLocalServer::UserAccessOption);
+		connect(_server, &QLocalServer::newConnection, this, &QWinToastInstance::acceptConnection);
+	}
+	if (!_server->isListening() && !_server->listen(_key)) {
+		QLocalServer::removeServer(_key);
+		_server->listen(_key);
+	}
+	return true;
+}
+
+bool QWinToastInstance::isPrimary() const
+{
+	return _server && _server->isListening();
+}
+
+const QString& QWinToastInstance::key() const
+{
+	return _key;
+}
+
+QWinToastBackend* QWinToastInstance::forwardingBackend()
+{
+	return _backend.get();
+}
+
+bool QWinToastInstance::takeOrigin(qint64 id, Origin& origin)
+{
+	QMutexLocker locker(&_mutex);
+	const auto it = _forwarded.find(id);
+	if (it == _forwarded.end()) {
+		return false;
+	}
+	origin = it.value();
+	_forwarded.erase(it);
+	_remoteToLocal[origin.socket].remove(origin.remoteId);
+	return true;
+}
+
+bool QWinToastInstance::routeActivated(qint64 id, QStringView arguments)
+{
+	Origin origin;
+	if (!takeOrigin(id, origin)) {
+		return false;
+	}
+	QByteArray payload;
+	QDataStream out(&payload, QIODevice::WriteOnly);
+	out << static_cast<qint64>(origin.remoteId) << arguments.toString();
+	sendToClient(origin.socket, QWinToastFrame::Activated, payload);
+	return true;
+}
+
+bool QWinToastInstance::routeDismissed(qint64 id, QWinToast::WinToastDismissalReason reason)
+{
+	Origin origin;
+	if (!takeOrigin(id, origin)) {
+		return false;
+	}
+	QByteArray payload;
+	QDataStream out(&payload, QIODevice::WriteOnly);
+	out << static_cast<qint64>(origin.remoteId) << static_cast<qint32>(reason);
+	sendToClient(origin.socket, QWinToastFrame::Dismissed, payload);
+	return true;
+}
+
+bool QWinToastInstance::routeFailed(qint64 id)
+{
+	Origin origin;
+	if (!takeOrigin(id, origin)) {
+		return false;
+	}
+	QByteArray payload;
+	QDataStream out(&payload, QIODevice::WriteOnly);
+	out << static_cast<qint64>(origin.remoteId);
+	sendToClient(origin.socket, QWinToastFrame::Failed, payload);
+	return true;
+}
+
+void QWinToastInstance::sendToClient(QLocalSocket* socket, quint8 type, const QByteArray& payload)
+{
+	QByteArray frame;
+	QWinToastFrame::append(frame, type, payload);
+	// Events arrive on shell threads; the socket may only be used on ours and
+	// may be gone by the time the call runs.
+	QPointer<QLocalSocket> target(socket);
+	QMetaObject::invokeMethod(this, [target, frame]() {
+		if (target) {
+			target->write(frame);
+		}
+	}, Qt::QueuedConnection);
+}
+
+void QWinToastInstance::sendToPrimary(quint8 type, const QByteArray& payload)
+{
+	if (!_primary) {
+		return;
+	}
+	QByteArray frame;
+	QWinToastFrame::append(frame, type, payload);
+	_primary->write(frame);
+}
+
+void QWinToastInstance::acceptConnection()
+{
+	while (QLocalSocket* socket = _server->nextPendingConnection()) {
+		connect(socket, &QLocalSocket::readyRead, this, &QWinToastInstance::readClient);
+		connect(socket, &QLocalSocket::disconnected, this, &QWinToastInstance::clientDisconnected);
+	}
+}
+
+void QWinToastInstance::readClient()
+{
+	QLocalSocket* socket = qobject_cast<QLocalSocket*>(sender());
+	if (!socket) {
+		return;
+	}
+	QByteArray& buffer = _clientBuffers[socket];
+	buffer += socket->readAll();
+	quint8 type;
+	QByteArray payload;
+	for (;;) {
+		const QWinToastFrame::Result result = QWinToastFrame::take(buffer, type, payload);
+		if (result == QWinToastFrame::Incomplete) {
+			break;
+		}
+		if (result == QWinToastFrame::Malformed) {
+			socket->abort();
+			break;
+		}
+		handleClientFrame(socket, type, payload);
+	}
+}
+
+void QWinToastInstance::clientDisconnected()
+{
+	QLocalSocket* socket = qobject_cast<QLocalSocket*>(sender());
+	if (socket) {
+		dropClient(socket);
+		socket->deleteLater();
+	}
+}
+
+void QWinToastInstance::dropClient(QLocalSocket* socket)
+{
+	QMutexLocker locker(&_mutex);
+	const QHash<qint64, qint64> ids = _remoteToLocal.take(socket);
+	for (auto it = ids.begin(); it != ids.end(); ++it) {
+		_forwarded.remove(it.value());
+	}
+	_clientBuffers.remove(socket);
+}
+
+void QWinToastInstance::handleClientFrame(QLocalSocket* socket, quint8 type, const QByteArray& payload)
+{
+	QDataStream in(payload);
+	switch (type) {
+	case QWinToastFrame::Show: {
+		qint64 remoteId = -1, expiration = 0;
+		QWinToastBackend::Request request;
+		in >> remoteId >> expiration >> request.xml >> request.tag >> request.group;
+		if (in.status() != QDataStream::Ok) {
+			break;
+		}
+		// A repeated remote id is the secondary replacing a tagged toast in place.
+		{
+			QMutexLocker locker(&_mutex);
+			request.id = _remoteToLocal[socket].value(remoteId, -1);
+			if (request.id < 0) {
+				request.id = QWinToast::nextToastId();
+				_forwarded.insert(request.id, Origin{ socket, remoteId });
+				_remoteToLocal[socket].insert(remoteId, request.id);
+			}
+		}
+		request.expiration = expiration;
+		if (!_toast->isInitialized() || !QWinToastBackend::succeeded(_toast->backend()->show(_toast, request))) {
+			routeFailed(request.id);
+		}
+		break;
+	}
+	case QWinToastFrame::Hide: {
+		qint64 remoteId = -1;
+		in >> remoteId;
+		qint64 id = -1;
+		{
+			QMutexLocker locker(&_mutex);
+			id = _remoteToLocal[socket].take(remoteId);
+			if (!_forwarded.remove(id)) {
+				id = -1;
+			}
+		}
+		if (id >= 0 && _toast->isInitialized()) {
+			_toast->backend()->hide(_toast, id);
+		}
+		break;
+	}
+	case QWinToastFrame::Clear: {
+		QHash<qint64, qint64> ids;
+		{
+			QMutexLocker locker(&_mutex);
+			ids = _remoteToLocal.take(socket);
+			for (auto it = ids.begin(); it != ids.end(); ++it) {
+				_forwarded.remove(it.value());
+			}
+		}
+		if (_toast->isInitialized()) {
+			for (auto it = ids.begin(); it != ids.end(); ++it) {
+				_toast->backend()->hide(_toast, it.value());
+			}
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+void QWinToastInstance::readPrimary()
+{
+	_primaryBuffer += _primary->readAll();
+	quint8 type;
+	QByteArray payload;
+	for (;;) {
+		const QWinToastFrame::Result result = QWinToastFrame::take(_primaryBuffer, type, payload);
+		if (result == QWinToastFrame::Incomplete) {
+			break;
+		}
+		if (result == QWinToastFrame::Malformed) {
+			_primary->abort();
+			break;
+		}
+		_backend->deliver(type, payload);
+	}
+}
+
+void QWinToastInstance::primaryDisconnected()
+{
+	// The primary went away: take over or follow whoever did, then bring the
+	// notifier back up on the new backend.
+	_primary->deleteLater();
+	_primary = nullptr;
+	_toast->setBackend(nullptr);
+	if (!elect()) {
+		_toast->setBackend(_backend.get());
+	}
+	_toast->initialize();
+}
@@ -0,0 +1,69 @@
+#ifndef QWINTOASTINSTANCE
+#define QWINTOASTINSTANCE
+
+#include "QWinToast.h"
+#include <QHash>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QMutex>
+
+// Single-instance coordination for QWinToast. The first process to listen on
+// the key becomes the primary and owns the real backend; later processes
+// forward their payloads to it and receive activation, dismissal and failure
+// events for their own toasts back over the same socket.
+class QWinToastInstance : public QObject
+{
+    Q_OBJECT
+public:
+    QWinToastInstance(QWinToast* toast, const QString& key);
+    ~QWinToastInstance() override;
+
+    // Connects to an existing primary or becomes one. Returns true when this
+    // process is the primary.
+    bool elect();
+    bool isPrimary() const;
+    const QString& key() const;
+    QWinToastBackend* forwardingBackend();
+
+    // Called by the primary for every event, from any thread. Returns true when
+    // the toast was shown on behalf of a secondary and the event has been
+    // forwarded to it instead of being emitted locally.
+    bool routeActivated(qint64 id, QStringView arguments);
+    bool routeDismissed(qint64 id, QWinToast::WinToastDismissalReason reason);
+    bool routeFailed(qint64 id);
+
+private slots:
+    void acceptConnection();
+    void readClient();
+    void clientDisconnected();
+    void readPrimary();
+    void primaryDisconnected();
+
+private:
+    class ForwardingBackend;
+    struct Origin
+    {
+        QLocalSocket* socket;
+        qint64 remoteId;
+    };
+
+    QWinToast* _toast;
+    QString _key;
+    QLocalServer* _server{ nullptr };
+    QLocalSocket* _primary{ nullptr };
+    QByteArray _primaryBuffer{};
+    QHash<QLocalSocket*, QByteArray> _clientBuffers{};
+    mutable QMutex _mutex;
+    QHash<qint64, Origin> _forwarded{};
+    QHash<QLocalSocket*, QHash<qint64, qint64>> _remoteToLocal{};
+    std::unique_ptr<ForwardingBackend> _backend;
+
+    bool takeOrigin(qint64 id, Origin& origin);
+    void sendToClient(QLocalSocket* socket, quint8 type, const QByteArray& payload);
+    void handleClientFrame(QLocalSocket* socket, quint8 type, const QByteArray& payload);
+    void handlePrimaryFrame(quint8 type, const QByteArray& payload);
+    void sendToPrimary(quint8 type, const QByteArray& payload);
+    void dropClient(QLocalSocket* socket);
+};
+
+#endif // QWINTOASTINSTANCE
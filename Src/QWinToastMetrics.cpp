@@ -0,0 +1,162 @@
+#include "QWinToastMetrics.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QSaveFile>
+
+QWinToastMetric::QWinToastMetric(const QString& name, const QString& help, Type type, const Labels& labels) :
+	_name(name),
+	_help(help),
+	_type(type),
+	_labels(labels)
+{
+}
+
+qint64 QWinToastMetric::value() const
+{
+	qint64 sum = 0;
+	for (const Shard& shard : _shards) {
+		sum += shard.value.loadAcquire();
+	}
+	return sum;
+}
+
+void QWinToastMetric::reset()
+{
+	for (Shard& shard : _shards) {
+		shard.value.storeRelease(0);
+	}
+}
+
+int QWinToastMetric::shardIndex()
+{
+	static QAtomicInteger<int> nextShard{ 0 };
+	thread_local const int shard = nextShard.fetchAndAddRelaxed(1) % Shards;
+	return shard;
+}
+
+QWinToastMetrics* QWinToastMetrics::global()
+{
+	static QWinToastMetrics metrics;
+	return &metrics;
+}
+
+QWinToastMetric* QWinToastMetrics::counter(const QString& name, const QString& help, const QWinToastMetric::Labels& labels)
+{
+	return metric(name, help, QWinToastMetric::Counter, labels);
+}
+
+QWinToastMetric* QWinToastMetrics::gauge(const QString& name, const QString& help, const QWinToastMetric::Labels& labels)
+{
+	return metric(name, help, QWinToastMetric::Gauge, labels);
+}
+
+QWinToastMetric* QWinToastMetrics::metric(const QString& name, const QString& help, QWinToastMetric::Type type, const QWinToastMetric::Labels& labels)
+{
+	QMutexLocker locker(&_mutex);
+	// Members of a family are kept next to each other for the text format.
+	auto insertAt = _metrics.end();
+	for (auto it = _metrics.begin(); it != _metrics.end(); ++it) {
+		if ((*it)->name() != name) {
+			continue;
+		}
+		if ((*it)->labels() == labels) {
+			return it->get();
+		}
+		insertAt = it + 1;
+	}
+	return _metrics.insert(insertAt, std::unique_ptr<QWinToastMetric>(new QWinToastMetric(name, help, type, labels)))->get();
+}
+
+QByteArray QWinToastMetrics::exportAs(Format format) const
+{
+	return format == Json ? toJson() : toPrometheus();
+}
+
+bool QWinToastMetrics::exportToFile(const QString& path, Format format) const
+{
+	QSaveFile file(path);
+	if (!file.open(QIODevice::WriteOnly)) {
+		return false;
+	}
+	file.write(exportAs(format));
+	return file.commit();
+}
+
+bool QWinToastMetrics::exportToLocalSocket(const QString& serverName, Format format, int timeoutMilliseconds) const
+{
+	QLocalSocket socket;
+	socket.connectToServer(serverName, QIODevice::WriteOnly);
+	if (!socket.waitForConnected(timeoutMilliseconds)) {
+		return false;
+	}
+	socket.write(exportAs(format));
+	bool written = true;
+	while (written && socket.bytesToWrite() > 0) {
+		written = socket.waitForBytesWritten(timeoutMilliseconds);
+	}
+	socket.disconnectFromServer();
+	return written;
+}
+
+void QWinToastMetrics::reset()
+{
+	QMutexLocker locker(&_mutex);
+	for (const auto& metric : _metrics) {
+		metric->reset();
+	}
+}
+
+QByteArray QWinToastMetrics::toPrometheus() const
+{
+	QMutexLocker locker(&_mutex);
+	QByteArray out;
+	out.reserve(static_cast<int>(_metrics.size()) * 96);
+	const QString* family = nullptr;
+	for (const auto& metric : _metrics) {
+		if (!family || *family != metric->name()) {
+			family = &metric->name();
+			const QByteArray name = metric->name().toUtf8();
+			out += "# HELP " + name + ' ' + metric->help().toUtf8() + '\n';
+			out += "# TYPE " + name + (metric->type() == QWinToastMetric::Counter ? " counter\n" : " gauge\n");
+		}
+		out += metric->name().toUtf8();
+		if (!metric->labels().isEmpty()) {
+			out += '{';
+			for (int i = 0; i < metric->labels().size(); i++) {
+				const auto& label = metric->labels()[i];
+				if (i) {
+					out += ',';
+				}
+				QString value = label.second;
+				value.replace(QLatin1Char('\\'), QLatin1String("\\\\"))
+					.replace(QLatin1Char('"'), QLatin1String("\\\""))
+					.replace(QLatin1Char('\n'), QLatin1String("\\n"));
+				out += label.first.toUtf8() + "=\"" + value.toUtf8() + '"';
+			}
+			out += '}';
+		}
+		out += ' ' + QByteArray::number(metric->value()) + '\n';
+	}
+	return out;
+}
+
+QByteArray QWinToastMetrics::toJson() const
+{
+	QMutexLocker locker(&_mutex);
+	QJsonArray metrics;
+	for (const auto& metric : _metrics) {
+		QJsonObject labels;
+		for (const auto& label : metric->labels()) {
+			labels.insert(label.first, label.second);
+		}
+		metrics.append(QJsonObject{
+			{ "name", metric->name() },
+			{ "type", metric->type() == QWinToastMetric::Counter ? "counter" : "gauge" },
+			{ "labels", labels },
+			{ "value", static_cast<double>(metric->value()) },
+		});
+	}
+	return QJsonDocument(QJsonObject{ { "metrics", metrics } }).toJson(QJsonDocument::Compact);
+}
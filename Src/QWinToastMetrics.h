@@ -0,0 +1,95 @@
+#ifndef QWINTOASTMETRICS
+#define QWINTOASTMETRICS
+
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+#include <QVector>
+#include <memory>
+#include <vector>
+
+// A counter or gauge split into cache-line sized shards. Each thread updates
+// its own shard; value() merges them on read.
+class QWinToastMetric
+{
+public:
+    enum Type
+    {
+        Counter = 0,
+        Gauge
+    };
+
+    typedef QVector<QPair<QString, QString>> Labels;
+
+    QWinToastMetric(const QString& name, const QString& help, Type type, const Labels& labels);
+
+    void add(qint64 delta)
+    {
+        _shards[shardIndex()].value.fetchAndAddRelaxed(delta);
+    }
+    void increment() { add(1); }
+    qint64 value() const;
+    void reset();
+
+    const QString& name() const { return _name; }
+    const QString& help() const { return _help; }
+    Type type() const { return _type; }
+    const Labels& labels() const { return _labels; }
+
+private:
+    static const int Shards = 16;
+
+    // Padded so that no two shard values share a cache line.
+    struct Shard
+    {
+        QAtomicInteger<qint64> value{ 0 };
+        char padding[64 - sizeof(QAtomicInteger<qint64>)];
+    };
+
+    QString _name;
+    QString _help;
+    Type _type;
+    Labels _labels;
+    Shard _shards[Shards];
+
+    static int shardIndex();
+
+    Q_DISABLE_COPY(QWinToastMetric)
+};
+
+// Process-wide metrics registry. Metrics are created once and live until the
+// process exits, so callers may cache the returned pointers.
+class QWinToastMetrics
+{
+public:
+    enum Format
+    {
+        Prometheus = 0,
+        Json
+    };
+
+    static QWinToastMetrics* global();
+
+    // Returns the existing metric for (name, labels) or registers a new one.
+    QWinToastMetric* counter(const QString& name, const QString& help, const QWinToastMetric::Labels& labels = {});
+    QWinToastMetric* gauge(const QString& name, const QString& help, const QWinToastMetric::Labels& labels = {});
+
+    QByteArray exportAs(Format format) const;
+    // Replaces the file atomically so a scraper never reads a partial export.
+    bool exportToFile(const QString& path, Format format) const;
+    // Writes one export to a QLocalServer and disconnects.
+    bool exportToLocalSocket(const QString& serverName, Format format, int timeoutMilliseconds = 1000) const;
+    void reset();
+
+private:
+    mutable QMutex _mutex;
+    std::vector<std::unique_ptr<QWinToastMetric>> _metrics{};
+
+    QWinToastMetric* metric(const QString& name, const QString& help, QWinToastMetric::Type type, const QWinToastMetric::Labels& labels);
+    QByteArray toPrometheus() const;
+    QByteArray toJson() const;
+};
+
+#endif // QWINTOASTMETRICS
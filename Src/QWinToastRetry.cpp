@@ -0,0 +1,113 @@
+#include "QWinToastRetry.h"
+#include <QRandomGenerator>
+
+int QWinToastRetryPolicy::delayFor(int retry) const
+{
+	qint64 ceiling = qMax(0, initialDelay);
+	for (int i = 1; i < retry && ceiling < maxDelay; i++) {
+		ceiling *= 2;
+	}
+	ceiling = qMin<qint64>(ceiling, qMax(0, maxDelay));
+	return static_cast<int>(QRandomGenerator::global()->bounded(ceiling + 1));
+}
+
+void QWinToastCircuitBreaker::setThreshold(int failures, int openMilliseconds)
+{
+	QMutexLocker locker(&_mutex);
+	_threshold = qMax(0, failures);
+	_openDuration = qMax(0, openMilliseconds);
+}
+
+void QWinToastCircuitBreaker::setClock(QWinToastClock* clock)
+{
+	QMutexLocker locker(&_mutex);
+	_clock = clock ? clock : QWinToastClock::system();
+}
+
+int QWinToastCircuitBreaker::failureThreshold() const
+{
+	QMutexLocker locker(&_mutex);
+	return _threshold;
+}
+
+int QWinToastCircuitBreaker::openDuration() const
+{
+	QMutexLocker locker(&_mutex);
+	return _openDuration;
+}
+
+QWinToastCircuitBreaker::State QWinToastCircuitBreaker::state() const
+{
+	QMutexLocker locker(&_mutex);
+	return _state;
+}
+
+bool QWinToastCircuitBreaker::allow(bool* changed)
+{
+	QMutexLocker locker(&_mutex);
+	if (changed) {
+		*changed = false;
+	}
+	switch (_state) {
+	case Closed:
+		return true;
+	case Open:
+		if (_clock->now() - _openedAt < _openDuration) {
+			return false;
+		}
+		_state = HalfOpen;
+		_probing = true;
+		if (changed) {
+			*changed = true;
+		}
+		return true;
+	case HalfOpen:
+		// Only one probe at a time.
+		if (_probing) {
+			return false;
+		}
+		_probing = true;
+		return true;
+	}
+	return true;
+}
+
+bool QWinToastCircuitBreaker::recordSuccess()
+{
+	QMutexLocker locker(&_mutex);
+	_failures = 0;
+	_probing = false;
+	return moveTo(Closed);
+}
+
+bool QWinToastCircuitBreaker::recordFailure()
+{
+	QMutexLocker locker(&_mutex);
+	_probing = false;
+	if (_threshold == 0) {
+		return false;
+	}
+	if (_state == HalfOpen || ++_failures >= _threshold) {
+		_failures = 0;
+		_openedAt = _clock->now();
+		return moveTo(Open);
+	}
+	return false;
+}
+
+void QWinToastCircuitBreaker::reset()
+{
+	QMutexLocker locker(&_mutex);
+	_state = Closed;
+	_failures = 0;
+	_probing = false;
+}
+
+bool QWinToastCircuitBreaker::moveTo(State state)
+{
+	if (_state == state) {
+		return false;
+	}
+	_state = state;
+	return true;
+}
@@ -0,0 +1,61 @@
+#ifndef QWINTOASTRETRY
+#define QWINTOASTRETRY
+
+#include "QWinToastClock.h"
+#include <QMutex>
+
+// Exponential backoff with full jitter for transient show() failures.
+struct QWinToastRetryPolicy
+{
+    // Total number of show() attempts, 1 disables retrying.
+    int maxAttempts{ 3 };
+    int initialDelay{ 100 };
+    int maxDelay{ 5000 };
+
+    // Delay in milliseconds before the given retry (1 for the first retry),
+    // drawn uniformly from [0, min(maxDelay, initialDelay * 2^(retry - 1))].
+    int delayFor(int retry) const;
+};
+
+// Opens after a run of consecutive failures so that further shows fail fast
+// without building a payload. Once the open period has passed a single probe
+// is let through; its outcome closes or re-opens the circuit.
+class QWinToastCircuitBreaker
+{
+public:
+    enum State
+    {
+        Closed = 0,
+        Open,
+        HalfOpen
+    };
+
+    // A threshold of 0 disables the breaker.
+    void setThreshold(int failures, int openMilliseconds);
+    // Not owned; nullptr restores the system clock.
+    void setClock(QWinToastClock* clock);
+    int failureThreshold() const;
+    int openDuration() const;
+    State state() const;
+
+    // Returns whether a show may proceed; changed reports a move to HalfOpen.
+    bool allow(bool* changed = nullptr);
+    // Both return whether the state changed.
+    bool recordSuccess();
+    bool recordFailure();
+    void reset();
+
+private:
+    mutable QMutex _mutex;
+    State _state{ Closed };
+    int _threshold{ 5 };
+    int _openDuration{ 30000 };
+    int _failures{ 0 };
+    bool _probing{ false };
+    QWinToastClock* _clock{ QWinToastClock::system() };
+    qint64 _openedAt{ 0 };
+
+    bool moveTo(State state);
+};
+
+#endif // QWINTOASTRETRY
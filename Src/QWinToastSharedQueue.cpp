@@ -0,0 +1,380 @@
+#include "QWinToastSharedQueue.h"
+#include "QWinToastCodec.h"
+#include <QThread>
+#include <atomic>
+#include <string.h>
+
+namespace
+{
+	const quint32 Magic = 0x51575451; // "QWTQ"
+	const quint32 LayoutVersion = 1;
+	const int HeaderSize = 192;
+	const int SlotHeaderSize = 16;
+
+	quint32 roundUpToPowerOfTwo(quint32 value)
+	{
+		quint32 result = 1;
+		while (result < value) {
+			result <<= 1;
+		}
+		return result;
+	}
+}
+
+// Positions and flags live on separate cache lines so producers claiming
+// slots do not bounce the line the consumer advances.
+struct QWinToastSharedQueue::Header
+{
+	QBasicAtomicInteger<quint32> magic;
+	quint32 version;
+	quint32 slotCount;
+	quint32 slotSize;
+	char padding0[64 - 16];
+	QBasicAtomicInteger<quint64> enqueue;
+	char padding1[64 - 8];
+	QBasicAtomicInteger<quint64> dequeue;
+	// Set by the consumer before it sleeps on the semaphore.
+	QBasicAtomicInteger<quint32> sleeping;
+	char padding2[64 - 12];
+};
+
+// A slot is free for the producer at position p when sequence == p and holds
+// a record for the consumer when sequence == p + 1.
+struct QWinToastSharedQueue::Slot
+{
+	QBasicAtomicInteger<quint64> sequence;
+	quint32 length;
+	quint32 reserved;
+	char data[1];
+};
+
+static_assert(sizeof(QBasicAtomicInteger<quint64>) == 8, "shared layout needs 8 byte atomics");
+
+QWinToastSharedQueue::QWinToastSharedQueue(const QString& key) :
+	_key(key),
+	_memory(QStringLiteral("qwintoast-queue-") + key)
+{
+}
+
+QWinToastSharedQueue::~QWinToastSharedQueue()
+{
+	if (_memory.isAttached()) {
+		_memory.detach();
+	}
+}
+
+bool QWinToastSharedQueue::create(int slotCount, int slotSize)
+{
+	const quint32 count = roundUpToPowerOfTwo(static_cast<quint32>(qMax(2, slotCount)));
+	const quint32 size = (static_cast<quint32>(qMax(SlotHeaderSize + 1, slotSize)) + 63) & ~quint32(63);
+	const int bytes = HeaderSize + static_cast<int>(count * size);
+	static_assert(sizeof(Header) <= HeaderSize, "header outgrew its reserved space");
+	if (!_memory.create(bytes)) {
+		// Left behind by a consumer that did not shut down; take it over.
+		if (_memory.error() != QSharedMemory::AlreadyExists || !_memory.attach() || _memory.size() < bytes) {
+			_error = _memory.errorString();
+			if (_memory.isAttached()) {
+				_memory.detach();
+			}
+			return false;
+		}
+	}
+
+	_header = static_cast<Header*>(_memory.data());
+	_header->magic.storeRelease(0);
+	_header->version = LayoutVersion;
+	_header->slotCount = count;
+	_header->slotSize = size;
+	_header->enqueue.storeRelease(0);
+	_header->dequeue.storeRelease(0);
+	_header->sleeping.storeRelease(0);
+	_slots = static_cast<char*>(_memory.data()) + HeaderSize;
+	_mask = count - 1;
+	_slotSize = size;
+	for (quint32 i = 0; i < count; i++) {
+		slotAt(i)->sequence.storeRelease(i);
+	}
+	_wakeup.reset(new QSystemSemaphore(QStringLiteral("qwintoast-queue-wake-") + _key, 0, QSystemSemaphore::Create));
+	if (_wakeup->error() != QSystemSemaphore::NoError) {
+		_error = _wakeup->errorString();
+		_memory.detach();
+		_header = nullptr;
+		return false;
+	}
+	_header->magic.storeRelease(Magic);
+	return true;
+}
+
+bool QWinToastSharedQueue::attach()
+{
+	if (!_memory.attach()) {
+		_error = _memory.errorString();
+		return false;
+	}
+	_header = static_cast<Header*>(_memory.data());
+	if (!bind()) {
+		_error = QStringLiteral("The shared queue is not initialized or has another layout");
+		_memory.detach();
+		_header = nullptr;
+		return false;
+	}
+	_wakeup.reset(new QSystemSemaphore(QStringLiteral("qwintoast-queue-wake-") + _key, 0, QSystemSemaphore::Open));
+	return true;
+}
+
+bool QWinToastSharedQueue::bind()
+{
+	if (_header->magic.loadAcquire() != Magic || _header->version != LayoutVersion) {
+		return false;
+	}
+	const quint32 count = _header->slotCount;
+	if (count == 0 || (count & (count - 1)) || _memory.size() < HeaderSize + static_cast<int>(count * _header->slotSize)) {
+		return false;
+	}
+	_slots = static_cast<char*>(_memory.data()) + HeaderSize;
+	_mask = count - 1;
+	_slotSize = _header->slotSize;
+	return true;
+}
+
+bool QWinToastSharedQueue::isAttached() const
+{
+	return _header != nullptr;
+}
+
+QString QWinToastSharedQueue::errorString() const
+{
+	return _error;
+}
+
+const QString& QWinToastSharedQueue::key() const
+{
+	return _key;
+}
+
+int QWinToastSharedQueue::slotCount() const
+{
+	return _header ? static_cast<int>(_mask + 1) : 0;
+}
+
+int QWinToastSharedQueue::maxRecordSize() const
+{
+	return _header ? static_cast<int>(_slotSize) - SlotHeaderSize : 0;
+}
+
+QWinToastSharedQueue::Slot* QWinToastSharedQueue::slotAt(quint64 position) const
+{
+	return reinterpret_cast<Slot*>(_slots + (position & _mask) * _slotSize);
+}
+
+bool QWinToastSharedQueue::push(const QWinToastTemplate& toast)
+{
+	QByteArray record;
+	QWinToastCodec::append(record, toast);
+	return push(record.constData(), record.size());
+}
+
+bool QWinToastSharedQueue::push(const char* record, int size)
+{
+	if (!_header || size <= 0 || size > maxRecordSize()) {
+		return false;
+	}
+
+	// Bounded MPMC ring in the style of Vyukov: claim a position whose slot has
+	// been released for it, fill the slot, then publish it.
+	quint64 position = _header->enqueue.loadAcquire();
+	Slot* slot;
+	for (;;) {
+		slot = slotAt(position);
+		const qint64 lag = static_cast<qint64>(slot->sequence.loadAcquire() - position);
+		if (lag == 0) {
+			if (_header->enqueue.testAndSetRelaxed(position, position + 1, position)) {
+				break;
+			}
+		}
+		else if (lag < 0) {
+			return false;
+		}
+		else {
+			position = _header->enqueue.loadAcquire();
+		}
+	}
+	memcpy(slot->data, record, static_cast<size_t>(size));
+	slot->length = static_cast<quint32>(size);
+	slot->sequence.storeRelease(position + 1);
+
+	// Pairs with the consumer's ordered store to sleeping in wait(): either it
+	// sees this record or this producer sees it asleep.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (_header->sleeping.loadAcquire() && _header->sleeping.testAndSetOrdered(1, 0)) {
+		_wakeup->release();
+	}
+	return true;
+}
+
+bool QWinToastSharedQueue::pop(QWinToastTemplate& toast, bool* malformed)
+{
+	if (!_header) {
+		return false;
+	}
+	const quint64 position = _header->dequeue.loadAcquire();
+	Slot* slot = slotAt(position);
+	if (slot->sequence.loadAcquire() != position + 1) {
+		return false;
+	}
+	const int length = static_cast<int>(qMin<quint32>(slot->length, static_cast<quint32>(maxRecordSize())));
+	// Decoded in place; the slot is not handed back until the template owns its data.
+	QWinToastTemplate decoded;
+	const bool valid = QWinToastCodec::decode(slot->data, length, decoded) == length;
+	slot->sequence.storeRelease(position + _mask + 1);
+	_header->dequeue.storeRelease(position + 1);
+	if (valid) {
+		toast = decoded;
+	}
+	if (malformed) {
+		*malformed = !valid;
+	}
+	return true;
+}
+
+bool QWinToastSharedQueue::pop(QByteArray& record)
+{
+	if (!_header) {
+		return false;
+	}
+	const quint64 position = _header->dequeue.loadAcquire();
+	Slot* slot = slotAt(position);
+	if (slot->sequence.loadAcquire() != position + 1) {
+		return false;
+	}
+	const int length = static_cast<int>(qMin<quint32>(slot->length, static_cast<quint32>(maxRecordSize())));
+	// Keeps the buffer's capacity, so a reused QByteArray does not allocate.
+	record.resize(length);
+	memcpy(record.data(), slot->data, static_cast<size_t>(length));
+	slot->sequence.storeRelease(position + _mask + 1);
+	_header->dequeue.storeRelease(position + 1);
+	return true;
+}
+
+bool QWinToastSharedQueue::isEmpty() const
+{
+	if (!_header) {
+		return true;
+	}
+	const quint64 position = _header->dequeue.loadAcquire();
+	return slotAt(position)->sequence.loadAcquire() != position + 1;
+}
+
+void QWinToastSharedQueue::wait()
+{
+	if (!_header) {
+		return;
+	}
+	_header->sleeping.fetchAndStoreOrdered(1);
+	if (!isEmpty()) {
+		// A producer that saw us asleep has already released the semaphore;
+		// take that release so it does not wake the next wait() early.
+		if (!_header->sleeping.testAndSetOrdered(1, 0)) {
+			_wakeup->acquire();
+		}
+		return;
+	}
+	_wakeup->acquire();
+}
+
+void QWinToastSharedQueue::wake()
+{
+	if (_header) {
+		_header->sleeping.fetchAndStoreOrdered(0);
+		_wakeup->release();
+	}
+}
+
+QWinToastSharedReceiver::QWinToastSharedReceiver(QWinToast* toast, const QString& key, QObject* parent) :
+	QObject(parent),
+	_toast(toast),
+	_queue(key)
+{
+}
+
+QWinToastSharedReceiver::~QWinToastSharedReceiver()
+{
+	stop();
+}
+
+bool QWinToastSharedReceiver::start(int slotCount, int slotSize)
+{
+	if (_worker) {
+		return true;
+	}
+	if (!_queue.isAttached() && !_queue.create(slotCount, slotSize)) {
+		return false;
+	}
+	_stopping.storeRelease(0);
+	_worker = QThread::create([this]() {
+		while (!_stopping.loadAcquire()) {
+			_queue.wait();
+			if (_stopping.loadAcquire()) {
+				break;
+			}
+			QMetaObject::invokeMethod(this, [this]() { drain(); }, Qt::QueuedConnection);
+			_drained.acquire();
+		}
+	});
+	_worker->start();
+	return true;
+}
+
+void QWinToastSharedReceiver::stop()
+{
+	if (!_worker) {
+		return;
+	}
+	_stopping.storeRelease(1);
+	_queue.wake();
+	_drained.release();
+	_worker->wait();
+	delete _worker;
+	_worker = nullptr;
+	// Leftover wake-ups from the shutdown must not satisfy the next start().
+	_drained.tryAcquire(_drained.available());
+}
+
+QString QWinToastSharedReceiver::errorString() const
+{
+	return _queue.errorString();
+}
+
+quint64 QWinToastSharedReceiver::receivedCount() const
+{
+	return _received.loadAcquire();
+}
+
+quint64 QWinToastSharedReceiver::malformedCount() const
+{
+	return _malformed.loadAcquire();
+}
+
+void QWinToastSharedReceiver::drain()
+{
+	QWinToastTemplate toast;
+	for (int i = 0; i < BatchSize && !_stopping.loadAcquire(); i++) {
+		bool malformed = false;
+		if (!_queue.pop(toast, &malformed)) {
+			_drained.release();
+			return;
+		}
+		if (malformed) {
+			_malformed.fetchAndAddRelaxed(1);
+			continue;
+		}
+		_received.fetchAndAddRelaxed(1);
+		_toast->showToast(toast);
+	}
+	if (_stopping.loadAcquire()) {
+		_drained.release();
+		return;
+	}
+	// Let the rest of the event loop run before the next batch.
+	QMetaObject::invokeMethod(this, [this]() { drain(); }, Qt::QueuedConnection);
+}
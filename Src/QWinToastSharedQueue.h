@@ -0,0 +1,106 @@
+#ifndef QWINTOASTSHAREDQUEUE
+#define QWINTOASTSHAREDQUEUE
+
+#include "QWinToast.h"
+#include <QAtomicInteger>
+#include <QSemaphore>
+#include <QSharedMemory>
+#include <QSystemSemaphore>
+#include <memory>
+
+class QThread;
+
+// Lock-free multi-producer, single-consumer ring of encoded toasts in shared
+// memory, for helper processes on the same machine. Each slot holds one
+// QWinToastCodec record; a record larger than maxRecordSize() is refused and
+// must take another path. Producers only signal the semaphore when the
+// consumer is asleep, so a busy ring costs no system call per toast.
+//
+// A producer killed between claiming a slot and publishing it stalls the
+// ring until the consumer creates it again.
+class QWinToastSharedQueue
+{
+public:
+    explicit QWinToastSharedQueue(const QString& key);
+    ~QWinToastSharedQueue();
+
+    // Consumer: creates the segment and its semaphore, taking over a stale
+    // one. slotCount is rounded up to a power of two, slotSize to 64 bytes.
+    bool create(int slotCount = 4096, int slotSize = 512);
+    // Producer: attaches to the segment of a running consumer.
+    bool attach();
+    bool isAttached() const;
+    QString errorString() const;
+    const QString& key() const;
+    int slotCount() const;
+    int maxRecordSize() const;
+
+    // Producer side, safe from any thread. Returns false when the ring is
+    // full, the record does not fit a slot or the queue is not attached.
+    bool push(const QWinToastTemplate& toast);
+    bool push(const char* record, int size);
+
+    // Consumer side, one thread at a time. Return false when the ring is
+    // empty. A malformed record is still consumed; malformed is then set and
+    // toast left as it was.
+    bool pop(QWinToastTemplate& toast, bool* malformed = nullptr);
+    bool pop(QByteArray& record);
+    bool isEmpty() const;
+
+    // Consumer: blocks until a record may be waiting or wake() is called.
+    void wait();
+    void wake();
+
+private:
+    struct Header;
+    struct Slot;
+
+    QString _key;
+    QSharedMemory _memory;
+    std::unique_ptr<QSystemSemaphore> _wakeup{};
+    Header* _header{ nullptr };
+    char* _slots{ nullptr };
+    quint32 _mask{ 0 };
+    quint32 _slotSize{ 0 };
+    QString _error{};
+
+    Slot* slotAt(quint64 position) const;
+    bool bind();
+
+    Q_DISABLE_COPY(QWinToastSharedQueue)
+};
+
+// Feeds a shared queue into a QWinToast. A worker thread sleeps on the queue
+// and, once woken, has the toast's thread drain it in batches through
+// showToast(), so producers never block on the GUI and the GUI never blocks
+// on producers.
+class QWinToastSharedReceiver : public QObject
+{
+    Q_OBJECT
+public:
+    QWinToastSharedReceiver(QWinToast* toast, const QString& key, QObject* parent = nullptr);
+    ~QWinToastSharedReceiver() override;
+
+    bool start(int slotCount = 4096, int slotSize = 512);
+    void stop();
+    QString errorString() const;
+    quint64 receivedCount() const;
+    quint64 malformedCount() const;
+
+    // Records handled per turn of the event loop.
+    static const int BatchSize = 256;
+
+private:
+    QWinToast* _toast;
+    QWinToastSharedQueue _queue;
+    QThread* _worker{ nullptr };
+    // Released by the toast's thread when a drain has emptied the queue.
+    QSemaphore _drained{};
+    QAtomicInteger<int> _stopping{ 0 };
+    QAtomicInteger<quint64> _received{ 0 };
+    QAtomicInteger<quint64> _malformed{ 0 };
+
+    void drain();
+};
+
+#endif // QWINTOASTSHAREDQUEUE
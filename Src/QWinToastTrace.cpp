@@ -0,0 +1,541 @@
+#include "QWinToastTrace.h"
+#include "QWinToastCatalog.h"
+#include "QWinToastClock.h"
+#include "QWinToastCodec.h"
+#include "QWinToastEventQueue.h"
+#include "QWinToastFakeBackend.h"
+#include <algorithm>
+#include <string.h>
+
+namespace
+{
+	const char Magic[4] = { 'Q', 'W', 'T', 'T' };
+	const int HeaderSize = 5;
+
+	void putVarint(QByteArray& out, quint64 value)
+	{
+		while (value >= 0x80) {
+			out += static_cast<char>((value & 0x7f) | 0x80);
+			value >>= 7;
+		}
+		out += static_cast<char>(value);
+	}
+
+	void putString(QByteArray& out, const QString& value)
+	{
+		const QByteArray utf8 = value.toUtf8();
+		putVarint(out, static_cast<quint64>(utf8.size()));
+		out += utf8;
+	}
+
+	// Ids are never below -1, so id + 1 keeps the varint short.
+	void putId(QByteArray& out, qint64 id)
+	{
+		putVarint(out, static_cast<quint64>(id + 1));
+	}
+
+	bool getVarint(const char*& p, const char* end, quint64& value)
+	{
+		value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (p == end) {
+				return false;
+			}
+			const uchar byte = static_cast<uchar>(*p++);
+			value |= static_cast<quint64>(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool getString(const char*& p, const char* end, QString& value)
+	{
+		quint64 size;
+		if (!getVarint(p, end, size) || size > static_cast<quint64>(end - p)) {
+			return false;
+		}
+		value = QString::fromUtf8(p, static_cast<int>(size));
+		p += size;
+		return true;
+	}
+
+	bool getId(const char*& p, const char* end, qint64& id)
+	{
+		quint64 value;
+		if (!getVarint(p, end, value)) {
+			return false;
+		}
+		id = static_cast<qint64>(value) - 1;
+		return true;
+	}
+
+	quint64 zigzag(qint64 value)
+	{
+		return (static_cast<quint64>(value) << 1) ^ static_cast<quint64>(value >> 63);
+	}
+
+	qint64 unzigzag(quint64 value)
+	{
+		return static_cast<qint64>(value >> 1) ^ -static_cast<qint64>(value & 1);
+	}
+}
+
+QWinToastTraceRecorder::QWinToastTraceRecorder() :
+	_clock(QWinToastClock::system())
+{
+}
+
+QWinToastTraceRecorder::~QWinToastTraceRecorder()
+{
+	stop();
+}
+
+bool QWinToastTraceRecorder::start(QIODevice* device)
+{
+	QMutexLocker locker(&_mutex);
+	if (_device) {
+		_error = QStringLiteral("Already recording");
+		return false;
+	}
+	if (!device || !device->isWritable()) {
+		_error = QStringLiteral("Device is not writable");
+		return false;
+	}
+	_device = device;
+	_buffer.clear();
+	_buffer.append(Magic, sizeof(Magic));
+	_buffer += static_cast<char>(Version);
+	_origin = _clock->timestamp();
+	_last = _origin;
+	_count = 0;
+	_error.clear();
+	return true;
+}
+
+bool QWinToastTraceRecorder::start(const QString& fileName)
+{
+	std::unique_ptr<QFile> file(new QFile(fileName));
+	if (!file->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		QMutexLocker locker(&_mutex);
+		_error = file->errorString();
+		return false;
+	}
+	if (!start(file.get())) {
+		return false;
+	}
+	QMutexLocker locker(&_mutex);
+	_file = std::move(file);
+	return true;
+}
+
+void QWinToastTraceRecorder::stop()
+{
+	QMutexLocker locker(&_mutex);
+	if (!_device) {
+		return;
+	}
+	if (_device->write(_buffer) != _buffer.size()) {
+		_error = _device->errorString();
+	}
+	_buffer.clear();
+	_device = nullptr;
+	if (_file) {
+		_file->close();
+		_file.reset();
+	}
+}
+
+void QWinToastTraceRecorder::setClock(QWinToastClock* clock)
+{
+	QMutexLocker locker(&_mutex);
+	_clock = clock ? clock : QWinToastClock::system();
+}
+
+bool QWinToastTraceRecorder::isRecording() const
+{
+	QMutexLocker locker(&_mutex);
+	return _device != nullptr;
+}
+
+quint64 QWinToastTraceRecorder::recordCount() const
+{
+	QMutexLocker locker(&_mutex);
+	return _count;
+}
+
+QString QWinToastTraceRecorder::errorString() const
+{
+	QMutexLocker locker(&_mutex);
+	return _error;
+}
+
+void QWinToastTraceRecorder::recordShow(const QWinToastTemplate& toast, qint64 id)
+{
+	QMutexLocker locker(&_mutex);
+	if (beginLocked(Show, _clock->timestamp())) {
+		putId(_buffer, id);
+		QWinToastCodec::append(_buffer, toast);
+		endLocked();
+	}
+}
+
+void QWinToastTraceRecorder::recordShowCatalog(const QWinToastCatalogEntry& entry, const QStringList& values, qint64 id)
+{
+	QMutexLocker locker(&_mutex);
+	if (beginLocked(ShowCatalog, _clock->timestamp())) {
+		putId(_buffer, id);
+		putString(_buffer, QString::fromUtf8(entry.name));
+		putVarint(_buffer, static_cast<quint64>(values.size()));
+		for (const QString& value : values) {
+			putString(_buffer, value);
+		}
+		endLocked();
+	}
+}
+
+void QWinToastTraceRecorder::recordHide(qint64 id)
+{
+	QMutexLocker locker(&_mutex);
+	if (beginLocked(Hide, _clock->timestamp())) {
+		putId(_buffer, id);
+		endLocked();
+	}
+}
+
+void QWinToastTraceRecorder::recordClear()
+{
+	QMutexLocker locker(&_mutex);
+	if (beginLocked(Clear, _clock->timestamp())) {
+		endLocked();
+	}
+}
+
+void QWinToastTraceRecorder::recordClearGroup(const QString& group)
+{
+	QMutexLocker locker(&_mutex);
+	if (beginLocked(ClearGroup, _clock->timestamp())) {
+		putString(_buffer, group);
+		endLocked();
+	}
+}
+
+void QWinToastTraceRecorder::recordEvent(const QWinToastEvent& event)
+{
+	QMutexLocker locker(&_mutex);
+	switch (event.type) {
+	case QWinToastEvent::Activated:
+		if (beginLocked(Activated, event.timestamp)) {
+			putId(_buffer, event.id);
+			putString(_buffer, event.arguments);
+			endLocked();
+		}
+		break;
+	case QWinToastEvent::Dismissed:
+		if (beginLocked(Dismissed, event.timestamp)) {
+			putId(_buffer, event.id);
+			putVarint(_buffer, static_cast<quint64>(event.reason));
+			endLocked();
+		}
+		break;
+	case QWinToastEvent::Failed:
+		if (beginLocked(Failed, event.timestamp)) {
+			putId(_buffer, event.id);
+			endLocked();
+		}
+		break;
+	}
+}
+
+bool QWinToastTraceRecorder::beginLocked(Kind kind, qint64 timestamp)
+{
+	if (!_device) {
+		return false;
+	}
+	// Events queued before start() are stamped as if raised at the start.
+	timestamp = qMax(timestamp, _origin);
+	_buffer += static_cast<char>(kind);
+	putVarint(_buffer, zigzag((timestamp - _last) / 1000));
+	// Only whole microseconds are written, so the remainder carries over.
+	_last += (timestamp - _last) / 1000 * 1000;
+	return true;
+}
+
+void QWinToastTraceRecorder::endLocked()
+{
+	_count++;
+	if (_buffer.size() < FlushSize) {
+		return;
+	}
+	if (_device->write(_buffer) != _buffer.size()) {
+		_error = _device->errorString();
+	}
+	_buffer.clear();
+}
+
+QWinToastTraceReplayer::QWinToastTraceReplayer(QWinToast* toast, QObject* parent) :
+	QObject(parent),
+	_toast(toast)
+{
+	_timer.setSingleShot(true);
+	_timer.setTimerType(Qt::PreciseTimer);
+	connect(&_timer, &QTimer::timeout, this, &QWinToastTraceReplayer::step);
+}
+
+QWinToastTraceReplayer::~QWinToastTraceReplayer()
+{
+}
+
+bool QWinToastTraceReplayer::load(QIODevice* device)
+{
+	const QByteArray data = device->readAll();
+	const char* p = data.constData();
+	const char* const end = p + data.size();
+	if (data.size() < HeaderSize || memcmp(p, Magic, sizeof(Magic)) != 0) {
+		_error = QStringLiteral("Not a toast trace");
+		return false;
+	}
+	const quint8 version = static_cast<quint8>(p[4]);
+	if (version < 1 || version > QWinToastTraceRecorder::Version) {
+		_error = QStringLiteral("Unsupported trace version %1").arg(version);
+		return false;
+	}
+	p += HeaderSize;
+
+	QVector<Record> records;
+	qint64 time = 0;
+	while (p != end) {
+		Record record{};
+		record.kind = static_cast<QWinToastTraceRecorder::Kind>(*p++);
+		quint64 delta;
+		bool ok = getVarint(p, end, delta);
+		time += unzigzag(delta);
+		record.time = time;
+		switch (record.kind) {
+		case QWinToastTraceRecorder::Show:
+			if (ok && getId(p, end, record.id)) {
+				const int used = QWinToastCodec::decode(p, static_cast<int>(end - p), record.toast);
+				ok = used > 0;
+				p += ok ? used : 0;
+			}
+			else {
+				ok = false;
+			}
+			break;
+		case QWinToastTraceRecorder::Hide:
+		case QWinToastTraceRecorder::Failed:
+			ok = ok && getId(p, end, record.id);
+			break;
+		case QWinToastTraceRecorder::Clear:
+			break;
+		case QWinToastTraceRecorder::ClearGroup:
+			ok = ok && getString(p, end, record.text);
+			break;
+		case QWinToastTraceRecorder::Activated:
+			ok = ok && getId(p, end, record.id) && getString(p, end, record.text);
+			break;
+		case QWinToastTraceRecorder::Dismissed: {
+			quint64 reason = 0;
+			ok = ok && getId(p, end, record.id) && getVarint(p, end, reason);
+			record.reason = static_cast<int>(reason);
+			break;
+		}
+		case QWinToastTraceRecorder::ShowCatalog: {
+			// Each value takes at least its length byte.
+			quint64 count = 0;
+			ok = ok && getId(p, end, record.id) && getString(p, end, record.text) && getVarint(p, end, count)
+				&& count <= static_cast<quint64>(end - p);
+			for (quint64 i = 0; ok && i < count; i++) {
+				QString value;
+				ok = getString(p, end, value);
+				record.values.append(value);
+			}
+			break;
+		}
+		default:
+			ok = false;
+			break;
+		}
+		if (!ok) {
+			_error = QStringLiteral("Malformed record %1").arg(records.size());
+			return false;
+		}
+		records.append(std::move(record));
+	}
+	_records = std::move(records);
+	_error.clear();
+	return true;
+}
+
+bool QWinToastTraceReplayer::load(const QString& fileName)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly)) {
+		_error = file.errorString();
+		return false;
+	}
+	return load(&file);
+}
+
+int QWinToastTraceReplayer::recordCount() const
+{
+	return _records.size();
+}
+
+QString QWinToastTraceReplayer::errorString() const
+{
+	return _error;
+}
+
+void QWinToastTraceReplayer::setSpeed(double speed)
+{
+	_speed = qMax(0.0, speed);
+}
+
+double QWinToastTraceReplayer::speed() const
+{
+	return _speed;
+}
+
+void QWinToastTraceReplayer::setEventBackend(QWinToastFakeBackend* backend)
+{
+	_events = backend;
+}
+
+void QWinToastTraceReplayer::addCatalogEntry(const QWinToastCatalogEntry& entry)
+{
+	_catalog.insert(QString::fromUtf8(entry.name), &entry);
+}
+
+void QWinToastTraceReplayer::start()
+{
+	if (_running) {
+		return;
+	}
+	_running = true;
+	_next = 0;
+	_ids.clear();
+	_stats = Stats();
+	_stats.showLatencies.reserve(_records.size());
+	_clock.start();
+	_timer.start(0);
+}
+
+void QWinToastTraceReplayer::stop()
+{
+	if (_running) {
+		_timer.stop();
+		finish();
+	}
+}
+
+bool QWinToastTraceReplayer::isRunning() const
+{
+	return _running;
+}
+
+const QWinToastTraceReplayer::Stats& QWinToastTraceReplayer::stats() const
+{
+	return _stats;
+}
+
+void QWinToastTraceReplayer::step()
+{
+	for (int i = 0; i < BatchSize && _next < _records.size(); i++) {
+		const Record& record = _records[_next];
+		if (_speed > 0.0) {
+			const qint64 due = static_cast<qint64>(record.time * 1000 / _speed);
+			const qint64 wait = due - _clock.nsecsElapsed();
+			// QTimer cannot wait less than a millisecond; closer records go now.
+			if (wait >= 1000000) {
+				_timer.start(static_cast<int>(wait / 1000000));
+				return;
+			}
+		}
+		_next++;
+		replay(record);
+	}
+	if (_next < _records.size()) {
+		_timer.start(0);
+		return;
+	}
+	finish();
+}
+
+void QWinToastTraceReplayer::replay(const Record& record)
+{
+	QElapsedTimer call;
+	switch (record.kind) {
+	case QWinToastTraceRecorder::Show:
+	case QWinToastTraceRecorder::ShowCatalog: {
+		_stats.calls++;
+		const QWinToastCatalogEntry* entry = nullptr;
+		if (record.kind == QWinToastTraceRecorder::ShowCatalog) {
+			entry = _catalog.value(record.text, nullptr);
+			if (!entry) {
+				_stats.skippedShows++;
+				return;
+			}
+		}
+		call.start();
+		const qint64 id = entry ? _toast->showCatalogToast(*entry, record.values) : _toast->showToast(record.toast);
+		_stats.showLatencies.append(call.nsecsElapsed());
+		if (id < 0) {
+			_stats.rejected++;
+			return;
+		}
+		_stats.shown++;
+		if (record.id >= 0) {
+			_ids.insert(record.id, id);
+		}
+		return;
+	}
+	case QWinToastTraceRecorder::Hide: {
+		_stats.calls++;
+		const auto it = _ids.constFind(record.id);
+		if (it != _ids.constEnd()) {
+			_toast->hideToast(it.value());
+		}
+		return;
+	}
+	case QWinToastTraceRecorder::Clear:
+		_stats.calls++;
+		_toast->clear();
+		return;
+	case QWinToastTraceRecorder::ClearGroup:
+		_stats.calls++;
+		_toast->clearGroup(record.text);
+		return;
+	default:
+		break;
+	}
+
+	_stats.events++;
+	const auto it = _ids.constFind(record.id);
+	bool fired = false;
+	if (_events && it != _ids.constEnd()) {
+		switch (record.kind) {
+		case QWinToastTraceRecorder::Activated:
+			fired = _events->activate(it.value(), record.text);
+			break;
+		case QWinToastTraceRecorder::Dismissed:
+			fired = _events->dismiss(it.value(), static_cast<QWinToast::WinToastDismissalReason>(record.reason));
+			break;
+		default:
+			fired = _events->fail(it.value());
+			break;
+		}
+	}
+	if (!fired) {
+		_stats.skippedEvents++;
+	}
+}
+
+void QWinToastTraceReplayer::finish()
+{
+	_running = false;
+	_stats.elapsed = _clock.nsecsElapsed();
+	std::sort(_stats.showLatencies.begin(), _stats.showLatencies.end());
+	emit finished();
+}
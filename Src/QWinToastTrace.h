@@ -0,0 +1,189 @@
+#ifndef QWINTOASTTRACE
+#define QWINTOASTTRACE
+
+#include "QWinToast.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QTimer>
+#include <QVector>
+#include <memory>
+
+class QWinToastFakeBackend;
+struct QWinToastCatalogEntry;
+
+// Captures the calls made on a QWinToast and the events it receives, so a
+// production burst can be replayed later; see QWinToast::setTraceRecorder()
+// and QWinToastTraceReplayer.
+//
+// A trace is the magic "QWTT" and a version byte followed by records: a kind
+// byte, the zigzag varint microseconds since the previous record, then
+//   Show        varint id + 1, QWinToastCodec record
+//   Hide        varint id + 1
+//   Clear       (nothing)
+//   ClearGroup  varint length, UTF-8 group
+//   Activated   varint id + 1, varint length, UTF-8 arguments
+//   Dismissed   varint id + 1, varint reason
+//   Failed      varint id + 1
+//   ShowCatalog varint id + 1, varint length, UTF-8 entry name, varint value
+//               count, then each value as varint length and UTF-8
+// Version 1 traces lack ShowCatalog and are still read. Ids are those of the
+// recording run; a rejected show, throttled ones included, has id -1. Events
+// are stamped when the backend raised them, so a record may be slightly older
+// than the one before it. Text providers are not run for the trace and their
+// text is missing from it.
+class QWinToastTraceRecorder
+{
+public:
+    enum Kind : quint8
+    {
+        Show = 1,
+        Hide = 2,
+        Clear = 3,
+        ClearGroup = 4,
+        Activated = 5,
+        Dismissed = 6,
+        Failed = 7,
+        ShowCatalog = 8
+    };
+
+    static const quint8 Version = 2;
+
+    QWinToastTraceRecorder();
+    ~QWinToastTraceRecorder();
+
+    // Starts a trace on an open device, which is not owned, or in a new file.
+    bool start(QIODevice* device);
+    bool start(const QString& fileName);
+    // Flushes the trace; a file opened by start() is closed.
+    void stop();
+    bool isRecording() const;
+    quint64 recordCount() const;
+    QString errorString() const;
+
+    // Source of the record timestamps, the system clock by default. Not
+    // owned; set it before start(). QWinToast::setTraceRecorder() passes the
+    // toast's clock.
+    void setClock(QWinToastClock* clock);
+
+    // Safe from any thread. Called by QWinToast while recording.
+    void recordShow(const QWinToastTemplate& toast, qint64 id);
+    void recordShowCatalog(const QWinToastCatalogEntry& entry, const QStringList& values, qint64 id);
+    void recordHide(qint64 id);
+    void recordClear();
+    void recordClearGroup(const QString& group);
+    void recordEvent(const QWinToastEvent& event);
+
+private:
+    // Records are written to the device in chunks of about this many bytes.
+    static const int FlushSize = 64 * 1024;
+
+    mutable QMutex _mutex;
+    QIODevice* _device{ nullptr };
+    std::unique_ptr<QFile> _file{};
+    QByteArray _buffer{};
+    QWinToastClock* _clock;
+    // _clock->timestamp() of the start and of the last record.
+    qint64 _origin{ 0 };
+    qint64 _last{ 0 };
+    quint64 _count{ 0 };
+    QString _error{};
+
+    // Begins a record under _mutex; false when not recording.
+    bool beginLocked(Kind kind, qint64 timestamp);
+    void endLocked();
+
+    Q_DISABLE_COPY(QWinToastTraceRecorder)
+};
+
+// Feeds a recorded trace into a QWinToast on its thread, either at the
+// recorded pace or as fast as it will go, and measures the calls. Whatever
+// backend the toast uses sees the same sequence of shows, hides and clears;
+// recorded events are fired through a fake backend when one is given and are
+// otherwise left to the real backend.
+class QWinToastTraceReplayer : public QObject
+{
+    Q_OBJECT
+public:
+    struct Stats
+    {
+        quint64 calls{ 0 };
+        quint64 shown{ 0 };
+        quint64 rejected{ 0 };
+        quint64 events{ 0 };
+        // Events for toasts that are not live in the replay.
+        quint64 skippedEvents{ 0 };
+        // Catalog shows whose entry was not added with addCatalogEntry().
+        quint64 skippedShows{ 0 };
+        // Nanoseconds from start() to the last record.
+        qint64 elapsed{ 0 };
+        // Nanoseconds spent in each showToast() call, sorted once finished.
+        QVector<qint64> showLatencies{};
+    };
+
+    explicit QWinToastTraceReplayer(QWinToast* toast, QObject* parent = nullptr);
+    ~QWinToastTraceReplayer() override;
+
+    // Reads and decodes a whole trace up front, so replay measures the
+    // library and not the decoder.
+    bool load(QIODevice* device);
+    bool load(const QString& fileName);
+    int recordCount() const;
+    QString errorString() const;
+
+    // 1 replays at the recorded pace, 2 twice as fast, 0 without any pauses.
+    void setSpeed(double speed);
+    double speed() const;
+    // Not owned; nullptr to skip recorded events.
+    void setEventBackend(QWinToastFakeBackend* backend);
+    // Catalog shows are replayed by entry name; the entry is not copied and
+    // normally comes from a generated catalog.
+    void addCatalogEntry(const QWinToastCatalogEntry& entry);
+
+    void start();
+    void stop();
+    bool isRunning() const;
+    const Stats& stats() const;
+
+    // Records replayed per turn of the event loop at full speed, so queued
+    // events still get drained between them.
+    static const int BatchSize = 256;
+
+signals:
+    void finished();
+
+private:
+    struct Record
+    {
+        QWinToastTraceRecorder::Kind kind;
+        // Microseconds since the start of the trace.
+        qint64 time;
+        qint64 id;
+        int reason;
+        // Group, arguments or catalog entry name.
+        QString text;
+        QStringList values;
+        QWinToastTemplate toast;
+    };
+
+    QWinToast* _toast;
+    QWinToastFakeBackend* _events{ nullptr };
+    QHash<QString, const QWinToastCatalogEntry*> _catalog{};
+    QVector<Record> _records{};
+    // Recorded id to the id of the replayed toast.
+    QHash<qint64, qint64> _ids{};
+    int _next{ 0 };
+    double _speed{ 1.0 };
+    bool _running{ false };
+    QElapsedTimer _clock;
+    QTimer _timer;
+    Stats _stats{};
+    QString _error{};
+
+    void step();
+    void replay(const Record& record);
+    void finish();
+};
+
+#endif // QWINTOASTTRACE
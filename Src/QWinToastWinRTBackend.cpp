@@ -0,0 +1,1035 @@
+#include "QWinToast_p.h"
+#include "QWinToastFailureTrace.h"
+#include <Windows.h>
+#include <sdkddkver.h>
+#include <WinUser.h>
+#include <ShObjIdl.h>
+#include <wrl/implements.h>
+#include <wrl/event.h>
+#include <windows.ui.notifications.h>
+#include <strsafe.h>
+#include <Psapi.h>
+#include <ShlObj.h>
+#include <roapi.h>
+#include <propvarutil.h>
+#include <functiondiscoverykeys.h>
+#include <winstring.h>
+#include <string.h>
+#include <functional>
+#include <iterator>
+#include <vector>
+#include <map>
+#include <QAtomicPointer>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QRunnable>
+#include <QThreadPool>
+using namespace Microsoft::WRL;
+using namespace ABI::Windows::Data::Xml::Dom;
+using namespace ABI::Windows::Foundation;
+using namespace ABI::Windows::UI::Notifications;
+using namespace Windows::Foundation;
+
+#pragma comment(lib,"shlwapi")
+#pragma comment(lib,"user32")
+
+// The portable enums mirror the WinRT ones so values cross without mapping.
+static_assert(QWinToast::UserCanceled == ToastDismissalReason_UserCanceled
+	&& QWinToast::ApplicationHidden == ToastDismissalReason_ApplicationHidden
+	&& QWinToast::TimedOut == ToastDismissalReason_TimedOut, "dismissal reasons out of sync");
+static_assert(QWinToastTemplate::ImageAndText01 == ToastTemplateType_ToastImageAndText01
+	&& QWinToastTemplate::Text01 == ToastTemplateType_ToastText01
+	&& QWinToastTemplate::Text04 == ToastTemplateType_ToastText04, "template types out of sync");
+
+#define DEFAULT_SHELL_LINKS_PATH	L"\\Microsoft\\Windows\\Start Menu\\Programs\\"
+#define DEFAULT_LINK_FORMAT			L".lnk"
+#define STATUS_SUCCESS (0x00000000)
+
+
+// Quickstart: Handling toast activations from Win32 apps in Windows 10
+// https://blogs.msdn.microsoft.com/tiles_and_toasts/2015/10/16/quickstart-handling-toast-activations-from-win32-apps-in-windows-10/
+namespace DllImporter
+{
+	// Function load a function from library
+	template <typename Function>
+	HRESULT loadFunctionFromLibrary(HINSTANCE library, LPCSTR name, Function& func)
+	{
+		if (!library)
+		{
+			return E_INVALIDARG;
+		}
+		func = reinterpret_cast<Function>(GetProcAddress(library, name));
+		return (func != nullptr) ? S_OK : E_FAIL;
+	}
+
+	using f_SetCurrentProcessExplicitAppUserModelID = HRESULT(FAR STDAPICALLTYPE*)(__in PCWSTR AppID);
+	using f_PropVariantToString = HRESULT(FAR STDAPICALLTYPE*)(
+		_In_ REFPROPVARIANT propvar, _Out_writes_(cch) PWSTR psz, _In_ UINT cch);
+	using f_RoGetActivationFactory = HRESULT(FAR STDAPICALLTYPE*)(_In_ HSTRING activatableClassId, _In_ REFIID iid,
+	                                                              _COM_Outptr_ void** factory);
+	using f_WindowsCreateStringReference = HRESULT(FAR STDAPICALLTYPE*)(
+		_In_reads_opt_(length + 1) PCWSTR sourceString, UINT32 length, _Out_ HSTRING_HEADER* hstringHeader,
+		_Outptr_result_maybenull_ _Result_nullonfailure_ HSTRING* string);
+	using f_WindowsGetStringRawBuffer = PCWSTR(FAR STDAPICALLTYPE*)(_In_ HSTRING string, _Out_opt_ UINT32* length);
+	using f_WindowsDeleteString = HRESULT(FAR STDAPICALLTYPE*)(_In_opt_ HSTRING string);
+
+	static f_SetCurrentProcessExplicitAppUserModelID SetCurrentProcessExplicitAppUserModelID;
+	static f_PropVariantToString PropVariantToString;
+	static f_RoGetActivationFactory RoGetActivationFactory;
+	static f_WindowsCreateStringReference WindowsCreateStringReference;
+	static f_WindowsGetStringRawBuffer WindowsGetStringRawBuffer;
+	static f_WindowsDeleteString WindowsDeleteString;
+
+
+	template <class T>
+	_Check_return_ __inline HRESULT _1_GetActivationFactory(_In_ HSTRING activatableClassId, _COM_Outptr_ T** factory)
+	{
+		return RoGetActivationFactory(activatableClassId, IID_INS_ARGS(factory));
+	}
+
+	template <typename T>
+	inline HRESULT Wrap_GetActivationFactory(_In_ HSTRING activatableClassId,
+	                                         _Inout_ Details::ComPtrRef<T> factory) noexcept
+	{
+		return _1_GetActivationFactory(activatableClassId, factory.ReleaseAndGetAddressOf());
+	}
+
+	inline HRESULT initialize()
+	{
+		HINSTANCE LibShell32 = LoadLibraryW(L"SHELL32.DLL");
+		HRESULT hr = loadFunctionFromLibrary(LibShell32, "SetCurrentProcessExplicitAppUserModelID",
+		                                     SetCurrentProcessExplicitAppUserModelID);
+		if (SUCCEEDED(hr))
+		{
+			HINSTANCE LibPropSys = LoadLibraryW(L"PROPSYS.DLL");
+			hr = loadFunctionFromLibrary(LibPropSys, "PropVariantToString", PropVariantToString);
+			if (SUCCEEDED(hr))
+			{
+				HINSTANCE LibComBase = LoadLibraryW(L"COMBASE.DLL");
+				const bool succeded = SUCCEEDED(
+						loadFunctionFromLibrary(LibComBase, "RoGetActivationFactory", RoGetActivationFactory))
+					&& SUCCEEDED(
+						loadFunctionFromLibrary(LibComBase, "WindowsCreateStringReference", WindowsCreateStringReference
+						))
+					&& SUCCEEDED(
+						loadFunctionFromLibrary(LibComBase, "WindowsGetStringRawBuffer", WindowsGetStringRawBuffer))
+					&& SUCCEEDED(loadFunctionFromLibrary(LibComBase, "WindowsDeleteString", WindowsDeleteString));
+				return succeded ? S_OK : E_FAIL;
+			}
+		}
+		return hr;
+	}
+}
+
+class WinToastStringWrapper
+{
+public:
+	WinToastStringWrapper(_In_reads_(length) PCWSTR stringRef, _In_ UINT32 length) noexcept
+	{
+		HRESULT hr = DllImporter::WindowsCreateStringReference(stringRef, length, &_header, &_hstring);
+		if (!SUCCEEDED(hr))
+		{
+			RaiseException(static_cast<DWORD>(STATUS_INVALID_PARAMETER), EXCEPTION_NONCONTINUABLE, 0, nullptr);
+		}
+	}
+
+	WinToastStringWrapper(_In_ const std::wstring& stringRef) noexcept
+	{
+		HRESULT hr = DllImporter::WindowsCreateStringReference(stringRef.c_str(),
+		                                                       static_cast<UINT32>(stringRef.length()), &_header,
+		                                                       &_hstring);
+		if (FAILED(hr))
+		{
+			RaiseException(static_cast<DWORD>(STATUS_INVALID_PARAMETER), EXCEPTION_NONCONTINUABLE, 0, nullptr);
+		}
+	}
+
+	~WinToastStringWrapper()
+	{
+		DllImporter::WindowsDeleteString(_hstring);
+	}
+
+	inline HSTRING Get() const noexcept
+	{
+		return _hstring;
+	}
+
+private:
+	HSTRING _hstring;
+	HSTRING_HEADER _header;
+};
+
+class InternalDateTime : public IReference<DateTime>
+{
+public:
+	static INT64 Now()
+	{
+		FILETIME now;
+		GetSystemTimeAsFileTime(&now);
+		return ((((INT64)now.dwHighDateTime) << 32) | now.dwLowDateTime);
+	}
+
+	InternalDateTime(DateTime dateTime) : _dateTime(dateTime)
+	{
+	}
+
+	InternalDateTime(INT64 millisecondsFromNow)
+	{
+		_dateTime.UniversalTime = Now() + millisecondsFromNow * 10000;
+	}
+
+	virtual ~InternalDateTime() = default;
+
+	operator INT64()
+	{
+		return _dateTime.UniversalTime;
+	}
+
+	HRESULT STDMETHODCALLTYPE get_Value(DateTime* dateTime) override
+	{
+		*dateTime = _dateTime;
+		return S_OK;
+	}
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(const IID& riid, void** ppvObject) override
+	{
+		if (!ppvObject)
+		{
+			return E_POINTER;
+		}
+		if (riid == __uuidof(IUnknown) || riid == __uuidof(IReference<DateTime>))
+		{
+			*ppvObject = static_cast<IUnknown*>(static_cast<IReference<DateTime>*>(this));
+			return S_OK;
+		}
+		return E_NOINTERFACE;
+	}
+
+	ULONG STDMETHODCALLTYPE Release() override
+	{
+		return 1;
+	}
+
+	ULONG STDMETHODCALLTYPE AddRef() override
+	{
+		return 2;
+	}
+
+	HRESULT STDMETHODCALLTYPE GetIids(ULONG*, IID**) override
+	{
+		return E_NOTIMPL;
+	}
+
+	HRESULT STDMETHODCALLTYPE GetRuntimeClassName(HSTRING*) override
+	{
+		return E_NOTIMPL;
+	}
+
+	HRESULT STDMETHODCALLTYPE GetTrustLevel(TrustLevel*) override
+	{
+		return E_NOTIMPL;
+	}
+
+protected:
+	DateTime _dateTime;
+};
+
+namespace Util
+{
+	typedef LONG NTSTATUS, *PNTSTATUS;
+	using RtlGetVersionPtr = NTSTATUS(WINAPI*)(PRTL_OSVERSIONINFOW);
+
+	inline RTL_OSVERSIONINFOW getRealOSVersion()
+	{
+		HMODULE hMod = ::GetModuleHandleW(L"ntdll.dll");
+		if (hMod)
+		{
+			auto fxPtr = (RtlGetVersionPtr)::GetProcAddress(hMod, "RtlGetVersion");
+			if (fxPtr != nullptr)
+			{
+				RTL_OSVERSIONINFOW rovi = {0};
+				rovi.dwOSVersionInfoSize = sizeof(rovi);
+				if (STATUS_SUCCESS == fxPtr(&rovi))
+				{
+					return rovi;
+				}
+			}
+		}
+		RTL_OSVERSIONINFOW rovi = {0};
+		return rovi;
+	}
+
+	inline HRESULT defaultExecutablePath(_In_ WCHAR* path, _In_ DWORD nSize = MAX_PATH)
+	{
+		DWORD written = GetModuleFileNameExW(GetCurrentProcess(), nullptr, path, nSize);
+		DEBUG_MSG("Default executable path: " << path);
+		return (written > 0) ? S_OK : E_FAIL;
+	}
+
+
+	inline HRESULT defaultShellLinksDirectory(_In_ WCHAR* path, _In_ DWORD nSize = MAX_PATH)
+	{
+		DWORD written = GetEnvironmentVariableW(L"APPDATA", path, nSize);
+		HRESULT hr = written > 0 ? S_OK : E_INVALIDARG;
+		if (SUCCEEDED(hr))
+		{
+			errno_t result = wcscat_s(path, nSize, DEFAULT_SHELL_LINKS_PATH);
+			hr = (result == 0) ? S_OK : E_INVALIDARG;
+			DEBUG_MSG("Default shell link path: " << path);
+		}
+		return hr;
+	}
+
+	inline HRESULT defaultShellLinkPath(const std::wstring& appname, _In_ WCHAR* path, _In_ DWORD nSize = MAX_PATH)
+	{
+		HRESULT hr = defaultShellLinksDirectory(path, nSize);
+		if (SUCCEEDED(hr))
+		{
+			const std::wstring appLink(appname + DEFAULT_LINK_FORMAT);
+			errno_t result = wcscat_s(path, nSize, appLink.c_str());
+			hr = (result == 0) ? S_OK : E_INVALIDARG;
+			DEBUG_MSG("Default shell link file path: " << path);
+		}
+		return hr;
+	}
+
+
+	inline PCWSTR AsString(ComPtr<IXmlDocument>& xmlDocument)
+	{
+		HSTRING xml;
+		ComPtr<IXmlNodeSerializer> ser;
+		HRESULT hr = xmlDocument.As<IXmlNodeSerializer>(&ser);
+		hr = ser->GetXml(&xml);
+		if (SUCCEEDED(hr))
+			return DllImporter::WindowsGetStringRawBuffer(xml, nullptr);
+		return nullptr;
+	}
+
+	inline PCWSTR AsString(HSTRING hstring)
+	{
+		return DllImporter::WindowsGetStringRawBuffer(hstring, nullptr);
+	}
+
+	inline HRESULT loadXml(_In_ const QString& xml, _Out_ ComPtr<IXmlDocument>& xmlDocument)
+	{
+		ComPtr<IActivationFactory> factory;
+		HRESULT hr = DllImporter::Wrap_GetActivationFactory(WinToastStringWrapper(RuntimeClass_Windows_Data_Xml_Dom_XmlDocument).Get(), &factory);
+		if (SUCCEEDED(hr))
+		{
+			ComPtr<IInspectable> inspectable;
+			hr = factory->ActivateInstance(&inspectable);
+			if (SUCCEEDED(hr))
+			{
+				hr = inspectable.As(&xmlDocument);
+				if (SUCCEEDED(hr))
+				{
+					ComPtr<IXmlDocumentIO> documentIO;
+					hr = xmlDocument.As(&documentIO);
+					if (SUCCEEDED(hr))
+					{
+						hr = documentIO->LoadXml(WinToastStringWrapper(reinterpret_cast<PCWSTR>(xml.utf16()),
+						                                               static_cast<UINT32>(xml.size())).Get());
+					}
+				}
+			}
+		}
+		return hr;
+	}
+}
+
+
+class QWinToastWinRTBackend : public QWinToastBackend
+{
+public:
+	~QWinToastWinRTBackend() override;
+	bool initialize(_In_ QWinToast* toast, _Out_opt_ QWinToast::QWinToastError* error) override;
+	QWinToast::ShortcutResult createShortcut(_In_ QWinToast* toast) override;
+	Result show(_In_ QWinToast* toast, _In_ const Request& request) override;
+	bool hide(_In_ QWinToast* toast, _In_ qint64 id) override;
+	void clear(_In_ QWinToast* toast, _In_ const QVector<qint64>& ids) override;
+	void clearGroup(_In_ QWinToast* toast, _In_ const QString& group, _In_ const QVector<qint64>& ids) override;
+	void release(_In_ QWinToast* toast, _In_ qint64 id) override;
+	void detach(_In_ QWinToast* toast) override;
+	bool isTransient(_In_ Result result) const override;
+	bool isCompatible() const override;
+	bool supportsModernFeatures() const override;
+
+	// One instance is shared by every QWinToast in the process, so COM setup and
+	// the activation factories are paid for once regardless of channel count.
+	static QWinToastWinRTBackend* shared();
+
+private:
+	struct Entry
+	{
+		QWinToast* owner;
+		QString group;
+		// COM identity of the notification, the key events are routed by.
+		IUnknown* identity;
+		ComPtr<IToastNotifier> notifier;
+		ComPtr<IToastNotification> notification;
+	};
+
+	// Toasts hidden inline by the fallback path; larger sets go to the pool
+	// in batches of this size so clearing never stalls the caller.
+	static const int HideBatch = 16;
+	class HideTask;
+	class EventSink;
+
+	QMutex _mutex;
+	bool _hasCoInitialized{ false };
+	bool _hasProcessAumi{ false };
+	ComPtr<IToastNotificationManagerStatics> _notificationManager{};
+	ComPtr<IToastNotificationFactory> _notificationFactory{};
+	// Windows 10 and later; null before that.
+	ComPtr<IToastNotificationHistory> _history{};
+	QHash<QString, ComPtr<IToastNotifier>> _notifiers{};
+	std::map<INT64, Entry> _notifications{};
+	// Sender to id for every live notification; the sink's routing table.
+	QHash<IUnknown*, INT64> _senders{};
+	// Handles the events of every toast; created with the factories.
+	ComPtr<EventSink> _sink{};
+
+	HRESULT ensureFactories();
+	ComPtr<IToastNotifier> notifierFor(_In_ QWinToast* toast);
+	bool sharesNotifier(_In_ QWinToast* toast, _In_ IToastNotifier* notifier, _In_opt_ const QString* group) const;
+	static void hideEntries(_In_ std::vector<std::pair<INT64, Entry>>&& entries);
+	Entry takeLocked(_Inout_ std::map<INT64, Entry>::iterator& it);
+	// Calls deliver with the sender's owner and id under the lock, so detach()
+	// never returns while an event is on its way to the owner.
+	bool route(_In_ IToastNotification* sender, _In_ const std::function<void(QWinToast*, INT64)>& deliver);
+
+	HRESULT validateShellLinkHelper(_In_ QWinToast* toast, _Out_ bool& wasChanged);
+	HRESULT createShellLinkHelper(_In_ QWinToast* toast);
+	HRESULT handleEventHandlers(_In_ IToastNotification* notification);
+	static void setError(_Out_opt_ QWinToast::QWinToastError* error, _In_ QWinToast::QWinToastError value);
+};
+
+namespace
+{
+	// Installed while the backend's object file is loaded; qwintoast-winrt is an
+	// object library so this translation unit always reaches the executable.
+	const bool Registered = (QWinToastBackend::setPlatformBackend([]() -> QWinToastBackend* {
+		return QWinToastWinRTBackend::shared();
+	}), true);
+}
+
+// One sink serves every toast of the process: the shell hands it the
+// notification that raised the event and the backend's table turns that into
+// the owning QWinToast and id, so showing a toast allocates no handlers.
+class QWinToastWinRTBackend::EventSink : public RuntimeClass<RuntimeClassFlags<ClassicCom>,
+	ITypedEventHandler<ToastNotification*, IInspectable*>,
+	ITypedEventHandler<ToastNotification*, ToastDismissedEventArgs*>,
+	ITypedEventHandler<ToastNotification*, ToastFailedEventArgs*>>
+{
+public:
+	explicit EventSink(_In_ QWinToastWinRTBackend* backend) :
+		_backend(backend)
+	{
+	}
+
+	// Notifications still on screen hold the sink past the backend's end.
+	void detach()
+	{
+		_backend.storeRelease(nullptr);
+	}
+
+	IFACEMETHODIMP Invoke(_In_ IToastNotification* sender, _In_ IInspectable* inspectable) override
+	{
+		// The view points straight into the HSTRING buffer; it is copied once
+		// when the event is queued.
+		HSTRING argumentsHandle = nullptr;
+		ComPtr<IToastActivatedEventArgs> activatedEventArgs;
+		if (SUCCEEDED(inspectable->QueryInterface(IID_PPV_ARGS(&activatedEventArgs)))
+			&& FAILED(activatedEventArgs->get_Arguments(&argumentsHandle))) {
+			argumentsHandle = nullptr;
+		}
+		UINT32 length = 0;
+		PCWSTR arguments = argumentsHandle ? DllImporter::WindowsGetStringRawBuffer(argumentsHandle, &length) : nullptr;
+		route(sender, [&](QWinToast* toast, INT64 id) {
+			activated(toast, id, QStringView(reinterpret_cast<const QChar*>(arguments), static_cast<qsizetype>(length)));
+		});
+		if (argumentsHandle) {
+			DllImporter::WindowsDeleteString(argumentsHandle);
+		}
+		return S_OK;
+	}
+
+	IFACEMETHODIMP Invoke(_In_ IToastNotification* sender, _In_ IToastDismissedEventArgs* e) override
+	{
+		ToastDismissalReason reason;
+		if (SUCCEEDED(e->get_Reason(&reason))) {
+			route(sender, [reason](QWinToast* toast, INT64 id) {
+				dismissed(toast, id, static_cast<QWinToast::WinToastDismissalReason>(reason));
+			});
+		}
+		return S_OK;
+	}
+
+	IFACEMETHODIMP Invoke(_In_ IToastNotification* sender, _In_ IToastFailedEventArgs* e) override
+	{
+		HRESULT errorCode = E_FAIL;
+		e->get_ErrorCode(&errorCode);
+		route(sender, [errorCode](QWinToast* toast, INT64 id) {
+			QWinToastFailureTrace::global()->record(QWinToastFailure::Delivery, errorCode, id, 0, 0);
+			failed(toast, id);
+		});
+		return S_OK;
+	}
+
+private:
+	QAtomicPointer<QWinToastWinRTBackend> _backend;
+
+	bool route(_In_ IToastNotification* sender, _In_ const std::function<void(QWinToast*, INT64)>& deliver)
+	{
+		QWinToastWinRTBackend* backend = _backend.loadAcquire();
+		return backend && backend->route(sender, deliver);
+	}
+};
+
+QWinToastWinRTBackend::~QWinToastWinRTBackend() {
+	if (_sink) {
+		_sink->detach();
+	}
+	if (_hasCoInitialized) {
+		CoUninitialize();
+	}
+}
+
+QWinToastWinRTBackend* QWinToastWinRTBackend::shared() {
+	static QWinToastWinRTBackend backend;
+	return &backend;
+}
+
+bool QWinToastWinRTBackend::isTransient(_In_ Result result) const {
+	return result == E_PENDING
+		|| result == E_OUTOFMEMORY
+		|| result == RPC_E_CALL_REJECTED
+		|| result == RPC_E_SERVERCALL_RETRYLATER
+		|| result == RPC_E_DISCONNECTED
+		|| result == HRESULT_FROM_WIN32(ERROR_BUSY)
+		|| result == HRESULT_FROM_WIN32(ERROR_TIMEOUT);
+}
+
+bool QWinToastWinRTBackend::isCompatible() const {
+	DllImporter::initialize();
+	return !((DllImporter::SetCurrentProcessExplicitAppUserModelID == nullptr)
+		|| (DllImporter::PropVariantToString == nullptr)
+		|| (DllImporter::RoGetActivationFactory == nullptr)
+		|| (DllImporter::WindowsCreateStringReference == nullptr)
+		|| (DllImporter::WindowsDeleteString == nullptr));
+}
+
+bool QWinToastWinRTBackend::supportsModernFeatures() const {
+	constexpr auto MinimumSupportedVersion = 6;
+	return Util::getRealOSVersion().dwMajorVersion > MinimumSupportedVersion;
+}
+
+bool QWinToastWinRTBackend::initialize(_In_ QWinToast* toast, _Out_opt_ QWinToast::QWinToastError* error) {
+	if (!isCompatible()) {
+		setError(error, QWinToast::SystemNotSupported);
+		DEBUG_MSG(L"Error: system not supported.");
+		return false;
+	}
+
+	if (toast->shortcutPolicy() != QWinToast::SHORTCUT_POLICY_IGNORE) {
+		if (createShortcut(toast) < 0) {
+			setError(error, QWinToast::ShellLinkNotCreated);
+			DEBUG_MSG(L"Error while attaching the AUMI to the current proccess =(");
+			return false;
+		}
+	}
+
+	QMutexLocker locker(&_mutex);
+	// The process identity can only be set once; further channels are told
+	// apart by the notifier created for their own AUMI.
+	if (!_hasProcessAumi) {
+		if (FAILED(DllImporter::SetCurrentProcessExplicitAppUserModelID(toast->appUserModelId().toStdWString().c_str()))) {
+			setError(error, QWinToast::InvalidAppUserModelID);
+			DEBUG_MSG(L"Error while attaching the AUMI to the current proccess =(");
+			return false;
+		}
+		_hasProcessAumi = true;
+	}
+
+	if (FAILED(ensureFactories()) || !notifierFor(toast)) {
+		setError(error, QWinToast::UnknownError);
+		return false;
+	}
+	return true;
+}
+
+HRESULT QWinToastWinRTBackend::ensureFactories() {
+	HRESULT hr = S_OK;
+	if (!_notificationManager) {
+		hr = DllImporter::Wrap_GetActivationFactory(WinToastStringWrapper(RuntimeClass_Windows_UI_Notifications_ToastNotificationManager).Get(), &_notificationManager);
+	}
+	if (SUCCEEDED(hr) && !_notificationFactory) {
+		hr = DllImporter::Wrap_GetActivationFactory(WinToastStringWrapper(RuntimeClass_Windows_UI_Notifications_ToastNotification).Get(), &_notificationFactory);
+	}
+	if (SUCCEEDED(hr) && !_history) {
+		// Optional: without it clearing falls back to hiding toast by toast.
+		ComPtr<IToastNotificationManagerStatics2> statics2;
+		if (SUCCEEDED(_notificationManager.As(&statics2))) {
+			statics2->get_History(&_history);
+		}
+	}
+	if (SUCCEEDED(hr) && !_sink) {
+		_sink = Make<EventSink>(this);
+		if (!_sink) {
+			hr = E_OUTOFMEMORY;
+		}
+	}
+	return hr;
+}
+
+ComPtr<IToastNotifier> QWinToastWinRTBackend::notifierFor(_In_ QWinToast* toast) {
+	const QString& aumi = toast->appUserModelId();
+	auto it = _notifiers.find(aumi);
+	if (it != _notifiers.end()) {
+		return it.value();
+	}
+	ComPtr<IToastNotifier> notifier;
+	if (_notificationManager
+		&& SUCCEEDED(_notificationManager->CreateToastNotifierWithId(WinToastStringWrapper(aumi.toStdWString()).Get(), &notifier))) {
+		_notifiers.insert(aumi, notifier);
+	}
+	return notifier;
+}
+
+QWinToast::ShortcutResult QWinToastWinRTBackend::createShortcut(_In_ QWinToast* toast) {
+	if (!isCompatible()) {
+		DEBUG_MSG(L"Your OS is not compatible with this library! =(");
+		return QWinToast::SHORTCUT_INCOMPATIBLE_OS;
+	}
+
+	QMutexLocker locker(&_mutex);
+	if (!_hasCoInitialized) {
+		HRESULT initHr = CoInitializeEx(nullptr, COINIT::COINIT_MULTITHREADED);
+		if (initHr != RPC_E_CHANGED_MODE) {
+			if (FAILED(initHr) && initHr != S_FALSE) {
+				DEBUG_MSG(L"Error on COM library initialization!");
+				return QWinToast::SHORTCUT_COM_INIT_FAILURE;
+			}
+			else {
+				_hasCoInitialized = true;
+			}
+		}
+	}
+
+	bool wasChanged;
+	HRESULT hr = validateShellLinkHelper(toast, wasChanged);
+	if (SUCCEEDED(hr))
+		return wasChanged ? QWinToast::SHORTCUT_WAS_CHANGED : QWinToast::SHORTCUT_UNCHANGED;
+
+	hr = createShellLinkHelper(toast);
+	return SUCCEEDED(hr) ? QWinToast::SHORTCUT_WAS_CREATED : QWinToast::SHORTCUT_CREATE_FAILED;
+}
+
+QWinToastBackend::Result QWinToastWinRTBackend::show(_In_ QWinToast* toast, _In_ const Request& request) {
+	QElapsedTimer started;
+	started.start();
+	// Every failing step is traced with its own stage; the success path never
+	// gets here and records nothing.
+	const auto fail = [&](QWinToastFailure::Stage stage, HRESULT hr) {
+		QWinToastFailureTrace::global()->record(stage, hr, request.id, qHash(request.xml), started.nsecsElapsed());
+		return hr;
+	};
+
+	ComPtr<IToastNotifier> notifier;
+	ComPtr<IToastNotificationFactory> notificationFactory;
+	{
+		QMutexLocker locker(&_mutex);
+		notifier = notifierFor(toast);
+		notificationFactory = _notificationFactory;
+	}
+	if (!notifier || !notificationFactory) {
+		return fail(QWinToastFailure::Notifier, E_ILLEGAL_METHOD_CALL);
+	}
+
+	ComPtr<IXmlDocument> xmlDocument;
+	HRESULT hr = Util::loadXml(request.xml, xmlDocument);
+	if (FAILED(hr)) {
+		return fail(QWinToastFailure::LoadXml, hr);
+	}
+
+	ComPtr<IToastNotification> notification;
+	hr = notificationFactory->CreateToastNotification(xmlDocument.Get(), &notification);
+	if (FAILED(hr)) {
+		return fail(QWinToastFailure::CreateNotification, hr);
+	}
+
+	if (request.expiration > 0) {
+		InternalDateTime expirationDateTime(request.expiration);
+		hr = notification->put_ExpirationTime(&expirationDateTime);
+		if (FAILED(hr)) {
+			return fail(QWinToastFailure::Expiration, hr);
+		}
+	}
+
+	if (!request.tag.isEmpty() || !request.group.isEmpty()) {
+		ComPtr<IToastNotification2> notification2;
+		hr = notification.As(&notification2);
+		if (FAILED(hr)) {
+			return fail(request.tag.isEmpty() ? QWinToastFailure::Group : QWinToastFailure::Tag, hr);
+		}
+		if (!request.tag.isEmpty()) {
+			hr = notification2->put_Tag(WinToastStringWrapper(request.tag.toStdWString()).Get());
+			if (FAILED(hr)) {
+				return fail(QWinToastFailure::Tag, hr);
+			}
+		}
+		if (!request.group.isEmpty()) {
+			hr = notification2->put_Group(WinToastStringWrapper(request.group.toStdWString()).Get());
+			if (FAILED(hr)) {
+				return fail(QWinToastFailure::Group, hr);
+			}
+		}
+	}
+
+	ComPtr<IUnknown> identity;
+	hr = notification.As(&identity);
+	if (SUCCEEDED(hr)) {
+		hr = handleEventHandlers(notification.Get());
+	}
+	if (FAILED(hr)) {
+		return fail(QWinToastFailure::EventHandlers, hr);
+	}
+
+	// Registered before Show() so an event the shell raises at once is routed.
+	// The shell replaces a toast with the same tag and group itself;
+	// overwriting the entry keeps the handle under the reused id.
+	Entry replaced{};
+	{
+		QMutexLocker locker(&_mutex);
+		Entry& entry = _notifications[request.id];
+		replaced = entry;
+		entry = Entry{ toast, request.group, identity.Get(), notifier, notification };
+		_senders.insert(identity.Get(), request.id);
+	}
+
+	DEBUG_MSG("xml: " << Util::AsString(xmlDocument));
+	hr = notifier->Show(notification.Get());
+
+	QMutexLocker locker(&_mutex);
+	if (FAILED(hr)) {
+		_senders.remove(identity.Get());
+		auto it = _notifications.find(request.id);
+		if (it != _notifications.end() && it->second.identity == identity.Get()) {
+			if (replaced.identity) {
+				it->second = replaced;
+			}
+			else {
+				_notifications.erase(it);
+			}
+		}
+		locker.unlock();
+		return fail(QWinToastFailure::Show, hr);
+	}
+	// Late events of the replaced toast must not reach its successor.
+	if (replaced.identity) {
+		_senders.remove(replaced.identity);
+	}
+	return hr;
+}
+
+bool QWinToastWinRTBackend::hide(_In_ QWinToast*, _In_ qint64 id) {
+	Entry entry;
+	{
+		QMutexLocker locker(&_mutex);
+		auto it = _notifications.find(id);
+		if (it == _notifications.end()) {
+			return false;
+		}
+		entry = takeLocked(it);
+	}
+	const HRESULT hr = entry.notifier->Hide(entry.notification.Get());
+	if (FAILED(hr)) {
+		QWinToastFailureTrace::global()->record(QWinToastFailure::Hide, hr, id, 0, 0);
+		return false;
+	}
+	return true;
+}
+
+void QWinToastWinRTBackend::release(_In_ QWinToast*, _In_ qint64 id) {
+	Entry entry;
+	{
+		QMutexLocker locker(&_mutex);
+		auto it = _notifications.find(id);
+		if (it == _notifications.end()) {
+			return;
+		}
+		// Destroyed outside the lock; this may run inside the toast's own event.
+		entry = takeLocked(it);
+	}
+}
+
+void QWinToastWinRTBackend::detach(_In_ QWinToast* toast) {
+	std::vector<Entry> entries;
+	{
+		QMutexLocker locker(&_mutex);
+		for (auto it = _notifications.begin(); it != _notifications.end();) {
+			if (it->second.owner == toast) {
+				entries.push_back(takeLocked(it));
+			}
+			else {
+				++it;
+			}
+		}
+	}
+	// The notifications are released outside the lock, as in release().
+}
+
+class QWinToastWinRTBackend::HideTask : public QRunnable
+{
+public:
+	explicit HideTask(std::vector<std::pair<INT64, Entry>>&& entries) :
+		_entries(std::move(entries))
+	{
+	}
+
+	void run() override
+	{
+		// Pool threads start without COM; S_FALSE and RPC_E_CHANGED_MODE mean
+		// the thread already has an apartment that the calls can use.
+		const HRESULT initHr = CoInitializeEx(nullptr, COINIT::COINIT_MULTITHREADED);
+		for (const auto& entry : _entries) {
+			// Nothing to report to the caller, but a failed hide leaves a toast behind.
+			const HRESULT hr = entry.second.notifier->Hide(entry.second.notification.Get());
+			if (FAILED(hr)) {
+				QWinToastFailureTrace::global()->record(QWinToastFailure::Hide, hr, entry.first, 0, 0);
+			}
+		}
+		if (SUCCEEDED(initHr)) {
+			CoUninitialize();
+		}
+	}
+
+private:
+	std::vector<std::pair<INT64, Entry>> _entries;
+};
+
+void QWinToastWinRTBackend::hideEntries(_In_ std::vector<std::pair<INT64, Entry>>&& entries) {
+	if (entries.size() <= static_cast<std::size_t>(HideBatch)) {
+		HideTask(std::move(entries)).run();
+		return;
+	}
+	for (std::size_t first = 0; first < entries.size(); first += HideBatch) {
+		const std::size_t last = qMin(entries.size(), first + HideBatch);
+		std::vector<std::pair<INT64, Entry>> batch(std::make_move_iterator(entries.begin() + first),
+			std::make_move_iterator(entries.begin() + last));
+		QThreadPool::globalInstance()->start(new HideTask(std::move(batch)));
+	}
+}
+
+bool QWinToastWinRTBackend::sharesNotifier(_In_ QWinToast* toast, _In_ IToastNotifier* notifier, _In_opt_ const QString* group) const {
+	// History removal works per AUMI, so it is only safe when no other
+	// QWinToast on the same notifier has a toast it would take down too.
+	for (const auto& entry : _notifications) {
+		if (entry.second.owner != toast && entry.second.notifier.Get() == notifier
+			&& (!group || entry.second.group == *group)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void QWinToastWinRTBackend::clear(_In_ QWinToast* toast, _In_ const QVector<qint64>& ids) {
+	// Toast by toast: ClearWithId would also take down the toasts forwarded by
+	// secondaries and those of other processes sharing the AUMI.
+	std::vector<std::pair<INT64, Entry>> entries;
+	{
+		QMutexLocker locker(&_mutex);
+		entries.reserve(static_cast<std::size_t>(ids.size()));
+		for (const qint64 id : ids) {
+			auto it = _notifications.find(id);
+			if (it != _notifications.end() && it->second.owner == toast) {
+				entries.push_back(std::make_pair(id, takeLocked(it)));
+			}
+		}
+	}
+	hideEntries(std::move(entries));
+}
+
+void QWinToastWinRTBackend::clearGroup(_In_ QWinToast* toast, _In_ const QString& group, _In_ const QVector<qint64>& ids) {
+	std::vector<std::pair<INT64, Entry>> entries;
+	ComPtr<IToastNotificationHistory> history;
+	{
+		QMutexLocker locker(&_mutex);
+		entries.reserve(static_cast<std::size_t>(ids.size()));
+		for (const qint64 id : ids) {
+			auto it = _notifications.find(id);
+			if (it != _notifications.end()) {
+				entries.push_back(std::make_pair(id, takeLocked(it)));
+			}
+		}
+		auto notifier = _notifiers.constFind(toast->appUserModelId());
+		if (_history && !group.isEmpty() && notifier != _notifiers.constEnd()
+			&& !sharesNotifier(toast, notifier.value().Get(), &group)) {
+			history = _history;
+		}
+	}
+	if (history) {
+		const HRESULT hr = history->RemoveGroupWithId(WinToastStringWrapper(group.toStdWString()).Get(),
+			WinToastStringWrapper(toast->appUserModelId().toStdWString()).Get());
+		if (SUCCEEDED(hr)) {
+			return;
+		}
+		QWinToastFailureTrace::global()->record(QWinToastFailure::Hide, hr, -1, 0, 0);
+	}
+	hideEntries(std::move(entries));
+}
+
+void QWinToastWinRTBackend::setError(_Out_opt_ QWinToast::QWinToastError* error, _In_ QWinToast::QWinToastError value) {
+	if (error) {
+		*error = value;
+	}
+}
+
+HRESULT QWinToastWinRTBackend::validateShellLinkHelper(_In_ QWinToast* toast, _Out_ bool& wasChanged) {
+	WCHAR	path[MAX_PATH] = { L'\0' };
+	Util::defaultShellLinkPath(toast->appName().toStdWString(), path);
+	// Check if the file exist
+	DWORD attr = GetFileAttributesW(path);
+	if (attr >= 0xFFFFFFF) {
+		DEBUG_MSG("Error, shell link not found. Try to create a new one in: " << path);
+		return E_FAIL;
+	}
+
+	// Let's load the file as shell link to validate.
+	// - Create a shell link
+	// - Create a persistant file
+	// - Load the path as data for the persistant file
+	// - Read the property AUMI and validate with the current
+	// - Review if AUMI is equal.
+	ComPtr<IShellLink> shellLink;
+	HRESULT hr = CoCreateInstance(CLSID_ShellLink, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&shellLink));
+	if (SUCCEEDED(hr)) {
+		ComPtr<IPersistFile> persistFile;
+		hr = shellLink.As(&persistFile);
+		if (SUCCEEDED(hr)) {
+			hr = persistFile->Load(path, STGM_READWRITE);
+			if (SUCCEEDED(hr)) {
+				ComPtr<IPropertyStore> propertyStore;
+				hr = shellLink.As(&propertyStore);
+				if (SUCCEEDED(hr)) {
+					PROPVARIANT appIdPropVar;
+					hr = propertyStore->GetValue(PKEY_AppUserModel_ID, &appIdPropVar);
+					if (SUCCEEDED(hr)) {
+						WCHAR AUMI[MAX_PATH];
+						hr = DllImporter::PropVariantToString(appIdPropVar, AUMI, MAX_PATH);
+						wasChanged = false;
+						if (FAILED(hr) || toast->appUserModelId() != QString::fromWCharArray(AUMI)) {
+							if (toast->shortcutPolicy() == QWinToast::SHORTCUT_POLICY_REQUIRE_CREATE) {
+								// AUMI Changed for the same app, let's update the current value! =)
+								wasChanged = true;
+								PropVariantClear(&appIdPropVar);
+								hr = InitPropVariantFromString(toast->appUserModelId().toStdWString().c_str(), &appIdPropVar);
+								if (SUCCEEDED(hr)) {
+									hr = propertyStore->SetValue(PKEY_AppUserModel_ID, appIdPropVar);
+									if (SUCCEEDED(hr)) {
+										hr = propertyStore->Commit();
+										if (SUCCEEDED(hr) && SUCCEEDED(persistFile->IsDirty())) {
+											hr = persistFile->Save(path, TRUE);
+										}
+									}
+								}
+							}
+							else {
+								// Not allowed to touch the shortcut to fix the AUMI
+								hr = E_FAIL;
+							}
+						}
+						PropVariantClear(&appIdPropVar);
+					}
+				}
+			}
+		}
+	}
+	return hr;
+}
+
+
+HRESULT QWinToastWinRTBackend::createShellLinkHelper(_In_ QWinToast* toast) {
+	if (toast->shortcutPolicy() != QWinToast::SHORTCUT_POLICY_REQUIRE_CREATE) {
+		return E_FAIL;
+	}
+
+	WCHAR   exePath[MAX_PATH]{ L'\0' };
+	WCHAR	slPath[MAX_PATH]{ L'\0' };
+	Util::defaultShellLinkPath(toast->appName().toStdWString(), slPath);
+	Util::defaultExecutablePath(exePath);
+	ComPtr<IShellLinkW> shellLink;
+	HRESULT hr = CoCreateInstance(CLSID_ShellLink, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&shellLink));
+	if (SUCCEEDED(hr)) {
+		hr = shellLink->SetPath(exePath);
+		if (SUCCEEDED(hr)) {
+			hr = shellLink->SetArguments(L"");
+			if (SUCCEEDED(hr)) {
+				hr = shellLink->SetWorkingDirectory(exePath);
+				if (SUCCEEDED(hr)) {
+					ComPtr<IPropertyStore> propertyStore;
+					hr = shellLink.As(&propertyStore);
+					if (SUCCEEDED(hr)) {
+						PROPVARIANT appIdPropVar;
+						hr = InitPropVariantFromString(toast->appUserModelId().toStdWString().c_str(), &appIdPropVar);
+						if (SUCCEEDED(hr)) {
+							hr = propertyStore->SetValue(PKEY_AppUserModel_ID, appIdPropVar);
+							if (SUCCEEDED(hr)) {
+								hr = propertyStore->Commit();
+								if (SUCCEEDED(hr)) {
+									ComPtr<IPersistFile> persistFile;
+									hr = shellLink.As(&persistFile);
+									if (SUCCEEDED(hr)) {
+										hr = persistFile->Save(slPath, TRUE);
+									}
+								}
+							}
+							PropVariantClear(&appIdPropVar);
+						}
+					}
+				}
+			}
+		}
+	}
+	return hr;
+}
+
+HRESULT QWinToastWinRTBackend::handleEventHandlers(IToastNotification* notification)
+{
+	EventRegistrationToken activatedToken, dismissedToken, failedToken;
+	HRESULT hr = notification->add_Activated(_sink.Get(), &activatedToken);
+	if (SUCCEEDED(hr))
+	{
+		hr = notification->add_Dismissed(_sink.Get(), &dismissedToken);
+		if (SUCCEEDED(hr))
+		{
+			hr = notification->add_Failed(_sink.Get(), &failedToken);
+		}
+	}
+	return hr;
+}
+
+QWinToastWinRTBackend::Entry QWinToastWinRTBackend::takeLocked(_Inout_ std::map<INT64, Entry>::iterator& it) {
+	Entry entry = it->second;
+	_senders.remove(entry.identity);
+	it = _notifications.erase(it);
+	return entry;
+}
+
+bool QWinToastWinRTBackend::route(_In_ IToastNotification* sender, _In_ const std::function<void(QWinToast*, INT64)>& deliver) {
+	ComPtr<IUnknown> identity;
+	if (!sender || FAILED(sender->QueryInterface(IID_PPV_ARGS(&identity)))) {
+		return false;
+	}
+	QMutexLocker locker(&_mutex);
+	auto sender_it = _senders.constFind(identity.Get());
+	if (sender_it == _senders.constEnd()) {
+		return false;
+	}
+	auto it = _notifications.find(sender_it.value());
+	if (it == _notifications.end()) {
+		return false;
+	}
+	deliver(it->second.owner, it->first);
+	return true;
+}
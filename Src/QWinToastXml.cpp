@@ -0,0 +1,318 @@
+#include "QWinToastXml.h"
+#include "QWinToast.h"
+#include <QtAlgorithms>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define QWINTOAST_XML_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define QWINTOAST_XML_SSE2
+#endif
+
+namespace
+{
+	// Code units XML 1.0 does not allow: controls other than tab, newline and
+	// carriage return, surrogates (a valid pair is let through by the caller)
+	// and the noncharacters U+FFFE and U+FFFF.
+	inline bool isInvalid(ushort c)
+	{
+		return (c < 0x20 && c != '\t' && c != '\n' && c != '\r')
+			|| (c & 0xF800) == 0xD800 || (c | 1) == 0xFFFF;
+	}
+
+	// Everything the slow path has to look at. Tab, newline and carriage
+	// return are written as references, which keeps them intact in attribute
+	// values and stops a parser from folding CR LF.
+	inline bool isSpecial(ushort c)
+	{
+		return c == '&' || c == '<' || c == '>' || c == '"' || c == '\''
+			|| c < 0x20 || (c & 0xF800) == 0xD800 || (c | 1) == 0xFFFF;
+	}
+
+	inline bool isSurrogatePair(const ushort* p, const ushort* end)
+	{
+		return (p[0] & 0xFC00) == 0xD800 && end - p >= 2 && (p[1] & 0xFC00) == 0xDC00;
+	}
+
+	inline int entityLength(ushort c)
+	{
+		switch (c) {
+		case '&': return 5;
+		case '<': return 4;
+		case '>': return 4;
+		case '"': return 6;
+		case '\'': return 6;
+		case '\t': return 5;
+		case '\n': return 5;
+		case '\r': return 5;
+		default: return 1;
+		}
+	}
+
+	// Invalid code units become U+FFFD, so LoadXml never sees them.
+	inline ushort* writeEntity(ushort c, ushort* dst)
+	{
+		const char* entity = nullptr;
+		switch (c) {
+		case '&': entity = "&amp;"; break;
+		case '<': entity = "&lt;"; break;
+		case '>': entity = "&gt;"; break;
+		case '"': entity = "&quot;"; break;
+		case '\'': entity = "&apos;"; break;
+		case '\t': entity = "&#x9;"; break;
+		case '\n': entity = "&#xA;"; break;
+		case '\r': entity = "&#xD;"; break;
+		default: *dst = isInvalid(c) ? 0xFFFD : c; return dst + 1;
+		}
+		while (*entity) {
+			*dst++ = static_cast<ushort>(*entity++);
+		}
+		return dst;
+	}
+
+	// Returns the first code unit in [p, end) that needs escaping, or end.
+	template <bool Vectorized>
+	inline const ushort* findSpecial(const ushort* p, const ushort* end)
+	{
+#if defined(QWINTOAST_XML_AVX2)
+		if (Vectorized) {
+			const __m256i amp = _mm256_set1_epi16('&');
+			const __m256i lt = _mm256_set1_epi16('<');
+			const __m256i gt = _mm256_set1_epi16('>');
+			const __m256i quot = _mm256_set1_epi16('"');
+			const __m256i apos = _mm256_set1_epi16('\'');
+			const __m256i controlMax = _mm256_set1_epi16(0x1F);
+			const __m256i zero = _mm256_setzero_si256();
+			const __m256i surrogateMask = _mm256_set1_epi16(static_cast<short>(0xF800));
+			const __m256i surrogate = _mm256_set1_epi16(static_cast<short>(0xD800));
+			const __m256i one = _mm256_set1_epi16(1);
+			const __m256i nonCharacter = _mm256_set1_epi16(static_cast<short>(0xFFFF));
+			for (; end - p >= 16; p += 16) {
+				const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+				__m256i hit = _mm256_or_si256(_mm256_cmpeq_epi16(v, amp), _mm256_cmpeq_epi16(v, lt));
+				hit = _mm256_or_si256(hit, _mm256_cmpeq_epi16(v, gt));
+				hit = _mm256_or_si256(hit, _mm256_cmpeq_epi16(v, quot));
+				hit = _mm256_or_si256(hit, _mm256_cmpeq_epi16(v, apos));
+				hit = _mm256_or_si256(hit, _mm256_cmpeq_epi16(_mm256_subs_epu16(v, controlMax), zero));
+				hit = _mm256_or_si256(hit, _mm256_cmpeq_epi16(_mm256_and_si256(v, surrogateMask), surrogate));
+				hit = _mm256_or_si256(hit, _mm256_cmpeq_epi16(_mm256_or_si256(v, one), nonCharacter));
+				const quint32 mask = static_cast<quint32>(_mm256_movemask_epi8(hit));
+				if (mask) {
+					return p + qCountTrailingZeroBits(mask) / 2;
+				}
+			}
+		}
+#endif
+#if defined(QWINTOAST_XML_AVX2) || defined(QWINTOAST_XML_SSE2)
+		if (Vectorized) {
+			const __m128i amp8 = _mm_set1_epi16('&');
+			const __m128i lt8 = _mm_set1_epi16('<');
+			const __m128i gt8 = _mm_set1_epi16('>');
+			const __m128i quot8 = _mm_set1_epi16('"');
+			const __m128i apos8 = _mm_set1_epi16('\'');
+			// Unsigned v <= 0x1F is a saturating subtract that lands on zero.
+			const __m128i controlMax8 = _mm_set1_epi16(0x1F);
+			const __m128i zero8 = _mm_setzero_si128();
+			const __m128i surrogateMask8 = _mm_set1_epi16(static_cast<short>(0xF800));
+			const __m128i surrogate8 = _mm_set1_epi16(static_cast<short>(0xD800));
+			const __m128i one8 = _mm_set1_epi16(1);
+			const __m128i nonCharacter8 = _mm_set1_epi16(static_cast<short>(0xFFFF));
+			for (; end - p >= 8; p += 8) {
+				const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+				__m128i hit = _mm_or_si128(_mm_cmpeq_epi16(v, amp8), _mm_cmpeq_epi16(v, lt8));
+				hit = _mm_or_si128(hit, _mm_cmpeq_epi16(v, gt8));
+				hit = _mm_or_si128(hit, _mm_cmpeq_epi16(v, quot8));
+				hit = _mm_or_si128(hit, _mm_cmpeq_epi16(v, apos8));
+				hit = _mm_or_si128(hit, _mm_cmpeq_epi16(_mm_subs_epu16(v, controlMax8), zero8));
+				hit = _mm_or_si128(hit, _mm_cmpeq_epi16(_mm_and_si128(v, surrogateMask8), surrogate8));
+				hit = _mm_or_si128(hit, _mm_cmpeq_epi16(_mm_or_si128(v, one8), nonCharacter8));
+				const quint32 mask = static_cast<quint32>(_mm_movemask_epi8(hit));
+				if (mask) {
+					return p + qCountTrailingZeroBits(mask) / 2;
+				}
+			}
+		}
+#endif
+		for (; p != end; ++p) {
+			if (isSpecial(*p)) {
+				return p;
+			}
+		}
+		return end;
+	}
+
+	template <bool Vectorized>
+	int escapedLengthOf(const ushort* src, int length)
+	{
+		const ushort* end = src + length;
+		int result = length;
+		const ushort* p = findSpecial<Vectorized>(src, end);
+		while (p != end) {
+			if (isSurrogatePair(p, end)) {
+				p = findSpecial<Vectorized>(p + 2, end);
+				continue;
+			}
+			result += entityLength(*p) - 1;
+			p = findSpecial<Vectorized>(p + 1, end);
+		}
+		return result;
+	}
+
+	template <bool Vectorized>
+	ushort* escapeInto(const ushort* src, int length, ushort* dst)
+	{
+		const ushort* end = src + length;
+		while (src != end) {
+			const ushort* special = findSpecial<Vectorized>(src, end);
+			const std::size_t clean = static_cast<std::size_t>(special - src);
+			memcpy(dst, src, clean * sizeof(ushort));
+			dst += clean;
+			if (special == end) {
+				break;
+			}
+			if (isSurrogatePair(special, end)) {
+				*dst++ = special[0];
+				*dst++ = special[1];
+				src = special + 2;
+				continue;
+			}
+			dst = writeEntity(*special, dst);
+			src = special + 1;
+		}
+		return dst;
+	}
+
+	// Binding template names, indexed by WinToastTemplateType.
+	const char* const TemplateNames[] = {
+		"ToastImageAndText01", "ToastImageAndText02", "ToastImageAndText03", "ToastImageAndText04",
+		"ToastText01", "ToastText02", "ToastText03", "ToastText04"
+	};
+}
+
+int QWinToastXml::escapedLength(const ushort* src, int length)
+{
+	return escapedLengthOf<true>(src, length);
+}
+
+ushort* QWinToastXml::escape(const ushort* src, int length, ushort* dst)
+{
+	return escapeInto<true>(src, length, dst);
+}
+
+int QWinToastXml::escapedLengthScalar(const ushort* src, int length)
+{
+	return escapedLengthOf<false>(src, length);
+}
+
+ushort* QWinToastXml::escapeScalar(const ushort* src, int length, ushort* dst)
+{
+	return escapeInto<false>(src, length, dst);
+}
+
+void QWinToastXml::appendEscaped(QString& out, const QString& text)
+{
+	const ushort* src = text.utf16();
+	const int length = text.size();
+	// Replacements keep the length, so only a clean scan proves a plain copy.
+	if (findSpecial<true>(src, src + length) == src + length) {
+		out.append(text);
+		return;
+	}
+	const int offset = out.size();
+	out.resize(offset + escapedLength(src, length));
+	escape(src, length, reinterpret_cast<ushort*>(out.data()) + offset);
+}
+
+QString QWinToastXml::escaped(const QString& text)
+{
+	QString out;
+	appendEscaped(out, text);
+	return out;
+}
+
+QString QWinToastXml::toastPayload(const QWinToastTemplate& toast, bool modernFeatures)
+{
+	const bool hasActions = modernFeatures && toast.actionsCount() > 0;
+
+	QString xml;
+	xml.reserve(256);
+	xml += QLatin1String("<toast");
+	if (modernFeatures) {
+		if (toast.duration() != QWinToastTemplate::Duration::System) {
+			xml += toast.duration() == QWinToastTemplate::Duration::Short
+				? QLatin1String(" duration=\"short\"") : QLatin1String(" duration=\"long\"");
+		}
+		else if (hasActions) {
+			xml += QLatin1String(" duration=\"long\"");
+		}
+		xml += QLatin1String(" scenario=\"");
+		appendEscaped(xml, toast.scenario());
+		xml += QLatin1Char('"');
+		if (hasActions) {
+			xml += QLatin1String(" template=\"ToastGeneric\"");
+		}
+	}
+	xml += QLatin1String("><visual><binding template=\"");
+	xml += QLatin1String(TemplateNames[toast.type()]);
+	xml += QLatin1String("\">");
+
+	if (toast.hasImage()) {
+		xml += QLatin1String("<image id=\"1\" src=\"file:///");
+		appendEscaped(xml, toast.imagePath());
+		xml += QLatin1String("\"/>");
+	}
+
+	for (std::size_t i = 0, fieldsCount = toast.textFieldsCount(); i < fieldsCount; i++) {
+		xml += QLatin1String("<text id=\"");
+		xml += QString::number(i + 1);
+		xml += QLatin1String("\">");
+		appendEscaped(xml, toast.textField(QWinToastTemplate::TextField(i)));
+		xml += QLatin1String("</text>");
+	}
+
+	// Available as of Windows 10 Anniversary Update
+	if (modernFeatures && !toast.attributionText().isEmpty()) {
+		xml += QLatin1String("<text placement=\"attribution\">");
+		appendEscaped(xml, toast.attributionText());
+		xml += QLatin1String("</text>");
+	}
+	xml += QLatin1String("</binding></visual>");
+
+	if (hasActions) {
+		xml += QLatin1String("<actions>");
+		for (std::size_t i = 0, actionsCount = toast.actionsCount(); i < actionsCount; i++) {
+			xml += QLatin1String("<action content=\"");
+			appendEscaped(xml, toast.actionLabel(i));
+			xml += QLatin1String("\" arguments=\"a=");
+			xml += QString::number(i);
+			if (!toast.actionArguments(i).isEmpty()) {
+				xml += QLatin1String("&amp;");
+				appendEscaped(xml, toast.actionArguments(i));
+			}
+			xml += QLatin1String("\"/>");
+		}
+		xml += QLatin1String("</actions>");
+	}
+
+	if (modernFeatures
+		&& (!toast.audioPath().isEmpty() || toast.audioOption() != QWinToastTemplate::AudioOption::Default)) {
+		xml += QLatin1String("<audio");
+		if (!toast.audioPath().isEmpty()) {
+			xml += QLatin1String(" src=\"");
+			appendEscaped(xml, toast.audioPath());
+			xml += QLatin1Char('"');
+		}
+		if (toast.audioOption() == QWinToastTemplate::AudioOption::Loop) {
+			xml += QLatin1String(" loop=\"true\"");
+		}
+		else if (toast.audioOption() == QWinToastTemplate::AudioOption::Silent) {
+			xml += QLatin1String(" silent=\"true\"");
+		}
+		xml += QLatin1String("/>");
+	}
+
+	xml += QLatin1String("</toast>");
+	return xml;
+}
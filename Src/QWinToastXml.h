@@ -0,0 +1,31 @@
+#ifndef QWINTOASTXML
+#define QWINTOASTXML
+
+#include <QString>
+
+class QWinToastTemplate;
+
+namespace QWinToastXml
+{
+    // Number of UTF-16 code units the escaped form of [src, src + length) occupies.
+    int escapedLength(const ushort* src, int length);
+
+    // Writes the escaped form of [src, src + length) to dst, which must hold at
+    // least escapedLength(src, length) code units. Returns the end of the output.
+    // Code units XML does not allow, such as most controls and lone
+    // surrogates, are replaced with U+FFFD.
+    ushort* escape(const ushort* src, int length, ushort* dst);
+
+    // The same without the vector compares, as a reference for them.
+    int escapedLengthScalar(const ushort* src, int length);
+    ushort* escapeScalar(const ushort* src, int length, ushort* dst);
+
+    void appendEscaped(QString& out, const QString& text);
+    QString escaped(const QString& text);
+
+    // Builds the complete toast document for a template, replacing the former
+    // GetTemplateContent + DOM editing round-trips.
+    QString toastPayload(const QWinToastTemplate& toast, bool modernFeatures);
+}
+
+#endif // QWINTOASTXML
@@ -0,0 +1,110 @@
+#ifndef QWINTOASTPRIVATE
+#define QWINTOASTPRIVATE
+
+#include "QWinToast.h"
+#include "QWinToastClock.h"
+#include "QWinToastDedupe.h"
+#include "QWinToastExpiry.h"
+#include <QFutureInterface>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <iostream>
+#include <memory>
+
+#ifdef NDEBUG
+#define DEBUG_MSG(str) do { } while ( false )
+#else
+#define DEBUG_MSG(str) do { std::wcout << str << std::endl; } while( false )
+#endif
+
+class QWinToastInstance;
+class QWinToastDigest;
+struct QWinToastCatalogEntry;
+
+// State and delivery pipeline behind QWinToast. Not part of the installed
+// headers; backends and the library's own helpers include it.
+class QWinToastPrivate
+{
+public:
+    explicit QWinToastPrivate(QWinToast* toast);
+    ~QWinToastPrivate();
+
+    struct LiveToast
+    {
+        QString group;
+        QString tag;
+    };
+
+    struct PendingResult
+    {
+        QFutureInterface<QWinToastResult> promise;
+        void (*resume)(void*);
+        void* context;
+    };
+
+    QWinToast* const q;
+    bool _isInitialized{ false };
+    QWinToast::ShortcutPolicy _shortcutPolicy{ QWinToast::SHORTCUT_POLICY_REQUIRE_CREATE };
+    QString _appName{};
+    QString _aumi{};
+    mutable QMutex _bufferMutex;
+    QHash<qint64, LiveToast> _buffer{};
+    QHash<QPair<QString, QString>, qint64> _tags{};
+    QHash<QString, QSet<qint64>> _groups{};
+    QWinToastBackend* _backend{ nullptr };
+    QWinToastCommandRegistry _commands{};
+    std::unique_ptr<QWinToastInstance> _instance{};
+    std::unique_ptr<QWinToastDigest> _digest;
+    QWinToastDedupe _dedupe{};
+    QWinToastRetryPolicy _retryPolicy{};
+    QWinToastCircuitBreaker _breaker{};
+    // Deadlines on _clock; ids in _expired were already reported as TimedOut.
+    QWinToastClock* _clock{ QWinToastClock::system() };
+    QWinToastExpiryIndex _expiry{};
+    QSet<qint64> _expired{};
+    // Clock handle of the pending expiry callback, 0 for none.
+    quint64 _expiryTimer{ 0 };
+    QWinToastEventQueue _events{};
+    QWinToastTraceRecorder* _trace{ nullptr };
+    // Guarded by _bufferMutex; several callers may wait on one toast.
+    QMultiHash<qint64, PendingResult> _pending{};
+
+    void trackToast(qint64 id, const QString& group, const QString& tag);
+    bool untrackToast(qint64 id);
+    bool untrackLocked(qint64 id);
+    void resetTracking();
+    // Forgets every live toast; the caller holds _bufferMutex and settles
+    // the pending results it is handed once the lock is released.
+    void resetLocked(QMultiHash<qint64, PendingResult>& pending);
+    void scheduleExpiry(qint64 id, qint64 expiration);
+    void armExpiryTimer();
+    void expireToasts();
+    void releaseToast(qint64 id);
+    // Deduplication, digesting and delivery behind QWinToast::showToast().
+    qint64 showToast(const QWinToastTemplate& toast, QWinToast::QWinToastError* error);
+    qint64 showCatalogToast(const QWinToastCatalogEntry& entry, const QStringList& values, QWinToast::QWinToastError* error);
+    // Shows the toast without any pipeline stage; a non-negative id is reused.
+    qint64 deliverToast(const QWinToastTemplate& toast, QWinToast::QWinToastError* error, qint64 id = -1);
+    qint64 deliverPayload(const QString& tag, const QString& group, qint64 expiration,
+                          const std::function<QString()>& payload, QWinToast::QWinToastError* error, qint64 id);
+    void flushDigest(const QString& key);
+    bool admitShow();
+    void noteShowResult(bool succeeded);
+    void scheduleRetry(const QWinToastBackend::Request& request, bool replacing, int attempt);
+    void retryShow(const QWinToastBackend::Request& request, bool replacing, int attempt);
+    // Safe from any thread; the event is handled on the toast's thread.
+    void postToastEvent(QWinToastEvent&& event);
+    void drainToastEvents(bool collect);
+    void handleActivated(qint64 id, QStringView arguments);
+    void handleDismissed(qint64 id, QWinToast::WinToastDismissalReason reason);
+    void handleFailed(qint64 id);
+    // Fulfils every future waiting on result.id, then resumes suspended coroutines.
+    void resolveResult(const QWinToastResult& result);
+    void resolveHidden(qint64 id);
+    void resolveHidden(const QSet<qint64>& ids);
+    // Reports ApplicationHidden to every entry, taken out of _pending already.
+    void finishHidden(QMultiHash<qint64, PendingResult>& pending);
+};
+
+#endif // QWINTOASTPRIVATE
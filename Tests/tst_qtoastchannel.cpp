@@ -0,0 +1,151 @@
+#include "QToastChannel.h"
+#include "QWinToastCatalog.h"
+#include "QWinToastClock.h"
+#include "QWinToastFakeBackend.h"
+#include <QtTest>
+
+#define LITERAL(s) { s, static_cast<int>(sizeof(s) / sizeof(char16_t)) - 1, -1, false }
+
+namespace
+{
+	const QWinToastCatalogSegment BuildSegments[] = {
+		LITERAL(u"<toast><visual><binding template=\"ToastGeneric\"><text>"),
+		{ nullptr, 0, 0, false },
+		LITERAL(u"</text></binding></visual></toast>"),
+	};
+	const char* const BuildPlaceholders[] = { "status" };
+	const QWinToastCatalogEntry Build = {
+		"build", BuildSegments, 3, BuildSegments, 3, BuildPlaceholders, 1, 0, u"", u""
+	};
+}
+
+class TestQToastChannel : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void rateLimit_data()
+	{
+		QTest::addColumn<double>("rate");
+		QTest::addColumn<int>("burst");
+		QTest::addColumn<qint64>("interval");
+
+		QTest::newRow("one per two seconds") << 0.5 << 1 << qint64(2000);
+		QTest::newRow("one per second") << 1.0 << 1 << qint64(1000);
+		QTest::newRow("ten per second") << 10.0 << 10 << qint64(100);
+	}
+
+	void rateLimit()
+	{
+		QFETCH(double, rate);
+		QFETCH(int, burst);
+		QFETCH(qint64, interval);
+
+		QWinToastManualClock clock(1000);
+		QWinToastFakeBackend fake;
+		QToastChannel channel("QToastChannelTest", "QWinToast.ChannelTest");
+		channel.setClock(&clock);
+		channel.setBackend(&fake);
+		QVERIFY(channel.initialize());
+		channel.setMaxToastsPerSecond(rate);
+
+		const QWinToastTemplate toast(QWinToastTemplate::Text01);
+		for (int i = 0; i < burst; i++) {
+			QVERIFY(channel.showToast(toast) >= 0);
+		}
+		QWinToast::QWinToastError error = QWinToast::NoError;
+		QCOMPARE(channel.showToast(toast, &error), qint64(-1));
+		QCOMPARE(error, QWinToast::Throttled);
+
+		clock.advance(interval - 1);
+		QCOMPARE(channel.showToast(toast), qint64(-1));
+		clock.advance(interval);
+		QVERIFY(channel.showToast(toast) >= 0);
+		QCOMPARE(channel.counters().shown, quint64(burst + 1));
+		QCOMPARE(channel.counters().throttled, quint64(2));
+	}
+
+	// Only display failures count as failed; a toast given up on after
+	// retries stops counting as shown.
+	void counters()
+	{
+		QWinToastManualClock clock(1000);
+		QWinToastFakeBackend fake;
+		QToastChannel channel("QToastChannelTest", "QWinToast.ChannelTest");
+		channel.setClock(&clock);
+		channel.setBackend(&fake);
+		QVERIFY(channel.initialize());
+		channel.setDuplicateWindow(1000);
+		channel.setCircuitBreaker(3, 60000);
+		QWinToastRetryPolicy policy;
+		policy.maxAttempts = 2;
+		channel.setRetryPolicy(policy);
+
+		QWinToastTemplate toast(QWinToastTemplate::Text01);
+		toast.setTextField("first", QWinToastTemplate::FirstLine);
+		QVERIFY(channel.showToast(toast) >= 0);
+		QWinToast::QWinToastError error = QWinToast::NoError;
+		QCOMPARE(channel.showToast(toast, &error), qint64(-1));
+		QCOMPARE(error, QWinToast::Duplicate);
+
+		fake.setFailureRate(1.0);
+		fake.setFailureResult(QWinToastBackend::Pending);
+		toast.setTextField("second", QWinToastTemplate::FirstLine);
+		QVERIFY(channel.showToast(toast) >= 0);
+		QCOMPARE(channel.counters().shown, quint64(2));
+		QCoreApplication::processEvents();
+		clock.advance(policy.maxDelay);
+		QCOMPARE(channel.counters().shown, quint64(1));
+		QCOMPARE(channel.counters().failed, quint64(1));
+
+		// The third failure in a row opens the circuit.
+		fake.setFailureResult(QWinToastBackend::Failed);
+		toast.setTextField("third", QWinToastTemplate::FirstLine);
+		QCOMPARE(channel.showToast(toast, &error), qint64(-1));
+		QCOMPARE(error, QWinToast::NotDisplayed);
+		toast.setTextField("fourth", QWinToastTemplate::FirstLine);
+		QCOMPARE(channel.showToast(toast, &error), qint64(-1));
+		QCOMPARE(error, QWinToast::CircuitOpen);
+
+		const QToastChannel::Counters counters = channel.counters();
+		QCOMPARE(counters.shown, quint64(1));
+		QCOMPARE(counters.failed, quint64(2));
+		QCOMPARE(counters.rejected, quint64(2));
+		QCOMPARE(counters.throttled, quint64(0));
+	}
+
+	// Catalog toasts go through the same limits, deduplication and counters.
+	void catalogToasts()
+	{
+		QWinToastManualClock clock(1000);
+		QWinToastFakeBackend fake;
+		QToastChannel channel("QToastChannelTest", "QWinToast.ChannelTest");
+		channel.setClock(&clock);
+		channel.setBackend(&fake);
+		QVERIFY(channel.initialize());
+		channel.setDuplicateWindow(10000);
+		channel.setMaxToastsPerSecond(3);
+
+		QVERIFY(channel.showCatalogToast(Build, { "passed" }) >= 0);
+		QWinToast::QWinToastError error = QWinToast::NoError;
+		QCOMPARE(channel.showCatalogToast(Build, { "passed" }, &error), qint64(-1));
+		QCOMPARE(error, QWinToast::Duplicate);
+		QVERIFY(channel.showCatalogToast(Build, { "failed" }) >= 0);
+		QCOMPARE(channel.showCatalogToast(Build, { "fixed" }, &error), qint64(-1));
+		QCOMPARE(error, QWinToast::Throttled);
+
+		const QToastChannel::Counters counters = channel.counters();
+		QCOMPARE(counters.shown, quint64(2));
+		QCOMPARE(counters.rejected, quint64(1));
+		QCOMPARE(counters.throttled, quint64(1));
+		QCOMPARE(fake.payloadCount(), 2);
+
+		channel.setMaxLiveToasts(2);
+		clock.advance(1000);
+		QCOMPARE(channel.showCatalogToast(Build, { "fixed" }, &error), qint64(-1));
+		QCOMPARE(error, QWinToast::Throttled);
+	}
+};
+
+QTEST_GUILESS_MAIN(TestQToastChannel)
+#include "tst_qtoastchannel.moc"
@@ -0,0 +1,156 @@
+#include "QWinToastArguments.h"
+#include <QRandomGenerator>
+#include <QtTest>
+
+namespace
+{
+	QString randomText(QRandomGenerator& random, int minLength, int maxLength)
+	{
+		static const char Pool[] = "ac=&%0123456789AFaf";
+		const int length = minLength + random.bounded(maxLength - minLength + 1);
+		QString text;
+		text.reserve(length);
+		while (text.size() < length) {
+			switch (random.bounded(3)) {
+			case 0:
+				text += QChar(static_cast<ushort>(random.bounded(0x10000)));
+				break;
+			default:
+				text += QLatin1Char(Pool[random.bounded(int(sizeof(Pool) - 1))]);
+				break;
+			}
+		}
+		return text;
+	}
+}
+
+class TestQWinToastArguments : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void actionIndex_data()
+	{
+		QTest::addColumn<QString>("source");
+		QTest::addColumn<int>("index");
+
+		QTest::newRow("encoded") << "a=3" << 3;
+		QTest::newRow("encoded with command") << "c=approve&a=12&id=42" << 12;
+		QTest::newRow("legacy") << "5" << 5;
+		QTest::newRow("legacy multi digit") << "107" << 107;
+		QTest::newRow("legacy too long") << "1234567890" << -1;
+		QTest::newRow("legacy not a number") << "5x" << -1;
+		QTest::newRow("key with value") << "5=1" << -1;
+		QTest::newRow("two keys") << "5&6" << -1;
+		QTest::newRow("empty index") << "a=" << -1;
+		QTest::newRow("empty") << "" << -1;
+	}
+
+	void actionIndex()
+	{
+		QFETCH(QString, source);
+		QFETCH(int, index);
+		QCOMPARE(QWinToastArgumentsView(source).actionIndex(), index);
+	}
+
+	void reservedKeys()
+	{
+		QWinToastArguments arguments;
+		arguments.insert("a", "9").insert("c", "other").insert("", "empty").insert("id", "42");
+		QCOMPARE(arguments.encoded(), QString("id=42"));
+
+		const QString source = "a=0&c=approve&" + arguments.encoded();
+		const QWinToastArgumentsView view(source);
+		QCOMPARE(view.actionIndex(), 0);
+		QCOMPARE(view.command().toString(), QString("approve"));
+	}
+
+	void dispatch_data()
+	{
+		QTest::addColumn<QString>("name");
+		QTest::addColumn<QString>("encoded");
+
+		QTest::newRow("plain") << "approve" << "approve";
+		QTest::newRow("special") << "a&b=c%d" << "a%26b%3Dc%25d";
+		QTest::newRow("lowercase hex") << "a&b=c%d" << "a%26b%3dc%25d";
+		QTest::newRow("over encoded") << "approve" << "%61pprove";
+	}
+
+	void dispatch()
+	{
+		QFETCH(QString, name);
+		QFETCH(QString, encoded);
+
+		QWinToastCommandRegistry registry;
+		qint64 calledWith = -1;
+		registry.registerCommand("other", [](qint64, const QWinToastArgumentsView&) { QFAIL("wrong handler"); });
+		const int id = registry.registerCommand(name, [&](qint64 toastId, const QWinToastArgumentsView& arguments) {
+			calledWith = toastId;
+			QCOMPARE(arguments.value(QStringView(u"id")).toString(), QString("42"));
+		});
+		QCOMPARE(registry.commandId(name), id);
+
+		const QString source = "a=0&c=" + encoded + "&id=42";
+		QVERIFY(registry.dispatch(7, QWinToastArgumentsView(source)));
+		QCOMPARE(calledWith, qint64(7));
+
+		registry.unregisterCommand(name);
+		QVERIFY(!registry.dispatch(7, QWinToastArgumentsView(source)));
+	}
+
+	void roundTrip()
+	{
+		QRandomGenerator random(1);
+		for (int round = 0; round < 10000; round++) {
+			QWinToastArguments arguments;
+			QVector<QPair<QString, QString>> pairs;
+			const int count = random.bounded(QWinToastArgumentsView::MaxPairs + 1);
+			for (int i = 0; i < count; i++) {
+				// Prefixed, so a key is never empty or reserved.
+				const QString key = "k" + randomText(random, 0, 8);
+				const QString value = randomText(random, 0, 16);
+				arguments.insert(key, value);
+				pairs.append(qMakePair(key, value));
+			}
+
+			const QString source = arguments.encoded();
+			const QWinToastArgumentsView view(source);
+			QCOMPARE(view.count(), count);
+			QVERIFY(!view.isTruncated());
+			for (int i = 0; i < count; i++) {
+				QCOMPARE(QWinToastArgumentsView::decode(view.key(i)), pairs[i].first);
+				QCOMPARE(QWinToastArgumentsView::decode(view.value(i)), pairs[i].second);
+			}
+		}
+	}
+
+	// Arbitrary launch strings come from the shell; none may crash the
+	// parser or yield a view outside its source.
+	void fuzz()
+	{
+		QRandomGenerator random(2);
+		QWinToastCommandRegistry registry;
+		registry.registerCommand("a&b", [](qint64, const QWinToastArgumentsView&) {});
+		for (int round = 0; round < 100000; round++) {
+			const QString source = randomText(random, 0, 64);
+			const QWinToastArgumentsView view(source);
+			QVERIFY(view.count() >= 0 && view.count() <= QWinToastArgumentsView::MaxPairs);
+			for (int i = 0; i < view.count(); i++) {
+				const QStringView key = view.key(i);
+				const QStringView value = view.value(i);
+				QVERIFY(!key.isEmpty());
+				QVERIFY(key.data() >= source.constData() && key.data() + key.size() <= source.constData() + source.size());
+				QVERIFY(value.data() >= source.constData() && value.data() + value.size() <= source.constData() + source.size());
+				QVERIFY(!key.toString().contains(QLatin1Char('&')) && !key.toString().contains(QLatin1Char('=')));
+				QVERIFY(!value.toString().contains(QLatin1Char('&')));
+				QVERIFY(QWinToastArgumentsView::decode(value).size() <= value.size());
+			}
+			QVERIFY(view.key(view.count()).isEmpty());
+			QVERIFY(view.actionIndex() >= -1);
+			registry.dispatch(round, view);
+		}
+	}
+};
+
+QTEST_APPLESS_MAIN(TestQWinToastArguments)
+#include "tst_qwintoastarguments.moc"
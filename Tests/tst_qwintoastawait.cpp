@@ -0,0 +1,105 @@
+#include "QWinToastAwait.h"
+#include "QWinToastFakeBackend.h"
+#include <QtTest>
+
+#ifdef QWINTOAST_HAS_COROUTINES
+namespace
+{
+	// Fire-and-forget coroutine: runs eagerly and frees its frame on completion.
+	struct Task
+	{
+		struct promise_type
+		{
+			Task get_return_object() { return Task(); }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() { std::terminate(); }
+		};
+	};
+
+	// Two prompts in a row, as a wizard would show them.
+	Task prompt(QWinToast& toast, QVector<QWinToastResult>& results)
+	{
+		results.append(co_await QWinToastAwaitable(toast, QWinToastTemplate(QWinToastTemplate::Text01)));
+		results.append(co_await QWinToastAwaitable(toast, QWinToastTemplate(QWinToastTemplate::Text02)));
+	}
+}
+#endif
+
+class TestQWinToastAwait : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void init()
+	{
+#ifndef QWINTOAST_HAS_COROUTINES
+		QSKIP("The compiler does not support coroutines.");
+#endif
+		_fake.reset(new QWinToastFakeBackend());
+		_toast.reset(new QWinToast());
+		_toast->setAppName("QWinToastTest");
+		_toast->setAppUserModelID("QWinToast.Test");
+		_toast->setBackend(_fake.get());
+		QVERIFY(_toast->initialize());
+	}
+
+	void cleanup()
+	{
+		_toast.reset();
+		_fake.reset();
+	}
+
+	// The slots are declared either way, as moc does not see the compiler's
+	// feature macros.
+	void activationThenDismissal()
+	{
+#ifdef QWINTOAST_HAS_COROUTINES
+		QVector<QWinToastResult> results;
+		prompt(*_toast, results);
+		QVERIFY(results.isEmpty());
+		QCOMPARE(_fake->liveToasts().size(), 1);
+
+		// Resumes while the event is handled and shows the second prompt.
+		const qint64 first = _fake->liveToasts().first();
+		QVERIFY(_fake->activateAction(first, 0));
+		QCoreApplication::processEvents();
+		QCOMPARE(results.size(), 1);
+		QCOMPARE(results[0].outcome, QWinToastResult::Activated);
+		QCOMPARE(results[0].id, first);
+		QCOMPARE(results[0].actionIndex, 0);
+		QCOMPARE(_fake->liveToasts().size(), 1);
+
+		const qint64 second = _fake->liveToasts().first();
+		QVERIFY(second != first);
+		QVERIFY(_fake->dismiss(second, QWinToast::UserCanceled));
+		QCoreApplication::processEvents();
+		QCOMPARE(results.size(), 2);
+		QCOMPARE(results[1].outcome, QWinToastResult::Dismissed);
+		QCOMPARE(results[1].id, second);
+		QCOMPARE(results[1].reason, QWinToast::UserCanceled);
+		QCOMPARE(_toast->liveToastCount(), 0);
+#endif
+	}
+
+	// A toast that was never shown resolves at once, without suspending.
+	void failedShowDoesNotSuspend()
+	{
+#ifdef QWINTOAST_HAS_COROUTINES
+		_fake->setFailureRate(1.0);
+		QVector<QWinToastResult> results;
+		prompt(*_toast, results);
+		QCOMPARE(results.size(), 2);
+		QCOMPARE(results[0].outcome, QWinToastResult::Failed);
+		QCOMPARE(results[1].outcome, QWinToastResult::Failed);
+#endif
+	}
+
+private:
+	std::unique_ptr<QWinToastFakeBackend> _fake;
+	std::unique_ptr<QWinToast> _toast;
+};
+
+QTEST_GUILESS_MAIN(TestQWinToastAwait)
+#include "tst_qwintoastawait.moc"
@@ -0,0 +1,103 @@
+#include "QWinToast.h"
+#include "QWinToastFakeBackend.h"
+#include "QWinToastMetrics.h"
+#include <QtTest>
+
+namespace
+{
+	QWinToastTemplate status(const QString& text, const QString& group, const QString& tag = QString())
+	{
+		QWinToastTemplate toast(QWinToastTemplate::Text01);
+		toast.setTextField(text, QWinToastTemplate::FirstLine);
+		toast.setGroup(group);
+		toast.setTag(tag);
+		return toast;
+	}
+
+	qint64 hiddenTotal()
+	{
+		return QWinToastMetrics::global()->counter("qwintoast_toasts_hidden_total", "Toasts hidden by the application.")->value();
+	}
+}
+
+// clearGroup() and clear() take toasts off screen, stop tracking them and
+// settle their results as ApplicationHidden.
+class TestQWinToastClear : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void init()
+	{
+		_fake.reset(new QWinToastFakeBackend());
+		_toast.reset(new QWinToast());
+		_toast->setAppName("QWinToastTest");
+		_toast->setAppUserModelID("QWinToast.Test");
+		_toast->setBackend(_fake.get());
+		QVERIFY(_toast->initialize());
+	}
+
+	void cleanup()
+	{
+		_toast.reset();
+		_fake.reset();
+	}
+
+	void clearGroup()
+	{
+		qint64 build = -1;
+		const QFuture<QWinToastResult> future = _toast->showToastForResult(status("50%", "build", "progress"), nullptr, &build);
+		const qint64 log = _toast->showToast(status("Compiling", "build"));
+		const qint64 upload = _toast->showToast(status("50%", "upload", "progress"));
+		QVERIFY(build >= 0 && log >= 0 && upload >= 0);
+		const qint64 hidden = hiddenTotal();
+
+		_toast->clearGroup("build");
+		QCOMPARE(hiddenTotal() - hidden, qint64(2));
+		QCOMPARE(_toast->liveToastCount(), 1);
+		QCOMPARE(_fake->liveToasts(), QVector<qint64>{ upload });
+		QVERIFY(future.isFinished());
+		QCOMPARE(future.result().outcome, QWinToastResult::Dismissed);
+		QCOMPARE(future.result().reason, QWinToast::ApplicationHidden);
+
+		// The tag is free again; the other group's is not.
+		const qint64 next = _toast->showToast(status("75%", "build", "progress"));
+		QVERIFY(next >= 0);
+		QVERIFY(next != build);
+		QCOMPARE(_toast->showToast(status("75%", "upload", "progress")), upload);
+
+		// Nothing left in the group: no backend call, no metric.
+		_toast->clearGroup("missing");
+		QCOMPARE(hiddenTotal() - hidden, qint64(2));
+	}
+
+	void clear()
+	{
+		qint64 id = -1;
+		const QFuture<QWinToastResult> future = _toast->showToastForResult(status("50%", "build", "progress"), nullptr, &id);
+		QVERIFY(_toast->showToast(status("Done", "upload")) >= 0);
+		QVERIFY(_toast->showToast(QWinToastTemplate(QWinToastTemplate::Text01)) >= 0);
+		const qint64 hidden = hiddenTotal();
+
+		_toast->clear();
+		QCOMPARE(hiddenTotal() - hidden, qint64(3));
+		QCOMPARE(_toast->liveToastCount(), 0);
+		QVERIFY(_fake->liveToasts().isEmpty());
+		QVERIFY(future.isFinished());
+		QCOMPARE(future.result().id, id);
+		QCOMPARE(future.result().reason, QWinToast::ApplicationHidden);
+
+		const qint64 next = _toast->showToast(status("75%", "build", "progress"));
+		QVERIFY(next >= 0);
+		QVERIFY(next != id);
+		_toast->clear();
+		QCOMPARE(hiddenTotal() - hidden, qint64(4));
+	}
+
+private:
+	std::unique_ptr<QWinToastFakeBackend> _fake;
+	std::unique_ptr<QWinToast> _toast;
+};
+
+QTEST_GUILESS_MAIN(TestQWinToastClear)
+#include "tst_qwintoastclear.moc"
@@ -0,0 +1,169 @@
+#include "QToastChannel.h"
+#include "QWinToast.h"
+#include "QWinToastClock.h"
+#include "QWinToastFakeBackend.h"
+#include "QWinToastRetry.h"
+#include "QWinToastTrace.h"
+#include <QBuffer>
+#include <QtTest>
+
+class TestQWinToastClock : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void eventsUseTheToastClock()
+	{
+		QWinToastManualClock clock(5000);
+		QWinToastFakeBackend fake;
+		QWinToast toast;
+		toast.setAppName("QWinToastTest");
+		toast.setAppUserModelID("QWinToast.Test");
+		toast.setClock(&clock);
+		toast.setBackend(&fake);
+		QVERIFY(toast.initialize());
+
+		QVector<QWinToastEvent> received;
+		connect(&toast, &QWinToast::toastEventsBatch, [&](const QVector<QWinToastEvent>& events) {
+			received += events;
+		});
+		const qint64 id = toast.showToast(QWinToastTemplate(QWinToastTemplate::Text01));
+		QVERIFY(id >= 0);
+		clock.advance(250);
+		QVERIFY(fake.dismiss(id, QWinToast::UserCanceled));
+		QCoreApplication::processEvents();
+
+		QCOMPARE(received.size(), 1);
+		QCOMPARE(received[0].timestamp, qint64(5250) * 1000000);
+	}
+
+	// Record times come from the toast's clock, so they are exact under a
+	// manual one.
+	void traceUsesTheToastClock()
+	{
+		QWinToastManualClock clock(1000);
+		QWinToastFakeBackend fake;
+		QWinToast toast;
+		toast.setAppName("QWinToastTest");
+		toast.setAppUserModelID("QWinToast.Test");
+		toast.setClock(&clock);
+		toast.setBackend(&fake);
+		QVERIFY(toast.initialize());
+
+		QBuffer buffer;
+		buffer.open(QIODevice::WriteOnly);
+		QWinToastTraceRecorder recorder;
+		toast.setTraceRecorder(&recorder);
+		QVERIFY(recorder.start(&buffer));
+		clock.advance(1500);
+		toast.clearGroup("g");
+		clock.advance(20);
+		toast.clear();
+		recorder.stop();
+
+		// Kind, zigzag microseconds since the previous record, fields.
+		const QByteArray expected = QByteArray("QWTT\x02", 5)
+			+ "\x04" + QByteArray("\xC0\x8D\xB7\x01", 4) + "\x01g"
+			+ "\x03" + QByteArray("\xC0\xB8\x02", 3);
+		QCOMPARE(buffer.data(), expected);
+	}
+
+	// A day of hourly traffic in a few milliseconds of wall time: each hour
+	// throttles a burst, collapses a digest, expires a toast and gives up on
+	// one after its retries.
+	void dayOfTraffic()
+	{
+		const qint64 start = 1000;
+		const qint64 hour = 3600000;
+		QWinToastManualClock clock(start);
+		QWinToastFakeBackend fake;
+		QToastChannel channel("QWinToastTest", "QWinToast.Test");
+		channel.setClock(&clock);
+		channel.setBackend(&fake);
+		QVERIFY(channel.initialize());
+		channel.setMaxToastsPerSecond(1);
+		channel.setDigestWindow(60000);
+		channel.setCircuitBreaker(0, 0);
+		QWinToastRetryPolicy policy;
+		policy.maxAttempts = 3;
+		policy.initialDelay = 100;
+		policy.maxDelay = 5000;
+		channel.setRetryPolicy(policy);
+
+		int timedOut = 0;
+		int notDisplayed = 0;
+		connect(&channel, &QWinToast::toastDismissed, [&timedOut](QWinToast::WinToastDismissalReason reason) {
+			timedOut += reason == QWinToast::TimedOut;
+		});
+		connect(&channel, &QWinToast::toastNotDisplayed, [&notDisplayed]() {
+			notDisplayed++;
+		});
+
+		QWinToastTemplate expiring(QWinToastTemplate::Text01);
+		expiring.setExpiration(600000);
+		QWinToastTemplate build(QWinToastTemplate::Text02);
+		build.setTextField("Build", QWinToastTemplate::FirstLine);
+		build.setDigestKey("builds");
+		const QWinToastTemplate plain(QWinToastTemplate::Text01);
+
+		for (int h = 0; h < 24; h++) {
+			const qint64 t0 = start + h * hour;
+			const auto at = [&](qint64 offset) {
+				clock.advanceTo(t0 + offset);
+				QCoreApplication::processEvents();
+			};
+			at(0);
+
+			// The bucket refilled over the idle hour, but holds one token.
+			QVERIFY(channel.showToast(expiring) >= 0);
+			QWinToast::QWinToastError error = QWinToast::NoError;
+			QCOMPARE(channel.showToast(plain, &error), qint64(-1));
+			QCOMPARE(error, QWinToast::Throttled);
+			QCoreApplication::processEvents();
+
+			// One toast now, one summary when the window closes.
+			at(10000);
+			const qint64 digest = channel.showToast(build);
+			QVERIFY(digest >= 0);
+			at(20000);
+			QCOMPARE(channel.showToast(build), digest);
+			at(30000);
+			QCOMPARE(channel.showToast(build), digest);
+
+			// Every attempt fails transiently; the backoff stays under a second.
+			at(40000);
+			fake.setFailureRate(1.0);
+			fake.setFailureResult(QWinToastBackend::Pending);
+			QVERIFY(channel.showToast(plain) >= 0);
+			QCoreApplication::processEvents();
+			at(41000);
+			QCOMPARE(notDisplayed, h + 1);
+			fake.setFailureRate(0.0);
+
+			at(69999);
+			QCOMPARE(fake.payloadCount(), 3 * h + 2);
+			at(70000);
+			QCOMPARE(fake.payloadCount(), 3 * h + 3);
+
+			at(599999);
+			QCOMPARE(timedOut, h);
+			at(600000);
+			QCOMPARE(timedOut, h + 1);
+
+			// Only the digest summary is left on screen.
+			at(hour - 1);
+			QCOMPARE(fake.liveToasts(), QVector<qint64>{ digest });
+			QCOMPARE(channel.liveToastCount(), 1);
+		}
+
+		QCOMPARE(clock.now(), start + 24 * hour - 1);
+		QCOMPARE(channel.digestedToastCount(), quint64(48));
+		const QToastChannel::Counters counters = channel.counters();
+		QCOMPARE(counters.throttled, quint64(24));
+		QCOMPARE(counters.failed, quint64(24));
+		QCOMPARE(counters.shown, quint64(24 * 4));
+	}
+};
+
+QTEST_GUILESS_MAIN(TestQWinToastClock)
+#include "tst_qwintoastclock.moc"
@@ -0,0 +1,223 @@
+#include "QWinToast.h"
+#include "QWinToastCodec.h"
+#include <QDataStream>
+#include <QRandomGenerator>
+#include <QtTest>
+
+namespace
+{
+	QString randomText(QRandomGenerator& random)
+	{
+		QString text;
+		const int length = random.bounded(12);
+		for (int i = 0; i < length; i++) {
+			// Mostly ASCII, sometimes a BMP character or a valid pair.
+			switch (random.bounded(8)) {
+			case 0:
+				text += QChar(static_cast<ushort>(0x80 + random.bounded(0xD800 - 0x80)));
+				break;
+			case 1:
+				text += QChar(0xD83D);
+				text += QChar(0xDE00);
+				break;
+			default:
+				text += QChar(static_cast<ushort>(' ' + random.bounded(95)));
+				break;
+			}
+		}
+		return text;
+	}
+
+	QWinToastTemplate randomTemplate(QRandomGenerator& random)
+	{
+		QWinToastTemplate toast(QWinToastTemplate::WinToastTemplateType(random.bounded(8)));
+		for (std::size_t i = 0; i < toast.textFieldsCount(); i++) {
+			toast.setTextField(randomText(random), QWinToastTemplate::TextField(i));
+		}
+		if (random.bounded(2)) {
+			toast.setImagePath(randomText(random));
+		}
+		if (random.bounded(2)) {
+			toast.setAudioPath(randomText(random));
+		}
+		toast.setAudioOption(QWinToastTemplate::AudioOption(random.bounded(3)));
+		toast.setDuration(QWinToastTemplate::Duration(random.bounded(3)));
+		toast.setAttributionText(randomText(random));
+		toast.setScenario(QWinToastTemplate::Scenario(random.bounded(4)));
+		toast.setExpiration(random.bounded(2) ? 0 : qint64(random.generate64() >> 1) * (random.bounded(2) ? 1 : -1));
+		for (int i = random.bounded(6); i > 0; i--) {
+			if (random.bounded(2)) {
+				toast.addAction(randomText(random));
+			}
+			else {
+				toast.addAction(randomText(random), randomText(random), QWinToastArguments().insert("id", randomText(random)));
+			}
+		}
+		toast.setTag(randomText(random));
+		toast.setGroup(randomText(random));
+		toast.setDigestKey(randomText(random));
+		return toast;
+	}
+
+	void putVarint(QByteArray& out, quint64 value)
+	{
+		while (value >= 0x80) {
+			out += static_cast<char>((value & 0x7f) | 0x80);
+			value >>= 7;
+		}
+		out += static_cast<char>(value);
+	}
+
+	// Wraps a body in a record with the current version.
+	QByteArray record(const QByteArray& fields)
+	{
+		QByteArray out;
+		putVarint(out, fields.size() + 1);
+		out += static_cast<char>(QWinToastCodec::Version);
+		return out + fields;
+	}
+
+	void compareTemplates(const QWinToastTemplate& actual, const QWinToastTemplate& expected)
+	{
+		QCOMPARE(actual.type(), expected.type());
+		QCOMPARE(actual.textFields(), expected.textFields());
+		QCOMPARE(actual.imagePath(), expected.imagePath());
+		QCOMPARE(actual.audioPath(), expected.audioPath());
+		QCOMPARE(actual.audioOption(), expected.audioOption());
+		QCOMPARE(actual.duration(), expected.duration());
+		QCOMPARE(actual.attributionText(), expected.attributionText());
+		QCOMPARE(actual.scenario(), expected.scenario());
+		QCOMPARE(actual.expiration(), expected.expiration());
+		QCOMPARE(actual.actionsCount(), expected.actionsCount());
+		for (std::size_t i = 0; i < expected.actionsCount(); i++) {
+			QCOMPARE(actual.actionLabel(i), expected.actionLabel(i));
+			QCOMPARE(actual.actionArguments(i), expected.actionArguments(i));
+		}
+		QCOMPARE(actual.tag(), expected.tag());
+		QCOMPARE(actual.group(), expected.group());
+		QCOMPARE(actual.digestKey(), expected.digestKey());
+	}
+}
+
+class TestQWinToastCodec : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void roundTrip()
+	{
+		QRandomGenerator random(1);
+		for (int i = 0; i < 5000; i++) {
+			const QWinToastTemplate toast = randomTemplate(random);
+			const QByteArray encoded = QWinToastCodec::encode(toast);
+			QWinToastTemplate decoded;
+			QCOMPARE(QWinToastCodec::decode(encoded.constData(), encoded.size(), decoded), encoded.size());
+			compareTemplates(decoded, toast);
+			if (QTest::currentTestFailed()) {
+				return;
+			}
+			QCOMPARE(QWinToastCodec::encode(decoded), encoded);
+		}
+	}
+
+	void stream()
+	{
+		QRandomGenerator random(2);
+		QVector<QWinToastTemplate> toasts;
+		QByteArray buffer;
+		{
+			QDataStream out(&buffer, QIODevice::WriteOnly);
+			for (int i = 0; i < 100; i++) {
+				toasts.append(randomTemplate(random));
+				out << toasts.last();
+			}
+		}
+		QDataStream in(buffer);
+		for (const QWinToastTemplate& expected : toasts) {
+			QWinToastTemplate decoded;
+			in >> decoded;
+			QCOMPARE(in.status(), QDataStream::Ok);
+			compareTemplates(decoded, expected);
+		}
+		QVERIFY(in.atEnd());
+	}
+
+	void truncated()
+	{
+		QRandomGenerator random(3);
+		for (int i = 0; i < 200; i++) {
+			const QByteArray encoded = QWinToastCodec::encode(randomTemplate(random));
+			for (int size = 0; size < encoded.size(); size++) {
+				QWinToastTemplate decoded;
+				QCOMPARE(QWinToastCodec::decode(encoded.constData(), size, decoded), 0);
+			}
+		}
+	}
+
+	// A newer writer's fields, whatever their wire type, are skipped and the
+	// known ones around them still decoded.
+	void skipsUnknownFields()
+	{
+		QWinToastTemplate toast(QWinToastTemplate::Text01);
+		toast.setFirstLine("known");
+		toast.setTag("tag");
+		const QByteArray known = QWinToastCodec::encode(toast);
+		const QByteArray body = known.mid(2);
+		QCOMPARE(quint8(known[0]), quint8(known.size() - 1));
+
+		QByteArray unknown;
+		putVarint(unknown, quint64(100) << 3 | 0);
+		putVarint(unknown, 1234567);
+		putVarint(unknown, quint64(101) << 3 | 1);
+		unknown += QByteArray(8, '\xff');
+		putVarint(unknown, quint64(102) << 3 | 2);
+		putVarint(unknown, 3);
+		unknown += "abc";
+		putVarint(unknown, quint64(103) << 3 | 5);
+		unknown += QByteArray(4, '\x80');
+		// A known number with a wire type it never uses.
+		putVarint(unknown, quint64(2) << 3 | 5);
+		unknown += QByteArray(4, 'x');
+
+		const QByteArray mixed = record(unknown + body + unknown);
+		QWinToastTemplate decoded;
+		QCOMPARE(QWinToastCodec::decode(mixed.constData(), mixed.size(), decoded), mixed.size());
+		compareTemplates(decoded, toast);
+	}
+
+	void malformed_data()
+	{
+		QTest::addColumn<QByteArray>("fields");
+
+		QByteArray group;
+		putVarint(group, quint64(100) << 3 | 3);
+		QTest::newRow("start group") << group;
+		QByteArray reserved;
+		putVarint(reserved, quint64(100) << 3 | 7);
+		QTest::newRow("reserved wire type") << reserved;
+		QByteArray shortFixed;
+		putVarint(shortFixed, quint64(100) << 3 | 1);
+		shortFixed += "1234";
+		QTest::newRow("short fixed64") << shortFixed;
+		QByteArray longBytes;
+		putVarint(longBytes, quint64(100) << 3 | 2);
+		putVarint(longBytes, 10);
+		longBytes += "abc";
+		QTest::newRow("bytes past the body") << longBytes;
+		QByteArray badType;
+		putVarint(badType, quint64(1) << 3 | 0);
+		putVarint(badType, 99);
+		QTest::newRow("template type out of range") << badType;
+	}
+
+	void malformed()
+	{
+		QFETCH(QByteArray, fields);
+		const QByteArray bad = record(fields);
+		QWinToastTemplate decoded;
+		QCOMPARE(QWinToastCodec::decode(bad.constData(), bad.size(), decoded), -1);
+	}
+};
+
+QTEST_APPLESS_MAIN(TestQWinToastCodec)
+#include "tst_qwintoastcodec.moc"
@@ -0,0 +1,194 @@
+#include "QWinToast.h"
+#include "QWinToastClock.h"
+#include "QWinToastDaemon.h"
+#include "QWinToastDaemonClient.h"
+#include "QWinToastFakeBackend.h"
+#include <QtTest>
+
+// Daemon and client share this process and its event loop; the fake backend
+// stands in for the shell behind the daemon.
+namespace
+{
+	struct Outcome
+	{
+		qint64 request;
+		QString kind;
+		int value;
+		QString arguments;
+	};
+
+	void collect(QWinToastDaemonClient& client, QVector<Outcome>& outcomes)
+	{
+		QObject::connect(&client, &QWinToastDaemonClient::activated, [&outcomes](qint64 request, int actionIndex, const QString& arguments) {
+			outcomes.append(Outcome{ request, "activated", actionIndex, arguments });
+		});
+		QObject::connect(&client, &QWinToastDaemonClient::dismissed, [&outcomes](qint64 request, QWinToast::WinToastDismissalReason reason) {
+			outcomes.append(Outcome{ request, "dismissed", reason, QString() });
+		});
+		QObject::connect(&client, &QWinToastDaemonClient::failed, [&outcomes](qint64 request) {
+			outcomes.append(Outcome{ request, "failed", 0, QString() });
+		});
+		QObject::connect(&client, &QWinToastDaemonClient::rejected, [&outcomes](qint64 request, QWinToast::QWinToastError error) {
+			outcomes.append(Outcome{ request, "rejected", error, QString() });
+		});
+	}
+
+	QWinToastTemplate numbered(int i)
+	{
+		QWinToastTemplate toast(QWinToastTemplate::Text01);
+		toast.setTextField(QString("toast %1").arg(i), QWinToastTemplate::FirstLine);
+		return toast;
+	}
+
+	// The fake's toast id for a shown text, -1 while it has not arrived.
+	qint64 toastFor(const QWinToastFakeBackend& fake, int i)
+	{
+		const QString text = QString(">toast %1<").arg(i);
+		for (const QWinToastFakeBackend::Payload& payload : fake.payloads()) {
+			if (payload.request.xml.contains(text)) {
+				return payload.request.id;
+			}
+		}
+		return -1;
+	}
+}
+
+class TestQWinToastDaemon : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void init()
+	{
+		_name = QString("qwintoastd-test-%1-%2").arg(QCoreApplication::applicationPid()).arg(QTest::currentTestFunction());
+		_clock.reset(new QWinToastManualClock(1000));
+		_fake.reset(new QWinToastFakeBackend());
+		_toast.reset(new QWinToast());
+		_toast->setAppName("QWinToastTest");
+		_toast->setAppUserModelID("QWinToast.Test");
+		_toast->setClock(_clock.get());
+		_toast->setBackend(_fake.get());
+		QVERIFY(_toast->initialize());
+	}
+
+	void cleanup()
+	{
+		_toast.reset();
+		_fake.reset();
+		_clock.reset();
+	}
+
+	// Requests are sent back to back and outcomes stream back as they happen,
+	// in whatever order the toasts resolve.
+	void pipelinedResults()
+	{
+		QWinToastDaemon::Quota quota;
+		quota.maxLive = 0;
+		quota.rate = 0.0;
+		QWinToastDaemon daemon(_toast.get(), quota);
+		QVERIFY2(daemon.listen(_name), qPrintable(daemon.errorString()));
+
+		QWinToastDaemonClient client;
+		QVector<Outcome> outcomes;
+		collect(client, outcomes);
+		QVERIFY(client.connectToDaemon(_name));
+		QVector<qint64> requests;
+		for (int i = 0; i < 3; i++) {
+			requests.append(client.show(numbered(i)));
+		}
+		QCOMPARE(requests, (QVector<qint64>{ 1, 2, 3 }));
+		QTRY_COMPARE(_fake->liveToasts().size(), 3);
+		QCOMPARE(daemon.clientCount(), 1);
+
+		QVERIFY(_fake->activate(toastFor(*_fake, 1), "a=2&order=42"));
+		QTRY_COMPARE(outcomes.size(), 1);
+		QCOMPARE(outcomes[0].request, requests[1]);
+		QCOMPARE(outcomes[0].kind, QString("activated"));
+		QCOMPARE(outcomes[0].value, 2);
+		QCOMPARE(outcomes[0].arguments, QString("a=2&order=42"));
+
+		QVERIFY(_fake->fail(toastFor(*_fake, 2)));
+		QVERIFY(_fake->dismiss(toastFor(*_fake, 0), QWinToast::UserCanceled));
+		QTRY_COMPARE(outcomes.size(), 3);
+		QCOMPARE(outcomes[1].request, requests[2]);
+		QCOMPARE(outcomes[1].kind, QString("failed"));
+		QCOMPARE(outcomes[2].request, requests[0]);
+		QCOMPARE(outcomes[2].kind, QString("dismissed"));
+		QCOMPARE(outcomes[2].value, int(QWinToast::UserCanceled));
+
+		// Hiding is reported through the same stream.
+		const qint64 hidden = client.show(numbered(3));
+		QTRY_VERIFY(toastFor(*_fake, 3) >= 0);
+		client.hide(hidden);
+		QTRY_COMPARE(outcomes.size(), 4);
+		QCOMPARE(outcomes[3].request, hidden);
+		QCOMPARE(outcomes[3].kind, QString("dismissed"));
+		QCOMPARE(outcomes[3].value, int(QWinToast::ApplicationHidden));
+	}
+
+	void quotaRejects()
+	{
+		QWinToastDaemon::Quota quota;
+		quota.maxLive = 2;
+		quota.rate = 1.0;
+		quota.burst = 2.0;
+		QWinToastDaemon daemon(_toast.get(), quota);
+		QVERIFY2(daemon.listen(_name), qPrintable(daemon.errorString()));
+
+		QWinToastDaemonClient client;
+		QVector<Outcome> outcomes;
+		collect(client, outcomes);
+		QVERIFY(client.connectToDaemon(_name));
+
+		// Over the live limit.
+		client.show(numbered(0));
+		client.show(numbered(1));
+		const qint64 overLive = client.show(numbered(2));
+		QTRY_COMPARE(outcomes.size(), 1);
+		QCOMPARE(outcomes[0].request, overLive);
+		QCOMPARE(outcomes[0].kind, QString("rejected"));
+		QCOMPARE(outcomes[0].value, int(QWinToast::Throttled));
+		QCOMPARE(_fake->liveToasts().size(), 2);
+
+		// The two shown toasts used up the burst; the bucket refills on the
+		// toast's clock.
+		QVERIFY(_fake->dismiss(toastFor(*_fake, 0), QWinToast::UserCanceled));
+		QTRY_COMPARE(outcomes.size(), 2);
+		const qint64 overRate = client.show(numbered(3));
+		QTRY_COMPARE(outcomes.size(), 3);
+		QCOMPARE(outcomes[2].request, overRate);
+		QCOMPARE(outcomes[2].kind, QString("rejected"));
+		QCOMPARE(outcomes[2].value, int(QWinToast::Throttled));
+
+		_clock->advance(1000);
+		client.show(numbered(4));
+		QTRY_VERIFY(toastFor(*_fake, 4) >= 0);
+		QCOMPARE(outcomes.size(), 3);
+	}
+
+	// A second daemon must not take the name from a running one.
+	void runningDaemonKeepsItsName()
+	{
+		QWinToastDaemon::Quota quota;
+		QWinToastDaemon first(_toast.get(), quota);
+		QVERIFY2(first.listen(_name), qPrintable(first.errorString()));
+
+		QWinToastDaemon second(_toast.get(), quota);
+		QVERIFY(!second.listen(_name));
+		QVERIFY(second.errorString().contains("already running"));
+
+		QWinToastDaemonClient client;
+		QVERIFY(client.connectToDaemon(_name));
+		client.show(numbered(0));
+		QTRY_VERIFY(toastFor(*_fake, 0) >= 0);
+	}
+
+private:
+	QString _name;
+	std::unique_ptr<QWinToastManualClock> _clock;
+	std::unique_ptr<QWinToastFakeBackend> _fake;
+	std::unique_ptr<QWinToast> _toast;
+};
+
+QTEST_GUILESS_MAIN(TestQWinToastDaemon)
+#include "tst_qwintoastdaemon.moc"
@@ -0,0 +1,95 @@
+#include "QWinToast.h"
+#include "QWinToastClock.h"
+#include "QWinToastDedupe.h"
+#include "QWinToastFakeBackend.h"
+#include <QtTest>
+
+namespace
+{
+	QWinToastTemplate status(const QString& text, const QString& group = QString(), const QString& tag = QString())
+	{
+		QWinToastTemplate toast(QWinToastTemplate::Text01);
+		toast.setTextField(text, QWinToastTemplate::FirstLine);
+		toast.setGroup(group);
+		toast.setTag(tag);
+		return toast;
+	}
+}
+
+class TestQWinToastDedupe : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void init()
+	{
+		_clock.reset(new QWinToastManualClock(1000));
+		_fake.reset(new QWinToastFakeBackend());
+		_toast.reset(new QWinToast());
+		_toast->setAppName("QWinToastTest");
+		_toast->setAppUserModelID("QWinToast.Test");
+		_toast->setClock(_clock.get());
+		_toast->setBackend(_fake.get());
+		QVERIFY(_toast->initialize());
+		_toast->setDuplicateWindow(4000);
+	}
+
+	void cleanup()
+	{
+		_toast.reset();
+		_fake.reset();
+		_clock.reset();
+	}
+
+	void repeatIsSuppressed()
+	{
+		QVERIFY(_toast->showToast(status("Build failed")) >= 0);
+		_clock->advance(3999);
+		QWinToast::QWinToastError error = QWinToast::NoError;
+		QCOMPARE(_toast->showToast(status("Build failed"), &error), qint64(-1));
+		QCOMPARE(error, QWinToast::Duplicate);
+		QVERIFY(_toast->showToast(status("Build passed")) >= 0);
+
+		QCOMPARE(_toast->suppressedDuplicateCount(), quint64(1));
+		QCOMPARE(_fake->payloadCount(), 2);
+	}
+
+	// A repeat is always caught up to the TTL and never past 5/4 of it; it
+	// does not extend the original's TTL.
+	void ttlExpires()
+	{
+		QVERIFY(_toast->showToast(status("Build failed")) >= 0);
+		_clock->advance(4000);
+		QCOMPARE(_toast->showToast(status("Build failed")), qint64(-1));
+		_clock->advance(1000);
+		QVERIFY(_toast->showToast(status("Build failed")) >= 0);
+		QCOMPARE(_toast->suppressedDuplicateCount(), quint64(1));
+
+		_toast->setDuplicateWindow(0);
+		QVERIFY(_toast->showToast(status("Build failed")) >= 0);
+		QCOMPARE(_toast->suppressedDuplicateCount(), quint64(1));
+	}
+
+	// The same content under another (group, tag) is another toast.
+	void groupAndTagAreContent()
+	{
+		QVERIFY(_toast->showToast(status("Done", "build", "progress")) >= 0);
+		QVERIFY(_toast->showToast(status("Done", "upload", "progress")) >= 0);
+		QVERIFY(_toast->showToast(status("Done", "build", "status")) >= 0);
+		QVERIFY(_toast->showToast(status("Done")) >= 0);
+		QCOMPARE(_toast->showToast(status("Done", "upload", "progress")), qint64(-1));
+		QCOMPARE(_toast->suppressedDuplicateCount(), quint64(1));
+		QCOMPARE(_fake->payloadCount(), 4);
+
+		QVERIFY(QWinToastDedupe::contentHash(status("Done", "a", "b"))
+			!= QWinToastDedupe::contentHash(status("Done", "ab", QString())));
+	}
+
+private:
+	std::unique_ptr<QWinToastManualClock> _clock;
+	std::unique_ptr<QWinToastFakeBackend> _fake;
+	std::unique_ptr<QWinToast> _toast;
+};
+
+QTEST_GUILESS_MAIN(TestQWinToastDedupe)
+#include "tst_qwintoastdedupe.moc"
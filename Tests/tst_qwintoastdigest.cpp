@@ -0,0 +1,50 @@
+#include "QWinToast.h"
+#include "QWinToastClock.h"
+#include "QWinToastFakeBackend.h"
+#include <QtTest>
+
+class TestQWinToastDigest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void burstsReplaceTheirSummary()
+	{
+		QWinToastManualClock clock;
+		QWinToastFakeBackend fake;
+		QWinToast toast;
+		toast.setAppName("QWinToastTest");
+		toast.setAppUserModelID("QWinToast.Test");
+		toast.setClock(&clock);
+		toast.setBackend(&fake);
+		QVERIFY(toast.initialize());
+		toast.setDigestWindow(1000);
+
+		QWinToastTemplate templ(QWinToastTemplate::Text02);
+		templ.setTextField("Build", QWinToastTemplate::FirstLine);
+		templ.setDigestKey("builds");
+
+		const qint64 id = toast.showToast(templ);
+		QVERIFY(id >= 0);
+		QCOMPARE(toast.showToast(templ), id);
+		QCOMPARE(toast.showToast(templ), id);
+		QCOMPARE(toast.digestedToastCount(), quint64(2));
+
+		// The window is armed on the toast's thread.
+		QCoreApplication::processEvents();
+		clock.advance(1000);
+		QCOMPARE(fake.payloadCount(), 2);
+		QCOMPARE(fake.lastPayload().request.id, id);
+
+		// The next burst replaces the summary, which still holds the burst tag.
+		QCOMPARE(toast.showToast(templ), id);
+		QCOMPARE(toast.liveToastCount(), 1);
+		QCOMPARE(fake.liveToasts(), QVector<qint64>{ id });
+
+		QVERIFY(toast.hideToast(id));
+		QCOMPARE(toast.liveToastCount(), 0);
+	}
+};
+
+QTEST_GUILESS_MAIN(TestQWinToastDigest)
+#include "tst_qwintoastdigest.moc"
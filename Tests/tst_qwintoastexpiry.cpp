@@ -0,0 +1,213 @@
+#include "QWinToast.h"
+#include "QWinToastClock.h"
+#include "QWinToastExpiry.h"
+#include "QWinToastFakeBackend.h"
+#include <QRandomGenerator>
+#include <QtTest>
+#include <limits>
+
+namespace
+{
+	// Pops everything and checks it against the model, in deadline order.
+	void drainAndCompare(QWinToastExpiryIndex& index, QHash<qint64, qint64> model)
+	{
+		QCOMPARE(index.size(), model.size());
+		for (auto it = model.constBegin(); it != model.constEnd(); ++it) {
+			QCOMPARE(index.deadline(it.key()), it.value());
+		}
+		qint64 previous = -1;
+		qint64 id;
+		while (index.popExpired(std::numeric_limits<qint64>::max(), id)) {
+			QVERIFY(model.contains(id));
+			const qint64 deadline = model.take(id);
+			QVERIFY(deadline >= previous);
+			previous = deadline;
+		}
+		QVERIFY(model.isEmpty());
+		QCOMPARE(index.nextDeadline(), qint64(-1));
+	}
+}
+
+class TestQWinToastExpiry : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void heapOrder()
+	{
+		QRandomGenerator random(1);
+		QWinToastExpiryIndex index;
+		QHash<qint64, qint64> model;
+		for (int i = 0; i < 20000; i++) {
+			const qint64 id = random.bounded(2000);
+			switch (random.bounded(3)) {
+			case 0:
+			case 1: {
+				// New ids and moved deadlines, earlier and later.
+				const qint64 deadline = random.bounded(100000);
+				index.insert(id, deadline);
+				model.insert(id, deadline);
+				break;
+			}
+			default:
+				QCOMPARE(index.remove(id), model.remove(id) > 0);
+				break;
+			}
+			QCOMPARE(index.contains(id), model.contains(id));
+			if (i % 1000 == 0) {
+				qint64 earliest = -1;
+				for (const qint64 deadline : model) {
+					earliest = earliest < 0 ? deadline : qMin(earliest, deadline);
+				}
+				QCOMPARE(index.nextDeadline(), earliest);
+			}
+		}
+		drainAndCompare(index, model);
+	}
+
+	void popExpiredStopsAtNow()
+	{
+		QWinToastExpiryIndex index;
+		index.insert(1, 300);
+		index.insert(2, 100);
+		index.insert(3, 200);
+		qint64 id;
+		QVERIFY(index.popExpired(200, id));
+		QCOMPARE(id, qint64(2));
+		QVERIFY(index.popExpired(200, id));
+		QCOMPARE(id, qint64(3));
+		QVERIFY(!index.popExpired(200, id));
+		QCOMPARE(index.nextDeadline(), qint64(300));
+	}
+
+	// A few ids are removed one by one, a large share by rebuilding the heap.
+	void removeAll_data()
+	{
+		QTest::addColumn<int>("removed");
+		QTest::newRow("per id") << 10;
+		QTest::newRow("rebuild") << 600;
+	}
+
+	void removeAll()
+	{
+		QFETCH(int, removed);
+		QRandomGenerator random(2);
+		QWinToastExpiryIndex index;
+		QHash<qint64, qint64> model;
+		for (qint64 id = 0; id < 1000; id++) {
+			const qint64 deadline = random.bounded(100000);
+			index.insert(id, deadline);
+			model.insert(id, deadline);
+		}
+		QSet<qint64> ids;
+		while (ids.size() < removed) {
+			ids.insert(random.bounded(1000));
+		}
+		// Unknown ids are not counted.
+		ids.insert(5000);
+		QCOMPARE(index.removeAll(ids), removed);
+		for (const qint64 id : ids) {
+			model.remove(id);
+		}
+		drainAndCompare(index, model);
+	}
+
+	void timedOutOnce()
+	{
+		QWinToastManualClock clock(1000);
+		QWinToastFakeBackend fake;
+		QWinToast toast;
+		setUp(toast, fake, clock);
+		QVector<QWinToast::WinToastDismissalReason> dismissed;
+		collect(toast, dismissed);
+
+		const qint64 id = toast.showToast(expiring(1000));
+		QVERIFY(id >= 0);
+		QCoreApplication::processEvents();
+		clock.advance(999);
+		QCOMPARE(dismissed.size(), 0);
+		clock.advance(1);
+		QCOMPARE(dismissed.size(), 1);
+		QCOMPARE(dismissed[0], QWinToast::TimedOut);
+		QCOMPARE(toast.liveToastCount(), 0);
+		QVERIFY(!fake.isLive(id));
+
+		// The grace entry runs out without another report.
+		clock.advance(120000);
+		QCoreApplication::processEvents();
+		QCOMPARE(dismissed.size(), 1);
+		QCOMPARE(clock.pendingCount(), 0);
+	}
+
+	// The shell's own report of the timeout arrives after expireToasts().
+	void lateDismissIsSwallowed()
+	{
+		QWinToastManualClock clock(1000);
+		QWinToastFakeBackend fake;
+		QWinToast toast;
+		setUp(toast, fake, clock);
+		QVector<QWinToast::WinToastDismissalReason> dismissed;
+		collect(toast, dismissed);
+
+		const qint64 id = toast.showToast(expiring(1000));
+		QCoreApplication::processEvents();
+		QVERIFY(fake.dismiss(id, QWinToast::UserCanceled));
+		clock.advance(1000);
+		QCOMPARE(dismissed.size(), 1);
+		QCoreApplication::processEvents();
+		QCOMPARE(dismissed.size(), 1);
+		QCOMPARE(dismissed[0], QWinToast::TimedOut);
+	}
+
+	// The shell reports a timeout as UserCanceled; past the deadline it is one.
+	void userCanceledPastDeadlineIsTimedOut()
+	{
+		QWinToastManualClock clock(1000);
+		QWinToastFakeBackend fake;
+		QWinToast toast;
+		setUp(toast, fake, clock);
+		QVector<QWinToast::WinToastDismissalReason> dismissed;
+		collect(toast, dismissed);
+
+		// Handled after the deadline but before the expiry timer was armed.
+		const qint64 late = toast.showToast(expiring(1000));
+		QVERIFY(fake.dismiss(late, QWinToast::UserCanceled));
+		clock.advance(1000);
+		QCoreApplication::processEvents();
+		QCOMPARE(dismissed.size(), 1);
+		QCOMPARE(dismissed[0], QWinToast::TimedOut);
+
+		const qint64 early = toast.showToast(expiring(1000));
+		QVERIFY(fake.dismiss(early, QWinToast::UserCanceled));
+		QCoreApplication::processEvents();
+		QCOMPARE(dismissed.size(), 2);
+		QCOMPARE(dismissed[1], QWinToast::UserCanceled);
+	}
+
+private:
+	static void setUp(QWinToast& toast, QWinToastFakeBackend& fake, QWinToastManualClock& clock)
+	{
+		toast.setAppName("QWinToastTest");
+		toast.setAppUserModelID("QWinToast.Test");
+		toast.setClock(&clock);
+		toast.setBackend(&fake);
+		QVERIFY(toast.initialize());
+	}
+
+	static void collect(QWinToast& toast, QVector<QWinToast::WinToastDismissalReason>& reasons)
+	{
+		connect(&toast, &QWinToast::toastDismissed, [&reasons](QWinToast::WinToastDismissalReason reason) {
+			reasons.append(reason);
+		});
+	}
+
+	static QWinToastTemplate expiring(qint64 milliseconds)
+	{
+		QWinToastTemplate toast(QWinToastTemplate::Text01);
+		toast.setExpiration(milliseconds);
+		return toast;
+	}
+};
+
+QTEST_GUILESS_MAIN(TestQWinToastExpiry)
+#include "tst_qwintoastexpiry.moc"
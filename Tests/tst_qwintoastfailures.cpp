@@ -0,0 +1,136 @@
+#include "QWinToast.h"
+#include "QWinToastClock.h"
+#include "QWinToastFakeBackend.h"
+#include "QWinToastRetry.h"
+#include <QSignalSpy>
+#include <QThread>
+#include <QtTest>
+
+class TestQWinToastFailures : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void init()
+	{
+		_fake.reset(new QWinToastFakeBackend());
+		_toast.reset(new QWinToast());
+		_toast->setAppName("QWinToastTest");
+		_toast->setAppUserModelID("QWinToast.Test");
+		_toast->setClock(&_clock);
+		_toast->setBackend(_fake.get());
+		QVERIFY(_toast->initialize());
+	}
+
+	void cleanup()
+	{
+		_toast.reset();
+		_fake.reset();
+	}
+
+	// Both ways of giving up emit the same signals; only a returned id is
+	// ever reported.
+	void immediateFailure()
+	{
+		_fake->setFailureRate(1.0);
+		QSignalSpy notDisplayed(_toast.get(), &QWinToast::toastNotDisplayed);
+		QSignalSpy failed(_toast.get(), &QWinToast::toastFailed);
+
+		QWinToast::QWinToastError error = QWinToast::NoError;
+		QCOMPARE(_toast->showToast(QWinToastTemplate(QWinToastTemplate::Text01), &error), qint64(-1));
+		QCOMPARE(error, QWinToast::NotDisplayed);
+		QCOMPARE(notDisplayed.count(), 1);
+		QCOMPARE(notDisplayed.at(0).at(0).toLongLong(), qint64(-1));
+		QCOMPARE(notDisplayed.at(0).at(2).toInt(), 1);
+		QCOMPARE(failed.count(), 1);
+		QCOMPARE(_toast->liveToastCount(), 0);
+	}
+
+	void retriesExhausted()
+	{
+		QWinToastRetryPolicy policy;
+		policy.maxAttempts = 2;
+		_toast->setRetryPolicy(policy);
+		_fake->setFailureRate(1.0);
+		_fake->setFailureResult(QWinToastBackend::Pending);
+		QSignalSpy notDisplayed(_toast.get(), &QWinToast::toastNotDisplayed);
+		QSignalSpy failed(_toast.get(), &QWinToast::toastFailed);
+
+		const qint64 id = _toast->showToast(QWinToastTemplate(QWinToastTemplate::Text01));
+		QVERIFY(id >= 0);
+		QCOMPARE(notDisplayed.count(), 0);
+
+		QCoreApplication::processEvents();
+		_clock.advance(policy.maxDelay);
+		QCOMPARE(notDisplayed.count(), 1);
+		QCOMPARE(notDisplayed.at(0).at(0).toLongLong(), id);
+		QCOMPARE(notDisplayed.at(0).at(2).toInt(), 2);
+		QCOMPARE(failed.count(), 1);
+		QCOMPARE(_toast->liveToastCount(), 0);
+	}
+
+	void failedHideResolvesResult()
+	{
+		qint64 id = -1;
+		const QFuture<QWinToastResult> future = _toast->showToastForResult(QWinToastTemplate(QWinToastTemplate::Text01), nullptr, &id);
+		QVERIFY(id >= 0);
+		// The backend lost the toast, so hiding it fails.
+		_fake->clear(_toast.get(), { id });
+
+		QVERIFY(!_toast->hideToast(id));
+		QVERIFY(future.isFinished());
+		QCOMPARE(future.result().id, id);
+		QCOMPARE(future.result().outcome, QWinToastResult::Failed);
+		QCOMPARE(_toast->liveToastCount(), 0);
+	}
+
+	// The backend forgets a destroyed toast, so later events have no owner.
+	void destroyedToastDetaches()
+	{
+		const qint64 id = _toast->showToast(QWinToastTemplate(QWinToastTemplate::Text01));
+		QVERIFY(id >= 0);
+		QVERIFY(_fake->isLive(id));
+
+		_toast.reset();
+		QVERIFY(!_fake->isLive(id));
+		QVERIFY(!_fake->dismiss(id, QWinToast::UserCanceled));
+	}
+
+	// An event fired from another thread while the toast is destroyed either
+	// reaches it before detach() returns or not at all.
+	void dismissRacesDestruction()
+	{
+		for (int i = 0; i < 500; i++) {
+			std::unique_ptr<QWinToast> toast(new QWinToast());
+			toast->setAppName("QWinToastTest");
+			toast->setAppUserModelID("QWinToast.Test");
+			toast->setBackend(_fake.get());
+			QVERIFY(toast->initialize());
+			const qint64 id = toast->showToast(QWinToastTemplate(QWinToastTemplate::Text01));
+			QVERIFY(id >= 0);
+
+			QAtomicInt started;
+			QThread* thread = QThread::create([this, id, &started]() {
+				started.storeRelease(1);
+				_fake->dismiss(id, QWinToast::UserCanceled);
+			});
+			thread->start();
+			while (!started.loadAcquire()) {
+				QThread::yieldCurrentThread();
+			}
+			toast.reset();
+			QVERIFY(thread->wait(5000));
+			delete thread;
+			QVERIFY(!_fake->isLive(id));
+		}
+		QCoreApplication::processEvents();
+	}
+
+private:
+	QWinToastManualClock _clock;
+	std::unique_ptr<QWinToastFakeBackend> _fake;
+	std::unique_ptr<QWinToast> _toast;
+};
+
+QTEST_GUILESS_MAIN(TestQWinToastFailures)
+#include "tst_qwintoastfailures.moc"
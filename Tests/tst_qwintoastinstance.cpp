@@ -0,0 +1,130 @@
+#include "QWinToast.h"
+#include "QWinToastEventQueue.h"
+#include "QWinToastFakeBackend.h"
+#include <QProcess>
+#include <QSet>
+#include <QTextStream>
+#include <QTimer>
+#include <QtTest>
+
+// The test binary is also the secondary process: started with "--secondary",
+// it forwards its toasts to the primary and waits for their events.
+namespace
+{
+	const int Secondaries = 3;
+	const int ToastsPerSecondary = 50;
+	const int TimeoutMs = 20000;
+
+	void setUp(QWinToast& toast)
+	{
+		toast.setAppName("QWinToastTest");
+		toast.setAppUserModelID("QWinToast.Test");
+	}
+
+	int runSecondary(const QString& key, int count)
+	{
+		QTextStream out(stdout);
+		QWinToast toast;
+		setUp(toast);
+		if (toast.enableSingleInstance(key) || !toast.initialize()) {
+			out << "not a secondary" << endl;
+			return 1;
+		}
+
+		QSet<qint64> shown;
+		QSet<qint64> received;
+		int errors = 0;
+		QObject::connect(&toast, &QWinToast::toastEventsBatch, [&](const QVector<QWinToastEvent>& events) {
+			for (const QWinToastEvent& event : events) {
+				const bool expected = event.type == QWinToastEvent::Activated
+					? event.arguments == "a=1"
+					: event.type == QWinToastEvent::Dismissed && event.reason == QWinToast::UserCanceled;
+				if (!expected || !shown.contains(event.id) || received.contains(event.id)) {
+					errors++;
+				}
+				received.insert(event.id);
+			}
+			if (received.size() + errors >= count) {
+				QCoreApplication::exit(errors == 0 ? 0 : 1);
+			}
+		});
+
+		for (int i = 0; i < count; i++) {
+			QWinToastTemplate templ(QWinToastTemplate::Text02);
+			templ.setTextField(QString("process %1").arg(QCoreApplication::applicationPid()), QWinToastTemplate::FirstLine);
+			templ.setTextField(QString("toast %1").arg(i), QWinToastTemplate::SecondLine);
+			const qint64 id = toast.showToast(templ);
+			if (id < 0) {
+				out << "show failed" << endl;
+				return 1;
+			}
+			shown.insert(id);
+		}
+
+		QTimer::singleShot(TimeoutMs, [] { QCoreApplication::exit(2); });
+		const int result = QCoreApplication::exec();
+		out << (result == 0 ? "ok" : "failed") << ' ' << received.size() << '/' << count << ' ' << errors << endl;
+		return result;
+	}
+}
+
+class TestQWinToastInstance : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void forwardsToPrimary()
+	{
+		const QString key = QString("qwintoast-test-%1").arg(QCoreApplication::applicationPid());
+		QWinToastFakeBackend fake;
+		QWinToast toast;
+		setUp(toast);
+		QVERIFY(toast.enableSingleInstance(key));
+		QVERIFY(toast.isPrimaryInstance());
+		toast.setBackend(&fake);
+		QVERIFY(toast.initialize());
+
+		// Events for forwarded toasts belong to the secondaries.
+		int localEvents = 0;
+		connect(&toast, &QWinToast::toastEventsBatch, [&](const QVector<QWinToastEvent>& events) {
+			localEvents += events.size();
+		});
+
+		QProcess processes[Secondaries];
+		for (QProcess& process : processes) {
+			process.start(QCoreApplication::applicationFilePath(),
+				{ "--secondary", key, QString::number(ToastsPerSecondary) });
+			QVERIFY(process.waitForStarted());
+		}
+
+		QTRY_COMPARE_WITH_TIMEOUT(fake.liveToasts().size(), Secondaries * ToastsPerSecondary, TimeoutMs);
+		// Clearing the primary's own toasts leaves the forwarded ones alone.
+		QVERIFY(toast.showToast(QWinToastTemplate(QWinToastTemplate::Text01)) >= 0);
+		toast.clear();
+		QCOMPARE(fake.liveToasts().size(), Secondaries * ToastsPerSecondary);
+		const QVector<qint64> live = fake.liveToasts();
+		for (int i = 0; i < live.size(); i++) {
+			QVERIFY(i % 2 == 0 ? fake.activate(live[i], "a=1") : fake.dismiss(live[i], QWinToast::UserCanceled));
+		}
+
+		for (QProcess& process : processes) {
+			QTRY_COMPARE_WITH_TIMEOUT(process.state(), QProcess::NotRunning, TimeoutMs);
+			const QByteArray output = process.readAllStandardOutput();
+			QVERIFY2(process.exitStatus() == QProcess::NormalExit && process.exitCode() == 0, output.constData());
+		}
+		QCOMPARE(localEvents, 0);
+		QCOMPARE(fake.liveToasts().size(), 0);
+	}
+};
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+	if (argc == 4 && qstrcmp(argv[1], "--secondary") == 0) {
+		return runSecondary(QString::fromLocal8Bit(argv[2]), atoi(argv[3]));
+	}
+	TestQWinToastInstance test;
+	return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_qwintoastinstance.moc"
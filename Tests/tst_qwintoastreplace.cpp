@@ -0,0 +1,112 @@
+#include "QWinToast.h"
+#include "QWinToastFakeBackend.h"
+#include <QtTest>
+
+namespace
+{
+	QWinToastTemplate status(const QString& text, const QString& group, const QString& tag)
+	{
+		QWinToastTemplate toast(QWinToastTemplate::Text01);
+		toast.setTextField(text, QWinToastTemplate::FirstLine);
+		toast.setGroup(group);
+		toast.setTag(tag);
+		return toast;
+	}
+}
+
+// A tagged toast replaces the live toast with the same (group, tag) in place.
+class TestQWinToastReplace : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void init()
+	{
+		_fake.reset(new QWinToastFakeBackend());
+		_toast.reset(new QWinToast());
+		_toast->setAppName("QWinToastTest");
+		_toast->setAppUserModelID("QWinToast.Test");
+		_toast->setBackend(_fake.get());
+		QVERIFY(_toast->initialize());
+	}
+
+	void cleanup()
+	{
+		_toast.reset();
+		_fake.reset();
+	}
+
+	void sameTagReusesId()
+	{
+		const qint64 id = _toast->showToast(status("50%", "build", "progress"));
+		QVERIFY(id >= 0);
+		QCOMPARE(_toast->showToast(status("75%", "build", "progress")), id);
+		QCOMPARE(_toast->liveToastCount(), 1);
+		QCOMPARE(_fake->payloadCount(), 2);
+
+		// The backend gets the tag and group it replaces by.
+		const QWinToastFakeBackend::Payload payload = _fake->lastPayload();
+		QCOMPARE(payload.request.id, id);
+		QCOMPARE(payload.request.tag, QString("progress"));
+		QCOMPARE(payload.request.group, QString("build"));
+		QVERIFY(payload.request.xml.contains("75%"));
+	}
+
+	void tagIsScopedByGroup()
+	{
+		const qint64 build = _toast->showToast(status("50%", "build", "progress"));
+		const qint64 upload = _toast->showToast(status("50%", "upload", "progress"));
+		const qint64 untagged = _toast->showToast(status("50%", "build", QString()));
+		QVERIFY(build >= 0 && upload >= 0 && untagged >= 0);
+		QVERIFY(build != upload && build != untagged && upload != untagged);
+		QCOMPARE(_toast->liveToastCount(), 3);
+	}
+
+	void dismissReleasesTag()
+	{
+		const qint64 id = _toast->showToast(status("50%", "build", "progress"));
+		QVERIFY(_fake->dismiss(id, QWinToast::UserCanceled));
+		QCoreApplication::processEvents();
+		QCOMPARE(_toast->liveToastCount(), 0);
+
+		const qint64 next = _toast->showToast(status("75%", "build", "progress"));
+		QVERIFY(next >= 0);
+		QVERIFY(next != id);
+	}
+
+	void hideReleasesTag()
+	{
+		const qint64 id = _toast->showToast(status("50%", "build", "progress"));
+		QVERIFY(_toast->hideToast(id));
+		QCOMPARE(_toast->liveToastCount(), 0);
+
+		const qint64 next = _toast->showToast(status("75%", "build", "progress"));
+		QVERIFY(next >= 0);
+		QVERIFY(next != id);
+		QCOMPARE(_fake->liveToasts(), QVector<qint64>{ next });
+	}
+
+	// The replaced toast is still on screen, so it stays tracked under its tag.
+	void failedReplaceKeepsOriginal()
+	{
+		const qint64 id = _toast->showToast(status("50%", "build", "progress"));
+		_fake->setFailureRate(1.0);
+		QWinToast::QWinToastError error = QWinToast::NoError;
+		QCOMPARE(_toast->showToast(status("75%", "build", "progress"), &error), qint64(-1));
+		QCOMPARE(error, QWinToast::NotDisplayed);
+		QCOMPARE(_toast->liveToastCount(), 1);
+		QVERIFY(_fake->isLive(id));
+
+		_fake->setFailureRate(0.0);
+		QCOMPARE(_toast->showToast(status("100%", "build", "progress")), id);
+		QCOMPARE(_toast->liveToastCount(), 1);
+		QVERIFY(_toast->hideToast(id));
+	}
+
+private:
+	std::unique_ptr<QWinToastFakeBackend> _fake;
+	std::unique_ptr<QWinToast> _toast;
+};
+
+QTEST_GUILESS_MAIN(TestQWinToastReplace)
+#include "tst_qwintoastreplace.moc"
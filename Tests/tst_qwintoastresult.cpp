@@ -0,0 +1,96 @@
+#include "QWinToast.h"
+#include "QWinToastClock.h"
+#include "QWinToastFakeBackend.h"
+#include <QtTest>
+
+// Each way a toast resolves fulfils its showToastForResult() future once.
+class TestQWinToastResult : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void init()
+	{
+		_clock.reset(new QWinToastManualClock(1000));
+		_fake.reset(new QWinToastFakeBackend());
+		_toast.reset(new QWinToast());
+		_toast->setAppName("QWinToastTest");
+		_toast->setAppUserModelID("QWinToast.Test");
+		_toast->setClock(_clock.get());
+		_toast->setBackend(_fake.get());
+		QVERIFY(_toast->initialize());
+	}
+
+	void cleanup()
+	{
+		_toast.reset();
+		_fake.reset();
+		_clock.reset();
+	}
+
+	void activatedBody()
+	{
+		qint64 id = -1;
+		const QFuture<QWinToastResult> future = _toast->showToastForResult(QWinToastTemplate(QWinToastTemplate::Text01), nullptr, &id);
+		QVERIFY(id >= 0);
+		QVERIFY(!future.isFinished());
+
+		QVERIFY(_fake->activate(id));
+		QCoreApplication::processEvents();
+		QVERIFY(future.isFinished());
+		const QWinToastResult result = future.result();
+		QCOMPARE(result.outcome, QWinToastResult::Activated);
+		QCOMPARE(result.id, id);
+		QCOMPARE(result.actionIndex, -1);
+		QCOMPARE(result.arguments, QString());
+	}
+
+	void activatedAction()
+	{
+		qint64 id = -1;
+		const QFuture<QWinToastResult> future = _toast->showToastForResult(QWinToastTemplate(QWinToastTemplate::Text02), nullptr, &id);
+		QVERIFY(id >= 0);
+
+		QVERIFY(_fake->activate(id, "a=1&order=42"));
+		QCoreApplication::processEvents();
+		QVERIFY(future.isFinished());
+		const QWinToastResult result = future.result();
+		QCOMPARE(result.outcome, QWinToastResult::Activated);
+		QCOMPARE(result.id, id);
+		QCOMPARE(result.actionIndex, 1);
+		QCOMPARE(result.arguments, QString("a=1&order=42"));
+		QCOMPARE(_toast->liveToastCount(), 0);
+	}
+
+	void timedOut()
+	{
+		QWinToastTemplate toast(QWinToastTemplate::Text01);
+		toast.setExpiration(5000);
+		qint64 id = -1;
+		const QFuture<QWinToastResult> future = _toast->showToastForResult(toast, nullptr, &id);
+		QVERIFY(id >= 0);
+		QCoreApplication::processEvents();
+
+		_clock->advance(4999);
+		QVERIFY(!future.isFinished());
+		_clock->advance(1);
+		QVERIFY(future.isFinished());
+		const QWinToastResult result = future.result();
+		QCOMPARE(result.outcome, QWinToastResult::Dismissed);
+		QCOMPARE(result.id, id);
+		QCOMPARE(result.reason, QWinToast::TimedOut);
+
+		// The shell's own report of the timeout does not resolve it again.
+		QVERIFY(!_fake->dismiss(id, QWinToast::UserCanceled));
+		QCoreApplication::processEvents();
+		QCOMPARE(future.resultCount(), 1);
+	}
+
+private:
+	std::unique_ptr<QWinToastManualClock> _clock;
+	std::unique_ptr<QWinToastFakeBackend> _fake;
+	std::unique_ptr<QWinToast> _toast;
+};
+
+QTEST_GUILESS_MAIN(TestQWinToastResult)
+#include "tst_qwintoastresult.moc"
@@ -0,0 +1,103 @@
+#include "QWinToast.h"
+#include "QWinToastSharedQueue.h"
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QThread>
+#include <QtTest>
+
+// The test binary is also the producer process: started with "--produce", it
+// attaches to the consumer's ring and pushes numbered toasts into it.
+namespace
+{
+	const int Producers = 4;
+	const int ToastsPerProducer = 20000;
+	const int TimeoutMs = 60000;
+
+	int runProducer(const QString& key, int producer, int count)
+	{
+		QWinToastSharedQueue queue(key);
+		if (!queue.attach()) {
+			return 1;
+		}
+		QElapsedTimer timer;
+		timer.start();
+		QWinToastTemplate toast(QWinToastTemplate::Text02);
+		toast.setTextField(QString::number(producer), QWinToastTemplate::FirstLine);
+		for (int i = 0; i < count; i++) {
+			toast.setTextField(QString::number(i), QWinToastTemplate::SecondLine);
+			while (!queue.push(toast)) {
+				if (timer.elapsed() > TimeoutMs) {
+					return 2;
+				}
+				QThread::yieldCurrentThread();
+			}
+		}
+		return 0;
+	}
+}
+
+class TestQWinToastSharedQueue : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	// Every record arrives exactly once and in order per producer, with the
+	// ring small enough to keep producers racing for slots.
+	void multiProcess()
+	{
+		const QString key = QString("qwintoast-test-%1").arg(QCoreApplication::applicationPid());
+		QWinToastSharedQueue queue(key);
+		QVERIFY2(queue.create(64, 128), qPrintable(queue.errorString()));
+
+		QProcess processes[Producers];
+		for (int p = 0; p < Producers; p++) {
+			processes[p].setProcessChannelMode(QProcess::ForwardedChannels);
+			processes[p].start(QCoreApplication::applicationFilePath(),
+				{ "--produce", key, QString::number(p), QString::number(ToastsPerProducer) });
+			QVERIFY(processes[p].waitForStarted());
+		}
+
+		QVector<int> next(Producers, 0);
+		QWinToastTemplate toast;
+		int received = 0;
+		QElapsedTimer timer;
+		timer.start();
+		while (received < Producers * ToastsPerProducer && timer.elapsed() < TimeoutMs) {
+			bool malformed = false;
+			if (!queue.pop(toast, &malformed)) {
+				QThread::yieldCurrentThread();
+				continue;
+			}
+			QVERIFY(!malformed);
+			bool ok = false;
+			const int producer = toast.textField(QWinToastTemplate::FirstLine).toInt(&ok);
+			QVERIFY(ok && producer >= 0 && producer < Producers);
+			QCOMPARE(toast.textField(QWinToastTemplate::SecondLine).toInt(), next[producer]);
+			next[producer]++;
+			received++;
+		}
+		const double seconds = timer.nsecsElapsed() / 1e9;
+
+		for (QProcess& process : processes) {
+			QVERIFY(process.waitForFinished(TimeoutMs));
+			QCOMPARE(process.exitStatus(), QProcess::NormalExit);
+			QCOMPARE(process.exitCode(), 0);
+		}
+		QCOMPARE(received, Producers * ToastsPerProducer);
+		QVERIFY(queue.isEmpty());
+		qInfo("%d records from %d processes through %d slots: %.0f records/s",
+			received, Producers, queue.slotCount(), received / seconds);
+	}
+};
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+	if (argc == 5 && qstrcmp(argv[1], "--produce") == 0) {
+		return runProducer(QString::fromLocal8Bit(argv[2]), atoi(argv[3]), atoi(argv[4]));
+	}
+	TestQWinToastSharedQueue test;
+	return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_qwintoastsharedqueue.moc"
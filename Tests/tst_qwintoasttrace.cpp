@@ -0,0 +1,136 @@
+#include "QToastChannel.h"
+#include "QWinToastCatalog.h"
+#include "QWinToastClock.h"
+#include "QWinToastFakeBackend.h"
+#include "QWinToastTrace.h"
+#include <QBuffer>
+#include <QSignalSpy>
+#include <QtTest>
+
+#define LITERAL(s) { s, static_cast<int>(sizeof(s) / sizeof(char16_t)) - 1, -1, false }
+
+namespace
+{
+	const QWinToastCatalogSegment GreetingSegments[] = {
+		LITERAL(u"<toast><visual><binding template=\"ToastGeneric\"><text>Hello "),
+		{ nullptr, 0, 0, false },
+		LITERAL(u"</text></binding></visual></toast>"),
+	};
+	const char* const GreetingPlaceholders[] = { "name" };
+	const QWinToastCatalogEntry Greeting = {
+		"greeting", GreetingSegments, 3, GreetingSegments, 3, GreetingPlaceholders, 1, 0, u"", u""
+	};
+
+	void setUp(QWinToast& toast, QWinToastFakeBackend& fake)
+	{
+		toast.setAppName("QWinToastTest");
+		toast.setAppUserModelID("QWinToast.Test");
+		toast.setBackend(&fake);
+	}
+}
+
+class TestQWinToastTrace : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	// A throttled show never reaches the pipeline but is still a call the
+	// replay has to make.
+	void throttledShowsAreTraced()
+	{
+		QWinToastManualClock clock(1000);
+		QWinToastFakeBackend fake;
+		QToastChannel channel;
+		setUp(channel, fake);
+		channel.setClock(&clock);
+		QVERIFY(channel.initialize());
+		channel.setMaxToastsPerSecond(1);
+
+		QBuffer buffer;
+		buffer.open(QIODevice::WriteOnly);
+		QWinToastTraceRecorder recorder;
+		channel.setTraceRecorder(&recorder);
+		QVERIFY(recorder.start(&buffer));
+
+		const QWinToastTemplate toast(QWinToastTemplate::Text01);
+		QVERIFY(channel.showToast(toast) >= 0);
+		QWinToast::QWinToastError error = QWinToast::NoError;
+		QCOMPARE(channel.showToast(toast, &error), qint64(-1));
+		QCOMPARE(error, QWinToast::Throttled);
+		recorder.stop();
+
+		QCOMPARE(recorder.recordCount(), quint64(2));
+		QCOMPARE(channel.counters().throttled, quint64(1));
+		QCOMPARE(channel.counters().failed, quint64(0));
+	}
+
+	void catalogShowsAreReplayed()
+	{
+		QWinToastFakeBackend recordedFake;
+		QWinToast recorded;
+		setUp(recorded, recordedFake);
+		QVERIFY(recorded.initialize());
+
+		QBuffer buffer;
+		buffer.open(QIODevice::WriteOnly);
+		QWinToastTraceRecorder recorder;
+		recorded.setTraceRecorder(&recorder);
+		QVERIFY(recorder.start(&buffer));
+		QVERIFY(recorded.showCatalogToast(Greeting, { "Diana" }) >= 0);
+		recorder.stop();
+		QCOMPARE(recorder.recordCount(), quint64(1));
+
+		QWinToastFakeBackend replayedFake;
+		QWinToast replayed;
+		setUp(replayed, replayedFake);
+		QVERIFY(replayed.initialize());
+		buffer.close();
+		buffer.open(QIODevice::ReadOnly);
+		QWinToastTraceReplayer replayer(&replayed);
+		QVERIFY2(replayer.load(&buffer), qPrintable(replayer.errorString()));
+		replayer.addCatalogEntry(Greeting);
+		replayer.setSpeed(0);
+		QSignalSpy finished(&replayer, &QWinToastTraceReplayer::finished);
+		replayer.start();
+		QVERIFY(finished.count() == 1 || finished.wait());
+
+		QCOMPARE(replayer.stats().shown, quint64(1));
+		QCOMPARE(replayer.stats().skippedShows, quint64(0));
+		QCOMPARE(replayedFake.lastPayload().request.xml, recordedFake.lastPayload().request.xml);
+		QVERIFY(replayedFake.lastPayload().request.xml.contains("Hello Diana"));
+	}
+
+	// Without the entry the show is counted, not guessed at.
+	void unknownCatalogEntriesAreSkipped()
+	{
+		QWinToastFakeBackend fake;
+		QWinToast toast;
+		setUp(toast, fake);
+		QVERIFY(toast.initialize());
+
+		QBuffer buffer;
+		buffer.open(QIODevice::WriteOnly);
+		QWinToastTraceRecorder recorder;
+		toast.setTraceRecorder(&recorder);
+		QVERIFY(recorder.start(&buffer));
+		QVERIFY(toast.showCatalogToast(Greeting, { "Diana" }) >= 0);
+		recorder.stop();
+		toast.setTraceRecorder(nullptr);
+
+		buffer.close();
+		buffer.open(QIODevice::ReadOnly);
+		QWinToastTraceReplayer replayer(&toast);
+		QVERIFY(replayer.load(&buffer));
+		replayer.setSpeed(0);
+		QSignalSpy finished(&replayer, &QWinToastTraceReplayer::finished);
+		replayer.start();
+		QVERIFY(finished.count() == 1 || finished.wait());
+
+		QCOMPARE(replayer.stats().shown, quint64(0));
+		QCOMPARE(replayer.stats().skippedShows, quint64(1));
+		QCOMPARE(fake.payloadCount(), 1);
+	}
+};
+
+QTEST_GUILESS_MAIN(TestQWinToastTrace)
+#include "tst_qwintoasttrace.moc"
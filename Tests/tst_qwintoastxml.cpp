@@ -0,0 +1,338 @@
+#include "QWinToast.h"
+#include "QWinToastXml.h"
+#include <QDomDocument>
+#include <QRandomGenerator>
+#include <QXmlStreamReader>
+#include <QtTest>
+#include <algorithm>
+
+// Checks the string writer against the DOM it replaced: every payload has to
+// parse and describe the same tree a DOM would have held for the template,
+// with XML-invalid input replaced the same way.
+namespace
+{
+	const char* const TemplateNames[] = {
+		"ToastImageAndText01", "ToastImageAndText02", "ToastImageAndText03", "ToastImageAndText04",
+		"ToastText01", "ToastText02", "ToastText03", "ToastText04"
+	};
+
+	typedef QVector<QPair<QString, QString>> Attributes;
+
+	QString randomText(QRandomGenerator& random, int maxLength)
+	{
+		static const ushort Pool[] = {
+			'&', '<', '>', '"', '\'', 0x0, 0x1, '\t', '\n', '\r', 0x1F, 0x7F,
+			0xD800, 0xDBFF, 0xDC00, 0xDFFF, 0xFFFE, 0xFFFF, 0xFFFD, 0x4E2D
+		};
+		const int length = random.bounded(maxLength + 1);
+		QString text;
+		text.reserve(length + 1);
+		while (text.size() < length) {
+			switch (random.bounded(5)) {
+			case 0:
+				text += QChar(Pool[random.bounded(int(sizeof(Pool) / sizeof(Pool[0])))]);
+				break;
+			case 1:
+				text += QChar(static_cast<ushort>(random.bounded(0x10000)));
+				break;
+			case 2:
+				// A valid pair, U+1F600.
+				text += QChar(0xD83D);
+				text += QChar(0xDE00);
+				break;
+			default:
+				text += QChar(static_cast<ushort>('a' + random.bounded(26)));
+				break;
+			}
+		}
+		return text;
+	}
+
+	// What a DOM text node or attribute holds once XML-invalid code units
+	// are replaced.
+	QString referenceClean(const QString& text)
+	{
+		QString out;
+		for (int i = 0; i < text.size(); i++) {
+			const ushort c = text[i].unicode();
+			if (QChar::isHighSurrogate(c) && i + 1 < text.size() && text[i + 1].isLowSurrogate()) {
+				out += text[i];
+				out += text[++i];
+				continue;
+			}
+			const bool valid = c == '\t' || c == '\n' || c == '\r'
+				|| (c >= 0x20 && !QChar::isSurrogate(c) && c != 0xFFFE && c != 0xFFFF);
+			out += valid ? QChar(c) : QChar(0xFFFD);
+		}
+		return out;
+	}
+
+	// Length-prefixed so no content can be mistaken for structure.
+	QString field(const QString& value)
+	{
+		return QString::number(value.size()) + QLatin1Char(':') + value;
+	}
+
+	QString startToken(const QString& name, Attributes attributes)
+	{
+		std::sort(attributes.begin(), attributes.end());
+		QString out = QLatin1Char('(') + name;
+		for (const auto& attribute : attributes) {
+			out += QLatin1Char(' ') + attribute.first + QLatin1Char('=') + field(attribute.second);
+		}
+		return out + QLatin1Char(' ');
+	}
+
+	void flushText(QString& out, QString& text)
+	{
+		if (!text.isEmpty()) {
+			out += QLatin1Char('T') + field(text);
+			text.clear();
+		}
+	}
+
+	// Parses the writer's output with a conforming reader; character data is
+	// kept exactly, whitespace included.
+	QString canonicalPayload(const QString& xml, QString& error)
+	{
+		QXmlStreamReader reader(xml);
+		QString out;
+		QString text;
+		while (!reader.atEnd()) {
+			reader.readNext();
+			if (reader.isCharacters()) {
+				text += reader.text();
+				continue;
+			}
+			flushText(out, text);
+			if (reader.isStartElement()) {
+				Attributes attributes;
+				for (const QXmlStreamAttribute& attribute : reader.attributes()) {
+					attributes.append(qMakePair(attribute.name().toString(), attribute.value().toString()));
+				}
+				out += startToken(reader.name().toString(), attributes);
+			}
+			else if (reader.isEndElement()) {
+				out += QLatin1Char(')');
+			}
+		}
+		if (reader.hasError()) {
+			error = reader.errorString();
+		}
+		return out;
+	}
+
+	void canonicalElement(const QDomElement& element, QString& out)
+	{
+		Attributes attributes;
+		const QDomNamedNodeMap map = element.attributes();
+		for (int i = 0; i < map.count(); i++) {
+			const QDomAttr attribute = map.item(i).toAttr();
+			attributes.append(qMakePair(attribute.name(), attribute.value()));
+		}
+		out += startToken(element.tagName(), attributes);
+		QString text;
+		for (QDomNode child = element.firstChild(); !child.isNull(); child = child.nextSibling()) {
+			if (child.isText()) {
+				text += child.nodeValue();
+				continue;
+			}
+			flushText(out, text);
+			if (child.isElement()) {
+				canonicalElement(child.toElement(), out);
+			}
+		}
+		flushText(out, text);
+		out += QLatin1Char(')');
+	}
+
+	QDomElement appendElement(QDomDocument& document, QDomNode parent, const QString& name)
+	{
+		QDomElement element = document.createElement(name);
+		parent.appendChild(element);
+		return element;
+	}
+
+	// The tree the former DOM helpers built for a template.
+	QDomDocument referenceDocument(const QWinToastTemplate& toast, bool modernFeatures)
+	{
+		const bool hasActions = modernFeatures && toast.actionsCount() > 0;
+		QDomDocument document;
+		QDomElement root = appendElement(document, document, "toast");
+		if (modernFeatures) {
+			if (toast.duration() != QWinToastTemplate::Duration::System) {
+				root.setAttribute("duration", toast.duration() == QWinToastTemplate::Duration::Short ? "short" : "long");
+			}
+			else if (hasActions) {
+				root.setAttribute("duration", "long");
+			}
+			root.setAttribute("scenario", referenceClean(toast.scenario()));
+			if (hasActions) {
+				root.setAttribute("template", "ToastGeneric");
+			}
+		}
+		QDomElement binding = appendElement(document, appendElement(document, root, "visual"), "binding");
+		binding.setAttribute("template", TemplateNames[toast.type()]);
+		if (toast.hasImage()) {
+			QDomElement image = appendElement(document, binding, "image");
+			image.setAttribute("id", "1");
+			image.setAttribute("src", "file:///" + referenceClean(toast.imagePath()));
+		}
+		for (std::size_t i = 0; i < toast.textFieldsCount(); i++) {
+			QDomElement text = appendElement(document, binding, "text");
+			text.setAttribute("id", QString::number(i + 1));
+			text.appendChild(document.createTextNode(referenceClean(toast.textField(QWinToastTemplate::TextField(i)))));
+		}
+		if (modernFeatures && !toast.attributionText().isEmpty()) {
+			QDomElement text = appendElement(document, binding, "text");
+			text.setAttribute("placement", "attribution");
+			text.appendChild(document.createTextNode(referenceClean(toast.attributionText())));
+		}
+		if (hasActions) {
+			QDomElement actions = appendElement(document, root, "actions");
+			for (std::size_t i = 0; i < toast.actionsCount(); i++) {
+				QDomElement action = appendElement(document, actions, "action");
+				action.setAttribute("content", referenceClean(toast.actionLabel(i)));
+				QString arguments = "a=" + QString::number(i);
+				if (!toast.actionArguments(i).isEmpty()) {
+					arguments += '&' + referenceClean(toast.actionArguments(i));
+				}
+				action.setAttribute("arguments", arguments);
+			}
+		}
+		if (modernFeatures
+			&& (!toast.audioPath().isEmpty() || toast.audioOption() != QWinToastTemplate::AudioOption::Default)) {
+			QDomElement audio = appendElement(document, root, "audio");
+			if (!toast.audioPath().isEmpty()) {
+				audio.setAttribute("src", referenceClean(toast.audioPath()));
+			}
+			if (toast.audioOption() == QWinToastTemplate::AudioOption::Loop) {
+				audio.setAttribute("loop", "true");
+			}
+			else if (toast.audioOption() == QWinToastTemplate::AudioOption::Silent) {
+				audio.setAttribute("silent", "true");
+			}
+		}
+		return document;
+	}
+
+	QWinToastTemplate randomTemplate(QRandomGenerator& random)
+	{
+		QWinToastTemplate toast(static_cast<QWinToastTemplate::WinToastTemplateType>(random.bounded(8)));
+		for (std::size_t i = 0; i < toast.textFieldsCount(); i++) {
+			toast.setTextField(randomText(random, 40), QWinToastTemplate::TextField(i));
+		}
+		if (random.bounded(2)) {
+			toast.setAttributionText(randomText(random, 20));
+		}
+		if (random.bounded(2)) {
+			toast.setImagePath(randomText(random, 30));
+		}
+		const int actions = random.bounded(4);
+		for (int i = 0; i < actions; i++) {
+			if (random.bounded(2)) {
+				toast.addAction(randomText(random, 12));
+			}
+			else {
+				toast.addAction(randomText(random, 12), randomText(random, 12));
+			}
+		}
+		if (random.bounded(2)) {
+			toast.setAudioPath(randomText(random, 30));
+		}
+		toast.setAudioOption(static_cast<QWinToastTemplate::AudioOption>(random.bounded(3)));
+		toast.setDuration(static_cast<QWinToastTemplate::Duration>(random.bounded(3)));
+		toast.setScenario(static_cast<QWinToastTemplate::Scenario>(random.bounded(4)));
+		return toast;
+	}
+
+	QString escapedWith(bool vectorized, const QString& text)
+	{
+		const ushort* src = text.utf16();
+		const int length = vectorized ? QWinToastXml::escapedLength(src, text.size())
+			: QWinToastXml::escapedLengthScalar(src, text.size());
+		QString out(length, Qt::Uninitialized);
+		ushort* dst = reinterpret_cast<ushort*>(out.data());
+		ushort* end = vectorized ? QWinToastXml::escape(src, text.size(), dst)
+			: QWinToastXml::escapeScalar(src, text.size(), dst);
+		out.truncate(static_cast<int>(end - dst));
+		return out;
+	}
+}
+
+class TestQWinToastXml : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void escape_data()
+	{
+		QTest::addColumn<QString>("input");
+		QTest::addColumn<QString>("expected");
+
+		const QString replacement(QChar(0xFFFD));
+		QTest::newRow("plain") << QString("toast") << QString("toast");
+		QTest::newRow("specials") << QString("&<>\"'") << QString("&amp;&lt;&gt;&quot;&apos;");
+		QTest::newRow("whitespace") << QString("a\tb\nc\rd") << QString("a&#x9;b&#xA;c&#xD;d");
+		QTest::newRow("controls") << QString(QChar(0x1)) + "x" + QChar(0x1F) + QChar(0x0)
+			<< replacement + "x" + replacement + replacement;
+		QTest::newRow("lone high surrogate") << QString(QChar(0xD800)) + "x" << replacement + "x";
+		QTest::newRow("lone low surrogate") << "x" + QString(QChar(0xDC00)) << "x" + replacement;
+		QTest::newRow("trailing high surrogate") << "x" + QString(QChar(0xDBFF)) << "x" + replacement;
+		QTest::newRow("surrogate pair") << QString::fromUtf8("\xF0\x9F\x98\x80") << QString::fromUtf8("\xF0\x9F\x98\x80");
+		QTest::newRow("noncharacters") << QString(QChar(0xFFFE)) + QChar(0xFFFF) << replacement + replacement;
+		// Specials past the first vector block and at its boundaries.
+		QTest::newRow("long") << QString(15, 'a') + "&" + QString(16, 'b') + "<" + QString(7, 'c') + QChar(0xD800)
+			<< QString(15, 'a') + "&amp;" + QString(16, 'b') + "&lt;" + QString(7, 'c') + replacement;
+		QTest::newRow("pair across blocks") << QString(7, 'a') + QString::fromUtf8("\xF0\x9F\x98\x80") + QString(15, 'b')
+			<< QString(7, 'a') + QString::fromUtf8("\xF0\x9F\x98\x80") + QString(15, 'b');
+	}
+
+	void escape()
+	{
+		QFETCH(QString, input);
+		QFETCH(QString, expected);
+		QCOMPARE(QWinToastXml::escaped(input), expected);
+		QCOMPARE(escapedWith(true, input), expected);
+		QCOMPARE(escapedWith(false, input), expected);
+	}
+
+	void kernelsAgree()
+	{
+		QRandomGenerator random(26);
+		for (int i = 0; i < 20000; i++) {
+			const QString text = randomText(random, 100);
+			const QString scalar = escapedWith(false, text);
+			QCOMPARE(escapedWith(true, text), scalar);
+			QCOMPARE(QWinToastXml::escaped(text), scalar);
+		}
+	}
+
+	void payloadMatchesDom_data()
+	{
+		QTest::addColumn<bool>("modernFeatures");
+		QTest::newRow("modern") << true;
+		QTest::newRow("legacy") << false;
+	}
+
+	void payloadMatchesDom()
+	{
+		QFETCH(bool, modernFeatures);
+		QRandomGenerator random(modernFeatures ? 1 : 2);
+		for (int i = 0; i < 2000; i++) {
+			const QWinToastTemplate toast = randomTemplate(random);
+			const QString payload = QWinToastXml::toastPayload(toast, modernFeatures);
+			QString error;
+			const QString actual = canonicalPayload(payload, error);
+			QVERIFY2(error.isEmpty(), qPrintable(error + ": " + payload));
+
+			QString expected;
+			canonicalElement(referenceDocument(toast, modernFeatures).documentElement(), expected);
+			QCOMPARE(actual, expected);
+		}
+	}
+};
+
+QTEST_APPLESS_MAIN(TestQWinToastXml)
+
+#include "tst_qwintoastxml.moc"